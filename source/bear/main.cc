@@ -21,28 +21,77 @@
 #include "libflags/Flags.h"
 #include "libresult/Result.h"
 #include "libsys/Environment.h"
+#include "libsys/Errors.h"
 #include "libsys/Process.h"
 #include "libsys/Signal.h"
 #include "libmain/ApplicationFromArgs.h"
 #include "libmain/main.h"
+#include "Application.h"
+#include "collect/db/EventsDatabaseReader.h"
 
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/stdout_sinks.h>
 
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <filesystem>
+#include <fstream>
+#include <iostream>
 #include <optional>
+#include <string>
 #include <string_view>
+#include <thread>
 #include <utility>
 
 namespace fs = std::filesystem;
+namespace db = ic::collect::db;
 
 namespace {
 
     constexpr std::optional<std::string_view> ADVANCED_GROUP = {"advanced options"};
     constexpr std::optional<std::string_view> DEVELOPER_GROUP = {"developer options"};
 
+    // A 64 bit FNV-1a hash, the key function of the result cache below.
+    constexpr uint64_t HASH_BASIS = UINT64_C(0xcbf29ce484222325);
+    constexpr uint64_t HASH_PRIME = UINT64_C(0x100000001b3);
+
+    uint64_t hash_bytes(uint64_t hash, const void *data, size_t size) {
+        const auto *bytes = static_cast<const unsigned char *>(data);
+        for (size_t idx = 0; idx < size; ++idx) {
+            hash = (hash ^ bytes[idx]) * HASH_PRIME;
+        }
+        return hash;
+    }
+
+    // The content hash of a file. Zero when the file is not readable
+    // (and never zero otherwise, so zero stays the "absent" marker).
+    uint64_t hash_file(const fs::path &file) {
+        const int fd = ::open(file.c_str(), O_RDONLY);
+        if (fd == -1) {
+            return 0;
+        }
+        uint64_t hash = HASH_BASIS;
+        char buffer[64 * 1024];
+        for (;;) {
+            const ssize_t count = ::read(fd, buffer, sizeof(buffer));
+            if (count <= 0) {
+                break;
+            }
+            hash = hash_bytes(hash, buffer, static_cast<size_t>(count));
+        }
+        ::close(fd);
+        return (hash == 0) ? 1 : hash;
+    }
+
     rust::Result<sys::Process::Builder>
-    prepare_intercept(const flags::Arguments &arguments, const sys::env::Vars &environment, const fs::path &output) {
+    prepare_intercept(const flags::Arguments &arguments, const sys::env::VarsPtr &environment, const fs::path &output) {
         auto program = arguments.as_string(cmd::bear::FLAG_INTERCEPT);
         auto command = arguments.as_string_list(cmd::intercept::FLAG_COMMAND);
         auto library = arguments.as_string(cmd::intercept::FLAG_LIBRARY);
@@ -51,10 +100,12 @@ namespace {
         auto verbose = arguments.as_bool(flags::VERBOSE).unwrap_or(false);
         auto force_wrapper = arguments.as_bool(cmd::intercept::FLAG_FORCE_WRAPPER).unwrap_or(false);
         auto force_preload = arguments.as_bool(cmd::intercept::FLAG_FORCE_PRELOAD).unwrap_or(false);
+        auto prune = arguments.as_string(cmd::intercept::FLAG_PRUNE);
+        auto capture_env = arguments.as_string(cmd::intercept::FLAG_CAPTURE_ENV);
 
         return rust::merge(program, command, rust::merge(library, wrapper, wrapper_dir))
                 .map<sys::Process::Builder>(
-                        [&environment, &output, &verbose, &force_wrapper, &force_preload](auto tuple) {
+                        [&environment, &output, &verbose, &force_wrapper, &force_preload, &prune, &capture_env](auto tuple) {
                             const auto&[program, command, pack] = tuple;
                             const auto&[library, wrapper, wrapper_dir] = pack;
 
@@ -71,6 +122,12 @@ namespace {
                             if (force_preload) {
                                 builder.add_argument(cmd::intercept::FLAG_FORCE_PRELOAD);
                             }
+                            if (prune.is_ok()) {
+                                builder.add_argument(cmd::intercept::FLAG_PRUNE).add_argument(prune.unwrap());
+                            }
+                            if (capture_env.is_ok()) {
+                                builder.add_argument(cmd::intercept::FLAG_CAPTURE_ENV).add_argument(capture_env.unwrap());
+                            }
                             if (verbose) {
                                 builder.add_argument(flags::VERBOSE);
                             }
@@ -81,11 +138,10 @@ namespace {
     }
 
     rust::Result<sys::Process::Builder>
-    prepare_citnames(const flags::Arguments &arguments, const sys::env::Vars &environment, const fs::path &input) {
+    prepare_citnames(const flags::Arguments &arguments, const sys::env::VarsPtr &environment, const fs::path &input, bool append) {
         auto program = arguments.as_string(cmd::bear::FLAG_CITNAMES);
         auto output = arguments.as_string(cmd::citnames::FLAG_OUTPUT);
         auto config = arguments.as_string(cmd::citnames::FLAG_CONFIG);
-        auto append = arguments.as_bool(cmd::citnames::FLAG_APPEND).unwrap_or(false);
         auto verbose = arguments.as_bool(flags::VERBOSE).unwrap_or(false);
 
         return rust::merge(program, output)
@@ -130,34 +186,340 @@ namespace {
                 });
     }
 
+    // Serializes the result updates of concurrent bear runs sharing one
+    // output path. The builds themselves run in parallel (each session
+    // records into its own events database); only the short citnames
+    // phase holds the advisory lock on `<result>.lock`. The lock file
+    // stays behind (removing it would race a waiting session); it is an
+    // empty file next to the result.
+    class OutputLock {
+    public:
+        explicit OutputLock(const fs::path &result) noexcept
+                : fd_(::open((result.string() + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644))
+        {
+            if (fd_ != -1 && ::flock(fd_, LOCK_EX) != 0) {
+                spdlog::warn("Locking the output failed ({}): {}; continuing without.",
+                             result.string(), sys::error_string(errno));
+                ::close(fd_);
+                fd_ = -1;
+            }
+        }
+
+        ~OutputLock() noexcept
+        {
+            // closing the descriptor releases the lock too.
+            if (fd_ != -1) {
+                ::close(fd_);
+            }
+        }
+
+        [[nodiscard]] bool locked() const noexcept { return fd_ != -1; }
+
+        NON_COPYABLE_NOR_MOVABLE(OutputLock);
+
+    private:
+        int fd_;
+    };
+
     struct Command : ps::Command {
     public:
-        Command(const sys::Process::Builder& intercept, const sys::Process::Builder& citnames, fs::path output) noexcept
+        Command(const sys::Process::Builder& intercept,
+                const sys::Process::Builder& citnames,
+                const sys::Process::Builder& citnames_append,
+                fs::path output,
+                fs::path result,
+                std::optional<fs::path> config,
+                bool stream,
+                bool watch,
+                bool in_process,
+                const char **envp) noexcept
                 : ps::Command()
                 , intercept_(intercept)
                 , citnames_(citnames)
+                , citnames_append_(citnames_append)
                 , output_(std::move(output))
+                , result_(std::move(result))
+                , config_(std::move(config))
+                , stream_(stream)
+                , watch_(watch)
+                , in_process_(in_process)
+                , envp_(envp)
         { }
 
         [[nodiscard]] rust::Result<int> execute() const override
         {
+            if (!watch_) {
+                return run_build(citnames_);
+            }
+            // The first round honors the append flag as given; the later
+            // rounds always append, so the database is patched with the
+            // new entries instead of being rebuilt from scratch.
+            auto result = run_build(citnames_);
+            while (result.is_ok() && await_trigger()) {
+                result = run_build(citnames_append_);
+            }
+            return result;
+        }
+
+        NON_DEFAULT_CONSTRUCTABLE(Command);
+        NON_COPYABLE_NOR_MOVABLE(Command);
+
+    private:
+        [[nodiscard]] rust::Result<int> run_build(const sys::Process::Builder &citnames) const
+        {
+            if (stream_) {
+                std::error_code error_code;
+                fs::remove(output_, error_code);
+                if (::mkfifo(output_.c_str(), 0600) == 0) {
+                    return execute_piped(citnames);
+                }
+                spdlog::warn("Creating pipe failed ({}): {}; running the tools in sequence.",
+                             output_.string(), sys::error_string(errno));
+            }
+            return execute_serial(citnames);
+        }
+
+        // Blocks until the next build is requested. Returns false when the
+        // input is closed, which ends the watch loop.
+        [[nodiscard]] static bool await_trigger()
+        {
+            std::cerr << "bear: press enter to run the build again (end of input quits)" << std::endl;
+            std::string line;
+            return static_cast<bool>(std::getline(std::cin, line));
+        }
+
+        rust::Result<int> run_citnames(const sys::Process::Builder &citnames) const
+        {
+            return (in_process_)
+                ? run_citnames_here(citnames)
+                : ::execute(citnames, "citnames");
+        }
+
+        // Runs the semantic phase in this process: the prepared command
+        // line drives the linked citnames application directly, which
+        // spares the process spawn and the flag parsing of a child.
+        [[nodiscard]] rust::Result<int> run_citnames_here(const sys::Process::Builder &citnames) const
+        {
+            sys::Process::Builder builder(citnames);
+            auto arguments = builder.arguments();
+            const auto argc = static_cast<int>(arguments.size() - 1);
+            const auto argv = const_cast<const char **>(arguments.data());
+
+            const cs::Application application;
+            return application.parse(argc, argv)
+                    .and_then<ps::CommandPtr>([this, &application](const auto &args) {
+                        return application.command(args, envp_);
+                    })
+                    .and_then<int>([](const auto &command) {
+                        return command->execute();
+                    })
+                    .on_error([](const auto &error) {
+                        spdlog::warn("Running citnames failed: {}", error.what());
+                    })
+                    .on_success([](auto code) {
+                        spdlog::debug("Running citnames finished. [Exited with {}]", code);
+                    });
+        }
+
+        // The key of the cached result: the content of the events
+        // database, and the citnames invocation (its flags and the
+        // configuration file content) which consumed it.
+        struct CacheKey {
+            uint64_t events;
+            uint64_t invocation;
+        };
+
+        [[nodiscard]] CacheKey cache_key(const sys::Process::Builder &citnames) const
+        {
+            // the writer keeps a running hash of the records in the index
+            // footer; an unindexed database is hashed by content here.
+            uint64_t events = db::EventsDatabaseReader::from(output_)
+                    .map<uint64_t>([](const auto &reader) { return reader->content_hash(); })
+                    .unwrap_or(0);
+            if (events == 0) {
+                events = hash_file(output_);
+            }
+            uint64_t invocation = HASH_BASIS;
+            sys::Process::Builder builder(citnames);
+            for (const char *argument : builder.arguments()) {
+                if (argument != nullptr) {
+                    invocation = hash_bytes(invocation, argument, std::strlen(argument) + 1);
+                }
+            }
+            if (config_) {
+                invocation = (invocation ^ hash_file(config_.value())) * HASH_PRIME;
+            }
+            return {events, invocation};
+        }
+
+        [[nodiscard]] fs::path cache_file() const
+        {
+            fs::path result = result_;
+            result += ".cache";
+            return result;
+        }
+
+        // True when the stored key matches and the result file is still
+        // the one citnames wrote: the same events with the same
+        // invocation reproduce the same result, so the semantic phase
+        // can be skipped.
+        [[nodiscard]] bool cache_hit(const CacheKey &key) const
+        {
+            std::ifstream stream(cache_file());
+            CacheKey stored = {0, 0};
+            uint64_t result_hash = 0;
+            if (!(stream >> stored.events >> stored.invocation >> result_hash)) {
+                return false;
+            }
+            return key.events != 0
+                && key.events == stored.events
+                && key.invocation == stored.invocation
+                && result_hash != 0
+                && result_hash == hash_file(result_);
+        }
+
+        void store_cache(const CacheKey &key) const
+        {
+            if (key.events == 0) {
+                return;
+            }
+            std::ofstream stream(cache_file());
+            stream << key.events << ' ' << key.invocation << ' ' << hash_file(result_) << std::endl;
+        }
+
+        // The two phase run: intercept to completion, then citnames on the
+        // finished events database. An unchanged events database with an
+        // unchanged invocation skips the semantic phase: CI machines
+        // re-run identical builds constantly, where this replaces the
+        // whole citnames run with a hash comparison.
+        [[nodiscard]] rust::Result<int> execute_serial(const sys::Process::Builder &citnames) const
+        {
+            const uint64_t result_before = hash_file(result_);
             auto result = ::execute(intercept_, "intercept");
 
             std::error_code error_code;
             if (fs::exists(output_, error_code)) {
-                ::execute(citnames_, "citnames");
+                // concurrent sessions serialize only here: the lock
+                // covers the result update. A result which changed while
+                // this session was building was written by a concurrent
+                // session; then this one merges into it by appending,
+                // so the sessions converge on a single database.
+                const OutputLock lock(result_);
+                const bool merge = lock.locked() && hash_file(result_) != result_before;
+                const sys::Process::Builder &tool = merge ? citnames_append_ : citnames;
+                const CacheKey key = cache_key(tool);
+                if (cache_hit(key)) {
+                    spdlog::debug("events are unchanged since the last run; skipping citnames.");
+                } else {
+                    run_citnames(tool)
+                            .on_success([this, &key](auto code) {
+                                if (code == EXIT_SUCCESS) {
+                                    store_cache(key);
+                                }
+                            });
+                }
                 fs::remove(output_, error_code);
             }
             return result;
         }
 
-        NON_DEFAULT_CONSTRUCTABLE(Command);
-        NON_COPYABLE_NOR_MOVABLE(Command);
+        // The overlapped run: the events flow through a pipe, so the
+        // semantic recognition happens while the build is still running.
+        // The citnames process is spawned first, and blocks on opening the
+        // pipe until the intercept process opens it for writing.
+        [[nodiscard]] rust::Result<int> execute_piped(const sys::Process::Builder &citnames_to_run) const
+        {
+            if (in_process_) {
+                return execute_piped_here(citnames_to_run);
+            }
+            sys::Process::Builder citnames_builder(citnames_to_run);
+            sys::Process::Builder intercept_builder(intercept_);
+            auto citnames = citnames_builder.spawn();
+            auto result = intercept_builder.spawn()
+                    .on_error([this, &citnames](const auto &) {
+                        // the consumer waits on the pipe; give it the end
+                        // of stream. (it is running, so the open is short.)
+                        if (citnames.is_ok()) {
+                            if (const int fd = ::open(output_.c_str(), O_WRONLY); fd != -1) {
+                                ::close(fd);
+                            }
+                        }
+                    })
+                    .and_then<sys::ExitStatus>([](auto child) {
+                        sys::SignalForwarder guard(child);
+                        return child.wait();
+                    })
+                    .map<int>([](auto status) {
+                        return status.code().value_or(EXIT_FAILURE);
+                    })
+                    .map_err<std::runtime_error>([](auto error) {
+                        spdlog::warn("Running intercept failed: {}", error.what());
+                        return error;
+                    });
+            citnames.and_then<sys::ExitStatus>([](auto child) {
+                        return child.wait();
+                    })
+                    .map<int>([](auto status) {
+                        return status.code().value_or(EXIT_FAILURE);
+                    })
+                    .on_error([](const auto &error) {
+                        spdlog::warn("Running citnames failed: {}", error.what());
+                    })
+                    .on_success([](auto code) {
+                        spdlog::debug("Running citnames finished. [Exited with {}]", code);
+                    });
+            std::error_code error_code;
+            fs::remove(output_, error_code);
+            return result;
+        }
+
+        // The overlapped in-process run: the semantic phase runs on a
+        // thread of this process, blocking on the pipe until the
+        // intercept process opens it for writing.
+        [[nodiscard]] rust::Result<int> execute_piped_here(const sys::Process::Builder &citnames_to_run) const
+        {
+            rust::Result<int> citnames_result = rust::Ok(EXIT_SUCCESS);
+            std::thread citnames([this, &citnames_to_run, &citnames_result]() {
+                citnames_result = run_citnames_here(citnames_to_run);
+            });
+            sys::Process::Builder intercept_builder(intercept_);
+            auto result = intercept_builder.spawn()
+                    .on_error([this](const auto &) {
+                        // the consumer waits on the pipe; give it the end
+                        // of stream. (it is running, so the open is short.)
+                        if (const int fd = ::open(output_.c_str(), O_WRONLY); fd != -1) {
+                            ::close(fd);
+                        }
+                    })
+                    .and_then<sys::ExitStatus>([](auto child) {
+                        sys::SignalForwarder guard(child);
+                        return child.wait();
+                    })
+                    .map<int>([](auto status) {
+                        return status.code().value_or(EXIT_FAILURE);
+                    })
+                    .map_err<std::runtime_error>([](auto error) {
+                        spdlog::warn("Running intercept failed: {}", error.what());
+                        return error;
+                    });
+            citnames.join();
+
+            std::error_code error_code;
+            fs::remove(output_, error_code);
+            return result;
+        }
 
     private:
         sys::Process::Builder intercept_;
         sys::Process::Builder citnames_;
+        sys::Process::Builder citnames_append_;
         fs::path output_;
+        fs::path result_;
+        std::optional<fs::path> config_;
+        bool stream_;
+        bool watch_;
+        bool in_process_;
+        const char **envp_;
     };
 
     struct Application : ps::ApplicationFromArgs {
@@ -171,7 +533,12 @@ namespace {
                     {cmd::citnames::FLAG_OUTPUT,         {1,  false, "path of the result file",                  {cmd::citnames::DEFAULT_OUTPUT},  std::nullopt}},
                     {cmd::citnames::FLAG_APPEND,         {0,  false, "append result to an existing output file", std::nullopt,                     ADVANCED_GROUP}},
                     {cmd::citnames::FLAG_CONFIG,         {1,  false, "path of the config file",                  std::nullopt,                     ADVANCED_GROUP}},
+                    {cmd::bear::FLAG_STREAM,             {0,  false, "run citnames during the build, streaming events over a pipe", std::nullopt,  ADVANCED_GROUP}},
+                    {cmd::bear::FLAG_WATCH,              {0,  false, "stay resident and re-run the build on request, appending to the output", std::nullopt, ADVANCED_GROUP}},
+                    {cmd::bear::FLAG_IN_PROCESS,         {0,  false, "run the citnames phase in this process instead of a child", std::nullopt, ADVANCED_GROUP}},
                     {cmd::intercept::FLAG_FORCE_PRELOAD, {0,  false, "force to use library preload",             std::nullopt,                     ADVANCED_GROUP}},
+                    {cmd::intercept::FLAG_PRUNE,         {1,  false, "colon separated list of programs whose process subtrees are not recorded", std::nullopt, ADVANCED_GROUP}},
+                    {cmd::intercept::FLAG_CAPTURE_ENV,   {1,  false, "colon separated list of environment variables to capture (default: all)", std::nullopt, ADVANCED_GROUP}},
                     {cmd::intercept::FLAG_FORCE_WRAPPER, {0,  false, "force to use compiler wrappers",           std::nullopt,                     ADVANCED_GROUP}},
                     {cmd::intercept::FLAG_LIBRARY,       {1,  false, "path to the preload library",              {cmd::library::DEFAULT_PATH},     DEVELOPER_GROUP}},
                     {cmd::intercept::FLAG_WRAPPER,       {1,  false, "path to the wrapper executable",           {cmd::wrapper::DEFAULT_PATH},     DEVELOPER_GROUP}},
@@ -185,21 +552,38 @@ namespace {
 
         rust::Result<ps::CommandPtr> command(const flags::Arguments &args, const char **envp) const override
         {
-            auto commands = args.as_string(cmd::citnames::FLAG_OUTPUT)
-                    .map<fs::path>([](const auto &output) {
-                        return fs::path(output).replace_extension(".db");
-                    })
+            auto result = args.as_string(cmd::citnames::FLAG_OUTPUT)
+                    .map<fs::path>([](const auto &output) { return fs::path(output); })
                     .unwrap_or(fs::path(cmd::citnames::DEFAULT_OUTPUT));
+            // the events database is scoped to this session: concurrent
+            // runs against the same output path record side by side
+            // instead of clobbering each other's events. (the database
+            // is removed at the end of the run anyway.)
+            auto commands = fs::path(result).replace_extension("");
+            commands += fmt::format("-{}.db", ::getpid());
+            auto config = args.as_string(cmd::citnames::FLAG_CONFIG)
+                    .map<std::optional<fs::path>>([](const auto &path) {
+                        return std::optional<fs::path>(fs::path(path));
+                    })
+                    .unwrap_or(std::nullopt);
 
-            auto environment = sys::env::from(const_cast<const char **>(envp));
+            // one shared snapshot serves all the child processes.
+            auto environment = std::make_shared<const sys::env::Vars>(
+                    sys::env::from(const_cast<const char **>(envp)));
+            auto append = args.as_bool(cmd::citnames::FLAG_APPEND).unwrap_or(false);
             auto intercept = prepare_intercept(args, environment, commands);
-            auto citnames = prepare_citnames(args, environment, commands);
+            auto citnames = prepare_citnames(args, environment, commands, append);
+            auto citnames_append = prepare_citnames(args, environment, commands, true);
+            auto stream = args.as_bool(cmd::bear::FLAG_STREAM).unwrap_or(false);
+            auto watch = args.as_bool(cmd::bear::FLAG_WATCH).unwrap_or(false);
+            auto in_process = args.as_bool(cmd::bear::FLAG_IN_PROCESS).unwrap_or(false);
 
-            return rust::merge(intercept, citnames)
-                    .map<ps::CommandPtr>([&commands](const auto &tuple) {
-                        const auto&[intercept, citnames] = tuple;
+            return rust::merge(intercept, citnames, citnames_append)
+                    .map<ps::CommandPtr>([&commands, &result, &config, &stream, &watch, &in_process, &envp](const auto &tuple) {
+                        const auto&[intercept, citnames, citnames_append] = tuple;
 
-                        return std::make_unique<Command>(intercept, citnames, commands);
+                        return std::make_unique<Command>(intercept, citnames, citnames_append, commands, result, config,
+                                                         stream, watch, in_process, const_cast<const char **>(envp));
                     });
         }
     };
@@ -0,0 +1,138 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Microbenchmarks for the citnames recognition hot path. The inputs
+// mirror what a real build produces: one compile command with the usual
+// warning, include and dependency flags, and the non-compiler commands
+// which make up most of the captured events.
+
+#include "semantic/Parsers.h"
+#include "semantic/ToolGcc.h"
+#include "Output.h"
+
+#include <fstream>
+
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+
+using namespace cs::semantic;
+
+namespace {
+
+    domain::Execution compile_execution()
+    {
+        return domain::Execution {
+            "/usr/bin/g++",
+            { "g++", "-c", "-o", "lib/source.o",
+              "-Wall", "-Wextra", "-O2", "-g", "-std=c++17",
+              "-Ilib/include", "-I", "third_party/include",
+              "-isystem", "/usr/local/include",
+              "-DNDEBUG", "-D", "VERSION=3",
+              "-MMD", "-MT", "lib/source.o", "-MF", "lib/source.d",
+              "lib/source.cc" },
+            "/home/user/project",
+            {}
+        };
+    }
+
+    void tool_gcc_compilation(benchmark::State& state)
+    {
+        const ToolGcc sut;
+        const auto execution = compile_execution();
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(sut.compilation(execution));
+        }
+    }
+
+    void tool_gcc_recognize_miss(benchmark::State& state)
+    {
+        const ToolGcc sut;
+        const domain::Execution execution = {
+            "/usr/bin/make",
+            { "make", "-j4", "all" },
+            "/home/user/project",
+            {}
+        };
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(sut.recognize(execution));
+        }
+    }
+
+    void flag_parser_parse(benchmark::State& state)
+    {
+        // a table with the shapes the gcc table uses: exact flags with and
+        // without arguments, partial matches and equal sign separation.
+        const FlagsByName flags = {
+            { "-c", { Instruction(0, Match::EXACT, false), CompilerFlagType::KIND_OF_OUTPUT_NO_LINKING } },
+            { "-o", { Instruction(1, Match::EXACT, false), CompilerFlagType::KIND_OF_OUTPUT_OUTPUT } },
+            { "-D", { Instruction(1, Match::BOTH, false), CompilerFlagType::PREPROCESSOR } },
+            { "-I", { Instruction(1, Match::BOTH, false), CompilerFlagType::DIRECTORY_SEARCH } },
+            { "-std", { Instruction(0, Match::PARTIAL, true), CompilerFlagType::OTHER } },
+            { "-W", { Instruction(0, Match::PARTIAL, false), CompilerFlagType::OTHER } },
+            { "-O", { Instruction(0, Match::PARTIAL, false), CompilerFlagType::OTHER } },
+        };
+        const FlagParser sut(flags);
+        const Arguments arguments = {
+            "-c", "-o", "source.o", "-Wall", "-O2", "-std=c++17",
+            "-Iinclude", "-I", "other", "-DNDEBUG", "source.cc"
+        };
+        for (auto _ : state) {
+            Input input { arguments.begin(), arguments.end() };
+            while (input.begin != input.end) {
+                auto result = sut.parse(input);
+                if (result.is_err()) {
+                    // unrecognized argument (the source file); skip it.
+                    input.begin = std::next(input.begin);
+                    continue;
+                }
+                input = result.unwrap().second;
+                benchmark::DoNotOptimize(input.begin);
+            }
+        }
+    }
+
+    // Serialization with the content and duplicate filters applied; half
+    // of the corpus are repeated entries, as append mode sees them.
+    void output_filter_and_serialize(benchmark::State& state)
+    {
+        const cs::CompilationDatabase database(
+            cs::Format { false, false },
+            cs::Content { false, {}, {} });
+        cs::CompilationDatabase::Entries entries;
+        for (size_t idx = 0; idx < 512; ++idx) {
+            entries.push_back(cs::Entry {
+                fmt::format("/home/user/project/source_{}.cc", idx % 256),
+                "/home/user/project",
+                fmt::format("/home/user/project/source_{}.o", idx % 256),
+                { "c++", "-c", "-O2", "-Wall", fmt::format("source_{}.cc", idx % 256) }
+            });
+        }
+        for (auto _ : state) {
+            std::ofstream stream("/dev/null");
+            benchmark::DoNotOptimize(database.to_json(stream, entries));
+        }
+    }
+}
+
+BENCHMARK(tool_gcc_compilation);
+BENCHMARK(tool_gcc_recognize_miss);
+BENCHMARK(flag_parser_parse);
+BENCHMARK(output_filter_and_serialize);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,89 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// The embeddable interface of the command recognition.
+//
+// Tools which capture process executions themselves (an IDE integration,
+// a build system plugin) can feed the executions in memory and receive
+// the compilation database entries back, without spawning the citnames
+// process and round tripping through JSON files. The recognition logic
+// is the same the citnames executable runs.
+//
+// The header is self contained on purpose: only standard library types
+// appear on the interface, none of the internal types leak out.
+
+#include <filesystem>
+#include <list>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace citnames {
+
+    namespace fs = std::filesystem;
+
+    // Represents a captured process execution.
+    struct Execution {
+        fs::path executable;
+        std::vector<std::string> arguments;
+        fs::path working_dir;
+        // Optional. (Only the wrapper recognition consults it.)
+        std::map<std::string, std::string> environment;
+    };
+
+    // Represents one element of the JSON compilation database, as
+    // defined here:
+    //   https://clang.llvm.org/docs/JSONCompilationDatabase.html
+    struct Entry {
+        fs::path file;
+        fs::path directory;
+        std::optional<fs::path> output;
+        std::list<std::string> arguments;
+    };
+
+    // Recognizes compiler calls with the default configuration of the
+    // citnames executable.
+    //
+    // Safe to call from multiple threads: the recognition is stateless.
+    class Recognizer {
+    public:
+        Recognizer();
+        ~Recognizer();
+
+        // Returns the compilation database entries of the execution.
+        //
+        // An execution which is not a compiler call, or a compiler call
+        // which compiles nothing (a version query, a plain link step)
+        // produces no entries. A compiler call with multiple source
+        // files produces one entry per source file.
+        [[nodiscard]]
+        std::list<Entry> recognize(const Execution &execution) const;
+
+        Recognizer(const Recognizer &) = delete;
+        Recognizer &operator=(const Recognizer &) = delete;
+
+    private:
+        struct State;
+        std::unique_ptr<State> state_;
+    };
+}
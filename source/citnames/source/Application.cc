@@ -21,12 +21,39 @@
 #include "Application.h"
 #include "Configuration.h"
 #include "Output.h"
+#include "Paths.h"
 #include "semantic/Build.h"
 #include "semantic/Tool.h"
 #include "collect/db/EventsDatabaseReader.h"
+#include "collect/db/EventsDatabaseWriter.h"
+#include "libshell/Command.h"
+#include "libsys/Errors.h"
 #include "libsys/Path.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 #include <spdlog/spdlog.h>
 #include <spdlog/fmt/ostr.h>
@@ -39,8 +66,7 @@ namespace {
     std::list<fs::path> to_abspath(const std::list<fs::path> &paths, const fs::path &root) {
         std::list<fs::path> results;
         for (const auto &path : paths) {
-            auto result = path.is_absolute() ? path : root / path;
-            results.emplace_back(result);
+            results.emplace_back(cs::path::absolute(path, root));
         }
         return results;
     }
@@ -52,6 +78,7 @@ namespace {
                 const fs::path& root = cwd.unwrap();
                 return cs::Content {
                         .include_only_existing_source = run_checks,
+                        .duplicates_by_output_only = content.duplicates_by_output_only,
                         .paths_to_include = to_abspath(content.paths_to_include, root),
                         .paths_to_exclude = to_abspath(content.paths_to_exclude, root)
                 };
@@ -86,24 +113,75 @@ namespace {
         return fs::exists(path, error_code);
     }
 
+    size_t as_count(const flags::Arguments &args, const char *flag) {
+        return args.as_string(flag)
+                .map<size_t>([](const auto &value) {
+                    const std::string input(value);
+                    char *end = nullptr;
+                    const unsigned long result = std::strtoul(input.c_str(), &end, 10);
+                    return (end != input.c_str() && *end == 0)
+                           ? static_cast<size_t>(result)
+                           : size_t(0);
+                })
+                .unwrap_or(size_t(0));
+    }
+
     rust::Result<cs::Arguments> into_arguments(const flags::Arguments &args) {
         auto input = args.as_string(cmd::citnames::FLAG_INPUT);
         auto output = args.as_string(cmd::citnames::FLAG_OUTPUT);
         auto append = args.as_bool(cmd::citnames::FLAG_APPEND)
                 .unwrap_or(false);
+        auto journal = args.as_bool(cmd::citnames::FLAG_JOURNAL)
+                .unwrap_or(false);
+        auto profile = args.as_bool(cmd::citnames::FLAG_PROFILE)
+                .unwrap_or(false);
+        auto record_corpus = args.as_string(cmd::citnames::FLAG_RECORD_CORPUS)
+                .map<fs::path>([](auto value) { return fs::path(value); })
+                .unwrap_or(fs::path());
+        auto replay = args.as_bool(cmd::citnames::FLAG_REPLAY)
+                .unwrap_or(false);
+        auto validate = args.as_bool(cmd::citnames::FLAG_VALIDATE)
+                .unwrap_or(false);
+        auto jobs = as_count(args, cmd::citnames::FLAG_JOBS);
+        auto memory_limit = as_count(args, cmd::citnames::FLAG_MEMORY_LIMIT);
+        auto serve_socket = args.as_string(cmd::citnames::FLAG_SERVE)
+                .map<fs::path>([](auto value) { return fs::path(value); })
+                .unwrap_or(fs::path());
+        auto diff = args.as_string_list(cmd::citnames::FLAG_DIFF)
+                .unwrap_or(std::vector<std::string_view>());
+        auto diff_old = (diff.size() == 2) ? fs::path(diff[0]) : fs::path();
+        auto diff_new = (diff.size() == 2) ? fs::path(diff[1]) : fs::path();
 
         return rust::merge(input, output)
-                .map<cs::Arguments>([&append](auto tuple) {
+                .map<cs::Arguments>([&append, &journal, &profile, &record_corpus, &replay, &validate, &diff_old, &diff_new, &jobs, &memory_limit, &serve_socket](auto tuple) {
                     const auto&[input, output] = tuple;
                     return cs::Arguments{
                             fs::path(input),
                             fs::path(output),
                             append,
+                            journal,
+                            profile,
+                            record_corpus,
+                            replay,
+                            validate,
+                            diff_old,
+                            diff_new,
+                            jobs,
+                            memory_limit,
+                            serve_socket,
                     };
                 })
                 .and_then<cs::Arguments>([](auto arguments) -> rust::Result<cs::Arguments> {
                     // validate
-                    if (!is_exists(arguments.input)) {
+                    // (`-` names the standard input, nothing to check;
+                    // the validate and diff modes read no events at all.)
+                    const bool reads_events = !arguments.validate && arguments.diff_old.empty();
+                    // a segmented database may have its first segment already
+                    // consumed and deleted; the manifest stands in for it.
+                    fs::path manifest = arguments.input;
+                    manifest += ".segments";
+                    if (reads_events && arguments.input != "-" && !is_exists(arguments.input)
+                            && !is_exists(manifest)) {
                         return rust::Err(std::runtime_error(
                                 fmt::format("Missing input file: {}", arguments.input)));
                     }
@@ -111,6 +189,16 @@ namespace {
                             arguments.input,
                             arguments.output,
                             (arguments.append && is_exists(arguments.output)),
+                            arguments.journal,
+                            arguments.profile,
+                            arguments.record_corpus,
+                            arguments.replay,
+                            arguments.validate,
+                            arguments.diff_old,
+                            arguments.diff_new,
+                            arguments.jobs,
+                            arguments.memory_limit,
+                            arguments.serve_socket,
                     });
                 });
     }
@@ -161,23 +249,591 @@ namespace {
                 });
     }
 
-    size_t transform(cs::semantic::Build &build, const db::EventsDatabaseReader::Ptr& events, std::list<cs::Entry> &output) {
+    // Remembers how far a run got with the events database: the number of
+    // processed records and the byte offset where the last one started.
+    // The offset ties the checkpoint to the database content, so a
+    // replaced or truncated database is simply processed from the start.
+    struct Checkpoint {
+        std::uint64_t records;
+        std::uint64_t last_offset;
+    };
+
+    std::optional<Checkpoint> read_checkpoint(const fs::path &file) {
+        std::ifstream stream(file);
+        if (Checkpoint result = {0, 0}; stream >> result.records >> result.last_offset) {
+            return result;
+        }
+        return std::nullopt;
+    }
+
+    void write_checkpoint(const fs::path &file, const Checkpoint &value) {
+        std::ofstream stream(file);
+        stream << value.records << ' ' << value.last_offset << std::endl;
+    }
+
+    // The number of leading records of the events database which a
+    // previous run has already processed. Zero when there is no (valid)
+    // checkpoint, or when the database does not support sliced access.
+    size_t records_to_skip(const db::EventsDatabaseReader::Ptr &events, const fs::path &checkpoint_file) {
+        if (!events->seekable()) {
+            return 0;
+        }
+        const auto checkpoint = read_checkpoint(checkpoint_file);
+        if (!checkpoint || checkpoint->records == 0 || checkpoint->records > events->indexed_count()) {
+            return 0;
+        }
+        const auto last = static_cast<int>(checkpoint->records - 1);
+        if (events->index().offsets(last) != checkpoint->last_offset) {
+            return 0;
+        }
+        return checkpoint->records;
+    }
+
+    // Collects per phase counters and times of a run. The counting happens
+    // on the worker pool, hence the atomics; the report is written to the
+    // standard error once, after the output got flushed.
+    struct Profile {
+        using clock = std::chrono::steady_clock;
+
+        std::atomic<std::uint64_t> events_read = 0;
+        std::atomic<std::uint64_t> recognized = 0;
+        std::atomic<std::uint64_t> rejected = 0;
+        std::atomic<std::uint64_t> not_recognized = 0;
+        std::atomic<std::uint64_t> produced = 0;
+        std::atomic<std::uint64_t> read_us = 0;
+        std::atomic<std::uint64_t> recognize_us = 0;
+        std::atomic<std::uint64_t> write_us = 0;
+
+        void add(std::atomic<std::uint64_t> &counter, const clock::time_point start) {
+            const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start);
+            counter += static_cast<std::uint64_t>(elapsed.count());
+        }
+
+        void report(const std::uint64_t written) const {
+            fmt::print(stderr, "profile: events read       {}\n", events_read.load());
+            fmt::print(stderr, "profile: recognized        {}\n", recognized.load());
+            fmt::print(stderr, "profile: rejected by tool  {}\n", rejected.load());
+            fmt::print(stderr, "profile: not recognized    {}\n", not_recognized.load());
+            fmt::print(stderr, "profile: entries produced  {}\n", produced.load());
+            fmt::print(stderr, "profile: entries filtered  {}\n", produced.load() - written);
+            fmt::print(stderr, "profile: entries written   {}\n", written);
+            fmt::print(stderr, "profile: reading time      {} us\n", read_us.load());
+            fmt::print(stderr, "profile: recognition time  {} us\n", recognize_us.load());
+            fmt::print(stderr, "profile: writing time      {} us\n", write_us.load());
+        }
+    };
+
+    // Extracts the distinct command lines of the processed events into a
+    // corpus: a small events database which holds each command line once.
+    // The corpus is a regular events database, so it replays through any
+    // citnames run (see the replay driver below), giving a compact and
+    // shareable workload to profile the semantic layer against real flag
+    // distributions, without handing around full event databases.
+    class CorpusRecorder {
+    public:
+        [[nodiscard]] static rust::Result<std::shared_ptr<CorpusRecorder>> create(const fs::path &file) {
+            return db::EventsDatabaseWriter::create(file)
+                    .map<std::shared_ptr<CorpusRecorder>>([](auto writer) {
+                        return std::shared_ptr<CorpusRecorder>(new CorpusRecorder(std::move(writer)));
+                    });
+        }
+
+        void record(const rpc::Event &event) {
+            if (!event.has_started()) {
+                return;
+            }
+            const auto &execution = event.started().execution();
+            // the same key which the events database uses for its command
+            // line references: the program, the working directory and the
+            // arguments (in either representation).
+            std::string key(execution.executable());
+            key.push_back('\0');
+            key.append(execution.working_dir());
+            key.push_back('\0');
+            key.append(execution.packed_arguments());
+            for (const auto &argument : execution.arguments()) {
+                key.push_back('\0');
+                key.append(argument);
+            }
+            const std::lock_guard<std::mutex> guard(mutex_);
+            if (seen_.insert(std::move(key)).second) {
+                writer_->insert_event(event)
+                        .on_error([](const auto &error) {
+                            spdlog::warn("Corpus recording failed: {}", error.what());
+                        });
+            }
+        }
+
+    private:
+        explicit CorpusRecorder(ic::collect::db::EventsDatabaseWriter::Ptr writer) noexcept
+                : mutex_()
+                , seen_()
+                , writer_(std::move(writer))
+        { }
+
+    private:
+        std::mutex mutex_;
+        std::unordered_set<std::string> seen_;
+        ic::collect::db::EventsDatabaseWriter::Ptr writer_;
+    };
+
+    // The replay driver of a recorded corpus: pulls the events and runs
+    // the recognition over them on the worker pool, with the counters and
+    // the times collected, but with no output written. The numbers
+    // isolate the semantic layer, so a flag parser change is measured
+    // against a stable workload.
+    rust::Result<size_t> replay(
+            const cs::semantic::Build &build,
+            const db::EventsDatabaseReader::Ptr &events,
+            const size_t worker_count,
+            Profile &profile) {
+        std::mutex input_mutex;
+        bool input_done = false;
+        std::atomic<size_t> count(0);
+
+        const auto worker = [&]() {
+            // reused over every record this worker pulls, like in the
+            // transform pass.
+            rpc::Event event;
+            for (;;) {
+                {
+                    const std::lock_guard<std::mutex> guard(input_mutex);
+                    if (input_done) {
+                        return;
+                    }
+                    const auto start = Profile::clock::now();
+                    const auto read = events->read_into(event);
+                    if (read.is_err() || !read.unwrap()) {
+                        input_done = true;
+                        return;
+                    }
+                    profile.events_read += 1;
+                    profile.add(profile.read_us, start);
+                }
+                const auto start = Profile::clock::now();
+                auto semantic = build.recognize(event);
+                profile.add(profile.recognize_us, start);
+                if (cs::semantic::Tool::recognized_ok(semantic)) {
+                    profile.recognized += 1;
+                } else if (cs::semantic::Tool::not_recognized(semantic)) {
+                    profile.not_recognized += 1;
+                } else {
+                    profile.rejected += 1;
+                }
+                semantic.on_success([&count](const auto &semantic_ptr) {
+                    auto candidate = dynamic_cast<cs::semantic::CompilerCall *>(semantic_ptr.get());
+                    if (candidate != nullptr) {
+                        count += std::move(*candidate).into_entries().size();
+                    }
+                });
+            }
+        };
+
+        std::vector<std::thread> workers;
+        workers.reserve(worker_count);
+        for (size_t idx = 0; idx < worker_count; ++idx) {
+            workers.emplace_back(worker);
+        }
+        for (auto &thread : workers) {
+            thread.join();
+        }
+        return rust::Ok(count.load());
+    }
+
+    // The parallel validation of an existing compilation database: the
+    // entries are checked concurrently against the filesystem (the source
+    // file and the working directory), and their argument lists for
+    // shell well-formedness (an entry whose command line does not survive
+    // the join and split round trip is unusable for the tools consuming
+    // the database). The offenders and the counts are reported on the
+    // standard error; the exit code tells whether the database is clean.
+    rust::Result<int> validate_database(
+            const cs::CompilationDatabase &output,
+            const fs::path &file,
+            const size_t worker_count) {
+        cs::CompilationDatabase::Entries entries;
+        return output.from_json(file, entries)
+                .map<int>([&entries, worker_count](auto count) {
+                    std::vector<const cs::Entry *> all;
+                    all.reserve(count);
+                    for (const auto &entry : entries) {
+                        all.push_back(&entry);
+                    }
+                    std::atomic<size_t> missing_files(0);
+                    std::atomic<size_t> missing_directories(0);
+                    std::atomic<size_t> malformed_arguments(0);
+                    std::mutex report_mutex;
+                    std::atomic<size_t> next(0);
+
+                    const auto worker = [&]() {
+                        for (size_t idx = next++; idx < all.size(); idx = next++) {
+                            const cs::Entry &entry = *all[idx];
+                            std::error_code error_code;
+                            if (!fs::exists(entry.file, error_code)) {
+                                missing_files += 1;
+                                const std::lock_guard<std::mutex> guard(report_mutex);
+                                fmt::print(stderr, "validate: entry {}: missing file: {}\n",
+                                           idx, entry.file.string());
+                            }
+                            if (!fs::is_directory(entry.directory, error_code)) {
+                                missing_directories += 1;
+                                const std::lock_guard<std::mutex> guard(report_mutex);
+                                fmt::print(stderr, "validate: entry {}: not a directory: {}\n",
+                                           idx, entry.directory.string());
+                            }
+                            const auto split = sh::split(sh::join(entry.arguments));
+                            const bool arguments_ok = !entry.arguments.empty()
+                                    && split.is_ok()
+                                    && split.unwrap() == entry.arguments;
+                            if (!arguments_ok) {
+                                malformed_arguments += 1;
+                                const std::lock_guard<std::mutex> guard(report_mutex);
+                                fmt::print(stderr, "validate: entry {}: malformed arguments: {}\n",
+                                           idx, entry.file.string());
+                            }
+                        }
+                    };
+                    std::vector<std::thread> workers;
+                    workers.reserve(worker_count);
+                    for (size_t idx = 0; idx < worker_count; ++idx) {
+                        workers.emplace_back(worker);
+                    }
+                    for (auto &thread : workers) {
+                        thread.join();
+                    }
+
+                    fmt::print(stderr, "validate: entries checked     {}\n", all.size());
+                    fmt::print(stderr, "validate: missing files       {}\n", missing_files.load());
+                    fmt::print(stderr, "validate: missing directories {}\n", missing_directories.load());
+                    fmt::print(stderr, "validate: malformed arguments {}\n", malformed_arguments.load());
+                    const size_t offenders =
+                            missing_files.load() + missing_directories.load() + malformed_arguments.load();
+                    return (offenders == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+                });
+    }
+
+    // The warm query server of the recognized entries.
+    //
+    // Editors ask for the flags of a single file far more often than the
+    // database changes; re-running the whole recognition for every lookup
+    // costs seconds, while the lookup itself is a hash table probe. The
+    // server keeps the recognized entries resident, indexed by their file
+    // attribute, and answers queries over a unix socket. Before every
+    // answer the new suffix of the events database is folded in through
+    // the sliced reader, the same way the append mode skips the already
+    // processed records.
+    //
+    // The protocol is line based: the client connects, sends the path of
+    // the source file and reads back the matching entries as a JSON
+    // array. An empty query line shuts the server down.
+    class QueryServer {
+    public:
+        QueryServer(const cs::CompilationDatabase &output, const cs::semantic::Build &build, fs::path input) noexcept
+                : output_(output)
+                , build_(build)
+                , input_(std::move(input))
+                , consumed_()
+                , index_()
+        { }
+
+        [[nodiscard]] rust::Result<int> run(const fs::path &socket)
+        {
+            sockaddr_un address = {};
+            address.sun_family = AF_UNIX;
+            if (socket.string().size() >= sizeof(address.sun_path)) {
+                return rust::Err(std::runtime_error(
+                        fmt::format("Socket path is too long: {}", socket.string())));
+            }
+            std::strncpy(address.sun_path, socket.c_str(), sizeof(address.sun_path) - 1);
+
+            const int server = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (server == -1) {
+                return rust::Err(std::runtime_error(
+                        fmt::format("Failed to create socket: {}", sys::error_string(errno))));
+            }
+            ::unlink(socket.c_str());
+            if (::bind(server, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == -1
+                    || ::listen(server, 8) == -1) {
+                auto error = std::runtime_error(
+                        fmt::format("Failed to listen on socket {}: {}", socket.string(), sys::error_string(errno)));
+                ::close(server);
+                return rust::Err(error);
+            }
+            // the first build of the index happens before any client is
+            // served, so the very first query is answered warm too.
+            refresh();
+            spdlog::debug("query server listening. [socket: {}, files: {}]", socket.string(), index_.size());
+
+            bool shutdown = false;
+            while (!shutdown) {
+                const int client = ::accept(server, nullptr, nullptr);
+                if (client == -1) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    break;
+                }
+                const auto query = read_query(client);
+                if (query.empty()) {
+                    shutdown = true;
+                } else {
+                    refresh();
+                    answer(client, query);
+                }
+                ::close(client);
+            }
+            ::close(server);
+            ::unlink(socket.c_str());
+            return rust::Ok(EXIT_SUCCESS);
+        }
+
+    private:
+        // Folds the records which arrived since the last call into the
+        // index. The sliced reader parses only the new suffix of each
+        // segment; a shrunk or replaced segment is processed from the
+        // start again (the duplicate check makes that harmless, like a
+        // database without random access support).
+        void refresh()
+        {
+            for (const auto &segment : db::EventsDatabaseReader::segments(input_)) {
+                auto events = db::EventsDatabaseReader::from(segment);
+                if (events.is_err()) {
+                    continue;
+                }
+                auto reader = events.unwrap();
+                reader->project(rpc::Event::kStarted);
+                auto &consumed = consumed_[segment.string()];
+                if (consumed > 0 && reader->seekable()) {
+                    if (consumed == reader->indexed_count()) {
+                        continue;
+                    }
+                    if (consumed < reader->indexed_count() && !reader->seek(consumed)) {
+                        continue;
+                    }
+                    // more consumed than present: processed from the start.
+                }
+                rpc::Event event;
+                for (;;) {
+                    const auto read = reader->read_into(event);
+                    if (read.is_err() || !read.unwrap()) {
+                        break;
+                    }
+                    build_.recognize(event)
+                            .on_success([this](const auto &semantic_ptr) {
+                                auto candidate = dynamic_cast<cs::semantic::CompilerCall *>(semantic_ptr.get());
+                                if (candidate != nullptr) {
+                                    for (auto &entry : std::move(*candidate).into_entries()) {
+                                        add(std::move(entry));
+                                    }
+                                }
+                            });
+                }
+                if (reader->seekable()) {
+                    consumed = reader->indexed_count();
+                }
+            }
+        }
+
+        void add(cs::Entry &&entry)
+        {
+            auto &bucket = index_[entry.file.string()];
+            if (std::find(bucket.begin(), bucket.end(), entry) == bucket.end()) {
+                bucket.emplace_back(std::move(entry));
+            }
+        }
+
+        [[nodiscard]] cs::CompilationDatabase::Entries lookup(const std::string &query) const
+        {
+            if (const auto it = index_.find(query); it != index_.end()) {
+                return it->second;
+            }
+            // a relative or unnormalized query is resolved against the
+            // working directory of the server.
+            std::error_code error_code;
+            const auto resolved = fs::weakly_canonical(fs::path(query), error_code);
+            if (!error_code) {
+                if (const auto it = index_.find(resolved.string()); it != index_.end()) {
+                    return it->second;
+                }
+            }
+            return {};
+        }
+
+        void answer(const int client, const std::string &query) const
+        {
+            std::ostringstream buffer;
+            output_.to_json(buffer, lookup(query))
+                    .on_error([](const auto &error) {
+                        spdlog::warn("Query serialization failed: {}", error.what());
+                    });
+            const auto content = buffer.str();
+            size_t written = 0;
+            while (written < content.size()) {
+                const auto count = ::write(client, content.data() + written, content.size() - written);
+                if (count <= 0) {
+                    break;
+                }
+                written += static_cast<size_t>(count);
+            }
+        }
+
+        [[nodiscard]] static std::string read_query(const int client)
+        {
+            std::string result;
+            char byte = 0;
+            while (result.size() < 4096) {
+                const auto count = ::read(client, &byte, 1);
+                if (count != 1 || byte == '\n') {
+                    break;
+                }
+                result.push_back(byte);
+            }
+            return result;
+        }
+
+    private:
+        const cs::CompilationDatabase &output_;
+        const cs::semantic::Build &build_;
+        fs::path input_;
+        // records already folded in, per segment file.
+        std::map<std::string, std::uint64_t> consumed_;
+        // the file attribute of the entry -> the entries themselves.
+        std::unordered_map<std::string, cs::CompilationDatabase::Entries> index_;
+    };
+
+    // The recognition of the events is independent work, so it is spread
+    // over a pool of threads. The reader stays a single consumer (the
+    // cursor is guarded by a lock, since the environment restoring is
+    // stateful), each worker parses into its own reused event, recognizes
+    // it and hands the entries over to the output sink through a bounded
+    // reorder window.
+    //
+    // The entries reach the sink in reading order, which keeps the output
+    // deterministic, independent of the thread scheduling. A worker that
+    // runs too far ahead of the writing position blocks until the window
+    // shrinks, so the memory use stays flat regardless of how many events
+    // the database holds.
+    rust::Result<size_t> transform(
+            const cs::semantic::Build &build,
+            const db::EventsDatabaseReader::Ptr &events,
+            cs::CompilationDatabase::Sink &sink,
+            const size_t skip,
+            const size_t worker_count,
+            const size_t window_size,
+            CorpusRecorder *const recorder,
+            Profile *const profile) {
+        std::mutex input_mutex;
+        // positions the reading past the checkpoint; when the seek fails,
+        // there is nothing left to read.
+        bool input_done = (skip != 0) && !events->seek(skip);
+        size_t index = 0;
+
+        std::mutex output_mutex;
+        std::condition_variable window_moved;
+        std::map<size_t, std::list<cs::Entry>> window;
+        size_t write_position = 0;
         size_t count = 0;
-        for (db::EventsIterator it = events->events_begin(), end = events->events_end(); it != end; ++it) {
-            (*it)
-                    .and_then<cs::semantic::SemanticPtr>([&build](const auto &event) {
-                        return build.recognize(*event);
-                    })
-                    .on_success([&output, &count](const auto &semantic) {
-                        auto candidate = dynamic_cast<const cs::semantic::CompilerCall *>(semantic.get());
-                        if (candidate != nullptr) {
-                            auto entries = candidate->into_entries();
-                            count += entries.size();
-                            std::copy(entries.begin(), entries.end(), std::back_inserter(output));
+        std::optional<std::runtime_error> failure;
+
+        // write every result which the window holds in order; the caller
+        // owns the output lock.
+        const auto drain = [&]() {
+            while (!window.empty() && window.begin()->first == write_position) {
+                auto node = window.extract(window.begin());
+                const auto start = (profile != nullptr) ? Profile::clock::now() : Profile::clock::time_point();
+                for (const auto &entry : node.mapped()) {
+                    if (!failure) {
+                        sink.add(entry).on_error([&failure](const auto &error) {
+                            failure = error;
+                        });
+                    }
+                }
+                if (profile != nullptr) {
+                    profile->add(profile->write_us, start);
+                }
+                write_position += 1;
+            }
+            window_moved.notify_all();
+        };
+
+        const auto worker = [&]() {
+            // reused over every record this worker pulls: the event is
+            // fully processed before the next read clears it.
+            rpc::Event event;
+            for (;;) {
+                size_t current = 0;
+                {
+                    const std::lock_guard<std::mutex> guard(input_mutex);
+                    if (input_done) {
+                        return;
+                    }
+                    const auto start = (profile != nullptr) ? Profile::clock::now() : Profile::clock::time_point();
+                    const auto read = events->read_into(event);
+                    if (read.is_err() || !read.unwrap()) {
+                        input_done = true;
+                        if (read.is_err()) {
+                            const std::lock_guard<std::mutex> output_guard(output_mutex);
+                            if (!failure) {
+                                failure = read.unwrap_err();
+                            }
                         }
+                        return;
+                    }
+                    current = index++;
+                    if (profile != nullptr) {
+                        profile->events_read += 1;
+                        profile->add(profile->read_us, start);
+                    }
+                }
+                if (recorder != nullptr) {
+                    recorder->record(event);
+                }
+                const auto start = (profile != nullptr) ? Profile::clock::now() : Profile::clock::time_point();
+                auto semantic = build.recognize(event);
+                if (profile != nullptr) {
+                    profile->add(profile->recognize_us, start);
+                    if (cs::semantic::Tool::recognized_ok(semantic)) {
+                        profile->recognized += 1;
+                    } else if (cs::semantic::Tool::not_recognized(semantic)) {
+                        profile->not_recognized += 1;
+                    } else {
+                        profile->rejected += 1;
+                    }
+                }
+                std::list<cs::Entry> entries;
+                semantic
+                        .on_success([&entries](const auto &semantic_ptr) {
+                            auto candidate = dynamic_cast<cs::semantic::CompilerCall *>(semantic_ptr.get());
+                            if (candidate != nullptr) {
+                                // consumes the semantic, which is not used afterwards.
+                                entries = std::move(*candidate).into_entries();
+                            }
+                        });
+                {
+                    std::unique_lock<std::mutex> guard(output_mutex);
+                    // the thread at the writing position shall never block.
+                    window_moved.wait(guard, [&]() {
+                        return current == write_position || window.size() < window_size;
                     });
+                    count += entries.size();
+                    window.emplace(current, std::move(entries));
+                    drain();
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        workers.reserve(worker_count);
+        for (size_t idx = 0; idx < worker_count; ++idx) {
+            workers.emplace_back(worker);
         }
-        return count;
+        for (auto &thread : workers) {
+            thread.join();
+        }
+
+        return (failure)
+               ? rust::Result<size_t>(rust::Err(failure.value()))
+               : rust::Result<size_t>(rust::Ok(count));
     }
 }
 
@@ -185,33 +841,175 @@ namespace cs {
 
     rust::Result<int> Command::execute() const {
         cs::CompilationDatabase output(configuration_.output.format, configuration_.output.content);
-        std::list<cs::Entry> entries;
 
-        // get current compilations from the input.
-        return db::EventsDatabaseReader::from(arguments_.input)
-                .map<size_t>([this, &entries](const auto &commands) {
-                    cs::semantic::Build build(configuration_.compilation);
-                    return transform(build, commands, entries);
-                })
-                .and_then<size_t>([this, &output, &entries](auto new_entries_count) {
-                    spdlog::debug("compilation entries created. [size: {}]", new_entries_count);
-                    // read back the current content and extend with the new elements.
-                    return (arguments_.append)
-                        ? output.from_json(arguments_.output.c_str(), entries)
-                                .template map<size_t>([&new_entries_count](auto old_entries_count) {
-                                    spdlog::debug("compilation entries have read. [size: {}]", old_entries_count);
-                                    return new_entries_count + old_entries_count;
-                                })
-                        : rust::Result<size_t>(rust::Ok(new_entries_count));
-                })
-                .and_then<size_t>([this, &output, &entries](const size_t & size) {
-                    // write the entries into the output file.
-                    spdlog::debug("compilation entries to output. [size: {}]", size);
-                    return output.to_json(arguments_.output.c_str(), entries);
+        // the profile stays empty (and the hot paths untouched) unless it
+        // was asked for on the command line.
+        const auto profile = (arguments_.profile)
+                ? std::make_unique<Profile>()
+                : std::unique_ptr<Profile>();
+        Profile *const profile_ptr = profile.get();
+
+        // governance of the parallel passes: the worker count and the
+        // reorder window are bounded up front, so the run fits into the
+        // share it was given on a busy machine.
+        const size_t workers = (arguments_.jobs != 0)
+                ? arguments_.jobs
+                : std::max<size_t>(1, std::thread::hardware_concurrency());
+        cs::set_worker_limit(workers);
+        // one window slot holds the recognized entries of one event; the
+        // per slot estimate is deliberately generous (long command lines),
+        // so the ceiling holds on pathological inputs too. the default of
+        // 256 slots corresponds to a 16 MB ceiling. the window never goes
+        // below the worker count, since every worker holds one entry in
+        // flight regardless.
+        constexpr size_t WINDOW_SLOT_ESTIMATE = 64 * 1024;
+        const size_t window_size = (arguments_.memory_limit != 0)
+                ? std::max(workers, std::min<size_t>(
+                        (arguments_.memory_limit << 20) / WINDOW_SLOT_ESTIMATE,
+                        64 * 1024))
+                : 256;
+
+        // the validation mode: the named database is checked, no events
+        // are processed. (replaces script based nightly checks with a
+        // parallel pass in this process.)
+        if (arguments_.validate) {
+            return validate_database(output, arguments_.output, workers);
+        }
+
+        // the diff mode: two databases compared by per entry
+        // fingerprints, no events are processed. the exit code makes it
+        // a cheap change gate for CI.
+        if (!arguments_.diff_old.empty()) {
+            return output.diff(arguments_.diff_old, arguments_.diff_new, std::cout)
+                    .map<int>([](auto differences) {
+                        return (differences == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+                    });
+        }
+
+        // the replay driver: runs only the recognition over the events of
+        // the input (typically a recorded corpus) and reports the
+        // counters and the times. a stable workload in, a comparable
+        // report out.
+        if (arguments_.replay) {
+            Profile replay_profile;
+            return db::EventsDatabaseReader::from(arguments_.input)
+                    .and_then<size_t>([this, workers, &replay_profile](const auto &commands) {
+                        commands->project(rpc::Event::kStarted);
+                        cs::semantic::Build build(configuration_.compilation);
+                        return replay(build, commands, workers, replay_profile);
+                    })
+                    .map<int>([&replay_profile](auto count) {
+                        replay_profile.produced = count;
+                        replay_profile.report(count);
+                        return EXIT_SUCCESS;
+                    });
+        }
+
+        // the query server mode: the recognized entries stay resident in
+        // this process and single file queries are answered over a unix
+        // socket; no compilation database is written. the call returns
+        // when a client sends an empty query line.
+        if (!arguments_.serve_socket.empty()) {
+            const cs::semantic::Build build(configuration_.compilation);
+            QueryServer server(output, build, arguments_.input);
+            return server.run(arguments_.serve_socket);
+        }
+
+        // the corpus recorder stays off (and the hot paths untouched)
+        // unless a corpus file was named on the command line.
+        std::shared_ptr<CorpusRecorder> recorder;
+        if (!arguments_.record_corpus.empty()) {
+            auto created = CorpusRecorder::create(arguments_.record_corpus);
+            if (!created.is_ok()) {
+                return rust::Err(created.unwrap_err());
+            }
+            recorder = created.unwrap();
+        }
+        CorpusRecorder *const recorder_ptr = recorder.get();
+
+        // in append mode the previous content is read up front, since the
+        // output file is reopened (and truncated) for the streaming write.
+        // the journal mode appends in place, so nothing is read back.
+        std::list<cs::Entry> previous;
+        rust::Result<size_t> previous_count = (arguments_.append && !arguments_.journal)
+                ? output.from_json(arguments_.output.c_str(), previous)
+                : rust::Result<size_t>(rust::Ok(size_t(0)));
+
+        // the entries flow from the event decoding through the recognition
+        // straight into the filtered serialization, so the memory use does
+        // not grow with the size of the events database.
+        auto checkpoint_file = arguments_.output;
+        checkpoint_file += ".checkpoint";
+
+        // a segmented events database (see the writer's rotation) is a
+        // chain of self contained files; a plain database is its own,
+        // single element chain.
+        const auto segments = db::EventsDatabaseReader::segments(arguments_.input);
+
+        return previous_count
+                .and_then<size_t>([this, &output, &previous, &segments, &checkpoint_file, workers, window_size, recorder_ptr, profile_ptr](const auto old_entries_count) {
+                    spdlog::debug("compilation entries have read. [size: {}]", old_entries_count);
+                    auto sink_result = (arguments_.journal)
+                            ? output.to_json_line_stream(arguments_.output.c_str())
+                            : output.to_json_stream(arguments_.output.c_str());
+                    return sink_result
+                            .and_then<size_t>([this, &previous, &segments, &checkpoint_file, workers, window_size, recorder_ptr, profile_ptr](const auto &sink) {
+                                cs::semantic::Build build(configuration_.compilation);
+                                size_t new_entries_count = 0;
+                                for (const auto &segment : segments) {
+                                    auto events = db::EventsDatabaseReader::from(segment);
+                                    if (events.is_err()) {
+                                        return rust::Result<size_t>(rust::Err(events.unwrap_err()));
+                                    }
+                                    auto commands = events.unwrap();
+                                    // a valid checkpoint lets the run parse only the
+                                    // new suffix of the events database. (the offset
+                                    // check ties it to one segment of the chain.)
+                                    const size_t skip = (arguments_.append || arguments_.journal)
+                                            ? records_to_skip(commands, checkpoint_file)
+                                            : 0;
+                                    spdlog::debug("events processed by previous runs. [file: {}, records: {}]", segment.string(), skip);
+                                    // only the started events carry an execution to
+                                    // recognize; terminate and signal records are stepped
+                                    // over on the wire format, without parsing them.
+                                    commands->project(rpc::Event::kStarted);
+                                    auto step = transform(build, commands, *sink, skip, workers, window_size, recorder_ptr, profile_ptr);
+                                    if (step.is_err()) {
+                                        return step;
+                                    }
+                                    new_entries_count += step.unwrap();
+                                    if (&segment == &segments.back()) {
+                                        // the checkpoint follows the open segment; the
+                                        // finished ones never grow a new suffix.
+                                        if (const auto records = commands->indexed_count(); records > 0) {
+                                            const auto last = static_cast<int>(records - 1);
+                                            write_checkpoint(checkpoint_file, {records, commands->index().offsets(last)});
+                                        }
+                                    } else if (arguments_.journal) {
+                                        // a rotated out segment is processed in full and
+                                        // never revisited: the journal run (whose output
+                                        // survives the next round) deletes it, which keeps
+                                        // a long session in constant disk space.
+                                        std::error_code ignored;
+                                        fs::remove(segment, ignored);
+                                    }
+                                }
+                                spdlog::debug("compilation entries created. [size: {}]", new_entries_count);
+                                if (profile_ptr != nullptr) {
+                                    profile_ptr->produced = new_entries_count + previous.size();
+                                }
+                                return sink->add_all(previous)
+                                        .template and_then<size_t>([&sink](auto ignored) {
+                                            return sink->flush();
+                                        });
+                            });
                 })
-                .map<int>([](auto size) {
+                .map<int>([profile_ptr](auto size) {
                     // just map to success exit code if it was successful.
                     spdlog::debug("compilation entries written. [size: {}]", size);
+                    if (profile_ptr != nullptr) {
+                        profile_ptr->report(size);
+                    }
                     return EXIT_SUCCESS;
                 });
     }
@@ -232,7 +1030,16 @@ namespace cs {
                 {cmd::citnames::FLAG_OUTPUT,     {1, false, "path of the result file",                   {cmd::citnames::DEFAULT_OUTPUT},  std::nullopt}},
                 {cmd::citnames::FLAG_CONFIG,     {1, false, "path of the config file",                   std::nullopt,                     std::nullopt}},
                 {cmd::citnames::FLAG_APPEND,     {0, false, "append to output, instead of overwrite it", std::nullopt,                     std::nullopt}},
-                {cmd::citnames::FLAG_RUN_CHECKS, {0, false, "can run checks on the current host",        std::nullopt,                     std::nullopt}}
+                {cmd::citnames::FLAG_JOURNAL,    {0, false, "append to output as JSON lines, without rewriting it (a later --append run compacts it)", std::nullopt, std::nullopt}},
+                {cmd::citnames::FLAG_RUN_CHECKS, {0, false, "can run checks on the current host",        std::nullopt,                     std::nullopt}},
+                {cmd::citnames::FLAG_PROFILE,    {0, false, "print per phase counters at exit",          std::nullopt,                     std::nullopt}},
+                {cmd::citnames::FLAG_JOBS,       {1, false, "number of worker threads (default: one per hardware thread)", std::nullopt,  std::nullopt}},
+                {cmd::citnames::FLAG_MEMORY_LIMIT, {1, false, "memory ceiling of the in flight entries, in megabytes",     std::nullopt,  std::nullopt}},
+                {cmd::citnames::FLAG_RECORD_CORPUS, {1, false, "write the distinct command lines into an events database", std::nullopt,  std::nullopt}},
+                {cmd::citnames::FLAG_REPLAY,     {0, false, "run only the recognition over the input and print counters",  std::nullopt,  std::nullopt}},
+                {cmd::citnames::FLAG_VALIDATE,   {0, false, "check the entries of the output file, instead of creating it", std::nullopt, std::nullopt}},
+                {cmd::citnames::FLAG_DIFF,       {2, false, "compare two compilation databases and print the added, removed and changed entries", std::nullopt, std::nullopt}},
+                {cmd::citnames::FLAG_SERVE,      {1, false, "answer single file flag queries over the given unix socket", std::nullopt, std::nullopt}}
         });
         return parser.parse_or_exit(argc, const_cast<const char **>(argv));
     }
@@ -36,6 +36,33 @@ namespace cs {
         fs::path input;
         fs::path output;
         bool append;
+        bool journal;
+        bool profile;
+        // when not empty, the distinct command lines of the run are
+        // written into this file as a small events database.
+        fs::path record_corpus;
+        // run only the recognition over the input and report counters
+        // and times; no compilation database is produced.
+        bool replay;
+        // check the entries of an existing compilation database (named
+        // by the output flag) against the filesystem; no events are
+        // processed.
+        bool validate;
+        // when not empty, compare these two compilation databases by
+        // per entry fingerprints instead of processing events. (both
+        // are set together, or both stay empty.)
+        fs::path diff_old;
+        fs::path diff_new;
+        // worker threads of the parallel passes; zero asks for one per
+        // hardware thread.
+        size_t jobs;
+        // memory ceiling of the in flight entries, in megabytes; the
+        // reorder window between the workers and the writer is sized
+        // from it. zero means the built in default.
+        size_t memory_limit;
+        // when not empty, answer single file queries over this unix
+        // socket instead of writing the output. (see the query server)
+        fs::path serve_socket;
     };
 
     struct Command : ps::Command {
@@ -0,0 +1,96 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "citnames/Citnames.h"
+
+#include "Domain.h"
+#include "semantic/Semantic.h"
+#include "semantic/Tool.h"
+#include "semantic/ToolAny.h"
+#include "semantic/ToolClang.h"
+#include "semantic/ToolCuda.h"
+#include "semantic/ToolGcc.h"
+#include "semantic/ToolWrapper.h"
+
+#include <utility>
+
+namespace {
+
+    // The same tool set the citnames executable assembles from the
+    // default configuration. (See `Build.cc`.)
+    std::shared_ptr<cs::semantic::Tool> default_tools() {
+        cs::semantic::ToolAny::ToolPtrs tools = {
+                std::make_shared<cs::semantic::ToolGcc>(),
+                std::make_shared<cs::semantic::ToolClang>(),
+                std::make_shared<cs::semantic::ToolWrapper>(),
+                std::make_shared<cs::semantic::ToolCuda>(),
+        };
+        return std::make_shared<cs::semantic::ToolAny>(
+                std::move(tools),
+                std::list<fs::path>());
+    }
+
+    domain::Execution from(const citnames::Execution &execution) {
+        return domain::Execution{
+                execution.executable,
+                execution.arguments,
+                execution.working_dir,
+                domain::Environment(execution.environment),
+        };
+    }
+
+    citnames::Entry from(cs::Entry &&entry) {
+        return citnames::Entry{
+                std::move(entry.file),
+                std::move(entry.directory),
+                std::move(entry.output),
+                std::move(entry.arguments),
+        };
+    }
+}
+
+namespace citnames {
+
+    struct Recognizer::State {
+        std::shared_ptr<cs::semantic::Tool> tools;
+    };
+
+    Recognizer::Recognizer()
+            : state_(std::make_unique<State>(State{default_tools()}))
+    { }
+
+    Recognizer::~Recognizer() = default;
+
+    std::list<Entry> Recognizer::recognize(const Execution &execution) const {
+        std::list<Entry> results;
+
+        auto semantic = state_->tools->recognize(from(execution));
+        if (cs::semantic::Tool::recognized_ok(semantic)) {
+            auto semantic_ptr = semantic.unwrap();
+            if (auto candidate = dynamic_cast<cs::semantic::CompilerCall *>(semantic_ptr.get()); candidate != nullptr) {
+                for (auto &entry : std::move(*candidate).into_entries()) {
+                    results.emplace_back(from(std::move(entry)));
+                }
+            }
+        }
+        // a recognition failure reports nothing: for the caller there is
+        // no difference between a failed and a not recognized execution.
+        return results;
+    }
+}
@@ -19,29 +19,261 @@
 
 #include "Configuration.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <iomanip>
 #include <fstream>
+#include <type_traits>
 
 #include <fmt/format.h>
 #include <nlohmann/json.hpp>
 
+namespace {
+
+    // Binary snapshot of a parsed configuration, written next to the
+    // configuration file. It is validated against the size and the
+    // modification time of the source, so repeated invocations skip the
+    // JSON parsing while the configuration is unchanged. Any mismatch or
+    // decoding problem falls back to the JSON parser.
+    namespace snapshot {
+
+        constexpr char MAGIC[8] = { 'b', 'e', 'a', 'r', 'c', 'f', 'g', '7' };
+
+        struct Stamp {
+            std::uint64_t size;
+            std::int64_t mtime;
+        };
+
+        std::optional<Stamp> stamp_of(const fs::path &file) {
+            std::error_code error_code;
+            const auto size = fs::file_size(file, error_code);
+            if (error_code) {
+                return std::nullopt;
+            }
+            const auto mtime = fs::last_write_time(file, error_code);
+            if (error_code) {
+                return std::nullopt;
+            }
+            return Stamp { size, static_cast<std::int64_t>(mtime.time_since_epoch().count()) };
+        }
+
+        void write32(std::ostream &os, std::uint32_t value) {
+            const char bytes[4] = {
+                    static_cast<char>(value & 0xFFu),
+                    static_cast<char>((value >> 8u) & 0xFFu),
+                    static_cast<char>((value >> 16u) & 0xFFu),
+                    static_cast<char>((value >> 24u) & 0xFFu),
+            };
+            os.write(bytes, sizeof(bytes));
+        }
+
+        std::uint32_t read32(std::istream &is) {
+            char bytes[4];
+            if (!is.read(bytes, sizeof(bytes))) {
+                throw std::runtime_error("Truncated snapshot.");
+            }
+            return static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[0]))
+                   | (static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[1])) << 8u)
+                   | (static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[2])) << 16u)
+                   | (static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[3])) << 24u);
+        }
+
+        void write64(std::ostream &os, std::uint64_t value) {
+            write32(os, static_cast<std::uint32_t>(value & 0xFFFFFFFFu));
+            write32(os, static_cast<std::uint32_t>(value >> 32u));
+        }
+
+        std::uint64_t read64(std::istream &is) {
+            const auto low = read32(is);
+            const auto high = read32(is);
+            return static_cast<std::uint64_t>(low) | (static_cast<std::uint64_t>(high) << 32u);
+        }
+
+        void write_flag(std::ostream &os, bool value) {
+            os.put(value ? char(1) : char(0));
+        }
+
+        bool read_flag(std::istream &is) {
+            const int value = is.get();
+            if (value == std::char_traits<char>::eof()) {
+                throw std::runtime_error("Truncated snapshot.");
+            }
+            return (value != 0);
+        }
+
+        void write_string(std::ostream &os, const std::string &value) {
+            write32(os, static_cast<std::uint32_t>(value.size()));
+            os.write(value.data(), static_cast<std::streamsize>(value.size()));
+        }
+
+        std::string read_string(std::istream &is) {
+            const auto length = read32(is);
+            std::string result(length, char(0));
+            if (length > 0 && !is.read(result.data(), length)) {
+                throw std::runtime_error("Truncated snapshot.");
+            }
+            return result;
+        }
+
+        template <typename T>
+        void write_list(std::ostream &os, const std::list<T> &values) {
+            write32(os, static_cast<std::uint32_t>(values.size()));
+            for (const auto &value : values) {
+                if constexpr (std::is_same_v<T, fs::path>) {
+                    write_string(os, value.string());
+                } else {
+                    write_string(os, value);
+                }
+            }
+        }
+
+        template <typename T>
+        std::list<T> read_list(std::istream &is) {
+            std::list<T> result;
+            for (auto count = read32(is); count > 0; --count) {
+                result.emplace_back(read_string(is));
+            }
+            return result;
+        }
+
+        void write(std::ostream &os, const Stamp &stamp, const cs::Configuration &config) {
+            os.write(MAGIC, sizeof(MAGIC));
+            write64(os, stamp.size);
+            write64(os, static_cast<std::uint64_t>(stamp.mtime));
+            write_flag(os, config.output.format.command_as_array);
+            write_flag(os, config.output.format.drop_output_field);
+            write_flag(os, config.output.format.binary_sidecar);
+            write_flag(os, config.output.format.offset_index);
+            write_flag(os, config.output.format.shard_by_language);
+            write_flag(os, config.output.format.sort_entries);
+            write_flag(os, config.output.format.drop_directory_field);
+            write_string(os, config.output.format.paths_relative_to.string());
+            write_flag(os, config.output.content.include_only_existing_source);
+            write_flag(os, config.output.content.duplicates_by_output_only);
+            write_flag(os, config.output.content.gc_stale_entries);
+            write_list(os, config.output.content.paths_to_include);
+            write_list(os, config.output.content.paths_to_exclude);
+            write32(os, static_cast<std::uint32_t>(config.compilation.compilers_to_recognize.size()));
+            for (const auto &wrapper : config.compilation.compilers_to_recognize) {
+                write_string(os, wrapper.executable.string());
+                write_list(os, wrapper.flags_to_add);
+                write_list(os, wrapper.flags_to_remove);
+            }
+            write_list(os, config.compilation.compilers_to_exclude);
+            write_list(os, config.compilation.recognizer_plugins);
+        }
+
+        cs::Configuration read(std::istream &is, const Stamp &expected) {
+            char magic[sizeof(MAGIC)];
+            if (!is.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), MAGIC)) {
+                throw std::runtime_error("Not a snapshot.");
+            }
+            if (read64(is) != expected.size || static_cast<std::int64_t>(read64(is)) != expected.mtime) {
+                throw std::runtime_error("Stale snapshot.");
+            }
+            cs::Configuration result;
+            result.output.format.command_as_array = read_flag(is);
+            result.output.format.drop_output_field = read_flag(is);
+            result.output.format.binary_sidecar = read_flag(is);
+            result.output.format.offset_index = read_flag(is);
+            result.output.format.shard_by_language = read_flag(is);
+            result.output.format.sort_entries = read_flag(is);
+            result.output.format.drop_directory_field = read_flag(is);
+            result.output.format.paths_relative_to = read_string(is);
+            result.output.content.include_only_existing_source = read_flag(is);
+            result.output.content.duplicates_by_output_only = read_flag(is);
+            result.output.content.gc_stale_entries = read_flag(is);
+            result.output.content.paths_to_include = read_list<fs::path>(is);
+            result.output.content.paths_to_exclude = read_list<fs::path>(is);
+            for (auto count = read32(is); count > 0; --count) {
+                cs::CompilerWrapper wrapper;
+                wrapper.executable = read_string(is);
+                wrapper.flags_to_add = read_list<std::string>(is);
+                wrapper.flags_to_remove = read_list<std::string>(is);
+                result.compilation.compilers_to_recognize.emplace_back(std::move(wrapper));
+            }
+            result.compilation.compilers_to_exclude = read_list<fs::path>(is);
+            result.compilation.recognizer_plugins = read_list<fs::path>(is);
+            return result;
+        }
+
+        std::optional<cs::Configuration> load(const fs::path &snapshot_file, const Stamp &expected) {
+            try {
+                std::ifstream source(snapshot_file, std::ios::binary);
+                if (!source.is_open()) {
+                    return std::nullopt;
+                }
+                return read(source, expected);
+            } catch (const std::exception &) {
+                return std::nullopt;
+            }
+        }
+
+        void store(const fs::path &snapshot_file, const Stamp &stamp, const cs::Configuration &config) {
+            // best effort: a failure only means the next run parses the
+            // JSON again.
+            try {
+                std::ofstream target(snapshot_file, std::ios::binary);
+                if (target.is_open()) {
+                    write(target, stamp, config);
+                }
+            } catch (const std::exception &) {
+                // ignore.
+            }
+        }
+    }
+}
+
 namespace cs {
 
     void from_json(const nlohmann::json &j, Format &rhs) {
         j.at("command_as_array").get_to(rhs.command_as_array);
         j.at("drop_output_field").get_to(rhs.drop_output_field);
+
+        if (j.contains("binary_sidecar")) {
+            j.at("binary_sidecar").get_to(rhs.binary_sidecar);
+        }
+        if (j.contains("offset_index")) {
+            j.at("offset_index").get_to(rhs.offset_index);
+        }
+        if (j.contains("shard_by_language")) {
+            j.at("shard_by_language").get_to(rhs.shard_by_language);
+        }
+        if (j.contains("sort_entries")) {
+            j.at("sort_entries").get_to(rhs.sort_entries);
+        }
+        if (j.contains("drop_directory_field")) {
+            j.at("drop_directory_field").get_to(rhs.drop_directory_field);
+        }
+        if (j.contains("paths_relative_to")) {
+            std::string root;
+            j.at("paths_relative_to").get_to(root);
+            rhs.paths_relative_to = root;
+        }
     }
 
     void to_json(nlohmann::json &j, const Format &rhs) {
         j = nlohmann::json{
-                {"command_as_array",  rhs.command_as_array},
-                {"drop_output_field", rhs.drop_output_field},
+                {"command_as_array",   rhs.command_as_array},
+                {"drop_output_field",  rhs.drop_output_field},
+                {"binary_sidecar",     rhs.binary_sidecar},
+                {"offset_index",       rhs.offset_index},
+                {"shard_by_language",  rhs.shard_by_language},
+                {"sort_entries",       rhs.sort_entries},
+                {"drop_directory_field", rhs.drop_directory_field},
+                {"paths_relative_to",  rhs.paths_relative_to.string()},
         };
     }
 
     void from_json(const nlohmann::json &j, Content &rhs) {
         j.at("include_only_existing_source").get_to(rhs.include_only_existing_source);
 
+        if (j.contains("duplicates_by_output_only")) {
+            j.at("duplicates_by_output_only").get_to(rhs.duplicates_by_output_only);
+        }
+        if (j.contains("gc_stale_entries")) {
+            j.at("gc_stale_entries").get_to(rhs.gc_stale_entries);
+        }
         if (j.contains("paths_to_include")) {
             j.at("paths_to_include").get_to(rhs.paths_to_include);
         }
@@ -53,6 +285,8 @@ namespace cs {
     void to_json(nlohmann::json &j, const Content &rhs) {
         j = nlohmann::json{
                 {"include_only_existing_source",  rhs.include_only_existing_source},
+                {"duplicates_by_output_only",     rhs.duplicates_by_output_only},
+                {"gc_stale_entries",              rhs.gc_stale_entries},
         };
         if (!rhs.paths_to_include.empty()) {
             j["paths_to_include"] = rhs.paths_to_include;
@@ -104,6 +338,9 @@ namespace cs {
         if (j.contains("compilers_to_exclude")) {
             j.at("compilers_to_exclude").get_to(rhs.compilers_to_exclude);
         }
+        if (j.contains("recognizer_plugins")) {
+            j.at("recognizer_plugins").get_to(rhs.recognizer_plugins);
+        }
     }
 
     void to_json(nlohmann::json &j, const Compilation &rhs) {
@@ -113,6 +350,9 @@ namespace cs {
         if (!rhs.compilers_to_exclude.empty()) {
             j["compilers_to_exclude"] = rhs.compilers_to_exclude;
         }
+        if (!rhs.recognizer_plugins.empty()) {
+            j["recognizer_plugins"] = rhs.recognizer_plugins;
+        }
     }
 
     void from_json(const nlohmann::json &j, Configuration &rhs) {
@@ -219,8 +459,21 @@ namespace cs {
     rust::Result<Configuration> ConfigurationSerializer::from_json(const fs::path &file) const
     {
         try {
+            auto snapshot_file = file;
+            snapshot_file += ".cache";
+            const auto stamp = snapshot::stamp_of(file);
+            if (stamp) {
+                if (auto cached = snapshot::load(snapshot_file, stamp.value()); cached) {
+                    return rust::Ok(std::move(cached.value()));
+                }
+            }
             std::ifstream source(file);
             return from_json(source)
+                    .on_success([&snapshot_file, &stamp](const auto &config) {
+                        if (stamp) {
+                            snapshot::store(snapshot_file, stamp.value(), config);
+                        }
+                    })
                     .map_err<std::runtime_error>([&file](auto error) {
                         return std::runtime_error(
                                 fmt::format("Failed to read file: {}, cause: {}",
@@ -39,9 +39,41 @@ namespace cs {
     // One format element is how the command is represented: it can be an array
     // of strings or a single string (shell escaping to protect white spaces).
     // Another format element is if the output field is emitted or not.
+    // The directory field can be dropped the same way, for consumers
+    // which only read the file and arguments fields. (Such an
+    // abbreviated database is not a valid input for the append mode.)
+    // A third element asks for a compact binary sidecar file next to the
+    // JSON output (same name with a ".bin" suffix), written in the same
+    // pass. It stores the entries length-prefixed with a deduplicated
+    // string table, which loads considerably faster in tooling that
+    // re-reads the database often. (JSON stays the primary output.)
+    // Sharding splits the entries by source language into separate
+    // database files next to the JSON output (same name with the language
+    // inserted before the extension), plus an index file mapping the
+    // languages to the shard files. Tooling which only cares about one
+    // language can load its shard instead of the whole database.
+    // The offset index asks for a sidecar file next to the JSON output
+    // (same name with an ".index" suffix), mapping the hash of every
+    // source path to the byte range of its entries in the JSON file.
+    // A consumer needing one file's entry can pread exactly those bytes
+    // instead of parsing the whole database. (Plain array output only:
+    // neither the compressed nor the journal form has stable offsets.)
+    // Sorting orders the entries (by file, then directory, then output)
+    // before they are written, so the output is deterministic and can be
+    // compared or cached byte by byte across runs.
+    // A relative root makes the file, directory and output fields
+    // relative to the given directory: the entries of a monorepo share
+    // long path prefixes, and dropping them shrinks the output
+    // substantially. (Paths outside the root stay absolute.)
     struct Format {
         bool command_as_array = true;
         bool drop_output_field = false;
+        bool drop_directory_field = false;
+        bool binary_sidecar = false;
+        bool offset_index = false;
+        bool shard_by_language = false;
+        bool sort_entries = false;
+        fs::path paths_relative_to = {};
     };
 
     // Controls the content of the output.
@@ -49,8 +81,24 @@ namespace cs {
     // This will act as a filter on the output elements.
     // These attributes can be read from the configuration file, and can be
     // overridden by command line arguments.
+    //
+    // The duplicate detection normally fingerprints the source file and
+    // the whole argument list of every entry. Builds which guarantee a
+    // unique output file per entry (Ninja enforces this) can promise that
+    // invariant, and the detection fingerprints the short output path
+    // alone: half the hashing work on large databases. An entry without
+    // an output field falls back to the full fingerprint.
+    //
+    // The stale entry collection applies to the append mode: the entries
+    // read back from the existing database are dropped when their source
+    // file no longer exists, so deleted or moved sources do not
+    // accumulate over repeated appends. (It reuses the same batched stat
+    // checks as the existing source filter, but touches only the merged
+    // in entries; the fresh entries of the run are not stat'ed.)
     struct Content {
         bool include_only_existing_source = false;
+        bool duplicates_by_output_only = false;
+        bool gc_stale_entries = false;
         std::list<fs::path> paths_to_include = {};
         std::list<fs::path> paths_to_exclude = {};
     };
@@ -73,9 +121,16 @@ namespace cs {
     };
 
     // Represents compiler related configuration.
+    //
+    // The recognizer plugins are shared libraries implementing the
+    // semantic `Tool` interface (see `semantic/ToolPlugin.h` for the
+    // entry points they export). They are consulted before the built in
+    // recognizers, so in house code generators can be classified by
+    // compiled code instead of the interpreted wrapper configuration.
     struct Compilation {
         std::list<CompilerWrapper> compilers_to_recognize;
         std::list<fs::path> compilers_to_exclude;
+        std::list<fs::path> recognizer_plugins;
     };
 
     // Represents the application configuration.
@@ -17,28 +17,182 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "config.h"
 #include "Output.h"
+#include "Paths.h"
 #include "libshell/Command.h"
 
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <iomanip>
+#include <iterator>
 #include <fstream>
-#include <set>
+#include <map>
+#include <thread>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include <fmt/format.h>
 #include <nlohmann/json.hpp>
 
 namespace {
 
+    // The worker thread cap of the parallel helpers below. Zero asks
+    // for one worker per hardware thread. (See `cs::set_worker_limit`.)
+    std::atomic<size_t> WORKER_LIMIT(0);
+
+    size_t worker_limit() {
+        const size_t limit = WORKER_LIMIT.load();
+        return (limit != 0)
+               ? limit
+               : std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    // Runs the function over the [0, count) index range on a pool of
+    // threads. The indices are handed out one by one from a shared
+    // counter, so the threads balance uneven work between themselves.
+    template <typename Function>
+    void parallel_for(const size_t count, Function &&function) {
+        std::atomic<size_t> next(0);
+        const auto worker = [count, &next, &function]() {
+            for (size_t idx = next++; idx < count; idx = next++) {
+                function(idx);
+            }
+        };
+        const size_t worker_count = std::min(worker_limit(), count);
+        if (worker_count > 1) {
+            std::vector<std::thread> workers;
+            workers.reserve(worker_count);
+            for (size_t idx = 0; idx < worker_count; ++idx) {
+                workers.emplace_back(worker);
+            }
+            for (auto &thread : workers) {
+                thread.join();
+            }
+        } else if (worker_count == 1) {
+            worker();
+        }
+    }
+
+    // Compares output entries for the deterministic ordering: by file,
+    // then directory, then output.
+    bool entry_less(const cs::Entry &lhs, const cs::Entry &rhs) {
+        static const std::string empty;
+        if (const int order = lhs.file.native().compare(rhs.file.native()); order != 0) {
+            return order < 0;
+        }
+        if (const int order = lhs.directory.native().compare(rhs.directory.native()); order != 0) {
+            return order < 0;
+        }
+        const std::string &lhs_output = lhs.output ? lhs.output->native() : empty;
+        const std::string &rhs_output = rhs.output ? rhs.output->native() : empty;
+        return lhs_output.compare(rhs_output) < 0;
+    }
+
+    // Stable sort on worker threads: the chunks are sorted in parallel,
+    // then the sorted runs of each round are merged in parallel too.
+    template <typename T, typename Less>
+    void parallel_stable_sort(std::vector<T> &values, Less less) {
+        const size_t count = values.size();
+        if (count < 2) {
+            return;
+        }
+        const size_t workers = worker_limit();
+        const size_t chunk = std::max<size_t>(1024, (count + workers - 1) / workers);
+        std::vector<size_t> bounds;
+        for (size_t begin = 0; begin < count; begin += chunk) {
+            bounds.push_back(begin);
+        }
+        bounds.push_back(count);
+        parallel_for(bounds.size() - 1, [&values, &bounds, &less](const size_t idx) {
+            std::stable_sort(values.begin() + bounds[idx], values.begin() + bounds[idx + 1], less);
+        });
+        while (bounds.size() > 2) {
+            parallel_for((bounds.size() - 1) / 2, [&values, &bounds, &less](const size_t idx) {
+                std::inplace_merge(
+                        values.begin() + bounds[2 * idx],
+                        values.begin() + bounds[2 * idx + 1],
+                        values.begin() + bounds[2 * idx + 2],
+                        less);
+            });
+            std::vector<size_t> merged;
+            for (size_t idx = 0; idx < bounds.size(); idx += 2) {
+                merged.push_back(bounds[idx]);
+            }
+            if (merged.back() != count) {
+                merged.push_back(count);
+            }
+            bounds.swap(merged);
+        }
+    }
+
     struct Filter {
         virtual ~Filter() noexcept = default;
         virtual bool apply(const cs::Entry &) = 0;
     };
 
+    // The configured filter directories compiled into a trie of path
+    // components. One walk of a file path answers the containment
+    // against every configured directory at once, instead of a
+    // component comparison pass per directory. (Configurations with
+    // dozens of excluded vendor directories made the per directory
+    // scan the cost of the filter.)
+    struct PathTrie {
+        explicit PathTrie(const std::list<fs::path> &directories) {
+            for (const auto &directory : directories) {
+                Node *node = &root;
+                for (const auto &component : directory) {
+                    node = &node->children[component.string()];
+                }
+                node->terminal = true;
+            }
+        }
+
+        [[nodiscard]] bool empty() const {
+            return root.children.empty() && !root.terminal;
+        }
+
+        // True when any configured directory is a component prefix of
+        // the file path (or equals it).
+        [[nodiscard]] bool contains(const fs::path &file) const {
+            const Node *node = &root;
+            for (const auto &component : file) {
+                if (node->terminal) {
+                    return true;
+                }
+                const auto it = node->children.find(component.string());
+                if (it == node->children.end()) {
+                    return false;
+                }
+                node = &it->second;
+            }
+            return node->terminal;
+        }
+
+    private:
+        // a map for the guaranteed incomplete value type support.
+        struct Node {
+            std::map<std::string, Node> children;
+            bool terminal = false;
+        };
+        Node root;
+    };
+
     struct ContentFilter : public Filter {
         explicit ContentFilter(cs::Content config)
                 : config(std::move(config))
+                , include(this->config.paths_to_include)
+                , exclude(this->config.paths_to_exclude)
         { }
 
         bool apply(const cs::Entry &entry) override {
@@ -46,20 +200,77 @@ namespace {
             return exists(file) && to_include(file) && !to_exclude(file);
         }
 
+        // The batch form of the filter, organized column wise.
+        //
+        // The entries scatter across the heap; walking them once per
+        // check chases pointers. Instead the file attribute is pulled
+        // into one contiguous column (normalized in parallel, it is pure
+        // computation), then every check scans that column in cache
+        // order. The existence checks of the distinct files are spread
+        // over a thread pool: on network filesystems each stat call is a
+        // round trip, batching them in parallel hides that latency, and
+        // repeated sources are checked only once.
+        //
+        // The verdicts vector is resized and filled: a non zero value
+        // means the entry of that index passed.
+        void apply_all(const std::vector<const cs::Entry *> &entries, std::vector<char> &verdicts) {
+            verdicts.assign(entries.size(), 1);
+            if (config.include_only_existing_source) {
+                apply_existence(entries, verdicts);
+            }
+            if (!config.paths_to_include.empty() || !config.paths_to_exclude.empty()) {
+                for (size_t idx = 0; idx < entries.size(); ++idx) {
+                    if (verdicts[idx]) {
+                        const auto &file = entries[idx]->file;
+                        verdicts[idx] = (to_include(file) && !to_exclude(file)) ? verdicts[idx] : char(0);
+                    }
+                }
+            }
+        }
+
+        // The existence column of the batch filter, on its own: clears
+        // the verdict of every entry whose source file is gone. (The
+        // stale entry collection of the append merge calls it directly,
+        // without the other content checks.)
+        void apply_existence(const std::vector<const cs::Entry *> &entries, std::vector<char> &verdicts) {
+            std::vector<std::string> files(entries.size());
+            parallel_for(entries.size(), [&entries, &files](const size_t idx) {
+                files[idx] = cs::path::normal(entries[idx]->file);
+            });
+            std::vector<std::pair<const std::string *, bool *>> jobs;
+            for (const auto &file : files) {
+                const auto [it, inserted] = cache.emplace(file, false);
+                if (inserted) {
+                    jobs.emplace_back(&it->first, &it->second);
+                }
+            }
+            parallel_for(jobs.size(), [&jobs](const size_t idx) {
+                *jobs[idx].second = does_exist(*jobs[idx].first);
+            });
+            for (size_t idx = 0; idx < files.size(); ++idx) {
+                verdicts[idx] = cache.find(files[idx])->second ? verdicts[idx] : char(0);
+            }
+        }
+
     private:
-        [[nodiscard]] inline bool exists(const fs::path &file) const {
+        [[nodiscard]] inline bool exists(const fs::path &file) {
             const auto &to_check = config.include_only_existing_source;
-            return (!to_check) || (to_check && does_exist(file));
+            if (!to_check) {
+                return true;
+            }
+            const auto [it, inserted] = cache.emplace(cs::path::normal(file), false);
+            if (inserted) {
+                it->second = does_exist(it->first);
+            }
+            return it->second;
         }
 
         [[nodiscard]] inline bool to_include(const fs::path &file) const {
-            const auto &include = config.paths_to_include;
-            return include.empty() || does_contain(include, file);
+            return include.empty() || include.contains(file);
         }
 
         [[nodiscard]] inline bool to_exclude(const fs::path &file) const {
-            const auto &exclude = config.paths_to_exclude;
-            return !exclude.empty() && does_contain(exclude, file);
+            return !exclude.empty() && exclude.contains(file);
         }
 
         [[nodiscard]] static bool does_exist(const fs::path &path) {
@@ -67,67 +278,773 @@ namespace {
             return fs::exists(path, error_code);
         }
 
-        [[nodiscard]] static bool does_contain(const std::list<fs::path> &directories, const fs::path &file) {
-            return std::any_of(directories.begin(), directories.end(), [&file](auto directory) {
-                // check if the path elements (list of directory names) are the same.
-                const auto [end, nothing] = std::mismatch(directory.begin(), directory.end(), file.begin());
-                // the file is contained in the directory if all path elements are
-                // in the file paths too.
-                return (end == directory.end());
-            });
-        }
-
     private:
         cs::Content config;
+        PathTrie include;
+        PathTrie exclude;
+        std::unordered_map<std::string, bool> cache;
     };
 
     // Duplicate detection filter.
     //
-    // Duplicate detection can be done two ways: first one is based on the `output` attribute,
-    // second is based on all attributes. The benefit to use the `output` attribute only is,
-    // that it faster and handles compiler flag changes better. The problem with it is, that
-    // it not present in every entries.
+    // Two entries are duplicates when they refer to the same source file
+    // and were compiled with the same flags. The compiler name itself is
+    // ignored, only the flags count.
     //
-    // Current implementation is starts with the output one, but computes both hashes (and
-    // maintains the hash sets). If an entry has no output attribute, then it switch to use
-    // all attributes hashes.
+    // Each entry is reduced to a 128-bit fingerprint, hashed incrementally
+    // over the file name and the argument list. Keeping only fingerprints
+    // (instead of formatted key strings) spares an allocation and the
+    // string comparisons per entry, which shows up on databases with
+    // hundreds of thousands of entries.
     struct DuplicateFilter : public Filter {
-        DuplicateFilter()
-                : hashes()
+        explicit DuplicateFilter(bool output_only = false)
+                : output_only(output_only)
+                , fingerprints()
         { }
 
         bool apply(const cs::Entry &entry) override {
-            if (const auto h2 = hash(entry); hashes.find(h2) == hashes.end()) {
-                hashes.insert(h2);
+            return insert(fingerprint(entry, output_only));
+        }
+
+        using Fingerprint = std::pair<std::uint64_t, std::uint64_t>;
+
+        // Records a precomputed fingerprint; tells if it was new. (The
+        // batch path computes the fingerprints on worker threads, and
+        // keeps the first-occurrence-wins order with a serial insert.)
+        bool insert(const Fingerprint &value) {
+            if (known(value)) {
+                return false;
+            }
+            fingerprints.emplace(value);
+            if (fingerprints.size() >= SPILL_LIMIT) {
+                spill();
+            }
+            return true;
+        }
+
+        // The fingerprint based on all attributes.
+        //
+        // - It shall ignore the compiler name, but count all compiler flags in.
+        // - Two independently seeded hash streams make up the 128 bits, to
+        //   keep accidental collisions out of reach of real build sizes.
+        //
+        // When the configuration promises unique output files, the output
+        // path alone makes the fingerprint: hashing a short path instead
+        // of the whole argument list halves the dedup work. An entry
+        // without an output falls back to the full fingerprint.
+        static Fingerprint fingerprint(const cs::Entry &entry, bool output_only = false) {
+            Fingerprint result = { 14695981039346656037ULL, 1099511628211ULL };
+            if (output_only && entry.output) {
+                feed(result.first, entry.output->string());
+                feed(result.second, entry.output->string());
+                return result;
+            }
+            feed(result.first, entry.file.string());
+            feed(result.second, entry.file.string());
+            for (auto it = std::next(entry.arguments.begin()); it != entry.arguments.end(); ++it) {
+                feed(result.first, *it);
+                feed(result.second, *it);
+            }
+            return result;
+        }
+
+        // Tells if the filter runs in the output only fingerprint mode.
+        const bool output_only;
+
+    private:
+        struct FingerprintHash {
+            std::size_t operator()(const Fingerprint &value) const noexcept {
+                return value.first ^ value.second;
+            }
+        };
+
+        // FNV-1a, fed byte by byte. The terminating zero of every string
+        // goes into the state too, so that argument boundaries count.
+        static void feed(std::uint64_t &state, const std::string &value) noexcept {
+            for (size_t idx = 0; idx <= value.size(); ++idx) {
+                const auto byte = (idx == value.size()) ? char(0) : value[idx];
+                state = (state ^ static_cast<unsigned char>(byte)) * 1099511628211ULL;
+            }
+        }
+
+        // The hash set does not grow without bound: past a limit its
+        // content moves into sorted runs (compact vectors, a fraction of
+        // the set's footprint), and the largest runs spill into unnamed
+        // temporary files. A lookup checks the recent set first, then
+        // binary searches the runs. The verdicts stay exact and online;
+        // the spilling only changes where the older fingerprints live.
+        struct DiskRun {
+            std::unique_ptr<std::FILE, int (*)(std::FILE *)> file;
+            size_t count;
+        };
+
+        [[nodiscard]] bool known(const Fingerprint &value) const {
+            if (fingerprints.find(value) != fingerprints.end()) {
                 return true;
             }
+            for (const auto &run : runs) {
+                if (std::binary_search(run.begin(), run.end(), value)) {
+                    return true;
+                }
+            }
+            for (const auto &run : disk_runs) {
+                if (contains(run, value)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void spill() {
+            std::vector<Fingerprint> run(fingerprints.begin(), fingerprints.end());
+            std::sort(run.begin(), run.end());
+            fingerprints.clear();
+            runs.push_back(std::move(run));
+            // merge neighbouring runs of similar size, so the run count
+            // stays logarithmic and the merge work amortizes.
+            while (runs.size() > 1
+                    && runs[runs.size() - 2].size() <= runs.back().size() * 2) {
+                std::vector<Fingerprint> merged;
+                merged.reserve(runs[runs.size() - 2].size() + runs.back().size());
+                std::merge(runs[runs.size() - 2].begin(), runs[runs.size() - 2].end(),
+                           runs.back().begin(), runs.back().end(),
+                           std::back_inserter(merged));
+                runs.pop_back();
+                runs.pop_back();
+                runs.push_back(std::move(merged));
+            }
+            if (runs.back().size() >= DISK_RUN_LIMIT) {
+                disk_runs.push_back(write_run(runs.back()));
+                runs.pop_back();
+                // the same geometric merging applies on disk, with a
+                // sequential streamed merge into a new temporary file.
+                while (disk_runs.size() > 1
+                        && disk_runs[disk_runs.size() - 2].count <= disk_runs.back().count * 2) {
+                    DiskRun merged = merge_runs(disk_runs[disk_runs.size() - 2], disk_runs.back());
+                    disk_runs.pop_back();
+                    disk_runs.pop_back();
+                    disk_runs.push_back(std::move(merged));
+                }
+            }
+        }
+
+        static DiskRun merge_runs(const DiskRun &lhs, const DiskRun &rhs) {
+            std::FILE *file = std::tmpfile();
+            if (file == nullptr) {
+                throw std::runtime_error("Failed to create the duplicate filter spill file.");
+            }
+            DiskRun result = { { file, &std::fclose }, lhs.count + rhs.count };
+            std::rewind(lhs.file.get());
+            std::rewind(rhs.file.get());
+            Fingerprint left, right;
+            bool left_valid = (std::fread(&left, sizeof(left), 1, lhs.file.get()) == 1);
+            bool right_valid = (std::fread(&right, sizeof(right), 1, rhs.file.get()) == 1);
+            while (left_valid || right_valid) {
+                const bool take_left = left_valid && (!right_valid || !(right < left));
+                const Fingerprint &current = take_left ? left : right;
+                if (std::fwrite(&current, sizeof(current), 1, file) != 1) {
+                    throw std::runtime_error("Failed to write the duplicate filter spill file.");
+                }
+                if (take_left) {
+                    left_valid = (std::fread(&left, sizeof(left), 1, lhs.file.get()) == 1);
+                } else {
+                    right_valid = (std::fread(&right, sizeof(right), 1, rhs.file.get()) == 1);
+                }
+            }
+            return result;
+        }
+
+        static DiskRun write_run(const std::vector<Fingerprint> &run) {
+            std::FILE *file = std::tmpfile();
+            if (file == nullptr) {
+                throw std::runtime_error("Failed to create the duplicate filter spill file.");
+            }
+            DiskRun result = { { file, &std::fclose }, run.size() };
+            if (std::fwrite(run.data(), sizeof(Fingerprint), run.size(), file) != run.size()) {
+                throw std::runtime_error("Failed to write the duplicate filter spill file.");
+            }
+            return result;
+        }
+
+        static bool contains(const DiskRun &run, const Fingerprint &value) {
+            size_t low = 0;
+            size_t high = run.count;
+            while (low < high) {
+                const size_t mid = low + (high - low) / 2;
+                Fingerprint current;
+                if (std::fseek(run.file.get(), static_cast<long>(mid * sizeof(Fingerprint)), SEEK_SET) != 0
+                        || std::fread(&current, sizeof(current), 1, run.file.get()) != 1) {
+                    throw std::runtime_error("Failed to read the duplicate filter spill file.");
+                }
+                if (current < value) {
+                    low = mid + 1;
+                } else if (value < current) {
+                    high = mid;
+                } else {
+                    return true;
+                }
+            }
             return false;
         }
 
+        // The recent set spills when it holds this many fingerprints
+        // (16 MB of payload); a merged run of this many fingerprints
+        // (128 MB) moves to disk.
+        static constexpr size_t SPILL_LIMIT = size_t(1) << 20;
+        static constexpr size_t DISK_RUN_LIMIT = size_t(8) << 20;
+
     private:
-        // The hash function based on all attributes.
-        //
-        // - It shall ignore the compiler name, but count all compiler flags in.
-        // - Same compiler call semantic is detected by filter out the irrelevant flags.
-        static std::string hash(const cs::Entry &entry) {
-            auto file = entry.file.string();
-            std::reverse(file.begin(), file.end());
+        std::unordered_set<Fingerprint, FingerprintHash> fingerprints;
+        std::vector<std::vector<Fingerprint>> runs;
+        std::vector<DiskRun> disk_runs;
+    };
+
+    // SAX consumer for the compilation database format.
+    //
+    // Builds the entries one by one as the parser walks the input, so
+    // reading a database does not materialize the whole document as a
+    // JSON value first. (With append mode the previous output is re-read
+    // on every run, where the DOM allocation used to dominate.)
+    //
+    // Any deviation from the expected structure is reported by throwing,
+    // which the caller turns into a failed result.
+    struct EntryConsumer : nlohmann::json_sax<nlohmann::json> {
+        explicit EntryConsumer(std::list<cs::Entry> &entries)
+                : entries(entries)
+        { }
+
+        bool start_array(std::size_t) override {
+            switch (depth) {
+                case Depth::DOCUMENT:
+                    depth = Depth::ENTRIES;
+                    return true;
+                case Depth::FIELDS:
+                    if (field == "arguments") {
+                        depth = Depth::ARGUMENTS;
+                        return true;
+                    }
+                    [[fallthrough]];
+                default:
+                    throw std::runtime_error("unexpected array");
+            }
+        }
+
+        bool end_array() override {
+            depth = (depth == Depth::ARGUMENTS) ? Depth::FIELDS : Depth::DOCUMENT;
+            return true;
+        }
+
+        bool start_object(std::size_t) override {
+            if (depth != Depth::ENTRIES) {
+                throw std::runtime_error("unexpected object");
+            }
+            depth = Depth::FIELDS;
+            entry = cs::Entry();
+            return true;
+        }
+
+        bool end_object() override {
+            cs::validate(entry);
+            entries.emplace_back(std::move(entry));
+            depth = Depth::ENTRIES;
+            return true;
+        }
+
+        bool key(string_t &value) override {
+            field = value;
+            return true;
+        }
+
+        bool string(string_t &value) override {
+            switch (depth) {
+                case Depth::ARGUMENTS:
+                    entry.arguments.emplace_back(value);
+                    return true;
+                case Depth::FIELDS:
+                    if (field == "file") {
+                        entry.file = value;
+                    } else if (field == "directory") {
+                        entry.directory = value;
+                    } else if (field == "output") {
+                        entry.output.emplace(value);
+                    } else if (field == "command") {
+                        sh::split(value)
+                                .on_success([this](auto arguments) {
+                                    entry.arguments = arguments;
+                                })
+                                .on_error([](auto error) {
+                                    throw error;
+                                });
+                    }
+                    // unknown fields are tolerated, as before.
+                    return true;
+                default:
+                    throw std::runtime_error("unexpected string");
+            }
+        }
+
+        bool null() override { throw std::runtime_error("unexpected value"); }
+        bool boolean(bool) override { throw std::runtime_error("unexpected value"); }
+        bool number_integer(number_integer_t) override { throw std::runtime_error("unexpected value"); }
+        bool number_unsigned(number_unsigned_t) override { throw std::runtime_error("unexpected value"); }
+        bool number_float(number_float_t, const string_t &) override { throw std::runtime_error("unexpected value"); }
+        bool binary(binary_t &) override { throw std::runtime_error("unexpected value"); }
 
-            auto args = fmt::format(
-                    "{}",
-                    fmt::join(entry.arguments.rbegin(), std::prev(entry.arguments.rend()), ","));
-            size_t args_hash = std::hash<std::string>{}(args);
+        bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception &error) override {
+            throw std::runtime_error(error.what());
+        }
+
+    private:
+        enum class Depth { DOCUMENT, ENTRIES, FIELDS, ARGUMENTS };
+
+        std::list<cs::Entry> &entries;
+        Depth depth = Depth::DOCUMENT;
+        std::string field;
+        cs::Entry entry;
+    };
+
+    // Marks the end of a binary compilation database file.
+    constexpr char BINARY_MAGIC[8] = { 'b', 'e', 'a', 'r', 'c', 'd', 'b', '1' };
+    constexpr std::uint32_t NO_STRING = 0xFFFFFFFFu;
+
+    // Writes the compact binary form of the compilation database.
+    //
+    // The file holds the entry records first, each a sequence of 32 bit
+    // little endian string references: file, directory, output (or the
+    // no-string marker), argument count and the arguments. The referenced
+    // strings follow as a deduplicated table (count, then length prefixed
+    // bytes), and the file ends with the table's byte offset and the magic
+    // bytes, so a reader can locate the table from the end.
+    class BinaryWriter {
+    public:
+        explicit BinaryWriter(const fs::path &file)
+                : stream_(file, std::ios::binary)
+                , table_()
+                , ids_()
+        { }
+
+        [[nodiscard]] bool good() const {
+            return stream_.good();
+        }
+
+        void add(const cs::Entry &entry, bool drop_output) {
+            write32(intern(entry.file.string()));
+            write32(intern(entry.directory.string()));
+            write32((!drop_output && entry.output.has_value())
+                    ? intern(entry.output.value().string())
+                    : NO_STRING);
+            write32(static_cast<std::uint32_t>(entry.arguments.size()));
+            for (const auto &argument : entry.arguments) {
+                write32(intern(argument));
+            }
+        }
+
+        void finish() {
+            const auto table_offset = static_cast<std::uint64_t>(stream_.tellp());
+            write32(static_cast<std::uint32_t>(table_.size()));
+            for (const auto &string : table_) {
+                write32(static_cast<std::uint32_t>(string.size()));
+                stream_.write(string.data(), static_cast<std::streamsize>(string.size()));
+            }
+            write64(table_offset);
+            stream_.write(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+            stream_.flush();
+        }
+
+    private:
+        std::uint32_t intern(const std::string &value) {
+            const auto [it, inserted] = ids_.emplace(value, static_cast<std::uint32_t>(table_.size()));
+            if (inserted) {
+                table_.push_back(value);
+            }
+            return it->second;
+        }
+
+        void write32(std::uint32_t value) {
+            const char bytes[4] = {
+                    static_cast<char>(value & 0xFFu),
+                    static_cast<char>((value >> 8u) & 0xFFu),
+                    static_cast<char>((value >> 16u) & 0xFFu),
+                    static_cast<char>((value >> 24u) & 0xFFu),
+            };
+            stream_.write(bytes, sizeof(bytes));
+        }
+
+        void write64(std::uint64_t value) {
+            write32(static_cast<std::uint32_t>(value & 0xFFFFFFFFu));
+            write32(static_cast<std::uint32_t>(value >> 32u));
+        }
 
-            return fmt::format("{}:{}", args_hash, file);
+    private:
+        std::ofstream stream_;
+        std::vector<std::string> table_;
+        std::unordered_map<std::string, std::uint32_t> ids_;
+    };
+
+    constexpr char OFFSETS_MAGIC[8] = { 'b', 'e', 'a', 'r', 'i', 'd', 'x', '1' };
+
+    // Writes the sidecar offset index of the JSON array output. One fixed
+    // size record per entry: the FNV-1a hash of the source path, then the
+    // byte offset and the byte length of the entry's rendered text in the
+    // JSON file (64 bit little endian each). The records are sorted by
+    // hash at finish, and the file ends with the record count and the
+    // magic bytes. A consumer binary searches the hash of the path it
+    // needs and preads exactly the entry's bytes, instead of parsing the
+    // whole database. (Several entries of the same source yield one
+    // record each, adjacent after the sort.)
+    class OffsetIndexWriter {
+    public:
+        explicit OffsetIndexWriter(const fs::path &file)
+                : stream_(file, std::ios::binary)
+                , records_()
+        { }
+
+        [[nodiscard]] bool good() const {
+            return stream_.good();
+        }
+
+        void add(const cs::Entry &entry, std::uint64_t offset, std::uint64_t length) {
+            records_.push_back({path_hash(entry.file.string()), offset, length});
+        }
+
+        void finish() {
+            std::sort(records_.begin(), records_.end(), [](const auto &lhs, const auto &rhs) {
+                return lhs.hash < rhs.hash;
+            });
+            for (const auto &record : records_) {
+                write64(record.hash);
+                write64(record.offset);
+                write64(record.length);
+            }
+            write64(records_.size());
+            stream_.write(OFFSETS_MAGIC, sizeof(OFFSETS_MAGIC));
+            stream_.flush();
+        }
+
+        // FNV-1a over the path bytes; a consumer computes the same hash
+        // for its lookup key.
+        static std::uint64_t path_hash(const std::string &value) noexcept {
+            std::uint64_t state = 14695981039346656037ULL;
+            for (const char byte : value) {
+                state = (state ^ static_cast<unsigned char>(byte)) * 1099511628211ULL;
+            }
+            return state;
+        }
+
+    private:
+        struct Record {
+            std::uint64_t hash;
+            std::uint64_t offset;
+            std::uint64_t length;
+        };
+
+        void write64(std::uint64_t value) {
+            char bytes[8];
+            for (size_t idx = 0; idx < sizeof(bytes); ++idx) {
+                bytes[idx] = static_cast<char>((value >> (idx * 8u)) & 0xFFu);
+            }
+            stream_.write(bytes, sizeof(bytes));
+        }
+
+    private:
+        std::ofstream stream_;
+        std::vector<Record> records_;
+    };
+
+    std::uint32_t read32(const std::vector<char> &bytes, size_t offset) {
+        if (offset + 4 > bytes.size()) {
+            throw std::runtime_error("Truncated content.");
+        }
+        return static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[offset]))
+               | (static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[offset + 1])) << 8u)
+               | (static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[offset + 2])) << 16u)
+               | (static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[offset + 3])) << 24u);
+    }
+
+    std::uint64_t read64(const std::vector<char> &bytes, size_t offset) {
+        return static_cast<std::uint64_t>(read32(bytes, offset))
+               | (static_cast<std::uint64_t>(read32(bytes, offset + 4)) << 32u);
+    }
+
+    // Tells if the named file asks for inline compression. (Artifact
+    // pipelines compress the database anyway; writing the compressed
+    // form directly spares the uncompressed intermediate.)
+    bool compressed_name(const fs::path &file) {
+        return file.extension() == ".zst";
+    }
+
+#ifdef HAVE_ZSTD
+    // A stream buffer which compresses everything written through it
+    // into a zstd frame on the wrapped stream. The frame is closed by
+    // the finish call, which must precede closing the wrapped stream.
+    class ZstdOutputBuffer : public std::streambuf {
+    public:
+        explicit ZstdOutputBuffer(std::ostream &target)
+                : target_(target)
+                , context_(ZSTD_createCStream())
+                , input_(ZSTD_CStreamInSize())
+                , output_(ZSTD_CStreamOutSize())
+                , finished_(false)
+        {
+            if (context_ == nullptr) {
+                throw std::runtime_error("Failed to create the zstd stream.");
+            }
+            setp(input_.data(), input_.data() + input_.size());
+        }
+
+        ~ZstdOutputBuffer() override {
+            try {
+                finish();
+            } catch (const std::exception &) {
+                // the wrapped stream carries the error state already.
+            }
+            ZSTD_freeCStream(context_);
+        }
+
+        // Ends the zstd frame on the wrapped stream. Done at most once;
+        // a write after it would start a new frame.
+        void finish() {
+            if (!finished_) {
+                finished_ = true;
+                drain(ZSTD_e_end);
+            }
+        }
+
+    protected:
+        int overflow(int character) override {
+            drain(ZSTD_e_continue);
+            if (character != traits_type::eof()) {
+                *pptr() = traits_type::to_char_type(character);
+                pbump(1);
+            }
+            return traits_type::not_eof(character);
+        }
+
+        int sync() override {
+            drain(ZSTD_e_flush);
+            target_.flush();
+            return target_.good() ? 0 : -1;
+        }
+
+    private:
+        // Pushes the buffered bytes through the compressor. The continue
+        // mode stops when the input is consumed; the flush and end modes
+        // run until the compressor reports an empty internal buffer.
+        void drain(ZSTD_EndDirective mode) {
+            ZSTD_inBuffer input = { input_.data(), static_cast<size_t>(pptr() - pbase()), 0 };
+            for (;;) {
+                ZSTD_outBuffer output = { output_.data(), output_.size(), 0 };
+                const size_t remaining = ZSTD_compressStream2(context_, &output, &input, mode);
+                if (ZSTD_isError(remaining)) {
+                    throw std::runtime_error(
+                            fmt::format("Failed to compress: {}", ZSTD_getErrorName(remaining)));
+                }
+                target_.write(output_.data(), static_cast<std::streamsize>(output.pos));
+                const bool done = (mode == ZSTD_e_continue)
+                        ? (input.pos == input.size)
+                        : (remaining == 0);
+                if (done) {
+                    break;
+                }
+            }
+            setp(input_.data(), input_.data() + input_.size());
         }
 
     private:
-        std::set<std::string> hashes;
+        std::ostream &target_;
+        ZSTD_CStream *context_;
+        std::vector<char> input_;
+        std::vector<char> output_;
+        bool finished_;
     };
+
+    // The decompressing counterpart: the get area is refilled from the
+    // zstd frames of the wrapped stream. Concatenated frames (a journal
+    // appends one per run) are read through seamlessly.
+    class ZstdInputBuffer : public std::streambuf {
+    public:
+        explicit ZstdInputBuffer(std::istream &source)
+                : source_(source)
+                , context_(ZSTD_createDStream())
+                , input_(ZSTD_DStreamInSize())
+                , output_(ZSTD_DStreamOutSize())
+                , buffer_({ input_.data(), 0, 0 })
+        {
+            if (context_ == nullptr) {
+                throw std::runtime_error("Failed to create the zstd stream.");
+            }
+        }
+
+        ~ZstdInputBuffer() override {
+            ZSTD_freeDStream(context_);
+        }
+
+    protected:
+        int underflow() override {
+            for (;;) {
+                if (buffer_.pos == buffer_.size) {
+                    source_.read(input_.data(), static_cast<std::streamsize>(input_.size()));
+                    const auto count = source_.gcount();
+                    if (count <= 0) {
+                        return traits_type::eof();
+                    }
+                    buffer_ = { input_.data(), static_cast<size_t>(count), 0 };
+                }
+                ZSTD_outBuffer output = { output_.data(), output_.size(), 0 };
+                const size_t result = ZSTD_decompressStream(context_, &output, &buffer_);
+                if (ZSTD_isError(result)) {
+                    throw std::runtime_error(
+                            fmt::format("Failed to decompress: {}", ZSTD_getErrorName(result)));
+                }
+                if (output.pos > 0) {
+                    setg(output_.data(), output_.data(), output_.data() + output.pos);
+                    return traits_type::to_int_type(*gptr());
+                }
+            }
+        }
+
+    private:
+        std::istream &source_;
+        ZSTD_DStream *context_;
+        std::vector<char> input_;
+        std::vector<char> output_;
+        ZSTD_inBuffer buffer_;
+    };
+#endif
+
+    // The source language bucket of a file, derived from its extension.
+    // (The buckets name the output shards, so they are filename safe.)
+    std::string language_of(const fs::path &file) {
+        static const std::map<std::string, std::string> mapping = {
+                {".c", "c"}, {".i", "c"},
+                {".C", "cxx"}, {".cc", "cxx"}, {".CC", "cxx"}, {".cp", "cxx"},
+                {".cpp", "cxx"}, {".CPP", "cxx"}, {".cxx", "cxx"},
+                {".c++", "cxx"}, {".C++", "cxx"}, {".ii", "cxx"},
+                {".m", "objc"}, {".mi", "objc"}, {".mm", "objc"}, {".M", "objc"}, {".mii", "objc"},
+                {".cu", "cuda"},
+                {".f", "fortran"}, {".for", "fortran"}, {".ftn", "fortran"},
+                {".F", "fortran"}, {".FOR", "fortran"}, {".fpp", "fortran"},
+                {".FPP", "fortran"}, {".FTN", "fortran"},
+                {".f90", "fortran"}, {".f95", "fortran"}, {".f03", "fortran"}, {".f08", "fortran"},
+                {".F90", "fortran"}, {".F95", "fortran"}, {".F03", "fortran"}, {".F08", "fortran"},
+                {".s", "asm"}, {".S", "asm"}, {".sx", "asm"}, {".asm", "asm"},
+        };
+        const auto it = mapping.find(file.extension().string());
+        return (it != mapping.end()) ? it->second : std::string("other");
+    }
+
+    // Escape scanner of the JSON string writer below. Classifies eight
+    // bytes at a time: the returned word has the high bit set in every
+    // byte which needs escaping (a quote, a backslash or a control
+    // byte), and is zero for a clean span. (The zero byte and the
+    // range tests are the folklore bit tricks; bytes with the high bit
+    // set never match either test.)
+    constexpr std::uint64_t BYTE_REPEAT = 0x0101010101010101ull;
+    constexpr std::uint64_t BYTE_HIGH = 0x8080808080808080ull;
+
+    std::uint64_t classify(const std::uint64_t word) noexcept {
+        const std::uint64_t quote = word ^ (BYTE_REPEAT * std::uint64_t('"'));
+        const std::uint64_t backslash = word ^ (BYTE_REPEAT * std::uint64_t('\\'));
+        return ((word - (BYTE_REPEAT * 0x20u)) & ~word & BYTE_HIGH)
+               | ((quote - BYTE_REPEAT) & ~quote & BYTE_HIGH)
+               | ((backslash - BYTE_REPEAT) & ~backslash & BYTE_HIGH);
+    }
+
+    void append_escaped_byte(std::string &out, const unsigned char byte) {
+        switch (byte) {
+            case '"': out.append("\\\"", 2); break;
+            case '\\': out.append("\\\\", 2); break;
+            case '\b': out.append("\\b", 2); break;
+            case '\f': out.append("\\f", 2); break;
+            case '\n': out.append("\\n", 2); break;
+            case '\r': out.append("\\r", 2); break;
+            case '\t': out.append("\\t", 2); break;
+            default: {
+                char buffer[8];
+                std::snprintf(buffer, sizeof(buffer), "\\u%04x", unsigned(byte));
+                out.append(buffer, 6);
+                break;
+            }
+        }
+    }
+
+    // Appends the value as a quoted JSON string. Escaping is the byte
+    // level inner loop of writing the whole database, and command lines
+    // and paths are almost entirely clean spans: those are located word
+    // wise with the classifier above and copied in bulk. The escape
+    // sequences match the nlohmann serializer; bytes above 0x7f pass
+    // through untouched.
+    void append_json_string(std::string &out, const std::string &value) {
+        out.push_back('"');
+        const size_t size = value.size();
+        size_t begin = 0;
+        size_t idx = 0;
+        while (idx + sizeof(std::uint64_t) <= size) {
+            std::uint64_t word;
+            std::memcpy(&word, value.data() + idx, sizeof(word));
+            if (classify(word) == 0) {
+                idx += sizeof(word);
+                continue;
+            }
+            for (const size_t stop = idx + sizeof(word); idx < stop; ++idx) {
+                const auto byte = static_cast<unsigned char>(value[idx]);
+                if (byte < 0x20 || byte == '"' || byte == '\\') {
+                    out.append(value, begin, idx - begin);
+                    append_escaped_byte(out, byte);
+                    begin = idx + 1;
+                }
+            }
+        }
+        for (; idx < size; ++idx) {
+            const auto byte = static_cast<unsigned char>(value[idx]);
+            if (byte < 0x20 || byte == '"' || byte == '\\') {
+                out.append(value, begin, idx - begin);
+                append_escaped_byte(out, byte);
+                begin = idx + 1;
+            }
+        }
+        out.append(value, begin, size - begin);
+        out.push_back('"');
+    }
+
+    // The string building form of `write_indented` below, producing the
+    // same bytes into a buffer. (The parallel serialization renders into
+    // per chunk buffers before anything reaches the stream.)
+    void append_indented(std::string &out, const std::string &json) {
+        for (size_t begin = 0; begin < json.size();) {
+            const size_t end = json.find('\n', begin);
+            out.append("  ");
+            if (end == std::string::npos) {
+                out.append(json, begin, json.size() - begin);
+                break;
+            }
+            out.append(json, begin, end - begin + 1);
+            begin = end + 1;
+        }
+    }
+
+    // Write the serialized entry with the extra indentation it would have
+    // as an element of the top level array.
+    void write_indented(std::ostream &os, const std::string &json) {
+        for (size_t begin = 0; begin < json.size();) {
+            const size_t end = json.find('\n', begin);
+            os << "  ";
+            if (end == std::string::npos) {
+                os.write(json.data() + begin, static_cast<std::streamsize>(json.size() - begin));
+                break;
+            }
+            os.write(json.data() + begin, static_cast<std::streamsize>(end - begin + 1));
+            begin = end + 1;
+        }
+    }
 }
 
 namespace cs {
 
+    void set_worker_limit(size_t limit) {
+        WORKER_LIMIT.store(limit);
+    }
+
     void validate(const Entry &entry) {
         if (entry.file.empty()) {
             throw std::runtime_error("Field 'file' is empty string.");
@@ -143,13 +1060,24 @@ namespace cs {
         }
     }
 
+    // Emits the path relative to the declared root; paths outside of
+    // the root stay absolute. (Pure lexical, nothing is resolved on
+    // disk.)
+    static fs::path relative_to(const fs::path &path, const fs::path &root) {
+        auto candidate = path.lexically_proximate(root);
+        return (!candidate.empty() && *candidate.begin() != "..") ? candidate : path;
+    }
+
     nlohmann::json to_json(const Entry &rhs, const Format &format) {
         nlohmann::json json;
 
-        json["file"] = rhs.file;
-        json["directory"] = rhs.directory;
+        const bool relative = !format.paths_relative_to.empty();
+        json["file"] = relative ? relative_to(rhs.file, format.paths_relative_to) : rhs.file;
+        if (!format.drop_directory_field) {
+            json["directory"] = relative ? relative_to(rhs.directory, format.paths_relative_to) : rhs.directory;
+        }
         if (!format.drop_output_field && rhs.output.has_value()) {
-            json["output"] = rhs.output.value();
+            json["output"] = relative ? relative_to(rhs.output.value(), format.paths_relative_to) : rhs.output.value();
         }
         if (format.command_as_array) {
             json["arguments"] = rhs.arguments;
@@ -160,6 +1088,58 @@ namespace cs {
         return json;
     }
 
+    // Renders the entry straight into a string, byte identical to the
+    // nlohmann serialization of `to_json` (keys in alphabetical order,
+    // two space indent or the single line journal form). Bypassing the
+    // DOM keeps the escape scanner above as the inner loop: building
+    // and dumping a value per entry dominated the output writing.
+    static std::string render_entry(const Entry &rhs, const Format &format, const bool lines) {
+        const bool relative = !format.paths_relative_to.empty();
+        const auto path_of = [&relative, &format](const fs::path &path) {
+            return relative ? relative_to(path, format.paths_relative_to).string() : path.string();
+        };
+
+        std::string out;
+        out.reserve(256);
+        out.push_back('{');
+        bool first = true;
+        const auto member = [&out, &lines, &first](const char *key) {
+            out.append(first ? (lines ? "\"" : "\n  \"") : (lines ? ",\"" : ",\n  \""));
+            out.append(key);
+            out.append(lines ? "\":" : "\": ");
+            first = false;
+        };
+        if (format.command_as_array) {
+            member("arguments");
+            out.push_back('[');
+            bool first_argument = true;
+            for (const auto &argument : rhs.arguments) {
+                out.append(first_argument ? (lines ? "" : "\n    ") : (lines ? "," : ",\n    "));
+                append_json_string(out, argument);
+                first_argument = false;
+            }
+            if (!lines && !rhs.arguments.empty()) {
+                out.append("\n  ");
+            }
+            out.push_back(']');
+        } else {
+            member("command");
+            append_json_string(out, sh::join(rhs.arguments));
+        }
+        if (!format.drop_directory_field) {
+            member("directory");
+            append_json_string(out, path_of(rhs.directory));
+        }
+        member("file");
+        append_json_string(out, path_of(rhs.file));
+        if (!format.drop_output_field && rhs.output.has_value()) {
+            member("output");
+            append_json_string(out, path_of(rhs.output.value()));
+        }
+        out.append(lines ? "}" : "\n}");
+        return out;
+    }
+
     void from_json(const nlohmann::json &j, Entry &entry) {
         j.at("file").get_to(entry.file);
         j.at("directory").get_to(entry.directory);
@@ -210,10 +1190,419 @@ namespace cs {
             , content(std::move(_content))
     { }
 
+    struct CompilationDatabase::Sink::State {
+        explicit State(const CompilationDatabase &parent)
+                : buffer(1024 * 1024)
+                , file()
+                , content_filter(parent.content)
+                , duplicate_filter(parent.content.duplicates_by_output_only)
+                , format(parent.format)
+                // the existing source filter covers the existence check
+                // already, the collection would only repeat it.
+                , gc_stale(parent.content.gc_stale_entries && !parent.content.include_only_existing_source)
+                , count(0)
+        { }
+
+        // One partition of the sharded output, holding the entries of a
+        // single source language.
+        struct Shard {
+            fs::path path;
+            std::ofstream stream;
+            size_t count = 0;
+        };
+
+        // The shard of the entry's source language, opened on the first
+        // entry of that language.
+        Shard &shard_for(const Entry &entry) {
+            const auto language = language_of(entry.file);
+            if (const auto it = shards.find(language); it != shards.end()) {
+                return it->second;
+            }
+            auto path = output;
+            path.replace_extension();
+            path += fmt::format(".{}", language);
+            path += output.extension();
+            auto &shard = shards[language];
+            shard.path = path;
+            shard.stream.open(path);
+            shard.stream << '[';
+            return shard;
+        }
+
+        // Writes the rendered entry to the main output, and to the binary
+        // and sharded forms when those are requested.
+        void write_text(const Entry &entry, const std::string &text) {
+            if (lines) {
+                // journal form: one line per entry, no array punctuation.
+                out() << text << '\n';
+                count += 1;
+                return;
+            }
+            out() << (count == 0 ? "\n" : ",\n");
+            if (offsets) {
+                // the recorded range covers exactly the indented entry
+                // text, so a pread of it yields one parseable JSON value.
+                const auto begin = static_cast<std::uint64_t>(file.tellp());
+                write_indented(out(), text);
+                offsets->add(entry, begin, static_cast<std::uint64_t>(file.tellp()) - begin);
+            } else {
+                write_indented(out(), text);
+            }
+            if (binary) {
+                binary->add(entry, format.drop_output_field);
+            }
+            if (format.shard_by_language) {
+                auto &shard = shard_for(entry);
+                shard.stream << (shard.count == 0 ? "\n" : ",\n");
+                write_indented(shard.stream, text);
+                shard.count += 1;
+            }
+            count += 1;
+        }
+
+        // The stream the serialized entries go through: the compressor
+        // when the output name asks for it, the file itself otherwise.
+        [[nodiscard]] std::ostream &out() {
+#ifdef HAVE_ZSTD
+            if (compressed) {
+                return *compressed;
+            }
+#endif
+            return file;
+        }
+
+        [[nodiscard]] bool good() const {
+            return file.good()
+#ifdef HAVE_ZSTD
+                   && (!compressed || compressed->good())
+#endif
+                   && (!binary || binary->good())
+                   && (!offsets || offsets->good())
+                   && std::all_of(shards.begin(), shards.end(),
+                                  [](const auto &shard) { return shard.second.stream.good(); });
+        }
+
+        // With sorting requested the rendered entries are held back and
+        // written ordered at flush. (The ordering needs the whole set,
+        // so the memory use scales with the output in this mode.)
+        void write_or_hold(const Entry &entry, std::string text) {
+            if (format.sort_entries) {
+                pending.emplace_back(entry, std::move(text));
+            } else {
+                write_text(entry, text);
+            }
+        }
+
+        // Renders the entry for this sink: indented for the array form,
+        // a single line for the journal form.
+        [[nodiscard]] std::string render(const Entry &entry) const {
+            return render_entry(entry, format, lines);
+        }
+
+        ~State() {
+            // a sink abandoned before flush leaves no partial output
+            // behind. (the rename in flush clears the temp path.)
+            if (!temp.empty()) {
+#ifdef HAVE_ZSTD
+                // the compressor writes into the file on destruction.
+                compressed.reset();
+                zstd.reset();
+#endif
+                file.close();
+                std::error_code ignored;
+                fs::remove(temp, ignored);
+            }
+        }
+
+        std::vector<char> buffer;
+        std::ofstream file;
+#ifdef HAVE_ZSTD
+        // present when the output name asks for compression; the
+        // entries pass through it into the file.
+        std::unique_ptr<ZstdOutputBuffer> zstd;
+        std::unique_ptr<std::ostream> compressed;
+#endif
+        ContentFilter content_filter;
+        DuplicateFilter duplicate_filter;
+        Format format;
+        bool lines = false;
+        bool gc_stale = false;
+        size_t count;
+        std::unique_ptr<BinaryWriter> binary;
+        std::unique_ptr<OffsetIndexWriter> offsets;
+        fs::path output;
+        // non empty while the content sits in the temp file, before the
+        // rename into place.
+        fs::path temp;
+        std::map<std::string, Shard> shards;
+        std::vector<std::pair<Entry, std::string>> pending;
+    };
+
+    CompilationDatabase::Sink::Sink(std::unique_ptr<State> state) noexcept
+            : state_(std::move(state))
+    { }
+
+    CompilationDatabase::Sink::~Sink() noexcept = default;
+
+    rust::Result<int> CompilationDatabase::Sink::add(const Entry &entry) noexcept {
+        try {
+            if (!state_->content_filter.apply(entry) || !state_->duplicate_filter.apply(entry)) {
+                return rust::Ok(0);
+            }
+            state_->write_or_hold(entry, state_->render(entry));
+            if (!state_->good()) {
+                throw std::runtime_error("Failed to write entry.");
+            }
+            return rust::Ok(1);
+        } catch (const std::exception &error) {
+            return rust::Err(std::runtime_error(error.what()));
+        }
+    }
+
+    rust::Result<size_t> CompilationDatabase::Sink::add_all(const Entries &entries) noexcept {
+        try {
+            std::vector<const Entry *> all;
+            all.reserve(entries.size());
+            for (const auto &entry : entries) {
+                all.push_back(&entry);
+            }
+            // the content filter runs column wise over the whole batch,
+            // and the fingerprints are hashed on worker threads too; the
+            // serial pass below only inserts them, so the first occurrence
+            // wins just like with repeated add calls.
+            std::vector<char> verdicts;
+            state_->content_filter.apply_all(all, verdicts);
+            // The stale entry collection of the append merge: the batch
+            // holds the entries read back from the existing database, the
+            // ones with a deleted or moved source are dropped here.
+            if (state_->gc_stale) {
+                state_->content_filter.apply_existence(all, verdicts);
+            }
+            std::vector<DuplicateFilter::Fingerprint> fingerprints(all.size());
+            const bool output_only = state_->duplicate_filter.output_only;
+            parallel_for(all.size(), [&all, &fingerprints, output_only](const size_t idx) {
+                fingerprints[idx] = DuplicateFilter::fingerprint(*all[idx], output_only);
+            });
+            std::vector<const Entry *> accepted;
+            accepted.reserve(all.size());
+            for (size_t idx = 0; idx < all.size(); ++idx) {
+                if (verdicts[idx] && state_->duplicate_filter.insert(fingerprints[idx])) {
+                    accepted.push_back(all[idx]);
+                }
+            }
+            // render the accepted entries in parallel; the write below
+            // keeps their order.
+            std::vector<std::string> rendered(accepted.size());
+            std::atomic<bool> failed(false);
+            parallel_for(accepted.size(), [this, &accepted, &rendered, &failed](const size_t idx) {
+                try {
+                    rendered[idx] = state_->render(*accepted[idx]);
+                } catch (const std::exception &) {
+                    failed = true;
+                }
+            });
+            if (failed) {
+                throw std::runtime_error("Failed to render entries.");
+            }
+            for (size_t idx = 0; idx < accepted.size(); ++idx) {
+                state_->write_or_hold(*accepted[idx], std::move(rendered[idx]));
+            }
+            if (!state_->good()) {
+                throw std::runtime_error("Failed to write entries.");
+            }
+            return rust::Ok(accepted.size());
+        } catch (const std::exception &error) {
+            return rust::Err(std::runtime_error(error.what()));
+        }
+    }
+
+    rust::Result<size_t> CompilationDatabase::Sink::flush() noexcept {
+        try {
+            if (state_->format.sort_entries && !state_->pending.empty()) {
+                // write the held back entries in the deterministic order.
+                parallel_stable_sort(state_->pending, [](const auto &lhs, const auto &rhs) {
+                    return entry_less(lhs.first, rhs.first);
+                });
+                for (const auto &[entry, text] : state_->pending) {
+                    state_->write_text(entry, text);
+                }
+                state_->pending.clear();
+            }
+            if (!state_->lines) {
+                if (state_->count > 0) {
+                    state_->out() << '\n';
+                }
+                state_->out() << ']' << std::endl;
+            }
+            if (state_->binary) {
+                state_->binary->finish();
+            }
+            if (state_->offsets) {
+                state_->offsets->finish();
+                if (!state_->offsets->good()) {
+                    throw std::runtime_error("Failed to write offset index.");
+                }
+            }
+            if (state_->format.shard_by_language) {
+                // close the shards and write the index file next to them.
+                nlohmann::json index = nlohmann::json::object();
+                for (auto &[language, shard] : state_->shards) {
+                    if (shard.count > 0) {
+                        shard.stream << '\n';
+                    }
+                    shard.stream << ']' << std::endl;
+                    index[language] = shard.path.string();
+                }
+                auto index_path = state_->output;
+                index_path.replace_extension();
+                index_path += ".shards";
+                index_path += state_->output.extension();
+                std::ofstream index_file(index_path);
+                index_file << std::setw(2) << index << std::endl;
+                if (!index_file.good()) {
+                    throw std::runtime_error("Failed to write shard index.");
+                }
+            }
+            if (!state_->good()) {
+                throw std::runtime_error("Failed to write entries.");
+            }
+#ifdef HAVE_ZSTD
+            // the frame must end before the file closes beneath it.
+            if (state_->zstd) {
+                state_->compressed->flush();
+                state_->zstd->finish();
+            }
+#endif
+            // the content becomes visible under the output name in one
+            // step: consumers never see a half written database.
+            if (!state_->temp.empty()) {
+                state_->file.close();
+                if (state_->file.fail()) {
+                    throw std::runtime_error("Failed to write entries.");
+                }
+                fs::rename(state_->temp, state_->output);
+                state_->temp.clear();
+            }
+            return rust::Ok(state_->count);
+        } catch (const std::exception &error) {
+            return rust::Err(std::runtime_error(error.what()));
+        }
+    }
+
+    rust::Result<CompilationDatabase::SinkPtr> CompilationDatabase::to_json_stream(const fs::path &file) const {
+        try {
+            auto state = std::make_unique<Sink::State>(*this);
+            state->output = file;
+            // the entries land in a same directory temp file, renamed
+            // into place at flush: a killed run cannot leave a truncated
+            // database under the output name.
+            state->temp = file;
+            state->temp += ".tmp";
+            state->file.rdbuf()->pubsetbuf(state->buffer.data(), static_cast<std::streamsize>(state->buffer.size()));
+            state->file.open(state->temp);
+            if (!state->file.is_open()) {
+                throw std::runtime_error("Failed to open file.");
+            }
+            // a `.zst` output name asks for inline compression: the
+            // entries are compressed in the same pass as they are
+            // serialized, no uncompressed intermediate touches the disk.
+            if (compressed_name(file)) {
+#ifdef HAVE_ZSTD
+                state->zstd = std::make_unique<ZstdOutputBuffer>(state->file);
+                state->compressed = std::make_unique<std::ostream>(state->zstd.get());
+#else
+                throw std::runtime_error("Compressed output is not supported: built without zstd.");
+#endif
+            }
+            state->out() << '[';
+            if (format.binary_sidecar) {
+                auto sidecar = file;
+                sidecar += ".bin";
+                state->binary = std::make_unique<BinaryWriter>(sidecar);
+                if (!state->binary->good()) {
+                    throw std::runtime_error("Failed to open sidecar file.");
+                }
+            }
+            // byte offsets into a compressed stream would not let a
+            // consumer pread an entry, so the index stays plain-only.
+            if (format.offset_index && !compressed_name(file)) {
+                auto index = file;
+                index += ".index";
+                state->offsets = std::make_unique<OffsetIndexWriter>(index);
+                if (!state->offsets->good()) {
+                    throw std::runtime_error("Failed to open offset index file.");
+                }
+            }
+            return rust::Ok(SinkPtr(new Sink(std::move(state))));
+        } catch (const std::exception &error) {
+            return rust::Err(std::runtime_error(
+                    fmt::format("Failed to write file: {}, cause: {}",
+                                file.string(),
+                                error.what())));
+        }
+    }
+
+    rust::Result<CompilationDatabase::SinkPtr> CompilationDatabase::to_json_line_stream(const fs::path &file) const {
+        try {
+            auto state = std::make_unique<Sink::State>(*this);
+            state->output = file;
+            state->lines = true;
+            // the sidecar and the shards rewrite their whole content, so
+            // they are not maintained by the journaling sink.
+            state->format.binary_sidecar = false;
+            state->format.shard_by_language = false;
+            state->file.rdbuf()->pubsetbuf(state->buffer.data(), static_cast<std::streamsize>(state->buffer.size()));
+            state->file.open(file, std::ios::app);
+            if (!state->file.is_open()) {
+                throw std::runtime_error("Failed to open file.");
+            }
+            // a compressed journal grows by one zstd frame per run; the
+            // reader walks the concatenated frames transparently.
+            if (compressed_name(file)) {
+#ifdef HAVE_ZSTD
+                state->zstd = std::make_unique<ZstdOutputBuffer>(state->file);
+                state->compressed = std::make_unique<std::ostream>(state->zstd.get());
+#else
+                throw std::runtime_error("Compressed output is not supported: built without zstd.");
+#endif
+            }
+            return rust::Ok(SinkPtr(new Sink(std::move(state))));
+        } catch (const std::exception &error) {
+            return rust::Err(std::runtime_error(
+                    fmt::format("Failed to write file: {}, cause: {}",
+                                file.string(),
+                                error.what())));
+        }
+    }
+
     rust::Result<size_t> CompilationDatabase::to_json(const fs::path &file, const Entries &rhs) const {
         try {
-            std::ofstream target(file);
+            // A larger stream buffer batches the entries into fewer write
+            // calls. (The default buffer is a few kilobytes only.)
+            std::vector<char> buffer(1024 * 1024);
+            std::ofstream target;
+            target.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            // same directory temp file, renamed into place on success.
+            auto temp = file;
+            temp += ".tmp";
+            target.open(temp);
             return to_json(target, rhs)
+                    .and_then<size_t>([&target, &temp, &file](auto count) -> rust::Result<size_t> {
+                        target.close();
+                        if (target.fail()) {
+                            return rust::Err(std::runtime_error("Failed to write entries."));
+                        }
+                        std::error_code error;
+                        fs::rename(temp, file, error);
+                        if (error) {
+                            return rust::Err(std::runtime_error(error.message()));
+                        }
+                        return rust::Ok(count);
+                    })
+                    .on_error([&temp](const auto &) {
+                        std::error_code ignored;
+                        fs::remove(temp, ignored);
+                    })
                     .map_err<std::runtime_error>([&file](auto error) {
                         return std::runtime_error(
                                 fmt::format("Failed to write file: {}, cause: {}",
@@ -232,19 +1621,75 @@ namespace cs {
     rust::Result<size_t> CompilationDatabase::to_json(std::ostream &ostream, const Entries &entries) const {
         try {
             ContentFilter content_filter(content);
-            DuplicateFilter duplicate_filter;
+            DuplicateFilter duplicate_filter(content.duplicates_by_output_only);
 
-            size_t count = 0;
-            nlohmann::json json = nlohmann::json::array();
+            // A flat view over the scattered list nodes: the filter scans
+            // its column in one pass, and the sorting permutes pointers
+            // while the entries stay put.
+            std::vector<const Entry *> view;
+            view.reserve(entries.size());
             for (const auto &entry : entries) {
-                if (content_filter.apply(entry) && duplicate_filter.apply(entry)) {
-                    auto json_entry = cs::to_json(entry, format);
-                    json.emplace_back(std::move(json_entry));
-                    ++count;
+                view.push_back(&entry);
+            }
+            std::vector<char> verdicts;
+            content_filter.apply_all(view, verdicts);
+            if (format.sort_entries) {
+                // deterministic order. (the verdicts travel with the view.)
+                std::vector<size_t> order(view.size());
+                for (size_t idx = 0; idx < order.size(); ++idx) {
+                    order[idx] = idx;
+                }
+                parallel_stable_sort(order, [&view](const size_t lhs, const size_t rhs) {
+                    return entry_less(*view[lhs], *view[rhs]);
+                });
+                std::vector<const Entry *> sorted_view(view.size());
+                std::vector<char> sorted_verdicts(view.size());
+                for (size_t idx = 0; idx < order.size(); ++idx) {
+                    sorted_view[idx] = view[order[idx]];
+                    sorted_verdicts[idx] = verdicts[order[idx]];
                 }
+                view.swap(sorted_view);
+                verdicts.swap(sorted_verdicts);
             }
 
-            ostream << std::setw(2) << json << std::endl;
+            // The admitted entries are decided first: the duplicate
+            // filter is stateful, its scan stays sequential. (It is a
+            // hash probe per entry, not the expensive part.)
+            std::vector<const Entry *> admitted;
+            admitted.reserve(view.size());
+            for (size_t idx = 0; idx < view.size(); ++idx) {
+                if (verdicts[idx] && duplicate_filter.apply(*view[idx])) {
+                    admitted.push_back(view[idx]);
+                }
+            }
+            // The serialization of immutable entries is embarrassingly
+            // parallel: the chunks are rendered concurrently into per
+            // chunk buffers, and the buffers reach the stream in order
+            // as a few large writes. The produced bytes are identical
+            // to the sequential entry by entry serialization.
+            const size_t count = admitted.size();
+            constexpr size_t RENDER_CHUNK = 1024;
+            const size_t chunks = (count + RENDER_CHUNK - 1) / RENDER_CHUNK;
+            std::vector<std::string> buffers(chunks);
+            const Format &layout = format;
+            parallel_for(chunks, [&admitted, &buffers, &layout, count](const size_t chunk) {
+                const size_t begin = chunk * RENDER_CHUNK;
+                const size_t end = std::min(begin + RENDER_CHUNK, count);
+                std::string &buffer = buffers[chunk];
+                buffer.reserve((end - begin) * 256);
+                for (size_t idx = begin; idx < end; ++idx) {
+                    buffer.append(idx == 0 ? "\n" : ",\n");
+                    append_indented(buffer, render_entry(*admitted[idx], layout, false));
+                }
+            });
+            ostream << '[';
+            for (const auto &buffer : buffers) {
+                ostream.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            }
+            if (count > 0) {
+                ostream << '\n';
+            }
+            ostream << ']' << std::endl;
 
             return rust::Ok(count);
         } catch (const std::exception &error) {
@@ -255,13 +1700,25 @@ namespace cs {
     rust::Result<size_t> CompilationDatabase::from_json(const fs::path &file, std::list<cs::Entry> &entries) const {
         try {
             std::ifstream source(file);
+            const auto annotate = [&file](auto error) {
+                return std::runtime_error(
+                        fmt::format("Failed to read file: {}, cause: {}",
+                                    file.string(),
+                                    error.what()));
+            };
+            // a `.zst` named database is decompressed transparently.
+            if (compressed_name(file)) {
+#ifdef HAVE_ZSTD
+                ZstdInputBuffer buffer(source);
+                std::istream decompressed(&buffer);
+                return from_json(decompressed, entries)
+                        .map_err<std::runtime_error>(annotate);
+#else
+                throw std::runtime_error("Compressed input is not supported: built without zstd.");
+#endif
+            }
             return from_json(source, entries)
-                    .map_err<std::runtime_error>([&file](auto error) {
-                        return std::runtime_error(
-                                fmt::format("Failed to read file: {}, cause: {}",
-                                            file.string(),
-                                            error.what()));
-                    });
+                    .map_err<std::runtime_error>(annotate);
         } catch (const std::exception &error) {
             return rust::Err(std::runtime_error(
                     fmt::format("Failed to read file: {}, cause: {}",
@@ -272,16 +1729,144 @@ namespace cs {
 
     rust::Result<size_t> CompilationDatabase::from_json(std::istream &istream, std::list<cs::Entry> &entries) const {
         try {
-            nlohmann::json in;
-            istream >> in;
+            const size_t before = entries.size();
+            // Both forms are accepted: the JSON array and the journal of
+            // JSON lines. (The first character decides.)
+            istream >> std::ws;
+            if (istream.peek() == '[') {
+                EntryConsumer consumer(entries);
+                if (!nlohmann::json::sax_parse(istream, &consumer)) {
+                    return rust::Err(std::runtime_error("Syntax error."));
+                }
+            } else {
+                std::string line;
+                while (std::getline(istream, line)) {
+                    if (line.empty()) {
+                        continue;
+                    }
+                    Entry entry;
+                    cs::from_json(nlohmann::json::parse(line), entry);
+                    entries.emplace_back(std::move(entry));
+                }
+            }
+            return rust::Ok(entries.size() - before);
+        } catch (const std::exception &error) {
+            return rust::Err(std::runtime_error(error.what()));
+        }
+    }
 
-            for (const auto &e : in) {
+    rust::Result<size_t> CompilationDatabase::from_binary(const fs::path &file, Entries &entries) const {
+        try {
+            std::ifstream source(file, std::ios::binary);
+            std::vector<char> bytes(
+                    (std::istreambuf_iterator<char>(source)),
+                    std::istreambuf_iterator<char>());
+            constexpr size_t TRAILER_SIZE = sizeof(std::uint64_t) + sizeof(BINARY_MAGIC);
+            if (bytes.size() < TRAILER_SIZE
+                    || std::memcmp(bytes.data() + bytes.size() - sizeof(BINARY_MAGIC), BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0) {
+                throw std::runtime_error("Not a binary compilation database.");
+            }
+            // read the string table from the end of the file.
+            const auto table_offset = read64(bytes, bytes.size() - TRAILER_SIZE);
+            if (table_offset > bytes.size() - TRAILER_SIZE) {
+                throw std::runtime_error("Truncated content.");
+            }
+            std::vector<std::string> table;
+            size_t offset = table_offset;
+            const auto string_count = read32(bytes, offset);
+            offset += 4;
+            table.reserve(string_count);
+            for (std::uint32_t idx = 0; idx < string_count; ++idx) {
+                const auto length = read32(bytes, offset);
+                offset += 4;
+                if (offset + length > bytes.size()) {
+                    throw std::runtime_error("Truncated content.");
+                }
+                table.emplace_back(bytes.data() + offset, length);
+                offset += length;
+            }
+            const auto lookup = [&table](std::uint32_t id) -> const std::string & {
+                if (id >= table.size()) {
+                    throw std::runtime_error("Invalid string reference.");
+                }
+                return table[id];
+            };
+            // read the entry records, which span up to the string table.
+            size_t count = 0;
+            for (offset = 0; offset < table_offset; ++count) {
                 Entry entry;
-                cs::from_json(e, entry);
-                entries.emplace_back(entry);
+                entry.file = lookup(read32(bytes, offset));
+                entry.directory = lookup(read32(bytes, offset + 4));
+                if (const auto output = read32(bytes, offset + 8); output != NO_STRING) {
+                    entry.output.emplace(lookup(output));
+                }
+                const auto arguments = read32(bytes, offset + 12);
+                offset += 16;
+                for (std::uint32_t idx = 0; idx < arguments; ++idx) {
+                    entry.arguments.emplace_back(lookup(read32(bytes, offset)));
+                    offset += 4;
+                }
+                validate(entry);
+                entries.emplace_back(std::move(entry));
             }
+            return rust::Ok(count);
+        } catch (const std::exception &error) {
+            return rust::Err(std::runtime_error(
+                    fmt::format("Failed to read file: {}, cause: {}",
+                                file.string(),
+                                error.what())));
+        }
+    }
 
-            return rust::Ok(in.size());
+    rust::Result<size_t> CompilationDatabase::diff(const fs::path &old_file, const fs::path &new_file, std::ostream &ostream) const {
+        try {
+            // every entry is reduced to its fingerprint right after
+            // reading: the comparison works over hashes keyed by the
+            // file attribute, not over the databases themselves.
+            using Fingerprints = std::map<std::string, std::vector<DuplicateFilter::Fingerprint>>;
+            const auto load = [this](const fs::path &file) {
+                Entries entries;
+                return from_json(file, entries)
+                        .map<Fingerprints>([&entries](auto) {
+                            Fingerprints result;
+                            for (const auto &entry : entries) {
+                                result[entry.file.string()].push_back(DuplicateFilter::fingerprint(entry));
+                            }
+                            // repeated files compare as sets.
+                            for (auto &pair : result) {
+                                std::sort(pair.second.begin(), pair.second.end());
+                            }
+                            return result;
+                        });
+            };
+            return rust::merge(load(old_file), load(new_file))
+                    .map<size_t>([&ostream](const auto &tuple) {
+                        const auto &[old_side, new_side] = tuple;
+                        // one merge pass over the two sorted maps.
+                        size_t differences = 0;
+                        auto lhs = old_side.begin();
+                        auto rhs = new_side.begin();
+                        while (lhs != old_side.end() || rhs != new_side.end()) {
+                            if (rhs == new_side.end()
+                                    || (lhs != old_side.end() && lhs->first < rhs->first)) {
+                                ostream << "removed: " << lhs->first << '\n';
+                                ++differences;
+                                ++lhs;
+                            } else if (lhs == old_side.end() || rhs->first < lhs->first) {
+                                ostream << "added: " << rhs->first << '\n';
+                                ++differences;
+                                ++rhs;
+                            } else {
+                                if (lhs->second != rhs->second) {
+                                    ostream << "changed: " << lhs->first << '\n';
+                                    ++differences;
+                                }
+                                ++lhs;
+                                ++rhs;
+                            }
+                        }
+                        return differences;
+                    });
         } catch (const std::exception &error) {
             return rust::Err(std::runtime_error(error.what()));
         }
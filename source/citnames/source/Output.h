@@ -25,6 +25,7 @@
 #include <filesystem>
 #include <iosfwd>
 #include <list>
+#include <memory>
 #include <optional>
 #include <string>
 
@@ -55,6 +56,12 @@ namespace cs {
     bool operator==(const Entry& lhs, const Entry& rhs);
     std::ostream& operator<<(std::ostream&, const Entry&);
 
+    // Caps the number of worker threads the parallel passes of this
+    // module may use. Zero (the default) asks for one worker per
+    // hardware thread. Meant to be set once at startup, before the
+    // first parallel pass runs.
+    void set_worker_limit(size_t limit);
+
     // Utility class to persists JSON compilation database.
     //
     // While the JSON compilation database might have different format
@@ -69,13 +76,67 @@ namespace cs {
         CompilationDatabase(Format, Content);
         virtual ~CompilationDatabase() noexcept = default;
 
+        // Streaming sink of the serialization: the entries are filtered
+        // and written as they are added, so the producer does not need to
+        // hold the whole database in memory. The flush method closes the
+        // JSON array and reports how many entries were written.
+        class Sink {
+        public:
+            ~Sink() noexcept;
+
+            [[nodiscard]] rust::Result<int> add(const Entry &entry) noexcept;
+            // Batch variant of the add method: the filters are applied in
+            // order (the first occurrence wins, as with repeated add
+            // calls), but the entries are rendered on a thread pool
+            // before they are written in order. Reports the number of
+            // entries written.
+            [[nodiscard]] rust::Result<size_t> add_all(const Entries &entries) noexcept;
+            [[nodiscard]] rust::Result<size_t> flush() noexcept;
+
+        private:
+            friend struct CompilationDatabase;
+            struct State;
+            explicit Sink(std::unique_ptr<State> state) noexcept;
+            std::unique_ptr<State> state_;
+        };
+        using SinkPtr = std::shared_ptr<Sink>;
+
         // Serialization methods with error mapping.
+        //
+        // A `.zst` output name asks for inline compression (built with
+        // zstd only): the entries are compressed in the same pass as
+        // they are serialized, and `from_json` reads the compressed
+        // form back transparently.
+        [[nodiscard]] virtual rust::Result<SinkPtr> to_json_stream(const fs::path &file) const;
+
+        // A journaling variant of the streaming sink: the entries are
+        // appended to the file as single JSON lines, without touching the
+        // existing content. An incremental run costs writes proportional
+        // to the new entries, instead of rewriting the whole database.
+        // (The JSON array form is produced from the journal on demand:
+        // `from_json` reads both forms. The sidecar and shard outputs are
+        // not maintained in this mode, those need the whole set.)
+        [[nodiscard]] virtual rust::Result<SinkPtr> to_json_line_stream(const fs::path &file) const;
+
         [[nodiscard]] virtual rust::Result<size_t> to_json(const fs::path& file, const Entries &entries) const;
         [[nodiscard]] virtual rust::Result<size_t> to_json(std::ostream &ostream, const Entries &entries) const;
 
         [[nodiscard]] virtual rust::Result<size_t> from_json(const fs::path& file, Entries &entries) const;
         [[nodiscard]] virtual rust::Result<size_t> from_json(std::istream &istream, Entries &entries) const;
 
+        // Reads the compact binary form back. (See the binary_sidecar
+        // format flag; the main use is converting it to JSON on demand.)
+        [[nodiscard]] virtual rust::Result<size_t> from_binary(const fs::path &file, Entries &entries) const;
+
+        // Compares two compilation databases by per entry fingerprints
+        // (the same hashing the duplicate filter uses). The added,
+        // removed and changed entries, keyed by their file attribute,
+        // are printed to the stream; the returned difference count is
+        // zero for semantically identical databases. The entry order
+        // does not matter, and both the array and the journal forms
+        // are read.
+        [[nodiscard]] virtual rust::Result<size_t> diff(const fs::path &old_file, const fs::path &new_file, std::ostream &ostream) const;
+
     private:
         Format format;
         Content content;
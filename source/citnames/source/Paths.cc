@@ -0,0 +1,50 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Paths.h"
+
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace cs::path {
+
+    const std::string &normal(const fs::path &file) {
+        // the cache is shared by the whole pipeline: the lookups greatly
+        // outnumber the inserts, hence the reader writer lock. (The map
+        // is node based, an insert does not move the stored strings.)
+        static std::shared_mutex mutex;
+        static std::unordered_map<std::string, std::string> cache;
+
+        const std::string &key = file.native();
+        {
+            std::shared_lock<std::shared_mutex> guard(mutex);
+            if (const auto it = cache.find(key); it != cache.end()) {
+                return it->second;
+            }
+        }
+        std::string value = file.lexically_normal().string();
+        std::unique_lock<std::shared_mutex> guard(mutex);
+        return cache.emplace(key, std::move(value)).first->second;
+    }
+
+    fs::path absolute(const fs::path &file, const fs::path &working_dir) {
+        return file.is_absolute() ? file : working_dir / file;
+    }
+}
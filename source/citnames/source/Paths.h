@@ -0,0 +1,42 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+namespace fs = std::filesystem;
+
+namespace cs::path {
+
+    // Returns the lexically normal form of the path, keyed on the raw
+    // path string. The results are interned: a repeated query returns a
+    // reference to the stored string without running the allocation heavy
+    // path decomposition again. The same source file appears in many
+    // entries of a build, so the repeats dominate.
+    //
+    // Safe to call from multiple threads; the returned reference stays
+    // valid for the lifetime of the process.
+    const std::string &normal(const fs::path &file);
+
+    // Resolves the path against the working directory. (A lexical
+    // operation, no filesystem access is made.)
+    fs::path absolute(const fs::path &file, const fs::path &working_dir);
+}
@@ -24,6 +24,7 @@
 #include "ToolCuda.h"
 #include "ToolWrapper.h"
 #include "ToolExtendingWrapper.h"
+#include "ToolPlugin.h"
 #include "Convert.h"
 
 #include <memory>
@@ -44,6 +45,19 @@ namespace {
         for (auto && compiler : cfg.compilers_to_recognize) {
             tools.emplace_front(std::make_shared<cs::semantic::ToolExtendingWrapper>(std::move(compiler)));
         }
+        // the plugins land in front of everything else: compiled
+        // recognizers beat the interpreted wrapper configuration. A
+        // plugin that fails to load is skipped, the built in recognition
+        // still covers the rest of the build.
+        for (const auto &plugin : cfg.recognizer_plugins) {
+            cs::semantic::ToolPlugin::load(plugin)
+                    .on_success([&tools](const auto &tool) {
+                        tools.emplace_front(tool);
+                    })
+                    .on_error([&plugin](const auto &error) {
+                        spdlog::warn("Recognizer plugin skipped (file {}): {}", plugin.string(), error.what());
+                    });
+        }
         return std::make_shared<cs::semantic::ToolAny>(
                 std::move(tools),
                 std::move(cfg.compilers_to_exclude)
@@ -58,24 +72,28 @@ namespace cs::semantic {
     { }
 
     [[nodiscard]]
-    rust::Result<SemanticPtr> Build::recognize(const rpc::Event &event) {
+    rust::Result<SemanticPtr> Build::recognize(const rpc::Event &event) const {
         if (event.has_started()) {
             auto execution = domain::from(event.started().execution());
             auto pid = event.started().pid();
 
-            spdlog::debug("[pid: {}] execution: {}", pid, execution);
+            SPDLOG_DEBUG("[pid: {}] execution: {}", pid, execution);
 
             auto result = tools_->recognize(execution);
             if (Tool::recognized_ok(result)) {
-                spdlog::debug("[pid: {}] recognized.", pid);
+                SPDLOG_DEBUG("[pid: {}] recognized.", pid);
             } else if (Tool::recognized_with_error(result)) {
-                spdlog::debug("[pid: {}] recognition failed: {}", pid, result.unwrap_err().what());
+                SPDLOG_DEBUG("[pid: {}] recognition failed: {}", pid, result.unwrap_err().what());
             } else if (Tool::not_recognized(result)) {
-                spdlog::debug("[pid: {}] not recognized.", pid);
+                SPDLOG_DEBUG("[pid: {}] not recognized.", pid);
             }
             return result;
         } else {
-            return rust::Result<SemanticPtr>(rust::Err(std::runtime_error("n/a")));
+            // every stopped event takes this arm; the prepared error is
+            // copied (a noexcept, allocation free operation) instead of
+            // formatting a new one each time.
+            static const std::runtime_error not_applicable("n/a");
+            return rust::Result<SemanticPtr>(rust::Err(not_applicable));
         }
     }
 }
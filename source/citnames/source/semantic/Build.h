@@ -35,8 +35,9 @@ namespace cs::semantic {
     public:
         explicit Build(Compilation cfg) noexcept;
 
+        // Safe to call from multiple threads: the tools are stateless.
         [[nodiscard]]
-        rust::Result<SemanticPtr> recognize(const rpc::Event &event);
+        rust::Result<SemanticPtr> recognize(const rpc::Event &event) const;
 
         NON_DEFAULT_CONSTRUCTABLE(Build);
         NON_COPYABLE_NOR_MOVABLE(Build);
@@ -18,9 +18,127 @@
  */
 
 #include "Parsers.h"
+#include "libshell/Command.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+    // The bucket of a flag (or a lookup key) is its second character.
+    // Entries which don't start with a dash (the response file prefix)
+    // sort after every dashed flag, and get the sentinel bucket.
+    constexpr unsigned bucket_of(const std::string_view &flag) noexcept {
+        return (flag.size() >= 2 && flag.front() == '-')
+               ? static_cast<unsigned char>(flag[1])
+               : 256u;
+    }
+
+    constexpr bool by_name(const std::pair<std::string_view, cs::semantic::FlagDefinition> &entry,
+                           const std::string_view &key) noexcept {
+        return entry.first < key;
+    }
+
+    bool is_response_file(const std::string &argument) noexcept {
+        return argument.size() > 1 && argument.front() == '@';
+    }
+
+    // The cache entry of a tokenized response file. The stamp identifies
+    // the file content; a changed file is read and tokenized again.
+    struct ResponseFile {
+        std::pair<std::int64_t, std::int64_t> stamp;
+        cs::semantic::Arguments arguments;
+    };
+
+    // Reads and tokenizes a response file. The file is mapped into memory
+    // (link commands can grow them large) and split with the shell rules.
+    // Returns nothing when the file can't be read or tokenized.
+    std::optional<cs::semantic::Arguments> read_response_file(const std::string &path, const struct stat &status) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd == -1) {
+            return std::nullopt;
+        }
+        std::string content;
+        if (status.st_size > 0) {
+            void *address = ::mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address == MAP_FAILED) {
+                ::close(fd);
+                return std::nullopt;
+            }
+            content.assign(static_cast<const char *>(address), static_cast<size_t>(status.st_size));
+            ::munmap(address, static_cast<size_t>(status.st_size));
+        }
+        ::close(fd);
+
+        std::optional<cs::semantic::Arguments> result = std::nullopt;
+        sh::split(content)
+                .on_success([&result](const auto &words) {
+                    result = cs::semantic::Arguments(words.begin(), words.end());
+                });
+        return result;
+    }
+}
 
 namespace cs::semantic {
 
+    FlagsByName::FlagsByName(std::initializer_list<value_type> flags)
+            : flags_(flags)
+            , index_()
+    {
+        build_index();
+    }
+
+    FlagsByName::FlagsByName(const FlagsByName &base, std::initializer_list<value_type> additions)
+            : flags_(base.flags_)
+            , index_()
+    {
+        for (const auto &addition : additions) {
+            const auto it = std::find_if(flags_.begin(), flags_.end(),
+                    [&addition](const auto &entry) { return entry.first == addition.first; });
+            if (it != flags_.end()) {
+                it->second = addition.second;
+            } else {
+                flags_.push_back(addition);
+            }
+        }
+        build_index();
+    }
+
+    void FlagsByName::build_index() noexcept {
+        std::sort(flags_.begin(), flags_.end(),
+                  [](const auto &lhs, const auto &rhs) { return lhs.first < rhs.first; });
+        // index_[b] is the first entry of bucket b; index_[b + 1] ends it.
+        size_t entry = 0;
+        for (unsigned bucket = 0; bucket <= 256u; ++bucket) {
+            while (entry < flags_.size() && bucket_of(flags_[entry].first) < bucket) {
+                ++entry;
+            }
+            index_[bucket] = static_cast<std::uint16_t>(entry);
+        }
+    }
+
+    FlagsByName::const_iterator FlagsByName::lower_bound(const std::string_view &key) const noexcept {
+        if (const auto bucket = bucket_of(key); bucket < 256u) {
+            // every entry before the bucket is ordered before the key, and
+            // every entry after it is ordered after, so the result within
+            // the bucket is the same as a search over the whole array.
+            return std::lower_bound(
+                    flags_.begin() + index_[bucket],
+                    flags_.begin() + index_[bucket + 1],
+                    key,
+                    by_name);
+        }
+        return std::lower_bound(flags_.begin(), flags_.end(), key, by_name);
+    }
+
     rust::Result<std::pair<CompilerFlag, Input>, Input> FlagParser::parse(const Input &input) const {
         if (input.begin == input.end) {
             return rust::Err(input);
@@ -32,7 +150,7 @@ namespace cs::semantic {
             auto begin = input.begin;
             auto end = std::next(begin, size_t(count) + 1);
 
-            CompilerFlag compiler_flag = {Arguments(begin, end), type};
+            CompilerFlag compiler_flag = {std::vector<std::string>(begin, end), type};
             Input remainder = {end, input.end};
             return rust::Ok(std::make_pair(compiler_flag, remainder));
         }
@@ -93,10 +211,57 @@ namespace cs::semantic {
             auto begin = input.begin;
             auto end = std::next(begin);
 
-            CompilerFlag compiler_flag = {Arguments(begin, end), CompilerFlagType::LINKER_OBJECT_FILE};
+            CompilerFlag compiler_flag = {std::vector<std::string>(begin, end), CompilerFlagType::LINKER_OBJECT_FILE};
             Input remainder = {end, input.end};
             return rust::Ok(std::make_pair(compiler_flag, remainder));
         }
         return rust::Err(input);
     }
+
+    bool has_response_files(const Arguments &arguments) noexcept {
+        return std::any_of(arguments.begin(), arguments.end(),
+                           [](const auto &argument) { return is_response_file(argument); });
+    }
+
+    Arguments expand_response_files(const Arguments &arguments) {
+        // the semantic analysis runs on multiple threads, which all share
+        // the cache. (a stat call validates the entries on every use.)
+        static std::mutex mutex;
+        static std::unordered_map<std::string, ResponseFile> cache;
+
+        Arguments result;
+        result.reserve(arguments.size());
+        for (const auto &argument : arguments) {
+            if (!is_response_file(argument)) {
+                result.push_back(argument);
+                continue;
+            }
+            const std::string path = argument.substr(1);
+            struct stat status {};
+            if (::stat(path.c_str(), &status) == -1 || !S_ISREG(status.st_mode)) {
+                result.push_back(argument);
+                continue;
+            }
+            const auto stamp = std::make_pair(
+                    static_cast<std::int64_t>(status.st_mtime),
+                    static_cast<std::int64_t>(status.st_size));
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                if (const auto it = cache.find(path); it != cache.end() && it->second.stamp == stamp) {
+                    std::copy(it->second.arguments.begin(), it->second.arguments.end(),
+                              std::back_inserter(result));
+                    continue;
+                }
+            }
+            const auto content = read_response_file(path, status);
+            if (!content) {
+                result.push_back(argument);
+                continue;
+            }
+            std::copy(content->begin(), content->end(), std::back_inserter(result));
+            std::lock_guard<std::mutex> guard(mutex);
+            cache[path] = ResponseFile {stamp, *content};
+        }
+        return result;
+    }
 }
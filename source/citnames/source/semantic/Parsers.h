@@ -22,11 +22,15 @@
 #include "libresult/Result.h"
 #include "Domain.h"
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
-#include <list>
-#include <map>
+#include <initializer_list>
+#include <iterator>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include <spdlog/spdlog.h>
 #include <spdlog/fmt/ostr.h>
@@ -35,8 +39,9 @@ namespace cs::semantic {
 
     using namespace domain;
 
-    // Represents command line arguments.
-    using Arguments = std::list<std::string>;
+    // Represents command line arguments. (Contiguous storage: the parsers
+    // and the response file expansion only ever append and iterate.)
+    using Arguments = std::vector<std::string>;
 
     // Represents a segment of a whole command line arguments,
     // which belongs together.
@@ -81,12 +86,16 @@ namespace cs::semantic {
         OTHER,
     };
 
+    // The recognized flag keeps its arguments in contiguous storage, and
+    // the flags of a command line are contiguous too. (The parser output
+    // is iterated by every downstream pass, where the former per-node
+    // allocated lists cost both the allocations and the pointer chasing.)
     struct CompilerFlag {
-        Arguments arguments;
+        std::vector<std::string> arguments;
         CompilerFlagType type;
     };
 
-    using CompilerFlags = std::list<CompilerFlag>;
+    using CompilerFlags = std::vector<CompilerFlag>;
     using Input = ArgumentsSegment;
 
     enum class Match {
@@ -136,7 +145,41 @@ namespace cs::semantic {
         CompilerFlagType type;
     };
 
-    using FlagsByName = std::map<std::string_view, FlagDefinition>;
+    // The flag definition table, ordered by flag name.
+    //
+    // The definitions are declared in semantic groups, so the constructor
+    // sorts them into a flat array once. Lookups are narrowed to the run
+    // of flags sharing the second character of the key (almost every flag
+    // starts with a dash, so the second character is the discriminating
+    // one), which classifies an argument with a handful of comparisons on
+    // one contiguous array and no allocation.
+    class FlagsByName {
+    public:
+        using value_type = std::pair<std::string_view, FlagDefinition>;
+        using const_iterator = std::vector<value_type>::const_iterator;
+
+        FlagsByName(std::initializer_list<value_type> flags);
+
+        // Extends a base table with further definitions. An addition with
+        // the name of a base entry replaces that entry. (Meant for the
+        // static table of a derived tool, built once from the base tool's
+        // table, not for merging on the parse path.)
+        FlagsByName(const FlagsByName &base, std::initializer_list<value_type> additions);
+
+        [[nodiscard]] const_iterator begin() const noexcept { return flags_.begin(); }
+        [[nodiscard]] const_iterator end() const noexcept { return flags_.end(); }
+
+        // The first entry which is not ordered before the key. (Same
+        // contract as the ordered containers' method of the same name.)
+        [[nodiscard]] const_iterator lower_bound(const std::string_view &key) const noexcept;
+
+    private:
+        void build_index() noexcept;
+
+    private:
+        std::vector<value_type> flags_;
+        std::array<std::uint16_t, 257> index_;
+    };
 
     // Parser combinator which takes a list of flag definition and tries to apply
     // for the the received input stream. It can recognize only a single compiler
@@ -168,56 +211,60 @@ namespace cs::semantic {
     // Parser combinator which recognize source files as a single argument
     // of a compiler call.
     struct SourceMatcher {
-        constexpr static const char* EXTENSIONS[] {
-                // header files
-                ".h", ".hh", ".H", ".hp", ".hxx", ".hpp", ".HPP", ".h++", ".tcc",
-                // C
-                ".c", ".C",
-                // C++
-                ".cc", ".CC", ".c++", ".C++", ".cxx", ".cpp", ".cp",
-                // CUDA
-                ".cu",
-                // ObjectiveC
-                ".m", ".mi", ".mm", ".M", ".mii",
-                // Preprocessed
-                ".i", ".ii",
-                // Assembly
-                ".s", ".S", ".sx", ".asm",
-                // Fortran
-                ".f", ".for", ".ftn",
-                ".F", ".FOR", ".fpp", ".FPP", ".FTN",
-                ".f90", ".f95", ".f03", ".f08",
-                ".F90", ".F95", ".F03", ".F08",
-                // go
-                ".go",
-                // brig
+        // The known source extensions of header files, C, C++, CUDA,
+        // ObjectiveC, preprocessed sources, assembly, Fortran, go, brig,
+        // D and Ada. Bucketed by length and ordered within the buckets,
+        // so a candidate is settled by a binary search over the few
+        // entries of its own length, without an allocation.
+        constexpr static std::string_view EXTENSIONS_2[] = {
+                ".C", ".F", ".H", ".M", ".S", ".c", ".d", ".f", ".h", ".i", ".m", ".s",
+        };
+        constexpr static std::string_view EXTENSIONS_3[] = {
+                ".CC", ".cc", ".cp", ".cu", ".dd", ".di", ".go", ".hh", ".hp", ".ii", ".mi", ".mm", ".sx",
+        };
+        constexpr static std::string_view EXTENSIONS_4[] = {
+                ".C++", ".F03", ".F08", ".F90", ".F95", ".FOR", ".FPP", ".FTN", ".HPP",
+                ".abd", ".ads", ".asm", ".c++", ".cpp", ".cxx",
+                ".f03", ".f08", ".f90", ".f95", ".for", ".fpp", ".ftn",
+                ".h++", ".hpp", ".hxx", ".mii", ".tcc",
+        };
+        constexpr static std::string_view EXTENSIONS_5[] = {
                 ".brig",
-                // D
-                ".d", ".di", ".dd",
-                // Ada
-                ".ads", ".abd"
         };
 
+        [[nodiscard]]
+        static bool match_extension(const std::string_view candidate) noexcept {
+            const auto lookup = [candidate](const auto &bucket) {
+                return std::binary_search(std::begin(bucket), std::end(bucket), candidate);
+            };
+            switch (candidate.size()) {
+                case 2: return lookup(EXTENSIONS_2);
+                case 3: return lookup(EXTENSIONS_3);
+                case 4: return lookup(EXTENSIONS_4);
+                case 5: return lookup(EXTENSIONS_5);
+                default: return false;
+            }
+        }
+
         [[nodiscard]]
         static rust::Result<std::pair<CompilerFlag, Input>, Input> parse(const Input &input) {
-            const std::string candidate = take_extension(*input.begin);
-            for (auto extension : EXTENSIONS) {
-                if (candidate == extension) {
-                    auto begin = input.begin;
-                    auto end = std::next(begin, 1);
-
-                    CompilerFlag compiler_flag = {Arguments(begin, end), CompilerFlagType::SOURCE };
-                    Input remainder = { end, input.end };
-                    return rust::Ok(std::make_pair(compiler_flag, remainder));
-                }
+            if (match_extension(take_extension(*input.begin))) {
+                auto begin = input.begin;
+                auto end = std::next(begin, 1);
+
+                CompilerFlag compiler_flag = {std::vector<std::string>(begin, end), CompilerFlagType::SOURCE };
+                Input remainder = { end, input.end };
+                return rust::Ok(std::make_pair(compiler_flag, remainder));
             }
             return rust::Err(input);
         }
 
         [[nodiscard]]
-        static std::string take_extension(const std::string& file) {
-            auto pos = file.rfind('.');
-            return (pos == std::string::npos) ? file : file.substr(pos);
+        static std::string_view take_extension(const std::string& file) noexcept {
+            const auto pos = file.rfind('.');
+            return (pos == std::string::npos)
+                ? std::string_view(file)
+                : std::string_view(file).substr(pos);
         }
     };
 
@@ -268,6 +315,9 @@ namespace cs::semantic {
         result_type parse(const Input& input) const
         {
             CompilerFlags flags;
+            // at most one flag per argument; a single allocation serves
+            // the whole command line.
+            flags.reserve(static_cast<size_t>(std::distance(input.begin, input.end)));
             auto it = Input { input.begin, input.end };
             for (; it.begin != it.end;) {
                 auto result = parser.parse(it)
@@ -286,13 +336,20 @@ namespace cs::semantic {
         }
     };
 
+    // Tells if any of the arguments is a response file reference ("@file").
+    [[nodiscard]] bool has_response_files(const Arguments &arguments) noexcept;
+
+    // Replaces the response file references with the content of the named
+    // files, tokenized with the shell splitting rules. The tokenized files
+    // are cached by path and modification time, since build systems reuse
+    // the same response file across many objects. References which can not
+    // be read are kept as they are (the compiler reports those itself), and
+    // references inside a response file are not expanded further.
+    [[nodiscard]] Arguments expand_response_files(const Arguments &arguments);
+
     template <typename Parser>
-    rust::Result<CompilerFlags> parse(const Parser &parser, const Execution &execution)
+    rust::Result<CompilerFlags> parse_arguments(const Parser &parser, const Input &input)
     {
-        if (execution.arguments.empty()) {
-            return rust::Err(std::runtime_error("Failed to recognize: no arguments found."));
-        }
-        auto input = Input {std::next(execution.arguments.begin()), execution.arguments.end() };
         return parser.parse(input)
                 .template map_err<std::runtime_error>([](auto remainder) {
                     return std::runtime_error(
@@ -300,4 +357,17 @@ namespace cs::semantic {
                                         fmt::join(remainder.begin, remainder.end, ", ")));
                 });
     }
+
+    template <typename Parser>
+    rust::Result<CompilerFlags> parse(const Parser &parser, const Execution &execution)
+    {
+        if (execution.arguments.empty()) {
+            return rust::Err(std::runtime_error("Failed to recognize: no arguments found."));
+        }
+        if (has_response_files(execution.arguments)) {
+            const Arguments arguments = expand_response_files(execution.arguments);
+            return parse_arguments(parser, Input {std::next(arguments.begin()), arguments.end() });
+        }
+        return parse_arguments(parser, Input {std::next(execution.arguments.begin()), execution.arguments.end() });
+    }
 }
@@ -18,6 +18,7 @@
  */
 
 #include "semantic/Semantic.h"
+#include "Paths.h"
 
 #include <fmt/format.h>
 
@@ -44,7 +45,7 @@ namespace cs::semantic {
         return os;
     }
 
-    std::list<cs::Entry> QueryCompiler::into_entries() const {
+    std::list<cs::Entry> QueryCompiler::into_entries() && {
         return std::list<cs::Entry>();
     }
 
@@ -57,13 +58,13 @@ namespace cs::semantic {
         return os;
     }
 
-    std::list<cs::Entry> Preprocess::into_entries() const {
+    std::list<cs::Entry> Preprocess::into_entries() && {
         return std::list<cs::Entry>();
     }
 
     Compile::Compile(fs::path working_dir,
                      fs::path compiler,
-                     std::list<std::string> flags,
+                     std::vector<std::string> flags,
                      std::vector<fs::path> sources,
                      std::optional<fs::path> output)
             : working_dir(std::move(working_dir))
@@ -97,24 +98,35 @@ namespace cs::semantic {
         return os;
     }
 
-    std::list<cs::Entry> Compile::into_entries() const {
+    std::list<cs::Entry> Compile::into_entries() && {
         const auto abspath = [this](const fs::path &path) -> fs::path {
-            return (path.is_absolute()) ? path : working_dir / path;
+            return cs::path::absolute(path, working_dir);
         };
         std::list<cs::Entry> results;
-        for (const auto& source : sources) {
+        for (auto source = sources.begin(); source != sources.end(); ++source) {
             cs::Entry result {
-                abspath(source),
+                abspath(*source),
                 working_dir,
                 output ? std::optional(abspath(output.value())) : std::nullopt,
                 { compiler.string() }
             };
-            std::copy(flags.begin(), flags.end(), std::back_inserter(result.arguments));
+            // The conversion owns the semantic, so the entry of the last
+            // source takes over the string storage of the flags instead
+            // of copying it. The earlier entries still copy: each entry
+            // carries its own source file in the argument list, so the
+            // blocks can not be shared through the output type.
+            if (std::next(source) == sources.end()) {
+                for (auto &flag : flags) {
+                    result.arguments.push_back(std::move(flag));
+                }
+            } else {
+                std::copy(flags.begin(), flags.end(), std::back_inserter(result.arguments));
+            }
             if (output) {
                 result.arguments.emplace_back("-o");
                 result.arguments.push_back(output.value().string());
             }
-            result.arguments.push_back(source);
+            result.arguments.push_back(*source);
             results.emplace_back(std::move(result));
         }
         return results;
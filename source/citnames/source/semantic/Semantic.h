@@ -59,8 +59,12 @@ namespace cs::semantic {
     using SemanticPtr = std::shared_ptr<Semantic>;
 
     // Represents a compiler call command.
+    //
+    // The conversion consumes the semantic (hence the rvalue qualifier):
+    // the argument storage is moved into the entries instead of copied,
+    // the object is not usable afterwards.
     struct CompilerCall : public Semantic {
-        [[nodiscard]] virtual std::list<cs::Entry> into_entries() const = 0;
+        [[nodiscard]] virtual std::list<cs::Entry> into_entries() && = 0;
     };
 
     // Represents a compiler call, which does process any input, but query
@@ -69,7 +73,7 @@ namespace cs::semantic {
         bool operator==(Semantic const&) const override;
         std::ostream& operator<<(std::ostream&) const override;
 
-        [[nodiscard]] std::list<cs::Entry> into_entries() const override;
+        [[nodiscard]] std::list<cs::Entry> into_entries() && override;
     };
 
     // Represents a compiler call, which runs only the preprocessor.
@@ -78,26 +82,26 @@ namespace cs::semantic {
         bool operator==(Semantic const&) const override;
         std::ostream& operator<<(std::ostream&) const override;
 
-        [[nodiscard]] std::list<cs::Entry> into_entries() const override;
+        [[nodiscard]] std::list<cs::Entry> into_entries() && override;
     };
 
     // Represents a compiler call, which runs the compilation pass.
     struct Compile : public CompilerCall {
         Compile(fs::path working_dir,
                 fs::path compiler,
-                std::list<std::string> flags,
+                std::vector<std::string> flags,
                 std::vector<fs::path> sources,
                 std::optional<fs::path> output);
 
         bool operator==(Semantic const&) const override;
         std::ostream& operator<<(std::ostream&) const override;
 
-        [[nodiscard]] std::list<cs::Entry> into_entries() const override;
+        [[nodiscard]] std::list<cs::Entry> into_entries() && override;
 
     public:
         fs::path working_dir;
         fs::path compiler;
-        std::list<std::string> flags;
+        std::vector<std::string> flags;
         std::vector<fs::path> sources;
         std::optional<fs::path> output;
     };
@@ -19,27 +19,94 @@
 
 #include "ToolAny.h"
 
+namespace {
+
+    // The miss verdicts carry fixed messages, and most executions of a
+    // build are misses. The errors are prepared once and handed out as
+    // copies: the std::runtime_error copy constructor is noexcept, the
+    // copies share the already allocated message, so the miss path
+    // allocates nothing.
+    const std::runtime_error& not_recognized_error() {
+        static const std::runtime_error error("No tools recognize this execution.");
+        return error;
+    }
+
+    const std::runtime_error& excluded_error() {
+        static const std::runtime_error error("The tool is on the exclude list from configuration.");
+        return error;
+    }
+}
+
 namespace cs::semantic {
 
     ToolAny::ToolAny(ToolAny::ToolPtrs &&tools, std::list<fs::path> &&to_exclude) noexcept
             : tools_(tools)
-            , to_exclude_(to_exclude)
-    { }
+            , to_exclude_()
+    {
+        for (const fs::path &path : to_exclude) {
+            to_exclude_.emplace(path.lexically_normal().string());
+        }
+    }
 
     rust::Result<SemanticPtr> ToolAny::recognize(const domain::Execution &execution) const {
         // do different things if the execution is matching one of the nominated compilers.
-        if (to_exclude_.end() != std::find(to_exclude_.begin(), to_exclude_.end(), execution.executable)) {
-            return rust::Err(std::runtime_error("The tool is on the exclude list from configuration."));
-        } else {
-            // check if any tool can recognize the execution.
-            for (const auto &tool : tools_) {
-                auto result = tool->recognize(execution);
-                // return if it recognized in any way.
-                if (Tool::recognized_ok(result) || Tool::recognized_with_error(result)) {
-                    return result;
-                }
+        if (!to_exclude_.empty()
+                && to_exclude_.find(execution.executable.lexically_normal().string()) != to_exclude_.end()) {
+            return rust::Err(excluded_error());
+        }
+        // The program match decision of every tool depends only on the
+        // executable, so the tool which matched it once will match it
+        // again. Remember the match, and spare the probing of the other
+        // tools for later executions of the same program.
+        const auto key = execution.executable.string();
+        const Tool *cached = nullptr;
+        bool found = false;
+        {
+            std::lock_guard<std::mutex> guard(cache_mutex_);
+            if (const auto it = cache_.find(key); it != cache_.end()) {
+                cached = it->second;
+                found = true;
             }
         }
-        return rust::Err(std::runtime_error("No tools recognize this execution."));
+        if (found) {
+            return (cached != nullptr)
+                   ? cached->recognize(execution)
+                   : rust::Result<SemanticPtr>(rust::Err(not_recognized_error()));
+        }
+        // probe the most recently matched tool first: the dominant
+        // compiler of the build answers most of the queries, regardless
+        // where it stands in the declared list order.
+        const Tool *preferred = nullptr;
+        {
+            std::lock_guard<std::mutex> guard(cache_mutex_);
+            preferred = last_hit_;
+        }
+        if (preferred != nullptr) {
+            auto result = preferred->recognize(execution);
+            if (Tool::recognized_ok(result) || Tool::recognized_with_error(result)) {
+                std::lock_guard<std::mutex> guard(cache_mutex_);
+                cache_.emplace(key, preferred);
+                return result;
+            }
+        }
+        // check if any tool can recognize the execution.
+        for (const auto &tool : tools_) {
+            if (tool.get() == preferred) {
+                continue;
+            }
+            auto result = tool->recognize(execution);
+            // return if it recognized in any way.
+            if (Tool::recognized_ok(result) || Tool::recognized_with_error(result)) {
+                std::lock_guard<std::mutex> guard(cache_mutex_);
+                cache_.emplace(key, tool.get());
+                last_hit_ = tool.get();
+                return result;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> guard(cache_mutex_);
+            cache_.emplace(key, nullptr);
+        }
+        return rust::Err(not_recognized_error());
     }
 }
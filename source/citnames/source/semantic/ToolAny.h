@@ -21,6 +21,11 @@
 
 #include "Tool.h"
 
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
 namespace cs::semantic {
 
     class ToolAny : public Tool {
@@ -35,6 +40,18 @@ namespace cs::semantic {
 
     private:
         ToolPtrs tools_;
-        std::list<fs::path> to_exclude_;
+        // The excluded program paths, normalized and prehashed. The check
+        // runs on every event, before any tool gets to probe it.
+        std::unordered_set<std::string> to_exclude_;
+        // Remembers which tool matched an executable. (A null entry means
+        // none of them did.) Guarded by the mutex, the method is called
+        // from multiple threads.
+        mutable std::mutex cache_mutex_;
+        mutable std::unordered_map<std::string, const Tool *> cache_;
+        // The tool which matched the most recent new executable. It is
+        // probed first for the next unknown one: a build is dominated by
+        // a single compiler, and the fixed list order makes every other
+        // compiler walk past the matchers declared before it.
+        mutable const Tool *last_hit_ = nullptr;
     };
 }
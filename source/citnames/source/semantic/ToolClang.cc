@@ -27,7 +27,34 @@ namespace cs::semantic {
     bool ToolClang::recognize(const fs::path& program) const {
         static const auto pattern = std::regex(R"(^([^-]*-)*clang(|\+\+)(-?\d+(\.\d+){0,2})?$)");
 
+        const auto name = program.filename().string();
+        // every name the pattern accepts contains this literal; reject the
+        // rest without entering the regex engine.
+        if (name.find("clang") == std::string::npos) {
+            return false;
+        }
         std::cmatch m;
-        return std::regex_match(program.filename().c_str(), m, pattern);
+        return std::regex_match(name.c_str(), m, pattern);
+    }
+
+    const FlagsByName &ToolClang::flag_definition() const {
+        // The GCC table extended with flags the clang driver accepts on
+        // top of the GCC interface. Merged once at the first use and
+        // shared by every instance; constructing the tool builds nothing.
+        //
+        // https://clang.llvm.org/docs/ClangCommandLineReference.html
+        static const FlagsByName merged(ToolGcc::flag_definition(), {
+                {"-cc1",                    {Instruction(0, Match::EXACT, false),   CompilerFlagType::KIND_OF_OUTPUT}},
+                {"-Xclang",                 {Instruction(1, Match::EXACT, false),   CompilerFlagType::OTHER}},
+                {"-Xanalyzer",              {Instruction(1, Match::EXACT, false),   CompilerFlagType::OTHER}},
+                {"-Xarch_",                 {Instruction(2, Match::PARTIAL, false), CompilerFlagType::OTHER}},
+                {"-arch",                   {Instruction(1, Match::EXACT, false),   CompilerFlagType::OTHER}},
+                {"-target",                 {Instruction(1, Match::EXACT, false),   CompilerFlagType::OTHER}},
+                {"--config",                {Instruction(1, Match::BOTH, true),     CompilerFlagType::OTHER}},
+                {"--analyze",               {Instruction(0, Match::EXACT, false),   CompilerFlagType::KIND_OF_OUTPUT_NO_LINKING}},
+                {"--serialize-diagnostics", {Instruction(1, Match::EXACT, false),   CompilerFlagType::OTHER}},
+                {"-index-store-path",       {Instruction(1, Match::EXACT, false),   CompilerFlagType::OTHER}},
+        });
+        return merged;
     }
 }
@@ -26,5 +26,9 @@ namespace cs::semantic {
     struct ToolClang : public ToolGcc {
         [[nodiscard]]
         bool recognize(const fs::path &program) const override;
+
+    protected:
+        [[nodiscard]]
+        const FlagsByName &flag_definition() const override;
     };
 }
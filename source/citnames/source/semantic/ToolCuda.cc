@@ -20,14 +20,105 @@
 #include "ToolCuda.h"
 #include "ToolGcc.h"
 
-#include <regex>
+#include <algorithm>
+#include <string>
+#include <string_view>
+
+using namespace cs::semantic;
+
+namespace {
+
+    // Tells if the argument forwards flags to the host compiler.
+    bool forwards_to_host(const std::string &argument) {
+        return argument == "-Xcompiler"
+            || argument == "--compiler-options"
+            || argument.rfind("-Xcompiler=", 0) == 0
+            || argument.rfind("--compiler-options=", 0) == 0;
+    }
+
+    // Expands the host forwarding wrappers: the comma separated flag list
+    // of every -Xcompiler (or --compiler-options) is spliced into the
+    // argument vector, so one pass of the GCC parser classifies the
+    // forwarded flags together with the rest of the command line. Parsing
+    // the wrapper verbatim would keep the host flags opaque (a forwarded
+    // -E would go unnoticed), and parsing them one by one would run the
+    // parser per wrapper instead of once per command line.
+    Arguments splice_host_flags(const Arguments &arguments) {
+        Arguments result;
+        result.reserve(arguments.size());
+        for (auto it = arguments.begin(); it != arguments.end(); ++it) {
+            std::string_view value;
+            if ((*it == "-Xcompiler") || (*it == "--compiler-options")) {
+                if (std::next(it) == arguments.end()) {
+                    // a wrapper without a value; keep it verbatim.
+                    result.push_back(*it);
+                    continue;
+                }
+                value = *(++it);
+            } else if (forwards_to_host(*it)) {
+                value = std::string_view(*it).substr(it->find('=') + 1);
+            } else {
+                result.push_back(*it);
+                continue;
+            }
+            while (!value.empty()) {
+                const auto comma = value.find(',');
+                result.emplace_back(value.substr(0, comma));
+                value = (comma == std::string_view::npos)
+                        ? std::string_view()
+                        : value.substr(comma + 1);
+            }
+        }
+        return result;
+    }
+}
 
 namespace cs::semantic {
 
     bool ToolCuda::recognize(const fs::path& program) const {
-        static const auto pattern = std::regex(R"(^(nvcc)$)");
+        // the accepted name is a single literal, no pattern needed.
+        return program.filename() == "nvcc";
+    }
+
+    const FlagsByName &ToolCuda::flag_definition() const {
+        // The GCC table extended with the nvcc driver's own flags. Merged
+        // once at the first use and shared by every instance, like the
+        // clang table.
+        //
+        // https://docs.nvidia.com/cuda/cuda-compiler-driver-nvcc/
+        static const FlagsByName merged(ToolGcc::flag_definition(), {
+                {"-ccbin",              {Instruction(1, Match::BOTH, true),  CompilerFlagType::OTHER}},
+                {"--compiler-bindir",   {Instruction(1, Match::BOTH, true),  CompilerFlagType::OTHER}},
+                {"-arch",               {Instruction(1, Match::BOTH, true),  CompilerFlagType::OTHER}},
+                {"--gpu-architecture",  {Instruction(1, Match::BOTH, true),  CompilerFlagType::OTHER}},
+                {"-code",               {Instruction(1, Match::BOTH, true),  CompilerFlagType::OTHER}},
+                {"--gpu-code",          {Instruction(1, Match::BOTH, true),  CompilerFlagType::OTHER}},
+                {"-gencode",            {Instruction(1, Match::BOTH, true),  CompilerFlagType::OTHER}},
+                {"--generate-code",     {Instruction(1, Match::BOTH, true),  CompilerFlagType::OTHER}},
+                {"-rdc",                {Instruction(1, Match::BOTH, true),  CompilerFlagType::OTHER}},
+                {"-cudart",             {Instruction(1, Match::BOTH, true),  CompilerFlagType::OTHER}},
+                {"-maxrregcount",       {Instruction(1, Match::BOTH, true),  CompilerFlagType::OTHER}},
+                {"-Xptxas",             {Instruction(1, Match::BOTH, true),  CompilerFlagType::OTHER}},
+                {"-Xcudafe",            {Instruction(1, Match::BOTH, true),  CompilerFlagType::OTHER}},
+                {"-Xnvlink",            {Instruction(1, Match::BOTH, true),  CompilerFlagType::LINKER}},
+                {"-dc",                 {Instruction(0, Match::EXACT, false), CompilerFlagType::KIND_OF_OUTPUT_NO_LINKING}},
+                {"-dw",                 {Instruction(0, Match::EXACT, false), CompilerFlagType::KIND_OF_OUTPUT_NO_LINKING}},
+                {"-cubin",              {Instruction(0, Match::EXACT, false), CompilerFlagType::KIND_OF_OUTPUT_NO_LINKING}},
+                {"-ptx",                {Instruction(0, Match::EXACT, false), CompilerFlagType::KIND_OF_OUTPUT_NO_LINKING}},
+                {"-fatbin",             {Instruction(0, Match::EXACT, false), CompilerFlagType::KIND_OF_OUTPUT_NO_LINKING}},
+                {"-cuda",               {Instruction(0, Match::EXACT, false), CompilerFlagType::KIND_OF_OUTPUT_NO_LINKING}},
+                {"-G",                  {Instruction(0, Match::EXACT, false), CompilerFlagType::OTHER}},
+                {"-lineinfo",           {Instruction(0, Match::EXACT, false), CompilerFlagType::OTHER}},
+        });
+        return merged;
+    }
 
-        std::cmatch m;
-        return std::regex_match(program.filename().c_str(), m, pattern);
+    rust::Result<SemanticPtr> ToolCuda::compilation(const Execution &execution) const {
+        if (std::any_of(execution.arguments.begin(), execution.arguments.end(), forwards_to_host)) {
+            Execution expanded = execution;
+            expanded.arguments = splice_host_flags(execution.arguments);
+            return ToolGcc::compilation(expanded);
+        }
+        return ToolGcc::compilation(execution);
     }
 }
@@ -26,5 +26,15 @@ namespace cs::semantic {
     struct ToolCuda : public ToolGcc {
         [[nodiscard]]
         bool recognize(const fs::path& program) const override;
+
+        // Expands the host compiler forwarding arguments (-Xcompiler and
+        // its long form) into plain flags before the parsing, so the one
+        // cached parse pass classifies the forwarded flags too.
+        [[nodiscard]]
+        rust::Result<SemanticPtr> compilation(const Execution &execution) const override;
+
+    protected:
+        [[nodiscard]]
+        const FlagsByName &flag_definition() const override;
     };
 }
@@ -23,10 +23,28 @@ namespace cs::semantic {
 
     ToolExtendingWrapper::ToolExtendingWrapper(CompilerWrapper &&compilers_to_recognize) noexcept
             : compilers_to_recognize_(compilers_to_recognize)
+            , executable_(compilers_to_recognize_.executable.string())
+            , executable_normal_(compilers_to_recognize_.executable.lexically_normal().string())
+            , basename_(compilers_to_recognize_.executable.filename().string())
+            , flags_to_remove_(compilers_to_recognize_.flags_to_remove.begin(),
+                               compilers_to_recognize_.flags_to_remove.end())
+            , flags_to_add_(compilers_to_recognize_.flags_to_add.begin(),
+                            compilers_to_recognize_.flags_to_add.end())
     { }
 
     bool ToolExtendingWrapper::recognize(const fs::path &program) const {
-        return compilers_to_recognize_.executable == program;
+        const std::string_view candidate(program.native());
+        // the common case is an exact match or a different program.
+        if (candidate == executable_) {
+            return true;
+        }
+        const auto slash = candidate.rfind('/');
+        const auto name = (slash == std::string_view::npos) ? candidate : candidate.substr(slash + 1);
+        if (name != basename_) {
+            return false;
+        }
+        // same basename, different spelling: normalize before giving up.
+        return program.lexically_normal().string() == executable_normal_;
     }
 
     rust::Result<SemanticPtr> ToolExtendingWrapper::recognize(const Execution &execution) const {
@@ -34,21 +52,18 @@ namespace cs::semantic {
                 .map<cs::semantic::SemanticPtr>([this](auto semantic) {
                     if (auto* ptr = dynamic_cast<Compile*>(semantic.get()); ptr != nullptr) {
                         // remove flags which were asked to be removed.
-                        ptr->flags.erase(
-                                std::remove_if(
-                                        ptr->flags.begin(),
-                                        ptr->flags.end(),
-                                        [this](auto flag) {
-                                            return std::any_of(
-                                                    compilers_to_recognize_.flags_to_remove.begin(),
-                                                    compilers_to_recognize_.flags_to_remove.end(),
-                                                    [&flag](auto flag_to_remove) { return flag_to_remove == flag; });
-                                        }),
-                                ptr->flags.end());
+                        if (!flags_to_remove_.empty()) {
+                            ptr->flags.erase(
+                                    std::remove_if(
+                                            ptr->flags.begin(),
+                                            ptr->flags.end(),
+                                            [this](const auto &flag) {
+                                                return flags_to_remove_.count(flag) != 0;
+                                            }),
+                                    ptr->flags.end());
+                        }
                         // add flags which were asked to be added.
-                        std::copy(compilers_to_recognize_.flags_to_add.begin(),
-                                  compilers_to_recognize_.flags_to_add.end(),
-                                  std::back_inserter(ptr->flags));
+                        ptr->flags.insert(ptr->flags.end(), flags_to_add_.begin(), flags_to_add_.end());
                     }
                     return semantic;
                 });
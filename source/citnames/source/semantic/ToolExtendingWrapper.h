@@ -21,6 +21,10 @@
 
 #include "ToolGcc.h"
 
+#include <string>
+#include <unordered_set>
+#include <vector>
+
 namespace cs::semantic {
 
     struct ToolExtendingWrapper : public ToolGcc {
@@ -35,5 +39,16 @@ namespace cs::semantic {
 
     private:
         CompilerWrapper compilers_to_recognize_;
+        // The configured executable, compiled once into comparable forms:
+        // the basename serves as a cheap reject, the normalized path as
+        // the final word on suspicious spellings.
+        std::string executable_;
+        std::string executable_normal_;
+        std::string basename_;
+        // The flag edits, compiled once from the configuration lists:
+        // the removals as a prehashed set (checked against every flag of
+        // every entry), the additions as a contiguous block to append.
+        std::unordered_set<std::string> flags_to_remove_;
+        std::vector<std::string> flags_to_add_;
     };
 }
@@ -22,6 +22,8 @@
 
 #include "libsys/Path.h"
 
+#include <map>
+#include <mutex>
 #include <regex>
 #include <utility>
 #include <functional>
@@ -136,22 +138,191 @@ namespace {
             {"--",                 {Instruction(0, Match::PARTIAL, false), CompilerFlagType::OTHER}},
     };
 
-    rust::Result<CompilerFlags> parse_flags(const Execution &execution)
+    // Marks the file slots of a command line skeleton. (A control
+    // character, which does not appear in real arguments.)
+    constexpr char PLACEHOLDER = '\x01';
+
+    // Skeletons above this count are not cached. A build normally reuses
+    // a few dozen flag combinations, the limit only guards degenerate
+    // inputs.
+    constexpr size_t CACHE_LIMIT = 256;
+
+    // Tells if the argument would be recognized as a source file. The
+    // flag parsers only match arguments starting with a dash (plus the
+    // response file syntax), those shall not be disturbed.
+    bool looks_like_source(const std::string &argument) {
+        if (argument.empty() || argument.front() == '-' || argument.front() == '@') {
+            return false;
+        }
+        return SourceMatcher::match_extension(SourceMatcher::take_extension(argument));
+    }
+
+    // Most link lines of a build are rejected with this fixed verdict.
+    // Prepared once and handed out as copies: the std::runtime_error
+    // copy constructor is noexcept, the copies share the already
+    // allocated message.
+    const std::runtime_error &no_sources_error() {
+        static const std::runtime_error error("Source files not found for compilation.");
+        return error;
+    }
+
+    // Tells if the command line cannot produce a compilation entry, and
+    // the verdict needs no flag parsing: none of the arguments looks
+    // like a source file, no response file can hide one, and no info
+    // query flag asks for a different semantic. Link invocations with
+    // hundreds of object file arguments take this exit.
+    bool link_only(const Arguments &arguments) {
+        if (arguments.size() <= 1) {
+            // an empty command line counts as a compiler query.
+            return false;
+        }
+        return std::none_of(std::next(arguments.begin()), arguments.end(), [](const auto &argument) {
+            return looks_like_source(argument)
+                   || (!argument.empty() && argument.front() == '@')
+                   || (argument == "--version")
+                   || (argument == "--target-help")
+                   || (argument.rfind("--help", 0) == 0);
+        });
+    }
+
+    // Tells if the command line is a dependency scan or a preprocessor
+    // run, without parsing the flags: a -M, -MM or -E argument makes the
+    // invocation produce no object file. Build systems run such scans in
+    // large numbers, and their verdict (a preprocessing) needs none of
+    // the flag classification. The check is conservative: an argument
+    // consumed by a forwarding flag does not count (-Xlinker -M asks the
+    // linker for a load map), and a compiler query keeps its own verdict;
+    // anything unclear falls through to the full parse.
+    bool preprocessor_only(const Arguments &arguments) {
+        static const std::set<std::string_view> MARKER = {"-E", "-M", "-MM"};
+        // the flags whose next argument is a verbatim value, which could
+        // look like a marker. (file name values do not.)
+        static const std::set<std::string_view> CONSUMES_MARKER =
+                {"-Xlinker", "-Xpreprocessor", "-Xassembler", "-Xclang", "-Xcompiler", "-wrapper"};
+        bool skip = false;
+        for (const auto &argument : arguments) {
+            if (skip) {
+                skip = false;
+                continue;
+            }
+            if (CONSUMES_MARKER.find(argument) != CONSUMES_MARKER.end()) {
+                skip = true;
+                continue;
+            }
+            if ((argument == "--version") || (argument == "--target-help")
+                    || (argument.rfind("--help", 0) == 0)) {
+                return false;
+            }
+            if (MARKER.find(argument) != MARKER.end()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // A command line with the per file arguments - the source files and
+    // the output file - replaced by placeholders, plus the replaced
+    // values in order. Command lines of the same build differ mostly in
+    // these slots only.
+    struct Skeleton {
+        Arguments arguments;
+        Arguments values;
+    };
+
+    Skeleton make_skeleton(const Arguments &arguments) {
+        Skeleton result;
+        result.arguments.reserve(arguments.size());
+        bool output_follows = false;
+        for (const auto &argument : arguments) {
+            if (output_follows) {
+                output_follows = false;
+                result.arguments.emplace_back(1, PLACEHOLDER);
+                result.values.push_back(argument);
+            } else if (argument == "-o") {
+                output_follows = true;
+                result.arguments.push_back(argument);
+            } else if (looks_like_source(argument)) {
+                // the extension stays, so the slot is still recognized as
+                // a source file when the skeleton is parsed.
+                std::string placeholder(1, PLACEHOLDER);
+                placeholder += SourceMatcher::take_extension(argument);
+                result.arguments.push_back(std::move(placeholder));
+                result.values.push_back(argument);
+            } else {
+                result.arguments.push_back(argument);
+            }
+        }
+        return result;
+    }
+
+    // Binds the placeholder slots of a parsed skeleton to the values of
+    // the current command line. (The parsing consumes the arguments left
+    // to right, so the slots appear in the value order.)
+    CompilerFlags rebind(const CompilerFlags &prototype, const Arguments &values) {
+        CompilerFlags result = prototype;
+        auto value = values.begin();
+        for (auto &flag : result) {
+            for (auto &argument : flag.arguments) {
+                if (!argument.empty() && argument.front() == PLACEHOLDER && value != values.end()) {
+                    argument = *value;
+                    ++value;
+                }
+            }
+        }
+        return result;
+    }
+
+    rust::Result<CompilerFlags> parse_flags(const FlagsByName &definitions, const Execution &execution)
     {
-        static auto const parser =
+        // the parser only holds a reference to the table, building it
+        // per call costs nothing.
+        const auto parser =
                 Repeat(
                         OneOf(
-                                FlagParser(FLAG_DEFINITION),
+                                FlagParser(definitions),
                                 SourceMatcher(),
                                 EverythingElseFlagMatcher()
                         )
                 );
 
-        return parse(parser, execution);
+        // response files are expanded from disk, their content shall not
+        // be remembered.
+        if (has_response_files(execution.arguments)) {
+            return parse(parser, execution);
+        }
+        // Builds repeat near identical command lines, which differ only
+        // in the source and output files. The parse result of the command
+        // line skeleton is remembered, and a repeat only binds the file
+        // slots again instead of parsing the whole flag vector.
+        static std::mutex mutex;
+        static std::map<Arguments, CompilerFlags> cache;
+
+        const auto skeleton = make_skeleton(execution.arguments);
+        {
+            const std::lock_guard<std::mutex> guard(mutex);
+            if (const auto it = cache.find(skeleton.arguments); it != cache.end()) {
+                return rust::Ok(rebind(it->second, skeleton.values));
+            }
+        }
+        Execution prototype = execution;
+        prototype.arguments = skeleton.arguments;
+        auto parsed = parse(parser, prototype);
+        if (parsed.is_err()) {
+            // let the error message show the real arguments.
+            return parse(parser, execution);
+        }
+        const CompilerFlags flags = parsed.unwrap();
+        {
+            const std::lock_guard<std::mutex> guard(mutex);
+            if (cache.size() < CACHE_LIMIT) {
+                cache.emplace(skeleton.arguments, flags);
+            }
+        }
+        return rust::Ok(rebind(flags, skeleton.values));
     }
 
     // https://gcc.gnu.org/onlinedocs/cpp/Environment-Variables.html
-    Arguments flags_from_environment(const std::map<std::string, std::string> &environment) {
+    Arguments flags_from_environment(const domain::Environment &environment) {
         Arguments flags;
         // define util function to append the content of a defined variable
         const auto inserter = [&flags](const std::string& value, const std::string& flag) {
@@ -267,12 +438,35 @@ namespace cs::semantic {
             R"(^(cc|c\+\+|cxx|CC|(([^-]*-)*([mg](cc|\+\+)|[g]?fortran)(-?\d+(\.\d+){0,2})?))$)"
         );
 
+        const auto name = program.filename().string();
+        // Cheap literal prefilter: every name the pattern accepts contains
+        // one of these substrings. Most executions are not compilers at
+        // all (shells, make, file utilities), and they are rejected here
+        // without entering the regex engine.
+        if (name.find("cc") == std::string::npos
+                && name.find("++") == std::string::npos
+                && name.find("CC") == std::string::npos
+                && name.find("cxx") == std::string::npos
+                && name.find("fortran") == std::string::npos) {
+            return false;
+        }
         std::cmatch m;
-        return std::regex_match(program.filename().c_str(), m, pattern);
+        return std::regex_match(name.c_str(), m, pattern);
+    }
+
+    const FlagsByName &ToolGcc::flag_definition() const {
+        return FLAG_DEFINITION;
     }
 
     rust::Result<SemanticPtr> ToolGcc::compilation(const Execution &execution) const {
-        return parse_flags(execution)
+        if (link_only(execution.arguments)) {
+            return rust::Err(no_sources_error());
+        }
+        if (preprocessor_only(execution.arguments)) {
+            SemanticPtr result = std::make_shared<Preprocess>();
+            return rust::Ok(std::move(result));
+        }
+        return parse_flags(flag_definition(), execution)
                 .and_then<SemanticPtr>([&execution](auto flags) -> rust::Result<SemanticPtr> {
                     if (is_compiler_query(flags)) {
                         SemanticPtr result = std::make_shared<QueryCompiler>();
@@ -286,7 +480,7 @@ namespace cs::semantic {
                     auto[arguments, sources, output] = split(flags);
                     // Validate: must have source files.
                     if (sources.empty()) {
-                        return rust::Err(std::runtime_error("Source files not found for compilation."));
+                        return rust::Err(no_sources_error());
                     }
                     // TODO: introduce semantic type for linking
                     if (linking(flags)) {
@@ -20,6 +20,7 @@
 #pragma once
 
 #include "Tool.h"
+#include "Parsers.h"
 
 namespace cs::semantic {
 
@@ -35,5 +36,13 @@ namespace cs::semantic {
 
         [[nodiscard]]
         virtual rust::Result<SemanticPtr> compilation(const Execution &execution) const;
+
+    protected:
+        // The flag table the compilation parsing runs against. A derived
+        // tool supplies its own static table here (see ToolClang); the
+        // tables live for the whole process, so constructing the tools
+        // for a run builds nothing.
+        [[nodiscard]]
+        virtual const FlagsByName &flag_definition() const;
     };
 }
@@ -0,0 +1,58 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ToolPlugin.h"
+
+#include <fmt/format.h>
+
+#include <dlfcn.h>
+
+namespace cs::semantic {
+
+    rust::Result<std::shared_ptr<Tool>> ToolPlugin::load(const fs::path &library) {
+        // the handle is deliberately not closed: the recognizer and the
+        // semantic objects it creates carry virtual tables living in the
+        // library. (See the header.)
+        void *handle = ::dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (handle == nullptr) {
+            auto message = fmt::format("Recognizer plugin load failed (file {}): {}", library.string(), ::dlerror());
+            return rust::Err(std::runtime_error(message));
+        }
+        using ApiFunction = int (*)();
+        using CreateFunction = Tool *(*)();
+        const auto api = reinterpret_cast<ApiFunction>(::dlsym(handle, TOOL_PLUGIN_API_SYMBOL));
+        const auto create = reinterpret_cast<CreateFunction>(::dlsym(handle, TOOL_PLUGIN_CREATE_SYMBOL));
+        if (api == nullptr || create == nullptr) {
+            auto message = fmt::format("Recognizer plugin entry points missing (file {})", library.string());
+            return rust::Err(std::runtime_error(message));
+        }
+        if (const int version = api(); version != TOOL_PLUGIN_API_VERSION) {
+            auto message = fmt::format(
+                    "Recognizer plugin API mismatch (file {}): plugin {}, expected {}",
+                    library.string(), version, TOOL_PLUGIN_API_VERSION);
+            return rust::Err(std::runtime_error(message));
+        }
+        std::shared_ptr<Tool> result(create());
+        if (!result) {
+            auto message = fmt::format("Recognizer plugin created no recognizer (file {})", library.string());
+            return rust::Err(std::runtime_error(message));
+        }
+        return rust::Ok(std::move(result));
+    }
+}
@@ -0,0 +1,64 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "semantic/Tool.h"
+#include "libresult/Result.h"
+
+#include <filesystem>
+#include <memory>
+
+namespace fs = std::filesystem;
+
+namespace cs::semantic {
+
+    // The API version of the recognizer plugin interface. It guards the
+    // C++ surface the plugin was compiled against (the `Tool` interface
+    // and the semantic types it returns); it is bumped whenever those
+    // change in an incompatible way.
+    constexpr int TOOL_PLUGIN_API_VERSION = 1;
+
+    // The entry points a recognizer plugin exports (with C linkage, so
+    // the loader can resolve them by name):
+    //
+    //      extern "C" int bear_recognizer_api();
+    //      extern "C" cs::semantic::Tool *bear_recognizer_create();
+    //
+    // The first returns the `TOOL_PLUGIN_API_VERSION` the plugin was
+    // compiled against. The second allocates the recognizer with `new`;
+    // the loader takes ownership and deletes it when the registry goes
+    // away. The plugin must be built with the same compiler family and
+    // standard library as the citnames binary, the interface is a C++
+    // one.
+    constexpr char TOOL_PLUGIN_API_SYMBOL[] = "bear_recognizer_api";
+    constexpr char TOOL_PLUGIN_CREATE_SYMBOL[] = "bear_recognizer_create";
+
+    // Loads a recognizer plugin from a shared library.
+    //
+    // The library stays loaded for the lifetime of the process: the
+    // semantic objects the recognizer returned may outlive the registry,
+    // and their virtual tables live in the library. Failures (a missing
+    // file, missing entry points, an API version mismatch, a recognizer
+    // the plugin refused to create) are reported, the caller decides
+    // whether to skip or abort.
+    struct ToolPlugin {
+        [[nodiscard]] static rust::Result<std::shared_ptr<Tool>> load(const fs::path &library);
+    };
+}
@@ -22,10 +22,45 @@
 #include "report/libexec/Resolver.h"
 #include "libsys/Errors.h"
 
+#include <map>
+#include <mutex>
+#include <optional>
 #include <set>
+#include <utility>
 
 namespace {
 
+    constexpr size_t CACHE_LIMIT = 256;
+
+    // Memoized lookup of the program behind the wrapper. The resolution
+    // walks the directories of the PATH, while a build keeps a constant
+    // wrapper prefix (the same few compilers behind ccache or distcc),
+    // so the same query repeats for every compilation. Failed lookups
+    // are remembered too. (The recognition runs on a thread pool, hence
+    // the lock.)
+    std::optional<fs::path> resolve_cached(const std::string &program, const std::string &search_path) {
+        static std::mutex mutex;
+        static std::map<std::pair<std::string, std::string>, std::optional<fs::path>> cache;
+
+        const auto key = std::make_pair(program, search_path);
+        {
+            const std::lock_guard<std::mutex> guard(mutex);
+            if (const auto it = cache.find(key); it != cache.end()) {
+                return it->second;
+            }
+        }
+        el::Resolver resolver;
+        const auto candidate = resolver.from_search_path(program, search_path.c_str());
+        const auto result = candidate.is_ok()
+                ? std::make_optional(fs::path(candidate.unwrap()))
+                : std::optional<fs::path>();
+        const std::lock_guard<std::mutex> guard(mutex);
+        if (cache.size() < CACHE_LIMIT) {
+            cache.emplace(key, result);
+        }
+        return result;
+    }
+
     bool looks_like_ccache_parameter(const std::string &candidate) {
         return candidate.empty() || candidate[0] == '-';
     }
@@ -59,7 +94,7 @@ namespace cs::semantic {
         return string == "ccache";
     }
 
-    bool ToolWrapper::is_ccache_query(const std::list<std::string> &arguments) {
+    bool ToolWrapper::is_ccache_query(const std::vector<std::string> &arguments) {
         if (arguments.size() <= 1) {
             return true;
         }
@@ -74,7 +109,7 @@ namespace cs::semantic {
         return string == "distcc";
     }
 
-    bool ToolWrapper::is_distcc_query(const std::list<std::string> &arguments) {
+    bool ToolWrapper::is_distcc_query(const std::vector<std::string> &arguments) {
         if (arguments.size() <= 1) {
             return true;
         }
@@ -85,8 +120,26 @@ namespace cs::semantic {
     }
 
     domain::Execution ToolWrapper::remove_wrapper(const Execution &execution) {
-        el::Resolver resolver;
-        return remove_wrapper(resolver, execution);
+        const auto &environment = execution.environment;
+        if (auto path = environment.find("PATH"); path != environment.end()) {
+            // take the second argument as a program candidate
+            auto program = std::next(execution.arguments.begin());
+            if (program != execution.arguments.end()) {
+                // the memoized lookup spares the PATH walk, the same
+                // wrapper prefix repeats through the whole build.
+                if (const auto candidate = resolve_cached(*program, path->second); candidate) {
+                    domain::Execution copy = execution;
+                    copy.arguments.erase(copy.arguments.begin());
+                    copy.executable = candidate.value();
+                    return copy;
+                }
+            }
+        }
+        // fall back to the second argument as an executable.
+        domain::Execution copy = execution;
+        copy.arguments.erase(copy.arguments.begin());
+        copy.executable = copy.arguments.front();
+        return copy;
     }
 
     domain::Execution ToolWrapper::remove_wrapper(el::Resolver &resolver, const Execution &execution) {
@@ -99,7 +152,7 @@ namespace cs::semantic {
                 auto candidate = resolver.from_search_path(*program, path->second.c_str());
                 if (candidate.is_ok()) {
                     domain::Execution copy = execution;
-                    copy.arguments.pop_front();
+                    copy.arguments.erase(copy.arguments.begin());
                     copy.executable = candidate.unwrap();
                     return copy;
                 }
@@ -107,7 +160,7 @@ namespace cs::semantic {
         }
         // fall back to the second argument as an executable.
         domain::Execution copy = execution;
-        copy.arguments.pop_front();
+        copy.arguments.erase(copy.arguments.begin());
         copy.executable = copy.arguments.front();
         return copy;
     }
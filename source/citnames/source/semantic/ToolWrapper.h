@@ -21,7 +21,7 @@
 
 #include "ToolGcc.h"
 
-#include <list>
+#include <vector>
 #include <string>
 
 namespace el {
@@ -37,10 +37,10 @@ namespace cs::semantic {
     // visible for testing
     public:
         static bool is_ccache_call(const fs::path &program);
-        static bool is_ccache_query(const std::list<std::string> &arguments);
+        static bool is_ccache_query(const std::vector<std::string> &arguments);
 
         static bool is_distcc_call(const fs::path &program);
-        static bool is_distcc_query(const std::list<std::string> &arguments);
+        static bool is_distcc_query(const std::vector<std::string> &arguments);
 
         static domain::Execution remove_wrapper(const domain::Execution &);
         static domain::Execution remove_wrapper(el::Resolver &, const domain::Execution &);
@@ -110,6 +110,40 @@ namespace {
         value_serialized_and_read_back(input, expected, AS_COMMAND_NO_OUTPUT);
     }
 
+    TEST(compilation_database, merged_by_output_read_back)
+    {
+        cs::Content by_output = NO_FILTER;
+        by_output.duplicates_by_output_only = true;
+
+        // the two variants of "entries.c" differ in flags, but write the
+        // same output file: the promised invariant merges them. entries
+        // without output fall back to the full fingerprint.
+        std::list<cs::Entry> input = {
+                { "entries.c", "/path/to", { "entries.o" }, { "cc", "-c", "-o", "entries.o", "entries.c" } },
+                { "entries.c", "/path/to", { "entries.o" }, { "cc", "-c", "-O2", "-o", "entries.o", "entries.c" } },
+                { "entry_one.c", "/path/to", std::nullopt, { "cc", "-c", "entry_one.c" } },
+                { "entry_one.c", "/path/to", std::nullopt, { "cc", "-c", "entry_one.c" } },
+        };
+        std::list<cs::Entry> expected = {
+                { "entries.c", "/path/to", { "entries.o" }, { "cc", "-c", "-o", "entries.o", "entries.c" } },
+                { "entry_one.c", "/path/to", std::nullopt, { "cc", "-c", "entry_one.c" } },
+        };
+
+        cs::CompilationDatabase sut(AS_ARGUMENTS, by_output);
+        std::stringstream buffer;
+
+        auto serialized = sut.to_json(buffer, input);
+        EXPECT_TRUE(serialized.is_ok());
+
+        std::list<cs::Entry> deserialized;
+        auto count = sut.from_json(buffer, deserialized);
+        EXPECT_TRUE(count.is_ok());
+        count.on_success([&expected, &deserialized](auto result) {
+            EXPECT_EQ(expected.size(), result);
+            EXPECT_EQ(expected, deserialized);
+        });
+    }
+
     TEST(compilation_database, deserialize_fails_with_empty_stream)
     {
         cs::CompilationDatabase sut(AS_COMMAND, NO_FILTER);
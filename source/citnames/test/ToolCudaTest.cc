@@ -0,0 +1,125 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+
+#include "semantic/Tool.h"
+#include "semantic/ToolCuda.h"
+
+using namespace cs::semantic;
+
+namespace {
+
+    TEST(ToolCuda, recognize) {
+        ToolCuda sut;
+
+        EXPECT_TRUE(sut.recognize("nvcc"));
+        EXPECT_TRUE(sut.recognize("/usr/local/cuda/bin/nvcc"));
+        EXPECT_FALSE(sut.recognize("cc"));
+        EXPECT_FALSE(sut.recognize("clang"));
+    }
+
+    TEST(ToolCuda, simple) {
+        Execution input = {
+                "/usr/local/cuda/bin/nvcc",
+                {"nvcc", "-c", "-arch=sm_80", "-o", "kernel.o", "kernel.cu"},
+                "/home/user/project",
+                {},
+        };
+        SemanticPtr expected = SemanticPtr(
+                new Compile(
+                        input.working_dir,
+                        input.executable,
+                        {"-c", "-arch=sm_80"},
+                        {fs::path("kernel.cu")},
+                        {fs::path("kernel.o")})
+        );
+
+        ToolCuda sut;
+
+        auto result = sut.compilation(input);
+        EXPECT_TRUE(Tool::recognized_ok(result));
+        EXPECT_PRED2([](auto lhs, auto rhs) { return lhs->operator==(*rhs); }, expected, result.unwrap());
+    }
+
+    TEST(ToolCuda, xcompiler_spliced) {
+        // the forwarded host flags are classified like plain ones.
+        Execution input = {
+                "/usr/local/cuda/bin/nvcc",
+                {"nvcc", "-c", "-Xcompiler", "-fPIC,-Wall", "-o", "kernel.o", "kernel.cu"},
+                "/home/user/project",
+                {},
+        };
+        SemanticPtr expected = SemanticPtr(
+                new Compile(
+                        input.working_dir,
+                        input.executable,
+                        {"-c", "-fPIC", "-Wall"},
+                        {fs::path("kernel.cu")},
+                        {fs::path("kernel.o")})
+        );
+
+        ToolCuda sut;
+
+        auto result = sut.compilation(input);
+        EXPECT_TRUE(Tool::recognized_ok(result));
+        EXPECT_PRED2([](auto lhs, auto rhs) { return lhs->operator==(*rhs); }, expected, result.unwrap());
+    }
+
+    TEST(ToolCuda, xcompiler_preprocessor_detected) {
+        // a forwarded -E makes the invocation a preprocessing, which the
+        // verbatim wrapper would hide.
+        Execution input = {
+                "/usr/local/cuda/bin/nvcc",
+                {"nvcc", "--compiler-options=-E", "kernel.cu"},
+                "/home/user/project",
+                {},
+        };
+
+        ToolCuda sut;
+
+        auto result = sut.compilation(input);
+        EXPECT_TRUE(Tool::recognized_ok(result));
+        EXPECT_NE(nullptr, dynamic_cast<Preprocess *>(result.unwrap().get()));
+    }
+
+    TEST(ToolCuda, device_only_output) {
+        // the device compilation flags stop the linking, like -c does.
+        Execution input = {
+                "/usr/local/cuda/bin/nvcc",
+                {"nvcc", "-dc", "-o", "kernel.o", "kernel.cu"},
+                "/home/user/project",
+                {},
+        };
+        SemanticPtr expected = SemanticPtr(
+                new Compile(
+                        input.working_dir,
+                        input.executable,
+                        {"-dc"},
+                        {fs::path("kernel.cu")},
+                        {fs::path("kernel.o")})
+        );
+
+        ToolCuda sut;
+
+        auto result = sut.compilation(input);
+        EXPECT_TRUE(Tool::recognized_ok(result));
+        EXPECT_PRED2([](auto lhs, auto rhs) { return lhs->operator==(*rhs); }, expected, result.unwrap());
+    }
+}
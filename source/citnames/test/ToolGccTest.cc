@@ -76,6 +76,33 @@ namespace {
         EXPECT_PRED2([](auto lhs, auto rhs) { return lhs->operator==(*rhs); }, expected, result.unwrap());
     }
 
+    TEST(ToolGcc, repeated_skeleton) {
+        // the same flag skeleton with different source and output files;
+        // the second call binds the remembered parse result again.
+        ToolGcc sut({});
+
+        for (const std::string name : {"first", "second"}) {
+            Execution input = {
+                    "/usr/bin/cc",
+                    {"cc", "-c", "-Wall", "-o", name + ".o", name + ".c"},
+                    "/home/user/project",
+                    {},
+            };
+            SemanticPtr expected = SemanticPtr(
+                    new Compile(
+                            input.working_dir,
+                            input.executable,
+                            {"-c", "-Wall"},
+                            {fs::path(name + ".c")},
+                            {fs::path(name + ".o")})
+            );
+
+            auto result = sut.recognize(input);
+            EXPECT_TRUE(Tool::recognized_ok(result));
+            EXPECT_PRED2([](auto lhs, auto rhs) { return lhs->operator==(*rhs); }, expected, result.unwrap());
+        }
+    }
+
     TEST(ToolGcc, linker_flag_filtered) {
         Execution input = {
                 "/usr/bin/cc",
@@ -116,6 +143,41 @@ namespace {
         EXPECT_PRED2([](auto lhs, auto rhs) { return lhs->operator==(*rhs); }, expected, result.unwrap());
     }
 
+    TEST(ToolGcc, dependency_scan_short_circuit) {
+        // the -M family of dependency scans is a preprocessing, decided
+        // without parsing the flags.
+        for (const std::string flag : {"-M", "-MM", "-E"}) {
+            Execution input = {
+                    "/usr/bin/cc",
+                    {"cc", flag, "source.c"},
+                    "/home/user/project",
+                    {},
+            };
+
+            ToolGcc sut({});
+
+            auto result = sut.recognize(input);
+            EXPECT_TRUE(Tool::recognized_ok(result));
+            EXPECT_NE(nullptr, dynamic_cast<Preprocess *>(result.unwrap().get()));
+        }
+    }
+
+    TEST(ToolGcc, forwarded_marker_not_a_scan) {
+        // -Xlinker consumes the -M, the invocation still compiles.
+        Execution input = {
+                "/usr/bin/cc",
+                {"cc", "-Xlinker", "-M", "-o", "exe", "source.c"},
+                "/home/user/project",
+                {},
+        };
+
+        ToolGcc sut({});
+
+        auto result = sut.recognize(input);
+        EXPECT_TRUE(Tool::recognized_ok(result));
+        EXPECT_NE(nullptr, dynamic_cast<Compile *>(result.unwrap().get()));
+    }
+
     TEST(ToolGcc, simple_with_C_PATH) {
         Execution input = {
                 "/usr/bin/cc",
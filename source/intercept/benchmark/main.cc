@@ -0,0 +1,207 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Measures the per-exec overhead of the interception.
+//
+// The harness runs the same synthetic build - a shell loop spawning N
+// trivial executions - three times: without interception, under the
+// preload session and under the wrapper session. It reports the
+// wall-clock cost per exec in microseconds for each mode and the
+// overhead against the uninstrumented baseline, which is the number
+// that decides whether intercepting a CI build is affordable.
+
+#include "config.h"
+#include "libflags/Flags.h"
+#include "libmain/ApplicationFromArgs.h"
+#include "libmain/main.h"
+#include "libsys/Process.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iterator>
+#include <list>
+#include <string>
+
+#include <fmt/format.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    constexpr char FLAG_INTERCEPT[] = "--intercept";
+    constexpr char FLAG_COUNT[] = "--count";
+    constexpr char FLAG_LIBRARY[] = "--library";
+    constexpr char FLAG_WRAPPER_DIR[] = "--wrapper-dir";
+
+    rust::Result<std::chrono::microseconds> run_build(
+            const fs::path &program,
+            std::list<std::string> arguments,
+            const sys::env::VarsPtr &environment)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        sys::Process::Builder builder(program);
+        builder.add_argument(program.string());
+        builder.add_arguments(arguments.begin(), arguments.end());
+        builder.set_environment(environment);
+
+        return builder.spawn()
+                .and_then<sys::ExitStatus>([](auto child) {
+                    return child.wait();
+                })
+                .and_then<std::chrono::microseconds>([&start](auto status) -> rust::Result<std::chrono::microseconds> {
+                    if (status.code().value_or(EXIT_FAILURE) != EXIT_SUCCESS) {
+                        return rust::Err(std::runtime_error("The synthetic build failed."));
+                    }
+                    const auto stop = std::chrono::steady_clock::now();
+                    return rust::Ok(std::chrono::duration_cast<std::chrono::microseconds>(stop - start));
+                });
+    }
+
+    struct Command : ps::Command {
+        Command(fs::path intercept,
+                size_t count,
+                std::list<std::string> extra_flags,
+                sys::env::VarsPtr environment) noexcept
+                : ps::Command()
+                , intercept_(std::move(intercept))
+                , count_(count)
+                , extra_flags_(std::move(extra_flags))
+                , environment_(std::move(environment))
+        { }
+
+        [[nodiscard]] rust::Result<int> execute() const override
+        {
+            // the same shell loop serves every mode.
+            const auto script = fmt::format(
+                    "i=0; while [ $i -lt {} ]; do /bin/true; i=$((i+1)); done", count_);
+            const auto output = fs::temp_directory_path() / fmt::format("intercept-benchmark-{}.db", getpid());
+
+            auto baseline = run_build("/bin/sh", {"-c", script}, environment_);
+            auto preload = run_build(intercept_, intercept_arguments(
+                    cmd::intercept::FLAG_FORCE_PRELOAD, output, script), environment_);
+            auto wrapper = run_build(intercept_, intercept_arguments(
+                    cmd::intercept::FLAG_FORCE_WRAPPER, output, script), environment_);
+
+            std::error_code error_code;
+            fs::remove(output, error_code);
+
+            // a failing mode is reported, but does not fail the run; the
+            // wrapper session, for example, needs an installed wrapper
+            // directory which a build tree does not have.
+            return baseline
+                    .map<int>([this, &preload, &wrapper](const auto &baseline_time) {
+                        const auto base = baseline_time.count() / static_cast<long>(count_);
+                        fmt::print("benchmark: baseline {} us/exec\n", base);
+                        report("preload", preload, base);
+                        report("wrapper", wrapper, base);
+                        return EXIT_SUCCESS;
+                    });
+        }
+
+    private:
+        [[nodiscard]] std::list<std::string> intercept_arguments(
+                const char *mode,
+                const fs::path &output,
+                const std::string &script) const
+        {
+            std::list<std::string> result = { mode, cmd::intercept::FLAG_OUTPUT, output.string() };
+            std::copy(extra_flags_.begin(), extra_flags_.end(), std::back_inserter(result));
+            result.insert(result.end(), { cmd::intercept::FLAG_COMMAND, "/bin/sh", "-c", script });
+            return result;
+        }
+
+        void report(const char *mode, const rust::Result<std::chrono::microseconds> &result, const long base) const
+        {
+            result
+                    .on_success([this, &mode, &base](const auto &elapsed) {
+                        const auto per_exec = elapsed.count() / static_cast<long>(count_);
+                        fmt::print("benchmark: {} {} us/exec (overhead {})\n", mode, per_exec, per_exec - base);
+                    })
+                    .on_error([&mode](const auto &error) {
+                        fmt::print("benchmark: {} failed: {}\n", mode, error.what());
+                    });
+        }
+
+    private:
+        fs::path intercept_;
+        size_t count_;
+        std::list<std::string> extra_flags_;
+        sys::env::VarsPtr environment_;
+    };
+
+    struct Application : ps::ApplicationFromArgs {
+        Application() noexcept
+                : ps::ApplicationFromArgs(ps::ApplicationLogConfig("intercept benchmark", "ib"))
+        { }
+
+        rust::Result<flags::Arguments> parse(int argc, const char **argv) const override
+        {
+            const flags::Parser parser("intercept_benchmark", cmd::VERSION, {
+                    {FLAG_INTERCEPT, {1, true, "path to the intercept executable", std::nullopt, std::nullopt}},
+                    {FLAG_COUNT, {1, false, "number of executions in the synthetic build", {"100"}, std::nullopt}},
+                    {FLAG_LIBRARY, {1, false, "path to the preload library, forwarded to intercept", std::nullopt, std::nullopt}},
+                    {FLAG_WRAPPER_DIR, {1, false, "path to the wrapper directory, forwarded to intercept", std::nullopt, std::nullopt}},
+            });
+            return parser.parse_or_exit(argc, argv);
+        }
+
+        rust::Result<ps::CommandPtr> command(const flags::Arguments &args, const char **envp) const override
+        {
+            auto intercept = args.as_string(FLAG_INTERCEPT);
+            auto count = args.as_string(FLAG_COUNT)
+                    .map<size_t>([](auto value) {
+                        const std::string input(value);
+                        char *end = nullptr;
+                        const unsigned long result = std::strtoul(input.c_str(), &end, 10);
+                        return (end != input.c_str() && *end == 0) ? static_cast<size_t>(result) : size_t(0);
+                    })
+                    .and_then<size_t>([](auto value) -> rust::Result<size_t> {
+                        return (value > 0)
+                               ? rust::Result<size_t>(rust::Ok(value))
+                               : rust::Result<size_t>(rust::Err(std::runtime_error("The count shall be a positive number.")));
+                    });
+
+            std::list<std::string> extra_flags;
+            args.as_string(FLAG_LIBRARY).on_success([&extra_flags](auto value) {
+                extra_flags.insert(extra_flags.end(), { cmd::intercept::FLAG_LIBRARY, std::string(value) });
+            });
+            args.as_string(FLAG_WRAPPER_DIR).on_success([&extra_flags](auto value) {
+                extra_flags.insert(extra_flags.end(), { cmd::intercept::FLAG_WRAPPER_DIR, std::string(value) });
+            });
+
+            return rust::merge(intercept, count)
+                    .map<ps::CommandPtr>([&envp, &extra_flags](const auto &tuple) {
+                        const auto &[intercept, count] = tuple;
+                        auto environment = std::make_shared<const sys::env::Vars>(
+                                sys::env::from(envp));
+                        return std::make_unique<Command>(
+                                fs::path(intercept), count, std::move(extra_flags), std::move(environment));
+                    });
+        }
+    };
+}
+
+int main(int argc, char *argv[], char *envp[])
+{
+    return ps::main<Application>(argc, argv, envp);
+}
@@ -19,23 +19,57 @@
 
 #include "Convert.h"
 
+#include <algorithm>
+
+namespace {
+
+    // Decodes the argument list from the packed blob when it is present,
+    // and falls back to the repeated field for messages written before
+    // the packed representation existed. Malformed offsets are clamped
+    // to the blob, since the input can come from a foreign database file.
+    std::vector<std::string> arguments_from(const rpc::Execution &input) noexcept {
+        const int count = input.argument_offsets_size();
+        if (count == 0) {
+            return std::vector<std::string>(input.arguments().begin(), input.arguments().end());
+        }
+        const std::string &blob = input.packed_arguments();
+        std::vector<std::string> result;
+        result.reserve(count);
+        for (int idx = 0; idx < count; ++idx) {
+            const size_t begin = std::min(size_t(input.argument_offsets(idx)), blob.size());
+            const size_t end = (idx + 1 < count)
+                    ? std::min(size_t(input.argument_offsets(idx + 1)), blob.size())
+                    : blob.size();
+            result.emplace_back(blob, begin, (begin <= end) ? end - begin : 0);
+        }
+        return result;
+    }
+}
+
 namespace domain {
 
     Execution from(const rpc::Execution &input) noexcept {
         return Execution{
                 fs::path(input.executable()),
-                std::list(input.arguments().begin(), input.arguments().end()),
+                arguments_from(input),
                 fs::path(input.working_dir()),
-                std::map(input.environment().begin(), input.environment().end())
+                Environment(input.environment().begin(), input.environment().end())
         };
     }
 
     rpc::Execution into(const Execution &input) noexcept {
         rpc::Execution result;
         result.set_executable(input.executable.string());
-        result.mutable_arguments()->Reserve(input.arguments.size());
+        size_t total = 0;
+        for (const auto &argument : input.arguments) {
+            total += argument.size();
+        }
+        auto &blob = *result.mutable_packed_arguments();
+        blob.reserve(total);
+        result.mutable_argument_offsets()->Reserve(input.arguments.size());
         for (const auto &argument : input.arguments) {
-            result.add_arguments(argument);
+            result.add_argument_offsets(static_cast<uint32_t>(blob.size()));
+            blob.append(argument);
         }
         result.set_working_dir(input.working_dir);
         result.mutable_environment()->insert(input.environment.begin(), input.environment.end());
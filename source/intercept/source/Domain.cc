@@ -22,10 +22,47 @@
 
 #include <google/protobuf/util/json_util.h>
 
+#include <algorithm>
 #include <iostream>
 
 namespace domain {
 
+    Environment::Environment(std::initializer_list<Entry> entries)
+            : entries_(entries)
+    {
+        normalize();
+    }
+
+    Environment::Environment(const std::map<std::string, std::string> &entries)
+            : entries_(entries.begin(), entries.end())
+    {
+        // a map iterates in key order; nothing to normalize.
+    }
+
+    void Environment::normalize() {
+        std::stable_sort(entries_.begin(), entries_.end(),
+                         [](const auto &lhs, const auto &rhs) { return lhs.first < rhs.first; });
+        entries_.erase(
+                std::unique(entries_.begin(), entries_.end(),
+                            [](const auto &lhs, const auto &rhs) { return lhs.first == rhs.first; }),
+                entries_.end());
+    }
+
+    Environment::const_iterator Environment::find(const std::string &key) const {
+        const auto it = std::lower_bound(
+                entries_.begin(), entries_.end(), key,
+                [](const auto &entry, const auto &key) { return entry.first < key; });
+        return (it != entries_.end() && it->first == key) ? it : entries_.end();
+    }
+
+    std::map<std::string, std::string> Environment::to_map() const {
+        return std::map<std::string, std::string>(entries_.begin(), entries_.end());
+    }
+
+    bool operator==(const Environment &lhs, const Environment &rhs) {
+        return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+    }
+
     bool operator==(const Execution &lhs, const Execution &rhs) {
         return (lhs.executable == rhs.executable)
                && (lhs.arguments == rhs.arguments)
@@ -20,9 +20,11 @@
 #pragma once
 
 #include <filesystem>
-#include <list>
+#include <initializer_list>
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
 #include <cstdint>
 #include <iosfwd>
 
@@ -33,11 +35,49 @@ namespace domain {
     using ReporterId = uint64_t;
     using ProcessId = uint32_t;
 
+    // Environment of a process as a sorted, contiguous key value list.
+    //
+    // An event carries dozens of environment entries, and a `std::map`
+    // spends a node allocation on each of them. The flat storage is built
+    // with a single pass and a sort, while the lookups (the only ordered
+    // container operation the consumers use) stay logarithmic.
+    class Environment {
+    public:
+        using Entry = std::pair<std::string, std::string>;
+        using const_iterator = std::vector<Entry>::const_iterator;
+
+        Environment() = default;
+        Environment(std::initializer_list<Entry> entries);
+        // implicit on purpose: the process handling code speaks `std::map`.
+        Environment(const std::map<std::string, std::string> &entries);
+
+        template <typename Iterator>
+        Environment(Iterator first, Iterator last)
+                : entries_(first, last)
+        { normalize(); }
+
+        [[nodiscard]] const_iterator find(const std::string &key) const;
+        [[nodiscard]] const_iterator begin() const { return entries_.begin(); }
+        [[nodiscard]] const_iterator end() const { return entries_.end(); }
+        [[nodiscard]] bool empty() const { return entries_.empty(); }
+        [[nodiscard]] size_t size() const { return entries_.size(); }
+
+        // For the process spawning boundary, which takes a real map.
+        [[nodiscard]] std::map<std::string, std::string> to_map() const;
+
+    private:
+        void normalize();
+
+        std::vector<Entry> entries_;
+    };
+
+    bool operator==(const Environment& lhs, const Environment& rhs);
+
     struct Execution {
         fs::path executable;
-        std::list<std::string> arguments;
+        std::vector<std::string> arguments;
         fs::path working_dir;
-        std::map<std::string, std::string> environment;
+        Environment environment;
     };
 
     bool operator==(const Execution& lhs, const Execution& rhs);
@@ -0,0 +1,148 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ResolveHints.h"
+
+#include <fstream>
+#include <string_view>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+    constexpr std::string_view VERSION = "bear resolve hints 1";
+
+    constexpr std::string_view RECORD_DROP = "drop";
+    constexpr std::string_view RECORD_WRAP = "wrap";
+
+    // Takes the next line off the front of the content. The terminating
+    // newline is consumed, but not part of the result.
+    std::string_view next_line(std::string_view &content)
+    {
+        const auto end = content.find('\n');
+        if (end == std::string_view::npos) {
+            return std::exchange(content, std::string_view());
+        }
+        const auto result = content.substr(0, end);
+        content.remove_prefix(end + 1);
+        return result;
+    }
+
+    // Takes the next tab separated field off the front of the line.
+    std::string_view next_field(std::string_view &line)
+    {
+        const auto end = line.find('\t');
+        if (end == std::string_view::npos) {
+            return std::exchange(line, std::string_view());
+        }
+        const auto result = line.substr(0, end);
+        line.remove_prefix(end + 1);
+        return result;
+    }
+
+    rust::Result<domain::ResolveHints> parse(std::string_view content)
+    {
+        if (next_line(content) != VERSION) {
+            return rust::Err(std::runtime_error("Resolve hints version mismatch."));
+        }
+        domain::ResolveHints result;
+        result.wrapper_dir = fs::path(std::string(next_line(content)));
+        if (result.wrapper_dir.empty()) {
+            return rust::Err(std::runtime_error("Resolve hints without wrapper directory."));
+        }
+        while (!content.empty()) {
+            auto line = next_line(content);
+            const auto record = next_field(line);
+            if (record == RECORD_DROP) {
+                result.erase.emplace_back(line);
+            } else if (record == RECORD_WRAP) {
+                const auto name = next_field(line);
+                if (name.empty() || line.empty()) {
+                    return rust::Err(std::runtime_error("Malformed resolve hints entry."));
+                }
+                result.mapping.emplace(std::string(name), fs::path(std::string(line)));
+            } else if (!record.empty()) {
+                return rust::Err(std::runtime_error("Malformed resolve hints entry."));
+            }
+        }
+        return rust::Ok(std::move(result));
+    }
+}
+
+namespace domain {
+
+    rust::Result<int> ResolveHints::write(const fs::path &file, const ResolveHints &hints)
+    {
+        // write a temporary file and rename it, a reader may race with us.
+        auto temporary = file;
+        temporary += "." + std::to_string(getpid());
+        {
+            std::ofstream output(temporary);
+            if (!output.is_open()) {
+                return rust::Err(std::runtime_error("Failed to create file: " + temporary.string()));
+            }
+            output << VERSION << std::endl;
+            output << hints.wrapper_dir.string() << std::endl;
+            for (const auto &name : hints.erase) {
+                output << RECORD_DROP << '\t' << name << std::endl;
+            }
+            for (const auto &[name, executable] : hints.mapping) {
+                output << RECORD_WRAP << '\t' << name << '\t' << executable.string() << std::endl;
+            }
+            if (!output.good()) {
+                std::error_code error_code;
+                fs::remove(temporary, error_code);
+                return rust::Err(std::runtime_error("Failed to write file: " + temporary.string()));
+            }
+        }
+        std::error_code error_code;
+        fs::rename(temporary, file, error_code);
+        if (error_code) {
+            fs::remove(temporary, error_code);
+            return rust::Err(std::runtime_error("Failed to rename file: " + file.string()));
+        }
+        return rust::Ok(0);
+    }
+
+    rust::Result<ResolveHints> ResolveHints::read(const fs::path &file)
+    {
+        const int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            return rust::Err(std::runtime_error("Failed to open file: " + file.string()));
+        }
+        struct stat stats {};
+        if (::fstat(fd, &stats) == -1 || stats.st_size <= 0) {
+            ::close(fd);
+            return rust::Err(std::runtime_error("Failed to stat file: " + file.string()));
+        }
+        const auto size = static_cast<size_t>(stats.st_size);
+        void *buffer = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (buffer == MAP_FAILED) {
+            return rust::Err(std::runtime_error("Failed to map file: " + file.string()));
+        }
+        auto result = parse(std::string_view(static_cast<const char *>(buffer), size));
+        ::munmap(buffer, size);
+        return result;
+    }
+}
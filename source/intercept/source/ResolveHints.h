@@ -0,0 +1,59 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "libresult/Result.h"
+
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace domain {
+
+    // The wrapper resolution table of a session.
+    //
+    // The collector publishes this table into a file once per session and
+    // advertises the file name in the build environment. A wrapper process
+    // maps the file read only and answers the executable resolution
+    // locally, instead of asking the supervisor over a synchronous RPC on
+    // every intercepted execution. The table carries everything the
+    // supervisor would apply: the real executables behind the wrapper
+    // names, the wrapper directory to strip from the PATH and the
+    // environment variable names to drop.
+    struct ResolveHints {
+        fs::path wrapper_dir;
+        std::map<std::string, fs::path> mapping;
+        std::vector<std::string> erase;
+
+        // Writes the table into the given file. A temporary file is
+        // renamed into place, a concurrent reader never sees a partial
+        // table.
+        static rust::Result<int> write(const fs::path &file, const ResolveHints &hints);
+
+        // Reads the table back from the given file. The file is mapped
+        // into memory and parsed in place. Any deviation from the
+        // expected format fails the read, the caller shall fall back to
+        // the supervisor then.
+        static rust::Result<ResolveHints> read(const fs::path &file);
+    };
+}
@@ -18,9 +18,12 @@
  */
 
 #include "collect/Application.h"
+#include "collect/EventsCommand.h"
 #include "collect/Reporter.h"
 #include "collect/RpcServices.h"
+#include "collect/RingServices.h"
 #include "collect/Session.h"
+#include "collect/SocketServices.h"
 #include "report/libexec/Resolver.h"
 #include "libsys/Environment.h"
 #include "libsys/Errors.h"
@@ -31,9 +34,17 @@
 #include <spdlog/spdlog.h>
 #include <fmt/format.h>
 
+#include <algorithm>
+#include <cstdlib>
 #include <filesystem>
+#include <thread>
 #include <vector>
 
+#include <unistd.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
 namespace fs = std::filesystem;
 
 namespace {
@@ -73,36 +84,165 @@ namespace {
                     const auto&[executable, command] = tuple;
                     return ic::Execution{
                         executable,
-                        std::list<std::string>(command.begin(), command.end()),
+                        std::vector<std::string>(command.begin(), command.end()),
                         fs::path("ignored"),
                         std::move(environment)
                     };
                 });
     }
+
+    // Parses a cpu list like "0-3,16,17". Entries which are not numbers
+    // (or are malformed ranges) are ignored.
+    std::vector<int> parse_cpu_list(const std::string_view &input) {
+        std::vector<int> result;
+        const std::string copy(input);
+        const char *it = copy.c_str();
+        while (*it != 0) {
+            char *end = nullptr;
+            const long first = std::strtol(it, &end, 10);
+            if (end == it) {
+                break;
+            }
+            long last = first;
+            if (*end == '-') {
+                it = end + 1;
+                last = std::strtol(it, &end, 10);
+                if (end == it) {
+                    break;
+                }
+            }
+            for (long cpu = first; cpu <= last; ++cpu) {
+                result.push_back(static_cast<int>(cpu));
+            }
+            it = (*end == ',') ? end + 1 : end;
+        }
+        return result;
+    }
+
+#ifdef __linux__
+    // Restricts the calling thread to the given cpus. Every thread created
+    // while the restriction is active inherits it. Returns false when the
+    // restriction could not be applied (and `saved` is untouched).
+    bool restrict_cpus(const std::vector<int> &cpus, cpu_set_t &saved) {
+        if (cpus.empty()) {
+            return false;
+        }
+        if (::sched_getaffinity(0, sizeof(cpu_set_t), &saved) != 0) {
+            return false;
+        }
+        cpu_set_t wanted;
+        CPU_ZERO(&wanted);
+        for (const int cpu : cpus) {
+            if (cpu >= 0 && cpu < CPU_SETSIZE) {
+                CPU_SET(cpu, &wanted);
+            }
+        }
+        if (CPU_COUNT(&wanted) == 0 || ::sched_setaffinity(0, sizeof(cpu_set_t), &wanted) != 0) {
+            spdlog::warn("Applying cpu affinity failed. Ignored.");
+            return false;
+        }
+        return true;
+    }
+#endif
 }
 
 namespace ic {
 
     rust::Result<int> Command::execute() const
     {
+#ifdef __linux__
+        // Reserve the given cpus for the collector: the service threads
+        // created below inherit the restriction, and the build command is
+        // spawned only after the original mask is restored, so the
+        // compilers keep the whole machine.
+        cpu_set_t saved_affinity;
+        const bool restricted = restrict_cpus(cpu_affinity_, saved_affinity);
+        if (restricted) {
+            reporter_->pin(cpu_affinity_);
+        }
+#else
+        if (!cpu_affinity_.empty()) {
+            spdlog::warn("Cpu affinity is not supported on this system. Ignored.");
+        }
+#endif
         // Create and start the gRPC server
-        int port = 0;
         ic::SupervisorImpl supervisor(*session_);
         ic::InterceptorImpl interceptor(*reporter_);
-        auto server = grpc::ServerBuilder()
+        auto builder = grpc::ServerBuilder();
+        // Spread the incoming calls over multiple completion queues, so a
+        // highly parallel build is not serialized on a single poller.
+        builder.SetSyncServerOption(grpc::ServerBuilder::SyncServerOption::NUM_CQS, static_cast<int>(server_threads_));
+        builder.SetSyncServerOption(grpc::ServerBuilder::SyncServerOption::MIN_POLLERS, 1);
+        builder.SetSyncServerOption(grpc::ServerBuilder::SyncServerOption::MAX_POLLERS, static_cast<int>(server_threads_));
+        // Payload compression for remote collection: the full environment
+        // start events compress well, but the local transports do not need
+        // it, so it is requested explicitly.
+        if (grpc_compression_) {
+            builder.SetDefaultCompressionAlgorithm(GRPC_COMPRESS_GZIP);
+            session_->set_grpc_compression();
+        }
+        // The server listens on a unix domain socket: the wrappers are
+        // short lived, and the TCP handshake would be a measurable part
+        // of their lifetime.
+#ifdef __linux__
+        // The abstract socket namespace needs no filesystem entry: there
+        // is nothing to create or to clean up, and the name disappears
+        // with the process even when it is killed.
+        const auto server_address = fmt::format("unix-abstract:intercept-{}.grpc", getpid());
+#else
+        const auto server_socket = fs::temp_directory_path() / fmt::format("intercept-{}.grpc", getpid());
+        const auto server_address = fmt::format("unix:{}", server_socket.string());
+#endif
+        auto server = builder
                           .RegisterService(&supervisor)
                           .RegisterService(&interceptor)
-                          .AddListeningPort("127.0.0.1:0", grpc::InsecureServerCredentials(), &port)
+                          .AddListeningPort(server_address, grpc::InsecureServerCredentials())
                           .BuildAndStart();
 
         // Create session_locator URL for the services
-        auto session_locator = SessionLocator(fmt::format("127.0.0.1:{}", port));
+        auto session_locator = SessionLocator(server_address);
         spdlog::debug("Running gRPC server. {0}", session_locator);
+        // Create the socket for direct event reports from the preload library.
+        auto event_socket = rust::Result<ic::EventSocketService::Ptr>(
+                rust::Err(std::runtime_error("Direct event reporting is not requested.")));
+        if (session_->wants_report_socket()) {
+            auto socket_file = fs::temp_directory_path() / fmt::format("intercept-{}.sock", getpid());
+            event_socket = ic::EventSocketService::create(socket_file, *reporter_)
+                    .on_success([this](const auto &service) {
+                        spdlog::debug("Running event report socket. {0}", service->address().string());
+                        session_->set_report_socket(service->address().string());
+                    })
+                    .on_error([](const auto &error) {
+                        spdlog::warn("Direct report socket setup failed: {} Falling back to the wrapper.", error.what());
+                    });
+        }
+        // Create the shared memory ring for event reports.
+        auto event_ring = rust::Result<ic::EventRingService::Ptr>(
+                rust::Err(std::runtime_error("Ring transport is not requested.")));
+        if (session_->wants_event_ring()) {
+            event_ring = ic::EventRingService::create(fmt::format("/intercept-{}", getpid()), *reporter_)
+                    .on_success([this](const auto &service) {
+                        spdlog::debug("Running event ring. {0}", service->name());
+                        session_->set_event_ring(service->name());
+                    })
+                    .on_error([](const auto &error) {
+                        spdlog::warn("Event ring setup failed: {} Falling back to gRPC.", error.what());
+                    });
+        }
+#ifdef __linux__
+        if (restricted) {
+            ::sched_setaffinity(0, sizeof(cpu_set_t), &saved_affinity);
+        }
+#endif
         // Execute the build command
         auto result = session_->run(execution_, session_locator);
         // Stop the gRPC server
         spdlog::debug("Stopping gRPC server.");
         server->Shutdown();
+#ifndef __linux__
+        std::error_code error_code;
+        fs::remove(server_socket, error_code);
+#endif
         // Exit with the build status
         return result;
     }
@@ -112,27 +252,74 @@ namespace ic {
     { }
 
     rust::Result<flags::Arguments> Application::parse(int argc, const char **argv) const {
+        const flags::Parser events(cmd::intercept::events::COMMAND, cmd::VERSION, {
+                {cmd::intercept::events::FLAG_PATH,    {1, false, "path of the events database",                        {cmd::intercept::DEFAULT_OUTPUT}, std::nullopt}},
+                {cmd::intercept::events::FLAG_PROGRAM, {1, false, "restrict to the executions of the given program",    std::nullopt,                     std::nullopt}},
+                {cmd::intercept::events::FLAG_COUNT,   {0, false, "print only the number of the matching events",       std::nullopt,                     std::nullopt}},
+                {cmd::intercept::events::FLAG_TIMES,   {0, false, "print only the time range the matching events cover", std::nullopt,                    std::nullopt}},
+                {cmd::intercept::events::FLAG_TRACE,   {0, false, "print the process timeline as Chrome trace JSON",    std::nullopt,                     std::nullopt}},
+                {cmd::intercept::events::FLAG_TOP,     {0, false, "print the programs ranked by the wall time burned",  std::nullopt,                     std::nullopt}},
+                {cmd::intercept::events::FLAG_COMPACT, {1, false, "rewrite only the started events into the given file, deduplicated", std::nullopt,     std::nullopt}},
+        });
         const flags::Parser parser("intercept", cmd::VERSION, {
                 {cmd::intercept::FLAG_OUTPUT,        {1,  false, "path of the result file",        {cmd::intercept::DEFAULT_OUTPUT}, std::nullopt}},
+                {cmd::intercept::FLAG_PRUNE,         {1,  false, "colon separated list of programs whose process subtrees are not recorded", std::nullopt, std::nullopt}},
+                {cmd::intercept::FLAG_ONLY,          {1,  false, "colon separated list of program names to record; other executions are not reported (preload mode)", std::nullopt, DEVELOPER_GROUP}},
+                {cmd::intercept::FLAG_PROFILE,       {0,  false, "write a per program wall time profile next to the result file", std::nullopt, std::nullopt}},
+                {cmd::intercept::FLAG_CAPTURE_ENV,   {1,  false, "colon separated list of environment variables to capture (default: all)", std::nullopt, std::nullopt}},
+                {cmd::intercept::FLAG_RESOURCE_USAGE, {0, false, "attach cpu times and peak memory of the intercepted processes to the events", std::nullopt, std::nullopt}},
                 {cmd::intercept::FLAG_FORCE_PRELOAD, {0,  false, "force to use library preload",   std::nullopt,                     DEVELOPER_GROUP}},
                 {cmd::intercept::FLAG_FORCE_WRAPPER, {0,  false, "force to use compiler wrappers", std::nullopt,                     DEVELOPER_GROUP}},
+                {cmd::intercept::FLAG_DIRECT_REPORT, {0,  false, "report events from the preload library without the wrapper process", std::nullopt, DEVELOPER_GROUP}},
+                {cmd::intercept::FLAG_RING_TRANSPORT, {0, false, "report events over a shared memory ring instead of gRPC", std::nullopt, DEVELOPER_GROUP}},
+                {cmd::intercept::FLAG_OUTPUT_BUFFER, {1, false, "size of the output write buffer in bytes", {cmd::intercept::DEFAULT_OUTPUT_BUFFER}, DEVELOPER_GROUP}},
+                {cmd::intercept::FLAG_OUTPUT_COMPRESS, {0, false, "compress the output file with zstd", std::nullopt, DEVELOPER_GROUP}},
+                {cmd::intercept::FLAG_OUTPUT_SEGMENT, {1, false, "rotate the output into segments of this many bytes", std::nullopt, DEVELOPER_GROUP}},
+                {cmd::intercept::FLAG_SERVER_THREADS, {1, false, "number of threads polling for gRPC calls", std::nullopt, DEVELOPER_GROUP}},
+                {cmd::intercept::FLAG_GRPC_COMPRESSION, {0, false, "compress the gRPC event payloads; for collectors reached over a network link", std::nullopt, DEVELOPER_GROUP}},
+                {cmd::intercept::FLAG_CPU_AFFINITY,  {1,  false, "comma separated cpu list (ranges allowed) to run the collector threads on", std::nullopt, DEVELOPER_GROUP}},
                 {cmd::intercept::FLAG_LIBRARY,       {1,  false, "path to the preload library",    {cmd::library::DEFAULT_PATH},     DEVELOPER_GROUP}},
                 {cmd::intercept::FLAG_WRAPPER,       {1,  false, "path to the wrapper executable", {cmd::wrapper::DEFAULT_PATH},     DEVELOPER_GROUP}},
                 {cmd::intercept::FLAG_WRAPPER_DIR,   {1,  false, "path to the wrapper directory",  {cmd::wrapper::DEFAULT_DIR_PATH}, DEVELOPER_GROUP}},
                 {cmd::intercept::FLAG_COMMAND,       {-1, true,  "command to execute",             std::nullopt,                     std::nullopt}}
-        });
+        }, {events});
         return parser.parse_or_exit(argc, const_cast<const char **>(argv));
     }
 
     rust::Result<ps::CommandPtr> Application::command(const flags::Arguments &args, const char **envp) const {
+        // the events subcommand inspects a database instead of running a build.
+        if (const auto subcommand = args.as_string(flags::COMMAND);
+                subcommand.is_ok() && subcommand.unwrap() == cmd::intercept::events::COMMAND) {
+            return EventsCommand::from(args);
+        }
         auto execution = capture_execution(args, sys::env::from(envp));
         auto session = Session::from(args, envp);
         auto reporter = Reporter::from(args);
+        const unsigned int server_threads = args
+                .as_string(cmd::intercept::FLAG_SERVER_THREADS)
+                .map<unsigned int>([](auto value) {
+                    const std::string input(value);
+                    char *end = nullptr;
+                    const unsigned long result = std::strtoul(input.c_str(), &end, 10);
+                    return (end != input.c_str() && *end == 0) ? static_cast<unsigned int>(result) : 0u;
+                })
+                .unwrap_or(0u);
+        const auto cpu_affinity = args
+                .as_string(cmd::intercept::FLAG_CPU_AFFINITY)
+                .map<std::vector<int>>([](auto value) { return parse_cpu_list(value); })
+                .unwrap_or(std::vector<int>());
+        const bool grpc_compression = args.as_bool(cmd::intercept::FLAG_GRPC_COMPRESSION).unwrap_or(false);
 
         return rust::merge(execution, session, reporter)
-                .map<ps::CommandPtr>([](auto tuple) {
+                .map<ps::CommandPtr>([&server_threads, &cpu_affinity, &grpc_compression](auto tuple) {
                     const auto&[execution, session, reporter] = tuple;
-                    return std::make_unique<Command>(execution, session, reporter);
+                    // a reserved core set sizes the poller pool too.
+                    const unsigned int threads = (server_threads > 0)
+                            ? server_threads
+                            : (!cpu_affinity.empty())
+                                    ? std::max(2u, static_cast<unsigned int>(cpu_affinity.size()))
+                                    : std::max(2u, std::thread::hardware_concurrency() / 4);
+                    return std::make_unique<Command>(execution, session, reporter, threads, cpu_affinity, grpc_compression);
                 });
     }
 }
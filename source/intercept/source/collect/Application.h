@@ -32,11 +32,15 @@ namespace ic {
 
     struct Command : ps::Command {
 
-        Command(Execution execution, Session::Ptr session, Reporter::Ptr reporter)
+        Command(Execution execution, Session::Ptr session, Reporter::Ptr reporter,
+                unsigned int server_threads, std::vector<int> cpu_affinity, bool grpc_compression)
                 : ps::Command()
                 , execution_(std::move(execution))
                 , session_(std::move(session))
                 , reporter_(std::move(reporter))
+                , server_threads_(server_threads)
+                , cpu_affinity_(std::move(cpu_affinity))
+                , grpc_compression_(grpc_compression)
         { }
 
         [[nodiscard]] rust::Result<int> execute() const override;
@@ -48,6 +52,9 @@ namespace ic {
         Execution execution_;
         Session::Ptr session_;
         Reporter::Ptr reporter_;
+        unsigned int server_threads_;
+        std::vector<int> cpu_affinity_;
+        bool grpc_compression_;
     };
 
     struct Application : ps::ApplicationFromArgs {
@@ -0,0 +1,429 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "collect/EventsCommand.h"
+#include "collect/db/EventsDatabaseReader.h"
+#include "collect/db/EventsDatabaseWriter.h"
+
+#include <google/protobuf/util/json_util.h>
+#include <google/protobuf/util/time_util.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace db = ic::collect::db;
+
+namespace {
+
+    // A bare program name matches in any directory, a path has to be
+    // equal. (The same rule the subtree pruner applies.)
+    bool matches(const fs::path &program, const fs::path &filter) {
+        return filter.parent_path().empty()
+               ? program.filename() == filter
+               : program == filter;
+    }
+
+    // With a program filter only the started events of that program are
+    // selected; without it every event is.
+    bool selected(const rpc::Event &event, const std::optional<std::string> &program) {
+        if (!program) {
+            return true;
+        }
+        return event.has_started()
+               && matches(event.started().execution().executable(), program.value());
+    }
+
+    // JSON string escaping for the trace output. (The paths and the
+    // arguments can contain anything.)
+    std::string escape(const std::string &input) {
+        std::string result;
+        result.reserve(input.size());
+        for (const char it : input) {
+            switch (it) {
+                case '"': result.append("\\\""); break;
+                case '\\': result.append("\\\\"); break;
+                case '\n': result.append("\\n"); break;
+                case '\t': result.append("\\t"); break;
+                case '\r': result.append("\\r"); break;
+                default:
+                    if (static_cast<unsigned char>(it) < 0x20) {
+                        result.append(fmt::format("\\u{:04x}", it));
+                    } else {
+                        result.push_back(it);
+                    }
+            }
+        }
+        return result;
+    }
+
+    // A started event waiting for its terminated pair.
+    struct OpenSlice {
+        std::string executable;
+        uint32_t pid;
+        uint32_t ppid;
+        int64_t started_usec;
+    };
+
+    // Streams the process timeline as Chrome trace JSON to the output.
+    //
+    // One pass over the database: a started event opens a slice, the
+    // terminated (or signalled) event of the same reporter id closes it
+    // and emits a complete ("X") trace event. Slices still open at the
+    // end of the stream (killed builds) are closed with the last seen
+    // timestamp. The timestamps are microseconds relative to the first
+    // event of the database, the slice lanes are the process ids.
+    rust::Result<int> export_trace(ic::collect::db::EventsDatabaseReader &events,
+                                   const std::optional<std::string> &program,
+                                   std::ostream &out) {
+        std::map<uint64_t, OpenSlice> open;
+        int64_t base_usec = 0;
+        int64_t last_usec = 0;
+        bool first_event = true;
+        bool first_slice = true;
+
+        auto emit = [&out, &base_usec, &first_slice](const OpenSlice &slice, uint64_t rid, int64_t end_usec) {
+            const int64_t begin = std::max(slice.started_usec - base_usec, int64_t(0));
+            const int64_t duration = std::max(end_usec - slice.started_usec, int64_t(0));
+            out << (first_slice ? "\n" : ",\n")
+                << "{\"name\":\"" << escape(fs::path(slice.executable).filename())
+                << "\",\"cat\":\"process\",\"ph\":\"X\""
+                << ",\"ts\":" << begin
+                << ",\"dur\":" << duration
+                << ",\"pid\":" << slice.pid
+                << ",\"tid\":" << slice.pid
+                << ",\"args\":{\"executable\":\"" << escape(slice.executable)
+                << "\",\"ppid\":" << slice.ppid
+                << ",\"rid\":" << rid << "}}";
+            first_slice = false;
+        };
+
+        out << "{\"traceEvents\":[";
+        for (auto it = events.events_begin(); it != events.events_end(); ++it) {
+            auto entry = *it;
+            if (entry.is_err()) {
+                return rust::Err(entry.unwrap_err());
+            }
+            const rpc::Event &event = *entry.unwrap();
+            const auto usec = google::protobuf::util::TimeUtil::TimestampToMicroseconds(event.timestamp());
+            if (first_event) {
+                base_usec = usec;
+                first_event = false;
+            }
+            last_usec = std::max(last_usec, usec);
+
+            if (event.has_started()) {
+                if (!selected(event, program)) {
+                    continue;
+                }
+                open[event.rid()] = OpenSlice{
+                        event.started().execution().executable(),
+                        event.started().pid(),
+                        event.started().ppid(),
+                        usec};
+            } else if (event.has_terminated() || event.has_signalled()) {
+                if (auto slice = open.find(event.rid()); slice != open.end()) {
+                    emit(slice->second, slice->first, usec);
+                    open.erase(slice);
+                }
+            }
+        }
+        // killed builds leave slices open; close them at the last event.
+        for (const auto &[rid, slice] : open) {
+            emit(slice, rid, last_usec);
+        }
+        out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+        return rust::Ok(EXIT_SUCCESS);
+    }
+
+    // Rewrites the database into a compact archive form.
+    //
+    // Only the started records are kept: citnames parses nothing else,
+    // so the terminated and signalled records (half or more of a build's
+    // events) are dead weight in an archive. The kept records pass
+    // through the writer again, which delta encodes their environments
+    // against the first event and deduplicates the repeated command
+    // lines and strings in its dictionary. With a program filter only
+    // the executions of that program survive, so an archive can be
+    // trimmed down to the compiler calls alone. The result is a regular
+    // events database, replayable by citnames.
+    rust::Result<int> compact(ic::collect::db::EventsDatabaseReader &events,
+                              const std::optional<std::string> &program,
+                              const fs::path &target) {
+        return db::EventsDatabaseWriter::create(target)
+                .and_then<int>([&events, &program](const auto &writer) -> rust::Result<int> {
+                    uint64_t read = 0;
+                    uint64_t written = 0;
+                    for (auto it = events.events_begin(); it != events.events_end(); ++it) {
+                        auto entry = *it;
+                        if (entry.is_err()) {
+                            return rust::Err(entry.unwrap_err());
+                        }
+                        const rpc::Event &event = *entry.unwrap();
+                        read += 1;
+                        if (!event.has_started() || !selected(event, program)) {
+                            continue;
+                        }
+                        if (auto result = writer->insert_event(event); result.is_err()) {
+                            return rust::Err(result.unwrap_err());
+                        }
+                        written += 1;
+                    }
+                    fmt::print("{} events read, {} events kept\n", read, written);
+                    return rust::Ok(EXIT_SUCCESS);
+                });
+    }
+
+    // A process of the exec tree, while the aggregation runs.
+    struct Process {
+        std::string program;
+        uint32_t pid;
+        uint64_t parent_rid;
+        int64_t started_usec;
+        int64_t children_usec;
+    };
+
+    // The aggregated times of a program.
+    struct Usage {
+        uint64_t count;
+        int64_t inclusive_usec;
+        int64_t exclusive_usec;
+    };
+
+    // Prints the programs ranked by the wall time they burned.
+    //
+    // One streaming pass reconstructs the exec tree: a pid indexed table
+    // of the live processes links every started event to its parent. The
+    // inclusive time of a process is its lifetime; the exclusive time is
+    // the lifetime minus the lifetimes of its direct children (what the
+    // process itself burned, waiting included). Both are aggregated by
+    // the executable path. Processes still running at the end of the
+    // stream are closed at the last seen event.
+    rust::Result<int> report_top(ic::collect::db::EventsDatabaseReader &events,
+                                 std::ostream &out) {
+        std::map<uint64_t, Process> open;
+        std::map<uint32_t, uint64_t> live;
+        std::map<std::string, Usage> usage;
+        int64_t last_usec = 0;
+
+        auto close = [&open, &live, &usage](const uint64_t rid, const int64_t end_usec) {
+            const auto node = open.find(rid);
+            if (node == open.end()) {
+                return;
+            }
+            const auto duration = std::max(end_usec - node->second.started_usec, int64_t(0));
+            auto &entry = usage[node->second.program];
+            entry.count += 1;
+            entry.inclusive_usec += duration;
+            entry.exclusive_usec += std::max(duration - node->second.children_usec, int64_t(0));
+            if (const auto parent = open.find(node->second.parent_rid); parent != open.end()) {
+                parent->second.children_usec += duration;
+            }
+            // the pid can be reused by a later process; unlink only our own.
+            if (const auto pid = live.find(node->second.pid); pid != live.end() && pid->second == rid) {
+                live.erase(pid);
+            }
+            open.erase(node);
+        };
+
+        for (auto it = events.events_begin(); it != events.events_end(); ++it) {
+            auto entry = *it;
+            if (entry.is_err()) {
+                return rust::Err(entry.unwrap_err());
+            }
+            const rpc::Event &event = *entry.unwrap();
+            const auto usec = google::protobuf::util::TimeUtil::TimestampToMicroseconds(event.timestamp());
+            last_usec = std::max(last_usec, usec);
+
+            if (event.has_started()) {
+                // the collector stamped linkage is exact; the live pid
+                // table only covers databases predating the field.
+                uint64_t parent_rid = event.started().parent_rid();
+                if (parent_rid == 0) {
+                    const auto parent = live.find(event.started().ppid());
+                    parent_rid = (parent != live.end()) ? parent->second : 0;
+                }
+                open[event.rid()] = Process{
+                        event.started().execution().executable(),
+                        event.started().pid(),
+                        parent_rid,
+                        usec,
+                        0};
+                live[event.started().pid()] = event.rid();
+            } else if (event.has_terminated() || event.has_signalled()) {
+                close(event.rid(), usec);
+            }
+        }
+        // close the processes still running in rid order: a parent has a
+        // smaller rid than its children, closing the children first keeps
+        // the parent's exclusive time honest.
+        while (!open.empty()) {
+            close(open.rbegin()->first, last_usec);
+        }
+
+        std::vector<std::pair<std::string, Usage>> ranked(usage.begin(), usage.end());
+        std::sort(ranked.begin(), ranked.end(), [](const auto &lhs, const auto &rhs) {
+            return lhs.second.inclusive_usec > rhs.second.inclusive_usec;
+        });
+        out << fmt::format("{:>12} {:>12} {:>8}  {}\n", "incl [s]", "excl [s]", "count", "program");
+        for (const auto &[program, times] : ranked) {
+            out << fmt::format("{:>12.3f} {:>12.3f} {:>8}  {}\n",
+                               times.inclusive_usec / 1e6,
+                               times.exclusive_usec / 1e6,
+                               times.count,
+                               program);
+        }
+        return rust::Ok(EXIT_SUCCESS);
+    }
+}
+
+namespace ic {
+
+    rust::Result<ps::CommandPtr> EventsCommand::from(const flags::Arguments &args) {
+        auto program = args.as_string(cmd::intercept::events::FLAG_PROGRAM)
+                .map<std::optional<std::string>>([](auto value) {
+                    return std::make_optional(std::string(value));
+                })
+                .unwrap_or(std::nullopt);
+        const bool count_only = args.as_bool(cmd::intercept::events::FLAG_COUNT).unwrap_or(false);
+        const bool times_only = args.as_bool(cmd::intercept::events::FLAG_TIMES).unwrap_or(false);
+        const bool trace_only = args.as_bool(cmd::intercept::events::FLAG_TRACE).unwrap_or(false);
+        const bool top_only = args.as_bool(cmd::intercept::events::FLAG_TOP).unwrap_or(false);
+        auto compact_to = args.as_string(cmd::intercept::events::FLAG_COMPACT)
+                .map<std::optional<fs::path>>([](auto value) {
+                    return std::make_optional(fs::path(value));
+                })
+                .unwrap_or(std::nullopt);
+
+        return args.as_string(cmd::intercept::events::FLAG_PATH)
+                .map<ps::CommandPtr>([&program, &count_only, &times_only, &trace_only, &top_only, &compact_to](auto path) {
+                    return std::make_unique<EventsCommand>(
+                            fs::path(path), std::move(program), count_only, times_only, trace_only, top_only,
+                            std::move(compact_to));
+                });
+    }
+
+    EventsCommand::EventsCommand(fs::path path,
+                                 std::optional<std::string> program,
+                                 bool count_only,
+                                 bool times_only,
+                                 bool trace_only,
+                                 bool top_only,
+                                 std::optional<fs::path> compact) noexcept
+            : ps::Command()
+            , path_(std::move(path))
+            , program_(std::move(program))
+            , count_only_(count_only)
+            , times_only_(times_only)
+            , trace_only_(trace_only)
+            , top_only_(top_only)
+            , compact_(std::move(compact))
+    { }
+
+    rust::Result<int> EventsCommand::execute() const {
+        if (compact_ || trace_only_ || top_only_) {
+            return db::EventsDatabaseReader::from(path_)
+                    .and_then<int>([this](const auto &events) -> rust::Result<int> {
+                        if (compact_) {
+                            return compact(*events, program_, compact_.value());
+                        }
+                        if (trace_only_) {
+                            return export_trace(*events, program_, std::cout);
+                        }
+                        return report_top(*events, std::cout);
+                    });
+        }
+        // The scan covers the whole segment chain of a rotated database.
+        // With a program filter the manifest's name filters drop the
+        // segments which cannot hold a matching event, without opening
+        // them; the per event check below still decides.
+        const auto chain = program_
+                ? db::EventsDatabaseReader::segments(path_, program_.value())
+                : db::EventsDatabaseReader::segments(path_);
+        uint64_t count = 0;
+        google::protobuf::Timestamp first;
+        google::protobuf::Timestamp last;
+        int64_t first_usec = 0;
+        int64_t last_usec = 0;
+
+        for (const auto &segment : chain) {
+            const auto events = db::EventsDatabaseReader::from(segment);
+            if (events.is_err()) {
+                return rust::Err(events.unwrap_err());
+            }
+            const auto &reader = events.unwrap();
+            if (program_) {
+                // only started events can match a program; the basename
+                // predicate over-approximates a path filter, the
+                // `selected` check below still decides exactly.
+                db::EventsFilter filter;
+                filter.kind = rpc::Event::kStarted;
+                filter.programs = { fs::path(program_.value()).filename().string() };
+                reader->filter(std::move(filter));
+            }
+            for (auto it = reader->events_begin(); it != reader->events_end(); ++it) {
+                auto entry = *it;
+                if (entry.is_err()) {
+                    return rust::Err(entry.unwrap_err());
+                }
+                const rpc::Event &event = *entry.unwrap();
+                if (!selected(event, program_)) {
+                    continue;
+                }
+                count += 1;
+                if (times_only_) {
+                    // the events are written in arrival order, which
+                    // is not strictly the time order.
+                    const auto usec = google::protobuf::util::TimeUtil::TimestampToMicroseconds(event.timestamp());
+                    if (count == 1 || usec < first_usec) {
+                        first = event.timestamp();
+                        first_usec = usec;
+                    }
+                    if (count == 1 || usec > last_usec) {
+                        last = event.timestamp();
+                        last_usec = usec;
+                    }
+                } else if (!count_only_) {
+                    std::string json;
+                    google::protobuf::util::MessageToJsonString(event, &json);
+                    std::cout << json << '\n';
+                }
+            }
+        }
+        if (count_only_) {
+            fmt::print("{}\n", count);
+        } else if (times_only_) {
+            if (count > 0) {
+                fmt::print("{} .. {} ({} events)\n",
+                           google::protobuf::util::TimeUtil::ToString(first),
+                           google::protobuf::util::TimeUtil::ToString(last),
+                           count);
+            } else {
+                fmt::print("no matching events\n");
+            }
+        }
+        return rust::Ok(EXIT_SUCCESS);
+    }
+}
@@ -0,0 +1,73 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "config.h"
+#include "libflags/Flags.h"
+#include "libmain/Application.h"
+#include "libresult/Result.h"
+
+#include <filesystem>
+#include <optional>
+#include <string>
+
+namespace fs = std::filesystem;
+
+namespace ic {
+
+    // Inspects an events database without materializing its content.
+    //
+    // The scan streams the events from the database: it prints them as
+    // JSON (one event per line), counts them, reports the time range
+    // they cover, exports a Chrome trace of the process timeline, or
+    // prints the programs ranked by the wall time they burned,
+    // optionally restricted to the executions of a single program.
+    // These questions otherwise need a throwaway protobuf script
+    // against a possibly huge file.
+    //
+    // It can also compact the database into an archive form: only the
+    // started records are kept (the only ones citnames parses), rewritten
+    // through the writer's dictionary and environment delta encoding.
+    struct EventsCommand : ps::Command {
+        static rust::Result<ps::CommandPtr> from(const flags::Arguments &args);
+
+        EventsCommand(fs::path path,
+                      std::optional<std::string> program,
+                      bool count_only,
+                      bool times_only,
+                      bool trace_only,
+                      bool top_only,
+                      std::optional<fs::path> compact) noexcept;
+
+        [[nodiscard]] rust::Result<int> execute() const override;
+
+        NON_DEFAULT_CONSTRUCTABLE(EventsCommand);
+        NON_COPYABLE_NOR_MOVABLE(EventsCommand);
+
+    private:
+        fs::path path_;
+        std::optional<std::string> program_;
+        bool count_only_;
+        bool times_only_;
+        bool trace_only_;
+        bool top_only_;
+        std::optional<fs::path> compact_;
+    };
+}
@@ -19,35 +19,385 @@
 
 #include "config.h"
 #include "collect/Reporter.h"
+#include "libsys/Path.h"
 
 #include <spdlog/spdlog.h>
+#include <fmt/format.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <optional>
+#include <string>
 #include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+    // Number of events the reporter can buffer before the producers have to
+    // wait for the writer thread. Shall be a power of two. Scaled with the
+    // width of the machine: more handler threads produce deeper bursts, and
+    // a producer stalled on a full queue holds up a supervised process.
+    size_t queue_size() {
+        const size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        size_t size = 1024;
+        while (size < threads * 64 && size < 64 * 1024) {
+            size *= 2;
+        }
+        return size;
+    }
+
+    // How often the events database publishes a snapshot point. A
+    // concurrent consumer of the session trails the build by at most
+    // this much, plus its own processing time.
+    constexpr std::chrono::seconds SNAPSHOT_INTERVAL(5);
+}
 
 namespace ic {
 
+    EventQueue::EventQueue(size_t size)
+            : slots_(new Slot[size])
+            , mask_(size - 1)
+            , head_(0)
+            , tail_(0)
+            , tail_position_(0)
+    {
+        for (size_t idx = 0; idx < size; ++idx) {
+            slots_[idx].sequence.store(idx, std::memory_order_relaxed);
+        }
+    }
+
+    bool EventQueue::push(const rpc::Event &event) {
+        uint64_t ticket = head_.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot &slot = slots_[ticket & mask_];
+            const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+            if (sequence == ticket) {
+                if (head_.compare_exchange_weak(ticket, ticket + 1, std::memory_order_relaxed)) {
+                    slot.event = event;
+                    slot.sequence.store(ticket + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (sequence < ticket) {
+                // The consumer has not freed this slot yet. The queue is full.
+                return false;
+            } else {
+                ticket = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool EventQueue::pop(rpc::Event &event) {
+        Slot &slot = slots_[tail_ & mask_];
+        const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != tail_ + 1) {
+            return false;
+        }
+        event = std::move(slot.event);
+        // Mark the slot free for the producer which wraps around to it.
+        slot.sequence.store(tail_ + mask_ + 1, std::memory_order_release);
+        ++tail_;
+        tail_position_.store(tail_, std::memory_order_relaxed);
+        return true;
+    }
+
+    size_t EventQueue::depth() const {
+        const uint64_t head = head_.load(std::memory_order_relaxed);
+        const uint64_t tail = tail_position_.load(std::memory_order_relaxed);
+        return (head > tail) ? head - tail : 0;
+    }
+
+    SubtreePruner::SubtreePruner(std::vector<fs::path> excludes)
+            : excludes_(std::move(excludes))
+            , pids_()
+            , rids_()
+    { }
+
+    bool SubtreePruner::matches(const fs::path &program) const {
+        for (const auto &exclude : excludes_) {
+            // a bare program name excludes it from any directory.
+            if (exclude.parent_path().empty()
+                    ? program.filename() == exclude
+                    : program == exclude) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool SubtreePruner::drop(const rpc::Event &event) {
+        if (excludes_.empty()) {
+            return false;
+        }
+        if (event.has_started()) {
+            const auto &started = event.started();
+            // the parent rid joins the tree exactly; the pid check keeps
+            // covering events without the linkage.
+            if ((started.parent_rid() != 0 && rids_.count(started.parent_rid()) > 0)
+                    || pids_.count(started.ppid()) > 0
+                    || matches(started.execution().executable())) {
+                pids_.insert(started.pid());
+                rids_.insert(event.rid());
+                return true;
+            }
+            return false;
+        }
+        // terminated and signalled events follow their started event.
+        return rids_.count(event.rid()) > 0;
+    }
+
+    namespace {
+
+        uint64_t to_usec(const google::protobuf::Timestamp &timestamp) {
+            return static_cast<uint64_t>(timestamp.seconds()) * 1000000u
+                   + static_cast<uint64_t>(timestamp.nanos()) / 1000u;
+        }
+    }
+
+    void BuildProfile::add(const rpc::Event &event) {
+        if (event.has_started()) {
+            running_.emplace(event.rid(),
+                             std::make_pair(event.started().execution().executable(), to_usec(event.timestamp())));
+            return;
+        }
+        const auto it = running_.find(event.rid());
+        if (it == running_.end()) {
+            return;
+        }
+        const auto start = it->second.second;
+        const auto end = to_usec(event.timestamp());
+        const auto duration = (end > start) ? end - start : 0u;
+
+        Times &times = totals_[it->second.first];
+        times.count += 1;
+        times.total_usec += duration;
+        times.min_usec = (times.count == 1) ? duration : std::min(times.min_usec, duration);
+        times.max_usec = std::max(times.max_usec, duration);
+        running_.erase(it);
+    }
+
+    void BuildProfile::write(const fs::path &file) const {
+        std::vector<std::pair<std::string, Times>> rows(totals_.begin(), totals_.end());
+        std::sort(rows.begin(), rows.end(),
+                  [](const auto &lhs, const auto &rhs) { return lhs.second.total_usec > rhs.second.total_usec; });
+
+        std::ofstream os(file);
+        os << "# count\ttotal_ms\tmin_ms\tmax_ms\tprogram\n";
+        for (const auto &[program, times] : rows) {
+            os << fmt::format("{}\t{}.{:03}\t{}.{:03}\t{}.{:03}\t{}\n",
+                              times.count,
+                              times.total_usec / 1000, times.total_usec % 1000,
+                              times.min_usec / 1000, times.min_usec % 1000,
+                              times.max_usec / 1000, times.max_usec % 1000,
+                              program);
+        }
+        if (!os.good()) {
+            spdlog::warn("Writing build profile failed (file {}). Ignored.", file.string());
+        }
+    }
+
     rust::Result<Reporter::Ptr> Reporter::from(const flags::Arguments& flags) {
-        return flags
-                .as_string(cmd::intercept::FLAG_OUTPUT)
-                .and_then<ic::collect::db::EventsDatabaseWriter::Ptr>([](auto file) {
-                    return ic::collect::db::EventsDatabaseWriter::create(file);
+        auto output = flags.as_string(cmd::intercept::FLAG_OUTPUT);
+        auto buffer_size = flags
+                .as_string(cmd::intercept::FLAG_OUTPUT_BUFFER)
+                .and_then<size_t>([](auto value) {
+                    const std::string input(value);
+                    char *end = nullptr;
+                    const unsigned long result = std::strtoul(input.c_str(), &end, 10);
+                    return (end != input.c_str() && *end == 0 && result > 0)
+                            ? rust::Result<size_t>(rust::Ok(result))
+                            : rust::Result<size_t>(rust::Err(
+                                    std::runtime_error(fmt::format("Invalid buffer size: {}", value))));
+                })
+                .unwrap_or(ic::collect::db::EventsDatabaseWriter::DEFAULT_BUFFER_SIZE);
+        const bool compress = flags.as_bool(cmd::intercept::FLAG_OUTPUT_COMPRESS).unwrap_or(false);
+        // zero keeps the output a single file.
+        const size_t segment_size = flags
+                .as_string(cmd::intercept::FLAG_OUTPUT_SEGMENT)
+                .and_then<size_t>([](auto value) {
+                    const std::string input(value);
+                    char *end = nullptr;
+                    const unsigned long result = std::strtoul(input.c_str(), &end, 10);
+                    return (end != input.c_str() && *end == 0 && result > 0)
+                            ? rust::Result<size_t>(rust::Ok(result))
+                            : rust::Result<size_t>(rust::Err(
+                                    std::runtime_error(fmt::format("Invalid segment size: {}", value))));
+                })
+                .unwrap_or(0);
+        // the excluded program paths come as a colon separated list.
+        auto excludes = flags.as_string(cmd::intercept::FLAG_PRUNE)
+                .map<std::vector<fs::path>>([](auto value) {
+                    const auto paths = sys::path::split(std::string(value));
+                    return std::vector<fs::path>(paths.begin(), paths.end());
+                })
+                .unwrap_or(std::vector<fs::path>());
+        // the captured variable names come as a colon separated list. (the
+        // reporters already filter at the source; this covers the preload
+        // library path, which sends the environment unfiltered.)
+        auto capture = flags.as_string(cmd::intercept::FLAG_CAPTURE_ENV)
+                .map<std::unordered_set<std::string>>([](auto value) {
+                    std::unordered_set<std::string> result;
+                    for (const auto &entry : sys::path::split(std::string(value))) {
+                        result.insert(entry.string());
+                    }
+                    return result;
                 })
-                .map<Reporter::Ptr>([](auto events) {
-                    return std::make_shared<Reporter>(events);
+                .unwrap_or(std::unordered_set<std::string>());
+        // the profile is written next to the output file.
+        const bool profiling = flags.as_bool(cmd::intercept::FLAG_PROFILE).unwrap_or(false);
+        auto profile = profiling
+                ? output.map<std::optional<fs::path>>([](auto file) {
+                    fs::path result(file);
+                    result += ".profile";
+                    return std::make_optional(result);
+                }).unwrap_or(std::nullopt)
+                : std::nullopt;
+
+        return output
+                .and_then<ic::collect::db::EventsDatabaseWriter::Ptr>([&buffer_size, &compress, &segment_size](auto file) {
+                    return ic::collect::db::EventsDatabaseWriter::create(file, buffer_size, compress)
+                            .on_success([&segment_size](const auto &events) {
+                                events->enable_snapshots(SNAPSHOT_INTERVAL);
+                                if (segment_size > 0) {
+                                    events->enable_segmentation(segment_size);
+                                }
+                            });
+                })
+                .map<Reporter::Ptr>([&excludes, &profile, &capture](auto events) {
+                    return std::make_shared<Reporter>(events, SubtreePruner(excludes), profile, capture);
                 });
     }
 
-    Reporter::Reporter(ic::collect::db::EventsDatabaseWriter::Ptr database)
+    Reporter::Reporter(ic::collect::db::EventsDatabaseWriter::Ptr database,
+                       SubtreePruner pruner,
+                       std::optional<fs::path> profile,
+                       std::unordered_set<std::string> capture)
             : database_(std::move(database))
-            , mutex_()
+            , pruner_(std::move(pruner))
+            , profile_file_(std::move(profile))
+            , profile_()
+            , capture_(std::move(capture))
+            , rids_()
+            // zero marks a record without a reporter, the sequence skips it.
+            , next_rid_(1)
+            , pid_rids_()
+            , rid_pids_()
+            , queue_(queue_size())
+            , stop_(false)
+            , writer_([this]() { drain(); })
     { }
 
+    Reporter::~Reporter() noexcept {
+        stop_.store(true);
+        writer_.join();
+        if (profile_file_) {
+            profile_.write(profile_file_.value());
+        }
+    }
+
+    void Reporter::pin([[maybe_unused]] const std::vector<int> &cpus) {
+#ifdef __linux__
+        cpu_set_t wanted;
+        CPU_ZERO(&wanted);
+        for (const int cpu : cpus) {
+            if (cpu >= 0 && cpu < CPU_SETSIZE) {
+                CPU_SET(cpu, &wanted);
+            }
+        }
+        if (CPU_COUNT(&wanted) == 0
+                || ::pthread_setaffinity_np(writer_.native_handle(), sizeof(cpu_set_t), &wanted) != 0) {
+            spdlog::warn("Pinning the writer thread failed. Ignored.");
+        }
+#endif
+    }
+
+    size_t Reporter::queue_depth() const {
+        return queue_.depth();
+    }
+
     void Reporter::report(const rpc::Event& event) {
-        std::lock_guard<std::mutex> lock(mutex_);
+        // When the queue is full, wait for the writer thread to catch up.
+        // Losing events would corrupt the output, so apply back pressure.
+        while (!queue_.push(event)) {
+            std::this_thread::yield();
+        }
+    }
 
-        database_->insert_event(event)
-                .on_error([](auto error) {
-                    spdlog::warn("Writing event into database failed: {} Ignored.", error.what());
-                });
+    void Reporter::drain() {
+        rpc::Event event;
+        for (;;) {
+            if (queue_.pop(event)) {
+                // the sequential id replaces the random wire id before
+                // anything keys on it, so the pruner, the profile and the
+                // database all see the same, compact id space.
+                if (const uint64_t rid = event.rid(); rid != 0) {
+                    const auto [it, inserted] = rids_.try_emplace(rid, next_rid_);
+                    if (inserted) {
+                        next_rid_ += 1;
+                    }
+                    event.set_rid(it->second);
+                }
+                // the parent linkage, stamped from the live process
+                // table. (See the pid_rids_ member comment.)
+                if (event.has_started()) {
+                    auto &started = *event.mutable_started();
+                    if (const auto parent = pid_rids_.find(started.ppid()); parent != pid_rids_.end()) {
+                        started.set_parent_rid(parent->second);
+                    }
+                    if (started.pid() != 0 && event.rid() != 0) {
+                        pid_rids_[started.pid()] = event.rid();
+                        rid_pids_[event.rid()] = started.pid();
+                    }
+                } else if (event.has_terminated()) {
+                    if (const auto it = rid_pids_.find(event.rid()); it != rid_pids_.end()) {
+                        // the process is gone and its pid free for reuse;
+                        // keep the mapping when a newer process took the
+                        // pid over already.
+                        if (const auto pid = pid_rids_.find(it->second);
+                                pid != pid_rids_.end() && pid->second == event.rid()) {
+                            pid_rids_.erase(pid);
+                        }
+                        rid_pids_.erase(it);
+                    }
+                }
+                // the profile covers the pruned subtrees too: their wall
+                // time is real even when their events are not recorded.
+                if (profile_file_) {
+                    profile_.add(event);
+                }
+                // the pruner state builds up in event order, which only the
+                // single writer thread can guarantee.
+                if (pruner_.drop(event)) {
+                    continue;
+                }
+                if (!capture_.empty() && event.has_started()) {
+                    auto &environment = *event.mutable_started()->mutable_execution()->mutable_environment();
+                    std::vector<std::string> dropped;
+                    for (const auto &[key, value] : environment) {
+                        if (capture_.count(key) == 0) {
+                            dropped.push_back(key);
+                        }
+                    }
+                    for (const auto &key : dropped) {
+                        environment.erase(key);
+                    }
+                }
+                database_->insert_event(event)
+                        .on_error([](auto error) {
+                            spdlog::warn("Writing event into database failed: {} Ignored.", error.what());
+                        });
+                BEAR_PROBE1(database_write, event.rid());
+            } else if (stop_.load()) {
+                break;
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        }
     }
 }
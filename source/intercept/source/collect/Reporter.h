@@ -24,12 +24,125 @@
 #include "libresult/Result.h"
 #include "intercept.pb.h"
 
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <map>
 #include <memory>
-#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
 
 namespace ic {
 
+    // Bounded multi producer, single consumer queue for events.
+    //
+    // Producers claim a slot with an atomic increment and publish it through
+    // the slot sequence number, so concurrent `push` calls don't block each
+    // other. The single consumer is the reporter writer thread.
+    class EventQueue {
+    public:
+        explicit EventQueue(size_t size);
+
+        // Returns false when the queue is full. Never blocks.
+        bool push(const rpc::Event &event);
+        // Returns false when the queue is empty. Shall be called from a
+        // single thread only.
+        bool pop(rpc::Event &event);
+
+        // Number of buffered events. Safe to call from any thread, but
+        // the value is approximate while the queue is in use.
+        [[nodiscard]] size_t depth() const;
+
+        NON_DEFAULT_CONSTRUCTABLE(EventQueue);
+        NON_COPYABLE_NOR_MOVABLE(EventQueue);
+
+    private:
+        struct Slot {
+            std::atomic<uint64_t> sequence;
+            rpc::Event event;
+        };
+
+        std::unique_ptr<Slot[]> slots_;
+        const uint64_t mask_;
+        alignas(64) std::atomic<uint64_t> head_;
+        alignas(64) uint64_t tail_;
+        // the consumer position again, published for the `depth` probe;
+        // `tail_` itself stays a plain member of the consumer thread.
+        alignas(64) std::atomic<uint64_t> tail_position_;
+    };
+
+    // Drops the events of excluded process subtrees.
+    //
+    // A started event whose program matches one of the excluded paths (or
+    // whose parent process is already dropped) marks a subtree: the event
+    // is dropped together with every later event of the same reporter and
+    // of its descendant processes. Test suites and code generators spawned
+    // mid-build can make up most of the recorded events, without ever
+    // producing a compilation.
+    class SubtreePruner {
+    public:
+        explicit SubtreePruner(std::vector<fs::path> excludes);
+
+        // Tells if the event belongs to an excluded subtree. Shall be
+        // called from a single thread only, in event order.
+        [[nodiscard]] bool drop(const rpc::Event &event);
+
+    private:
+        [[nodiscard]] bool matches(const fs::path &program) const;
+
+    private:
+        std::vector<fs::path> excludes_;
+        std::unordered_set<uint32_t> pids_;
+        std::unordered_set<uint64_t> rids_;
+    };
+
+    // Aggregates per program wall times of the supervised processes.
+    //
+    // The events carry timestamps; the profile pairs each started event
+    // with the terminating event of the same reporter and sums the wall
+    // time per executable. The report makes the slow build steps visible
+    // without post-processing the whole database.
+    class BuildProfile {
+    public:
+        // Shall be called from a single thread only, in event order.
+        void add(const rpc::Event &event);
+
+        // Writes the report: one line per executable, sorted by the total
+        // wall time, descending.
+        void write(const fs::path &file) const;
+
+    private:
+        struct Times {
+            uint64_t count = 0;
+            uint64_t total_usec = 0;
+            uint64_t min_usec = 0;
+            uint64_t max_usec = 0;
+        };
+
+        // reporter id of a running process -> (executable, start time)
+        std::unordered_map<uint64_t, std::pair<std::string, uint64_t>> running_;
+        std::map<std::string, Times> totals_;
+    };
+
     // Responsible to collect executions and persist them into an output file.
+    //
+    // The gRPC handler threads only enqueue the events; a dedicated writer
+    // thread drains the queue into the database, so reporting does not
+    // serialize the handlers on disk writes.
+    //
+    // The reporters draw their ids randomly (unique without any
+    // coordination); the writer thread remaps them to session sequential
+    // ids in arrival order before anything consumes the event. Small ids
+    // encode as one or two byte varints in the database, and a consumer
+    // pairing the started and terminating events can use a dense array
+    // instead of a hash table.
     class Reporter {
     public:
         using Ptr = std::shared_ptr<Reporter>;
@@ -37,16 +150,47 @@ namespace ic {
 
         void report(const rpc::Event &event);
 
+        // Restricts the writer thread to the given cpus. (No-op on
+        // systems without thread affinity support.)
+        void pin(const std::vector<int> &cpus);
+
+        // Number of events waiting for the writer thread.
+        [[nodiscard]] size_t queue_depth() const;
+
     public:
-        explicit Reporter(ic::collect::db::EventsDatabaseWriter::Ptr database);
+        Reporter(ic::collect::db::EventsDatabaseWriter::Ptr database,
+                 SubtreePruner pruner,
+                 std::optional<fs::path> profile,
+                 std::unordered_set<std::string> capture);
 
-        ~Reporter() noexcept = default;
+        ~Reporter() noexcept;
 
         NON_DEFAULT_CONSTRUCTABLE(Reporter);
         NON_COPYABLE_NOR_MOVABLE(Reporter);
 
+    private:
+        void drain();
+
     private:
         ic::collect::db::EventsDatabaseWriter::Ptr database_;
-        std::mutex mutex_;
+        SubtreePruner pruner_;
+        std::optional<fs::path> profile_file_;
+        BuildProfile profile_;
+        std::unordered_set<std::string> capture_;
+        // wire reporter id -> the session sequential id, owned by the
+        // writer thread. (See the class comment.)
+        std::unordered_map<uint64_t, uint64_t> rids_;
+        uint64_t next_rid_;
+        // The live process table, owned by the writer thread: the pid of
+        // every running supervised process -> its reporter id, and the
+        // reverse for the cleanup on termination. It stamps each started
+        // event with the parent's reporter id, so consumers join the
+        // process tree exactly instead of timestamp windowed pid/ppid
+        // matching (pids are reused over a long build, rids are not).
+        std::unordered_map<uint32_t, uint64_t> pid_rids_;
+        std::unordered_map<uint64_t, uint32_t> rid_pids_;
+        EventQueue queue_;
+        std::atomic<bool> stop_;
+        std::thread writer_;
     };
 }
@@ -0,0 +1,61 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "collect/RingServices.h"
+#include "collect/Reporter.h"
+
+#include <chrono>
+
+namespace ic {
+
+    rust::Result<EventRingService::Ptr> EventRingService::create(const std::string &name, Reporter &reporter) {
+        return ring::EventRing::create(name)
+                .map<EventRingService::Ptr>([&reporter](auto ring) {
+                    return std::make_shared<EventRingService>(std::move(ring), reporter);
+                });
+    }
+
+    EventRingService::EventRingService(ring::EventRing::Ptr ring, Reporter &reporter)
+            : ring_(std::move(ring))
+            , reporter_(reporter)
+            , stop_(false)
+            , thread_([this]() { serve(); })
+    { }
+
+    EventRingService::~EventRingService() noexcept {
+        stop_.store(true);
+        thread_.join();
+    }
+
+    void EventRingService::serve() noexcept {
+        rpc::Event event;
+        while (true) {
+            if (ring_->pop(event)) {
+                reporter_.report(event);
+                continue;
+            }
+            // The ring is drained before the service stops, reporters are
+            // gone when the build command finished.
+            if (stop_.load()) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+}
@@ -0,0 +1,65 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "config.h"
+#include "ring/EventRing.h"
+#include "libresult/Result.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace ic {
+
+    class Reporter;
+
+    // Consumes event reports from the shared memory ring.
+    //
+    // It owns the shared memory object and drains it with a single
+    // background thread, which forwards every event to the reporter.
+    // Reporter processes fall back to gRPC when the ring is full, so
+    // the drain can be a simple polling loop.
+    class EventRingService {
+    public:
+        using Ptr = std::shared_ptr<EventRingService>;
+
+        [[nodiscard]] static rust::Result<EventRingService::Ptr> create(const std::string &name, Reporter &reporter);
+
+        [[nodiscard]] const std::string &name() const { return ring_->name(); }
+
+    public:
+        EventRingService(ring::EventRing::Ptr ring, Reporter &reporter);
+        ~EventRingService() noexcept;
+
+        NON_DEFAULT_CONSTRUCTABLE(EventRingService);
+        NON_COPYABLE_NOR_MOVABLE(EventRingService);
+
+    private:
+        void serve() noexcept;
+
+    private:
+        ring::EventRing::Ptr ring_;
+        Reporter &reporter_;
+        std::atomic<bool> stop_;
+        std::thread thread_;
+    };
+}
@@ -20,19 +20,100 @@
 #include "collect/Reporter.h"
 #include "collect/RpcServices.h"
 #include "collect/Session.h"
+#include "collect/db/EventsDatabaseReader.h"
+
+#include <csignal>
+#include <functional>
+
+#include <fmt/format.h>
+
+namespace {
+
+    // Entries above this count are not cached. One build normally has a
+    // single environment, the limit only guards degenerate inputs.
+    constexpr size_t CACHE_LIMIT = 256;
+
+    // Credit is granted while the writer queue sits below this depth.
+    // Past it the collector is behind; the reporters are asked to spill
+    // locally instead of pushing into the congested stream.
+    constexpr size_t QUEUE_HIGH_WATER = 64 * 1024;
+
+    // Order independent hash of the executable and the environment map.
+    // (The iteration order of a protobuf map is not specified.)
+    size_t resolution_hash(const rpc::Execution &execution) {
+        const std::hash<std::string> hasher;
+        size_t result = hasher(execution.executable());
+        for (const auto &[key, value] : execution.environment()) {
+            result ^= (hasher(key) * 31u) + hasher(value);
+        }
+        return result;
+    }
+
+    // Set from the signal handler, consumed by whichever handler thread
+    // receives the next event.
+    std::atomic<bool> DUMP_REQUESTED(false);
+
+    void request_dump(int) {
+        DUMP_REQUESTED.store(true);
+    }
+
+    // The index of the power of two bucket the latency falls into.
+    size_t latency_bucket(uint64_t usec, size_t buckets) {
+        size_t result = 0;
+        while (usec > 0 && result < buckets - 1) {
+            usec >>= 1u;
+            result += 1;
+        }
+        return result;
+    }
+
+    bool environment_equals(const std::map<std::string, std::string> &lhs,
+                            const google::protobuf::Map<std::string, std::string> &rhs) {
+        if (lhs.size() != static_cast<size_t>(rhs.size())) {
+            return false;
+        }
+        for (const auto &[key, value] : rhs) {
+            const auto it = lhs.find(key);
+            if (it == lhs.end() || it->second != value) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
 
 namespace ic {
 
     SupervisorImpl::SupervisorImpl(const Session &session)
             : rpc::Supervisor::Service()
             , session_(session)
+            , mutex_()
+            , cache_()
     { }
 
     grpc::Status SupervisorImpl::Resolve(grpc::ServerContext *, const rpc::ResolveRequest *request, rpc::ResolveResponse *response) {
+        const size_t hash = resolution_hash(request->execution());
+        // The common case: the same executable with the same environment
+        // was resolved before, replay the remembered answer.
+        if (const auto cached = lookup(hash, request->execution()); cached != nullptr) {
+            auto &execution = *response->mutable_execution();
+            execution.set_executable(cached->executable);
+            execution.mutable_arguments()->CopyFrom(request->execution().arguments());
+            if (cached->executable_changed && (execution.arguments_size() > 0)) {
+                execution.set_arguments(0, cached->executable);
+            }
+            execution.set_working_dir(request->execution().working_dir());
+            auto &environment = *execution.mutable_environment();
+            for (const auto &[key, value] : cached->environment) {
+                environment[key] = value;
+            }
+            return ::grpc::Status::OK;
+        }
         return session_.resolve(from(request->execution()))
-                .map<grpc::Status>([&response](auto execution) {
+                .map<grpc::Status>([this, &hash, &request, &response](auto execution) {
                     // Need to copy the execution into the response.
                     response->mutable_execution()->CopyFrom(into(execution));
+                    remember(hash, request->execution(), response->execution());
                     // Confirm it with an OK.
                     return ::grpc::Status::OK;
                 })
@@ -41,14 +122,163 @@ namespace ic {
                 });
     }
 
+    SupervisorImpl::CachedResolutionPtr SupervisorImpl::lookup(size_t hash, const rpc::Execution &execution) const {
+        const std::lock_guard<std::mutex> guard(mutex_);
+        const auto [begin, end] = cache_.equal_range(hash);
+        for (auto it = begin; it != end; ++it) {
+            const auto &candidate = it->second;
+            if (candidate->request_executable == execution.executable()
+                    && environment_equals(candidate->request_environment, execution.environment())) {
+                return candidate;
+            }
+        }
+        return nullptr;
+    }
+
+    void SupervisorImpl::remember(size_t hash, const rpc::Execution &request, const rpc::Execution &resolved) {
+        auto entry = std::make_shared<CachedResolution>();
+        entry->request_executable = request.executable();
+        entry->request_environment.insert(request.environment().begin(), request.environment().end());
+        entry->executable = resolved.executable();
+        entry->executable_changed = (resolved.executable() != request.executable());
+        entry->environment.insert(resolved.environment().begin(), resolved.environment().end());
+
+        const std::lock_guard<std::mutex> guard(mutex_);
+        if (cache_.size() < CACHE_LIMIT) {
+            cache_.emplace(hash, std::move(entry));
+        }
+    }
+
+    CollectorMetrics::CollectorMetrics() noexcept
+            : events_(0)
+            , bytes_(0)
+            , latencies_()
+            , dumped_events_(0)
+            , dumped_at_us_(0)
+            , started_(std::chrono::steady_clock::now())
+    {
+        std::signal(SIGUSR1, request_dump);
+    }
+
+    void CollectorMetrics::count(uint64_t bytes, std::chrono::microseconds latency) noexcept {
+        count(1, bytes, latency);
+    }
+
+    void CollectorMetrics::count(uint64_t events, uint64_t bytes, std::chrono::microseconds latency) noexcept {
+        events_.fetch_add(events, std::memory_order_relaxed);
+        bytes_.fetch_add(bytes, std::memory_order_relaxed);
+        const auto usec = static_cast<uint64_t>(latency.count());
+        latencies_[latency_bucket(usec, LATENCY_BUCKETS)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void CollectorMetrics::dump_if_requested(size_t queue_depth) noexcept {
+        if (!DUMP_REQUESTED.load(std::memory_order_relaxed)) {
+            return;
+        }
+        bool expected = true;
+        if (!DUMP_REQUESTED.compare_exchange_strong(expected, false)) {
+            return;
+        }
+        const auto now_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - started_).count();
+        const auto events = events_.load();
+        const auto elapsed_us = now_us - dumped_at_us_.exchange(now_us);
+        const auto new_events = events - dumped_events_.exchange(events);
+        const auto rate = (elapsed_us > 0)
+                ? (new_events * 1000000u) / static_cast<uint64_t>(elapsed_us)
+                : 0u;
+        fmt::print(stderr, "metrics: events {} ({} events/sec), bytes {}, queue depth {}\n",
+                   events, rate, bytes_.load(), queue_depth);
+        for (size_t idx = 0; idx < LATENCY_BUCKETS; ++idx) {
+            if (const auto count = latencies_[idx].load(); count > 0) {
+                fmt::print(stderr, "metrics: handler latency < {} us: {}\n", 1u << idx, count);
+            }
+        }
+    }
+
     InterceptorImpl::InterceptorImpl(Reporter &reporter)
             : rpc::Interceptor::Service()
             , reporter_(reporter)
+            , metrics_()
     { }
 
     grpc::Status InterceptorImpl::Register(grpc::ServerContext*, const rpc::Event* request, google::protobuf::Empty*)
     {
+        BEAR_PROBE1(collector_receive, request->rid());
+        const auto start = std::chrono::steady_clock::now();
         reporter_.report(*request);
+        metrics_.count(request->ByteSizeLong(), std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start));
+        metrics_.dump_if_requested(reporter_.queue_depth());
+        return ::grpc::Status::OK;
+    }
+
+    grpc::Status InterceptorImpl::RegisterBatch(grpc::ServerContext*, const rpc::EventBatch* request, google::protobuf::Empty*)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (const auto &event : request->events()) {
+            BEAR_PROBE1(collector_receive, event.rid());
+            reporter_.report(event);
+        }
+        metrics_.count(static_cast<uint64_t>(request->events_size()), request->ByteSizeLong(),
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start));
+        metrics_.dump_if_requested(reporter_.queue_depth());
+        return ::grpc::Status::OK;
+    }
+
+    grpc::Status InterceptorImpl::RegisterStream(grpc::ServerContext*, grpc::ServerReader<rpc::Event>* reader, google::protobuf::Empty*)
+    {
+        rpc::Event event;
+        while (reader->Read(&event)) {
+            BEAR_PROBE1(collector_receive, event.rid());
+            const auto start = std::chrono::steady_clock::now();
+            reporter_.report(event);
+            metrics_.count(event.ByteSizeLong(), std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start));
+            metrics_.dump_if_requested(reporter_.queue_depth());
+        }
+        return ::grpc::Status::OK;
+    }
+
+    grpc::Status InterceptorImpl::AcquireCredit(grpc::ServerContext*, const rpc::CreditRequest* request, rpc::CreditGrant* response)
+    {
+        // The budget is a point in time verdict, not a reservation: the
+        // queue depth tells whether the writer keeps up right now.
+        const auto granted = (reporter_.queue_depth() < QUEUE_HIGH_WATER)
+                ? request->requested()
+                : 0u;
+        response->set_granted(granted);
+        return ::grpc::Status::OK;
+    }
+
+    grpc::Status InterceptorImpl::RegisterSpill(grpc::ServerContext*, const rpc::SpillLocation* request, google::protobuf::Empty*)
+    {
+        const fs::path file(request->path());
+        auto events = ic::collect::db::EventsDatabaseReader::from(file);
+        if (events.is_err()) {
+            return grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
+                    fmt::format("Failed to open spill file: {}", file.string()));
+        }
+        auto database = events.unwrap();
+        const auto start = std::chrono::steady_clock::now();
+        uint64_t count = 0;
+        uint64_t bytes = 0;
+        for (auto it = database->events_begin(); it != database->events_end(); ++it) {
+            if ((*it).is_err()) {
+                return grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
+                        fmt::format("Failed to read spill file: {}", file.string()));
+            }
+            const auto event = (*it).unwrap();
+            reporter_.report(*event);
+            count += 1;
+            bytes += event->ByteSizeLong();
+        }
+        metrics_.count(count, bytes, std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start));
+        metrics_.dump_if_requested(reporter_.queue_depth());
+        std::error_code ignored;
+        fs::remove(file, ignored);
         return ::grpc::Status::OK;
     }
 }
@@ -22,6 +22,16 @@
 #include "intercept.grpc.pb.h"
 #include "supervise.grpc.pb.h"
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
 namespace ic {
 
     class Reporter;
@@ -37,8 +47,64 @@ namespace ic {
         NON_DEFAULT_CONSTRUCTABLE(SupervisorImpl);
         NON_COPYABLE_NOR_MOVABLE(SupervisorImpl);
 
+    private:
+        // A remembered resolution. The session resolves the executable and
+        // rewrites the environment; both depend only on the incoming
+        // executable and environment, which are identical for almost every
+        // call of a build. (The arguments are echoed back per request.)
+        struct CachedResolution {
+            std::string request_executable;
+            std::map<std::string, std::string> request_environment;
+            std::string executable;
+            bool executable_changed;
+            std::map<std::string, std::string> environment;
+        };
+        using CachedResolutionPtr = std::shared_ptr<const CachedResolution>;
+
+        [[nodiscard]] CachedResolutionPtr lookup(size_t hash, const rpc::Execution &execution) const;
+        void remember(size_t hash, const rpc::Execution &request, const rpc::Execution &resolved);
+
     private:
         const Session &session_;
+        mutable std::mutex mutex_;
+        std::unordered_multimap<size_t, CachedResolutionPtr> cache_;
+    };
+
+    // Collector side throughput counters.
+    //
+    // The gRPC handler threads bump the counters for every received event.
+    // On SIGUSR1 the totals - the event and byte counts, the receive rate
+    // since the previous dump, the queue depth and a handler latency
+    // histogram - are written to the standard error. This tells whether
+    // the collector keeps up with a large build, without attaching a
+    // profiler to the box.
+    class CollectorMetrics {
+    public:
+        CollectorMetrics() noexcept;
+
+        void count(uint64_t bytes, std::chrono::microseconds latency) noexcept;
+        // For batched registration: many events arrive in one call, but
+        // the handler latency is still a single measurement.
+        void count(uint64_t events, uint64_t bytes, std::chrono::microseconds latency) noexcept;
+
+        // Writes the counters when a dump was requested (by SIGUSR1) since
+        // the last call. The dump happens on the handler thread which
+        // receives the next event after the signal.
+        void dump_if_requested(size_t queue_depth) noexcept;
+
+        NON_COPYABLE_NOR_MOVABLE(CollectorMetrics);
+
+    private:
+        // The handler latencies are binned by powers of two, in
+        // microseconds; the last bucket holds everything above.
+        static constexpr size_t LATENCY_BUCKETS = 16;
+
+        std::atomic<uint64_t> events_;
+        std::atomic<uint64_t> bytes_;
+        std::atomic<uint64_t> latencies_[LATENCY_BUCKETS];
+        std::atomic<uint64_t> dumped_events_;
+        std::atomic<int64_t> dumped_at_us_;
+        std::chrono::steady_clock::time_point started_;
     };
 
     class InterceptorImpl final : public rpc::Interceptor::Service {
@@ -47,11 +113,16 @@ namespace ic {
         ~InterceptorImpl() override = default;
 
         ::grpc::Status Register(::grpc::ServerContext* context, const rpc::Event* request, google::protobuf::Empty* response) override;
+        ::grpc::Status RegisterStream(::grpc::ServerContext* context, ::grpc::ServerReader<rpc::Event>* reader, google::protobuf::Empty* response) override;
+        ::grpc::Status RegisterBatch(::grpc::ServerContext* context, const rpc::EventBatch* request, google::protobuf::Empty* response) override;
+        ::grpc::Status AcquireCredit(::grpc::ServerContext* context, const rpc::CreditRequest* request, rpc::CreditGrant* response) override;
+        ::grpc::Status RegisterSpill(::grpc::ServerContext* context, const rpc::SpillLocation* request, google::protobuf::Empty* response) override;
 
         NON_DEFAULT_CONSTRUCTABLE(InterceptorImpl);
         NON_COPYABLE_NOR_MOVABLE(InterceptorImpl);
 
     private:
         Reporter& reporter_;
+        CollectorMetrics metrics_;
     };
 }
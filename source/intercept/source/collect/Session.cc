@@ -23,6 +23,7 @@
 #include "collect/SessionWrapper.h"
 #ifdef SUPPORT_PRELOAD
 #include "collect/SessionLibrary.h"
+#include "collect/SessionProbe.h"
 #endif
 
 #include "libsys/Path.h"
@@ -40,7 +41,17 @@ namespace ic {
         if (args.as_bool(cmd::intercept::FLAG_FORCE_PRELOAD).unwrap_or(false))
             return LibraryPreloadSession::from(args);
 
-        return LibraryPreloadSession::from(args);
+        // Without a force flag the probe picks: the preload session when
+        // it is expected to cover the build, the wrapper session
+        // otherwise. (The verdict is cached, see `SessionProbe`.)
+        const bool preload = args.as_string(cmd::intercept::FLAG_LIBRARY)
+                .map<bool>([&envp](const auto &library) {
+                    return SessionProbe::preload_viable(fs::path(std::string(library)), envp);
+                })
+                .unwrap_or(true);
+        return preload
+                ? LibraryPreloadSession::from(args)
+                : WrapperSession::from(args, envp);
     }
 #else
     {
@@ -78,9 +89,25 @@ namespace ic {
         return sys::path::join(result);
     }
 
+    void Session::set_report_socket(const SessionLocator &report_socket) {
+        report_socket_ = std::make_unique<SessionLocator>(report_socket);
+    }
+
+    void Session::set_event_ring(const std::string &event_ring) {
+        event_ring_ = std::make_unique<std::string>(event_ring);
+    }
+
+    void Session::set_grpc_compression() {
+        grpc_compression_ = true;
+    }
+
     rust::Result<int> Session::run(const ic::Execution &execution, const SessionLocator &session_locator) {
         session_locator_ = std::make_unique<SessionLocator>(session_locator);
         return supervise(execution)
+                // the build command leads its own process group: a
+                // cancellation tears down the whole build tree with one
+                // group targeted signal.
+                .set_process_group()
                 .spawn()
                 .and_then<sys::ExitStatus>([](auto child) {
                     sys::SignalForwarder guard(child);
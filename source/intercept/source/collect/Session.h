@@ -47,13 +47,33 @@ namespace ic {
         [[nodiscard]] virtual rust::Result<ic::Execution> resolve(const ic::Execution &execution) const = 0;
         [[nodiscard]] virtual sys::Process::Builder supervise(const ic::Execution &execution) const = 0;
 
+        // Tells if the session wants the direct event report socket.
+        [[nodiscard]] virtual bool wants_report_socket() const { return false; }
+
+        // Tells if the session wants the shared memory event ring.
+        [[nodiscard]] virtual bool wants_event_ring() const { return false; }
+
+        // Tells the session where the shared memory event ring is.
+        void set_event_ring(const std::string &event_ring);
+
         [[nodiscard]] rust::Result<int> run(const ic::Execution &execution, const SessionLocator &session_locator);
 
+        // Tells the session where the direct event report socket is listening.
+        void set_report_socket(const SessionLocator &report_socket);
+
+        // Tells the session that the reporting processes shall compress
+        // their gRPC payloads. (Only worth it when the collector is
+        // reached over a network link.)
+        void set_grpc_compression();
+
     protected:
         static std::string keep_front_in_path(const std::string& path, const std::string& paths);
         static std::string remove_from_path(const std::string& path, const std::string& paths);
 
     protected:
         std::unique_ptr<SessionLocator> session_locator_;
+        std::unique_ptr<SessionLocator> report_socket_;
+        std::unique_ptr<std::string> event_ring_;
+        bool grpc_compression_ = false;
     };
 }
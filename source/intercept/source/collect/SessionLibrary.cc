@@ -24,14 +24,81 @@
 #include "libsys/Path.h"
 #include "libsys/Process.h"
 
+#include <fmt/format.h>
 #include <spdlog/spdlog.h>
 
 #include <functional>
 
+#ifdef HAVE_MEMFD_CREATE
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 namespace {
 
     constexpr char GLIBC_PRELOAD_KEY[] = "LD_PRELOAD";
 
+    // Picks the reporter executable the preload library shall name. In
+    // direct report mode the reporter only backs up a failed socket
+    // send, which the minimal reporter handles without the loader
+    // relocating the wrapper's dependency graph. The wrapper stays for
+    // the verbose runs, and when the minimal binary is not installed.
+    std::string pick_executor(const std::string_view &wrapper, bool direct, bool verbose)
+    {
+        if (direct && !verbose) {
+            std::error_code error_code;
+            if (const auto mini = fs::path(wrapper).parent_path() / "er"; fs::exists(mini, error_code)) {
+                return mini.string();
+            }
+        }
+        return std::string(wrapper);
+    }
+
+#ifdef HAVE_MEMFD_CREATE
+    // Stages the preload library into an anonymous in-memory file, and
+    // returns the /proc path naming it. When the install sits on a
+    // network filesystem, every intercepted process's loader would
+    // otherwise fetch the library over the network; the staged copy is
+    // served from memory instead. The descriptor is deliberately kept
+    // open: the path stays valid while the intercept process runs, which
+    // covers the whole build. Any failure falls back to the install path.
+    std::string stage_library(const std::string &library)
+    {
+        const int source = ::open(library.c_str(), O_RDONLY | O_CLOEXEC);
+        if (source == -1) {
+            return library;
+        }
+        const int staged = ::memfd_create("bear-libexec", MFD_CLOEXEC);
+        if (staged == -1) {
+            ::close(source);
+            return library;
+        }
+        char buffer[65536];
+        for (;;) {
+            const ssize_t count = ::read(source, buffer, sizeof(buffer));
+            if (count == 0) {
+                break;
+            }
+            if (count == -1 || ::write(staged, buffer, count) != count) {
+                spdlog::debug("Staging the preload library failed: {}", sys::error_string(errno));
+                ::close(source);
+                ::close(staged);
+                return library;
+            }
+        }
+        ::close(source);
+        // the children resolve the path through this process' proc entry,
+        // the descriptor itself is not inherited.
+        return fmt::format("/proc/{}/fd/{}", ::getpid(), staged);
+    }
+#else
+    std::string stage_library(const std::string &library)
+    {
+        return library;
+    }
+#endif
+
     using env_t = std::map<std::string, std::string>;
     using mapper_t = std::function<std::string(const std::string&, const std::string&)>;
 
@@ -54,22 +121,41 @@ namespace ic {
     rust::Result<Session::Ptr> LibraryPreloadSession::from(const flags::Arguments& args)
     {
         auto verbose = args.as_bool(flags::VERBOSE).unwrap_or(false);
+        auto direct = args.as_bool(cmd::intercept::FLAG_DIRECT_REPORT).unwrap_or(false);
+        auto ring = args.as_bool(cmd::intercept::FLAG_RING_TRANSPORT).unwrap_or(false);
+        auto capture_env = args.as_string(cmd::intercept::FLAG_CAPTURE_ENV)
+                .map<std::string>([](auto value) { return std::string(value); })
+                .unwrap_or(std::string());
+        auto only = args.as_string(cmd::intercept::FLAG_ONLY)
+                .map<std::string>([](auto value) { return std::string(value); })
+                .unwrap_or(std::string());
         auto library = args.as_string(cmd::intercept::FLAG_LIBRARY);
         auto wrapper = args.as_string(cmd::intercept::FLAG_WRAPPER);
 
         return merge(library, wrapper)
-            .map<Session::Ptr>([&verbose](auto tuple) {
+            .map<Session::Ptr>([&verbose, &direct, &ring, &capture_env, &only](auto tuple) {
                 const auto& [library, wrapper] = tuple;
-                return std::make_shared<LibraryPreloadSession>(verbose, library, wrapper);
+                // the in-memory copy is advertised instead of the install path.
+                const auto staged = stage_library(std::string(library));
+                return std::make_shared<LibraryPreloadSession>(verbose, direct, ring, capture_env, only, staged,
+                                                               pick_executor(wrapper, direct, verbose));
             });
     }
 
     LibraryPreloadSession::LibraryPreloadSession(
         bool verbose,
+        bool direct,
+        bool ring,
+        std::string capture_env,
+        std::string only,
         const std::string_view &library,
         const std::string_view &executor)
             : Session()
             , verbose_(verbose)
+            , direct_(direct)
+            , ring_(ring)
+            , capture_env_(std::move(capture_env))
+            , only_(std::move(only))
             , library_(library)
             , executor_(executor)
     {
@@ -78,12 +164,12 @@ namespace ic {
 
     rust::Result<ic::Execution> LibraryPreloadSession::resolve(const ic::Execution &execution) const
     {
-        spdlog::debug("trying to resolve for library: {}", execution.executable.string());
+        SPDLOG_DEBUG("trying to resolve for library: {}", execution.executable.string());
         return rust::Ok(ic::Execution{
                 execution.executable,
                 execution.arguments,
                 execution.working_dir,
-                update(execution.environment)
+                update(execution.environment.to_map())
         });
     }
 
@@ -103,7 +189,7 @@ namespace ic {
                 .add_argument(execution.executable)
                 .add_argument(cmd::wrapper::FLAG_COMMAND)
                 .add_arguments(execution.arguments.begin(), execution.arguments.end())
-                .set_environment(update(execution.environment));
+                .set_environment(update(execution.environment.to_map()));
     }
 
     std::map<std::string, std::string>
@@ -115,6 +201,21 @@ namespace ic {
         }
         copy[cmd::library::KEY_DESTINATION] = *session_locator_;
         copy[cmd::library::KEY_REPORTER] = executor_;
+        if (direct_ && report_socket_) {
+            copy[cmd::library::KEY_DIRECT] = *report_socket_;
+        }
+        if (event_ring_) {
+            copy[cmd::wrapper::KEY_RING] = *event_ring_;
+        }
+        if (!capture_env_.empty()) {
+            copy[cmd::wrapper::KEY_CAPTURE_ENV] = capture_env_;
+        }
+        if (!only_.empty()) {
+            copy[cmd::library::KEY_ONLY] = only_;
+        }
+        if (grpc_compression_) {
+            copy[cmd::wrapper::KEY_COMPRESSION] = "true";
+        }
         insert_or_merge(copy, GLIBC_PRELOAD_KEY, library_, Session::keep_front_in_path);
 
         return copy;
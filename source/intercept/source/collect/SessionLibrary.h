@@ -25,12 +25,14 @@ namespace ic {
 
     class LibraryPreloadSession : public ic::Session {
     public:
-        LibraryPreloadSession(bool verbose, const std::string_view &library, const std::string_view &executor);
+        LibraryPreloadSession(bool verbose, bool direct, bool ring, std::string capture_env, std::string only, const std::string_view &library, const std::string_view &executor);
 
         static rust::Result<Session::Ptr> from(const flags::Arguments&);
 
         [[nodiscard]] rust::Result<ic::Execution> resolve(const ic::Execution &execution) const override;
         [[nodiscard]] sys::Process::Builder supervise(const ic::Execution &execution) const override;
+        [[nodiscard]] bool wants_report_socket() const override { return direct_; }
+        [[nodiscard]] bool wants_event_ring() const override { return ring_; }
 
         NON_DEFAULT_CONSTRUCTABLE(LibraryPreloadSession);
         NON_COPYABLE_NOR_MOVABLE(LibraryPreloadSession);
@@ -40,6 +42,10 @@ namespace ic {
 
     private:
         bool verbose_;
+        bool direct_;
+        bool ring_;
+        std::string capture_env_;
+        std::string only_;
         std::string library_;
         std::string executor_;
     };
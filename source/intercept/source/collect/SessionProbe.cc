@@ -0,0 +1,246 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "collect/SessionProbe.h"
+#include "report/libexec/Resolver.h"
+#include "report/libexec/Environment.h"
+
+#include <spdlog/spdlog.h>
+#include <fmt/format.h>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <string>
+
+#include <unistd.h>
+
+namespace {
+
+    // The relevant pieces of an ELF file header.
+    //
+    // Only what the viability verdict needs: whether the file would load
+    // into our own processes (class, data encoding and machine match the
+    // running binary), and whether the program headers name an
+    // interpreter. A binary without PT_INTERP is statically linked, the
+    // dynamic loader (and with it the preload) never runs for it.
+    struct ElfShape {
+        uint8_t klass;
+        uint8_t data;
+        uint16_t type;
+        uint16_t machine;
+        bool has_interp;
+    };
+
+    constexpr uint16_t ET_DYN_ = 3;
+    constexpr uint32_t PT_INTERP_ = 3;
+
+    std::optional<ElfShape> read_elf_shape(const fs::path &file)
+    {
+        std::ifstream input(file, std::ios::binary);
+        if (!input.is_open()) {
+            return std::nullopt;
+        }
+        uint8_t header[64];
+        if (!input.read(reinterpret_cast<char *>(header), sizeof(header))) {
+            return std::nullopt;
+        }
+        if (std::memcmp(header, "\177ELF", 4) != 0) {
+            return std::nullopt;
+        }
+        ElfShape result = {};
+        result.klass = header[4];
+        result.data = header[5];
+        std::memcpy(&result.type, header + 16, sizeof(result.type));
+        std::memcpy(&result.machine, header + 18, sizeof(result.machine));
+        // Scan the program headers for PT_INTERP. (Only the 64 bit layout
+        // is parsed; a different class fails the shape comparison anyway.)
+        if (result.klass == 2) {
+            uint64_t ph_offset = 0;
+            uint16_t ph_size = 0;
+            uint16_t ph_count = 0;
+            std::memcpy(&ph_offset, header + 32, sizeof(ph_offset));
+            std::memcpy(&ph_size, header + 54, sizeof(ph_size));
+            std::memcpy(&ph_count, header + 56, sizeof(ph_count));
+            for (uint16_t idx = 0; idx < ph_count && idx < 64; ++idx) {
+                uint32_t p_type = 0;
+                input.seekg(ph_offset + uint64_t(idx) * ph_size);
+                if (!input.read(reinterpret_cast<char *>(&p_type), sizeof(p_type))) {
+                    break;
+                }
+                if (p_type == PT_INTERP_) {
+                    result.has_interp = true;
+                    break;
+                }
+            }
+        }
+        return std::make_optional(result);
+    }
+
+    // Tells if the file would load into the same processes as we do.
+    bool loadable_with(const ElfShape &own, const ElfShape &candidate)
+    {
+        return own.klass == candidate.klass
+            && own.data == candidate.data
+            && own.machine == candidate.machine;
+    }
+
+    // The compiler names worth probing. The build may call others too,
+    // but a project whose default compilers are static binaries is very
+    // likely built entirely with static tools.
+    constexpr const char *COMPILERS[] = {
+        "cc", "c++", "gcc", "g++", "clang", "clang++"
+    };
+
+    // Verdict cache, alongside the wrapper name mapping cache.
+    //
+    // Keyed on the library file (with its modification time) and the PATH
+    // value: replacing the library or installing a compiler re-probes.
+    // Any problem with the cache falls back to a fresh probe silently.
+    constexpr char PROBE_CACHE_VERSION[] = "bear session probe 1";
+
+    std::optional<fs::path> probe_cache_file(const char **envp, const std::string &key)
+    {
+        fs::path directory;
+        if (auto value = el::env::get_env_value(envp, "XDG_CACHE_HOME"); value != nullptr) {
+            directory = fs::path(value) / "bear";
+        } else if (auto value = el::env::get_env_value(envp, "HOME"); value != nullptr) {
+            directory = fs::path(value) / ".cache" / "bear";
+        } else {
+            return std::nullopt;
+        }
+        const auto name = fmt::format("session-{:016x}", std::hash<std::string>{}(key));
+        return std::make_optional(directory / name);
+    }
+
+    std::string probe_cache_key(const fs::path &library, const char **envp)
+    {
+        std::error_code error_code;
+        const auto mtime = fs::last_write_time(library, error_code);
+        const auto ticks = error_code ? 0 : mtime.time_since_epoch().count();
+        const auto search_path = el::env::get_env_value(envp, "PATH");
+        return fmt::format("{}|{}|{}", library.string(), ticks, (search_path != nullptr) ? search_path : "");
+    }
+
+    std::optional<bool> load_verdict(const fs::path &file, const std::string &key)
+    {
+        std::ifstream input(file);
+        if (!input.is_open()) {
+            return std::nullopt;
+        }
+        std::string line;
+        if (!std::getline(input, line) || line != PROBE_CACHE_VERSION) {
+            return std::nullopt;
+        }
+        if (!std::getline(input, line) || line != key) {
+            return std::nullopt;
+        }
+        if (!std::getline(input, line)) {
+            return std::nullopt;
+        }
+        if (line == "preload") {
+            return std::make_optional(true);
+        }
+        if (line == "wrapper") {
+            return std::make_optional(false);
+        }
+        return std::nullopt;
+    }
+
+    void store_verdict(const fs::path &file, const std::string &key, bool preload)
+    {
+        std::error_code error_code;
+        fs::create_directories(file.parent_path(), error_code);
+        if (error_code) {
+            return;
+        }
+        // write a temporary file and rename it, concurrent runs may race.
+        auto temporary = file;
+        temporary += fmt::format(".{}", getpid());
+        {
+            std::ofstream output(temporary);
+            if (!output.is_open()) {
+                return;
+            }
+            output << PROBE_CACHE_VERSION << std::endl;
+            output << key << std::endl;
+            output << (preload ? "preload" : "wrapper") << std::endl;
+            if (!output.good()) {
+                fs::remove(temporary, error_code);
+                return;
+            }
+        }
+        fs::rename(temporary, file, error_code);
+        if (error_code) {
+            fs::remove(temporary, error_code);
+        }
+    }
+
+    bool probe(const fs::path &library, const char **envp)
+    {
+        // The running binary defines what the loader of this system
+        // accepts; an unreadable self image leaves the probe undecided.
+        const auto own = read_elf_shape("/proc/self/exe");
+        if (!own) {
+            return true;
+        }
+        // The library has to be a shared object the loader takes.
+        const auto shape = read_elf_shape(library);
+        if (!shape || shape.value().type != ET_DYN_ || !loadable_with(own.value(), shape.value())) {
+            spdlog::debug("session probe: the library is not loadable: {}", library.string());
+            return false;
+        }
+        // A statically linked compiler escapes the preload entirely.
+        el::Resolver resolver;
+        for (const auto *name : COMPILERS) {
+            auto candidate = resolver.from_path(name, envp);
+            if (candidate.is_err()) {
+                continue;
+            }
+            const auto compiler = read_elf_shape(fs::path(candidate.unwrap()));
+            if (compiler && !compiler.value().has_interp) {
+                spdlog::debug("session probe: statically linked compiler: {}", candidate.unwrap());
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+namespace ic {
+
+    bool SessionProbe::preload_viable(const fs::path &library, const char **envp)
+    {
+        const auto key = probe_cache_key(library, envp);
+        const auto cache_file = probe_cache_file(envp, key);
+        if (cache_file) {
+            if (const auto cached = load_verdict(cache_file.value(), key); cached) {
+                spdlog::debug("session probe verdict loaded from cache: {}", cache_file.value().string());
+                return cached.value();
+            }
+        }
+        const bool verdict = probe(library, envp);
+        if (cache_file) {
+            store_verdict(cache_file.value(), key, verdict);
+        }
+        return verdict;
+    }
+}
@@ -0,0 +1,51 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace ic {
+
+    // Decides if the library preload session can cover the build.
+    //
+    // The preload session is the faster choice (no wrapper process per
+    // compiler call), but it silently loses coverage when the dynamic
+    // loader can not inject the library: the library file is missing or
+    // built for another architecture, or the compilers themselves are
+    // statically linked binaries, for which the loader never runs. Today
+    // the choice between the sessions is manual (the force flags), and
+    // the cautious default costs either speed or coverage.
+    //
+    // The probe reads the ELF headers of the library and of the compilers
+    // found on PATH, and caches the verdict in the user's cache directory
+    // (keyed on the library and the PATH, like the wrapper name mapping);
+    // subsequent runs of the same project read the cached verdict instead
+    // of re-probing.
+    struct SessionProbe {
+
+        // Returns true when the preload session is expected to observe
+        // the compiler executions. An undecidable probe (unreadable
+        // files, no cache directory) answers true, which keeps the
+        // historic preload default.
+        [[nodiscard]] static bool preload_viable(const fs::path &library, const char **envp);
+    };
+}
@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "collect/SessionWrapper.h"
+#include "ResolveHints.h"
 #include "report/libexec/Resolver.h"
 #include "report/libexec/Environment.h"
 #include "libsys/Errors.h"
@@ -27,11 +28,17 @@
 
 #include <spdlog/spdlog.h>
 #include <spdlog/fmt/ostr.h>
+#include <fmt/format.h>
 
 #include <algorithm>
+#include <fstream>
+#include <functional>
 #include <iterator>
+#include <optional>
 #include <utility>
 
+#include <unistd.h>
+
 namespace {
 
     struct Rule {
@@ -102,6 +109,107 @@ namespace {
         }
         return rust::Ok(result);
     }
+
+    // Persistent cache of the wrapper name resolutions.
+    //
+    // Resolving every wrapper name against PATH costs a directory walk per
+    // name on every single run, which adds up for frequent small
+    // invocations. The resolved mapping is stored in the user's cache
+    // directory, keyed on the wrapper directory (with its modification
+    // time) and the PATH value; the cached executables are re-checked for
+    // existence before use. Any problem with the cache falls back to a
+    // fresh resolution silently.
+    constexpr char MAPPING_CACHE_VERSION[] = "bear wrapper mapping 1";
+
+    std::optional<fs::path> mapping_cache_directory(const char **envp)
+    {
+        if (auto value = el::env::get_env_value(envp, "XDG_CACHE_HOME"); value != nullptr) {
+            return std::make_optional(fs::path(value) / "bear");
+        }
+        if (auto value = el::env::get_env_value(envp, "HOME"); value != nullptr) {
+            return std::make_optional(fs::path(value) / ".cache" / "bear");
+        }
+        return std::nullopt;
+    }
+
+    std::string mapping_cache_key(const fs::path& wrapper_dir, const char* search_path)
+    {
+        std::error_code error_code;
+        const auto mtime = fs::last_write_time(wrapper_dir, error_code);
+        const auto ticks = error_code ? 0 : mtime.time_since_epoch().count();
+        return fmt::format("{}|{}|{}", wrapper_dir.string(), ticks, (search_path != nullptr) ? search_path : "");
+    }
+
+    std::optional<fs::path> mapping_cache_file(const char **envp, const std::string& key)
+    {
+        const auto directory = mapping_cache_directory(envp);
+        if (!directory) {
+            return std::nullopt;
+        }
+        const auto name = fmt::format("wrappers-{:016x}", std::hash<std::string>{}(key));
+        return std::make_optional(directory.value() / name);
+    }
+
+    std::optional<std::map<std::string, fs::path>> load_mapping(const fs::path& file, const std::string& key)
+    {
+        std::ifstream input(file);
+        if (!input.is_open()) {
+            return std::nullopt;
+        }
+        std::string line;
+        if (!std::getline(input, line) || line != MAPPING_CACHE_VERSION) {
+            return std::nullopt;
+        }
+        if (!std::getline(input, line) || line != key) {
+            return std::nullopt;
+        }
+        std::map<std::string, fs::path> result;
+        while (std::getline(input, line)) {
+            const auto tab = line.find('\t');
+            if (tab == std::string::npos) {
+                return std::nullopt;
+            }
+            auto executable = fs::path(line.substr(tab + 1));
+            // a removed executable invalidates the whole cache entry.
+            std::error_code error_code;
+            if (!fs::exists(executable, error_code)) {
+                return std::nullopt;
+            }
+            result.emplace(line.substr(0, tab), std::move(executable));
+        }
+        return std::make_optional(std::move(result));
+    }
+
+    void store_mapping(const fs::path& file, const std::string& key, const std::map<std::string, fs::path>& mapping)
+    {
+        std::error_code error_code;
+        fs::create_directories(file.parent_path(), error_code);
+        if (error_code) {
+            return;
+        }
+        // write a temporary file and rename it, concurrent runs may race.
+        auto temporary = file;
+        temporary += fmt::format(".{}", getpid());
+        {
+            std::ofstream output(temporary);
+            if (!output.is_open()) {
+                return;
+            }
+            output << MAPPING_CACHE_VERSION << std::endl;
+            output << key << std::endl;
+            for (const auto& [name, executable] : mapping) {
+                output << name << '\t' << executable.string() << std::endl;
+            }
+            if (!output.good()) {
+                fs::remove(temporary, error_code);
+                return;
+            }
+        }
+        fs::rename(temporary, file, error_code);
+        if (error_code) {
+            fs::remove(temporary, error_code);
+        }
+    }
 }
 
 namespace ic {
@@ -109,11 +217,27 @@ namespace ic {
     rust::Result<Session::Ptr> WrapperSession::from(const flags::Arguments &args, const char **envp)
     {
         const bool verbose = args.as_bool(flags::VERBOSE).unwrap_or(false);
+        const bool ring = args.as_bool(cmd::intercept::FLAG_RING_TRANSPORT).unwrap_or(false);
+        const bool resource_usage = args.as_bool(cmd::intercept::FLAG_RESOURCE_USAGE).unwrap_or(false);
+        auto capture_env = args.as_string(cmd::intercept::FLAG_CAPTURE_ENV)
+                .map<std::string>([](auto value) { return std::string(value); })
+                .unwrap_or(std::string());
         auto wrapper_dir = args.as_string(cmd::intercept::FLAG_WRAPPER_DIR);
         auto wrappers = wrapper_dir.and_then<std::list<fs::path>>(list_dir);
 
-        auto mapping = wrappers
-            .map<std::map<std::string, fs::path>>([&envp](auto wrappers) {
+        auto mapping = rust::merge(wrapper_dir, wrappers)
+            .map<std::map<std::string, fs::path>>([&envp](auto tuple) {
+                const auto& [wrapper_dir, wrappers] = tuple;
+                // Reuse the resolution results from a previous run if the
+                // wrapper directory and the PATH are unchanged.
+                const auto key = mapping_cache_key(fs::path(std::string(wrapper_dir)), el::env::get_env_value(envp, "PATH"));
+                const auto cache_file = mapping_cache_file(envp, key);
+                if (cache_file) {
+                    if (auto cached = load_mapping(cache_file.value(), key); cached) {
+                        spdlog::debug("wrapper mapping loaded from cache: {}", cache_file.value().string());
+                        return cached.value();
+                    }
+                }
                 // Find the executables with the same name from the path.
                 std::map<std::string, fs::path> result;
                 el::Resolver resolver;
@@ -124,11 +248,14 @@ namespace ic {
                         result[basename] = fs::path(candidate);
                     });
                 }
+                if (cache_file) {
+                    store_mapping(cache_file.value(), key, result);
+                }
                 return result;
             });
 
         return rust::merge(wrapper_dir, mapping)
-            .map<Session::Ptr>([&envp, &verbose](const auto &tuple) {
+            .map<Session::Ptr>([&envp, &verbose, &ring, &resource_usage, &capture_env](const auto &tuple) {
                 const auto& [wrapper_dir, const_mapping] = tuple;
 
                 std::map<std::string, fs::path> mapping(const_mapping);
@@ -155,17 +282,23 @@ namespace ic {
                                 });
                     }
                 }
-                return std::make_shared<WrapperSession>(verbose, std::string(wrapper_dir), std::move(mapping), std::move(override));
+                return std::make_shared<WrapperSession>(verbose, ring, resource_usage, capture_env, std::string(wrapper_dir), std::move(mapping), std::move(override));
             });
     }
 
     WrapperSession::WrapperSession(
         bool verbose,
+        bool ring,
+        bool resource_usage,
+        std::string capture_env,
         std::string wrapper_dir,
         std::map<std::string, fs::path> mapping,
         std::map<std::string, fs::path> override)
             : Session()
             , verbose_(verbose)
+            , ring_(ring)
+            , resource_usage_(resource_usage)
+            , capture_env_(std::move(capture_env))
             , wrapper_dir_(std::move(wrapper_dir))
             , mapping_(std::move(mapping))
             , override_(std::move(override))
@@ -173,11 +306,53 @@ namespace ic {
         spdlog::debug("session initialized with: wrapper_dir: {}", wrapper_dir_);
         spdlog::debug("session initialized with: mapping: {}", MapHolder { mapping_ });
         spdlog::debug("session initialized with: override: {}", MapHolder { override_ });
+
+        // Publish the resolution table for the wrappers. A wrapper which
+        // finds the table answers the resolution locally and spares the
+        // `Resolve` round trip; without it the wrapper falls back to the
+        // RPC, so a failure here costs only performance.
+        std::error_code error_code;
+        const auto temp_dir = fs::temp_directory_path(error_code);
+        if (!error_code) {
+            domain::ResolveHints hints {
+                    fs::path(wrapper_dir_),
+                    mapping_,
+                    {
+                            cmd::wrapper::KEY_VERBOSE,
+                            cmd::wrapper::KEY_DESTINATION,
+                            cmd::wrapper::KEY_CAPTURE_ENV,
+                            cmd::wrapper::KEY_RING,
+                            cmd::wrapper::KEY_HINTS,
+                            cmd::wrapper::KEY_COMPRESSION,
+                            cmd::wrapper::KEY_RESOURCE_USAGE,
+                    }
+            };
+            for (const auto& override : override_) {
+                hints.erase.push_back(override.first);
+            }
+            auto hints_file = temp_dir / ("intercept-" + std::to_string(getpid()) + ".hints");
+            domain::ResolveHints::write(hints_file, hints)
+                    .on_success([this, &hints_file](auto) {
+                        spdlog::debug("resolve hints published: {}", hints_file.string());
+                        hints_file_ = hints_file;
+                    })
+                    .on_error([](const auto& error) {
+                        spdlog::debug("failed to publish resolve hints: {}", error.what());
+                    });
+        }
+    }
+
+    WrapperSession::~WrapperSession()
+    {
+        if (!hints_file_.empty()) {
+            std::error_code error_code;
+            fs::remove(hints_file_, error_code);
+        }
     }
 
     rust::Result<ic::Execution> WrapperSession::resolve(const ic::Execution &execution) const
     {
-        spdlog::debug("trying to resolve for wrapper: {}", execution.executable.string());
+        SPDLOG_DEBUG("trying to resolve for wrapper: {}", execution.executable.string());
         return resolve(execution.executable)
                 .map<ic::Execution>([this, &execution](auto executable) {
                     auto arguments = execution.arguments;
@@ -186,7 +361,7 @@ namespace ic {
                             fs::path(executable),
                             std::move(arguments),
                             fs::path(execution.working_dir),
-                            update(execution.environment)
+                            update(execution.environment.to_map())
                     };
                 });
     }
@@ -195,7 +370,7 @@ namespace ic {
     {
         auto result = sys::Process::Builder(execution.executable)
                 .add_arguments(execution.arguments.begin(), execution.arguments.end())
-                .set_environment(set_up(execution.environment));
+                .set_environment(set_up(execution.environment.to_map()));
 
         return result;
     }
@@ -225,6 +400,26 @@ namespace ic {
         if (auto it = copy.find(cmd::wrapper::KEY_DESTINATION); it != copy.end()) {
             copy.erase(it);
         }
+        // remove capture list
+        if (auto it = copy.find(cmd::wrapper::KEY_CAPTURE_ENV); it != copy.end()) {
+            copy.erase(it);
+        }
+        // remove event ring
+        if (auto it = copy.find(cmd::wrapper::KEY_RING); it != copy.end()) {
+            copy.erase(it);
+        }
+        // remove resolve hints
+        if (auto it = copy.find(cmd::wrapper::KEY_HINTS); it != copy.end()) {
+            copy.erase(it);
+        }
+        // remove compression request
+        if (auto it = copy.find(cmd::wrapper::KEY_COMPRESSION); it != copy.end()) {
+            copy.erase(it);
+        }
+        // remove resource usage request
+        if (auto it = copy.find(cmd::wrapper::KEY_RESOURCE_USAGE); it != copy.end()) {
+            copy.erase(it);
+        }
         // remove all implicits
         for (const auto& override : override_) {
             if (auto it = copy.find(override.first); it != copy.end()) {
@@ -243,6 +438,26 @@ namespace ic {
         }
         // sets the server address to wrappers
         environment[cmd::wrapper::KEY_DESTINATION] = *session_locator_;
+        // sets the event ring name to wrappers
+        if (event_ring_) {
+            environment[cmd::wrapper::KEY_RING] = *event_ring_;
+        }
+        // tells the wrappers which environment variables to capture
+        if (!capture_env_.empty()) {
+            environment[cmd::wrapper::KEY_CAPTURE_ENV] = capture_env_;
+        }
+        // asks the wrappers to capture the resource usage of the children
+        if (resource_usage_) {
+            environment[cmd::wrapper::KEY_RESOURCE_USAGE] = "true";
+        }
+        // sets the resolve hints file to wrappers
+        if (!hints_file_.empty()) {
+            environment[cmd::wrapper::KEY_HINTS] = hints_file_.string();
+        }
+        // asks the wrappers to compress their gRPC payloads
+        if (grpc_compression_) {
+            environment[cmd::wrapper::KEY_COMPRESSION] = "true";
+        }
         // change PATH to put the wrapper directory at the front.
         if (auto it = environment.find("PATH"); it != environment.end()) {
             it->second = keep_front_in_path(wrapper_dir_, it->second);
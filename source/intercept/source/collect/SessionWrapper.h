@@ -27,14 +27,20 @@ namespace ic {
     public:
         WrapperSession(
             bool verbose,
+            bool ring,
+            bool resource_usage,
+            std::string capture_env,
             std::string wrapper_dir,
             std::map<std::string, fs::path> mapping,
             std::map<std::string, fs::path> override);
 
+        ~WrapperSession() override;
+
         static rust::Result<Session::Ptr> from(const flags::Arguments &args, const char **envp);
 
         [[nodiscard]] rust::Result<ic::Execution> resolve(const ic::Execution &execution) const override;
         [[nodiscard]] sys::Process::Builder supervise(const ic::Execution &execution) const override;
+        [[nodiscard]] bool wants_event_ring() const override { return ring_; }
 
         NON_DEFAULT_CONSTRUCTABLE(WrapperSession);
         NON_COPYABLE_NOR_MOVABLE(WrapperSession);
@@ -46,8 +52,12 @@ namespace ic {
 
     private:
         bool verbose_;
+        bool ring_;
+        bool resource_usage_;
+        std::string capture_env_;
         std::string wrapper_dir_;
         std::map<std::string, fs::path> mapping_;
         std::map<std::string, fs::path> override_;
+        fs::path hints_file_;
     };
 }
@@ -0,0 +1,109 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "collect/SocketServices.h"
+#include "collect/Reporter.h"
+#include "libsys/Errors.h"
+
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+    rust::Result<int> listen_on(const fs::path &socket) {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        const auto path = socket.string();
+        if (path.size() >= sizeof(address.sun_path)) {
+            return rust::Err(std::runtime_error(
+                    fmt::format("Socket path is too long: {}", path)));
+        }
+        path.copy(address.sun_path, path.size());
+
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd == -1) {
+            return rust::Err(std::runtime_error(
+                    fmt::format("Socket create failed: {}", sys::error_string(errno))));
+        }
+        if (::bind(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == -1) {
+            auto message = fmt::format("Socket bind failed (to {}): {}", path, sys::error_string(errno));
+            ::close(fd);
+            return rust::Err(std::runtime_error(message));
+        }
+        if (::listen(fd, SOMAXCONN) == -1) {
+            auto message = fmt::format("Socket listen failed (on {}): {}", path, sys::error_string(errno));
+            ::close(fd);
+            return rust::Err(std::runtime_error(message));
+        }
+        return rust::Ok(fd);
+    }
+}
+
+namespace ic {
+
+    rust::Result<EventSocketService::Ptr> EventSocketService::create(const fs::path &socket, Reporter &reporter) {
+        return listen_on(socket)
+                .map<EventSocketService::Ptr>([&socket, &reporter](auto fd) {
+                    return std::make_shared<EventSocketService>(socket, fd, reporter);
+                });
+    }
+
+    EventSocketService::EventSocketService(fs::path socket, int fd, Reporter &reporter)
+            : socket_(std::move(socket))
+            , fd_(fd)
+            , reporter_(reporter)
+            , thread_([this]() { serve(); })
+    { }
+
+    EventSocketService::~EventSocketService() noexcept {
+        ::shutdown(fd_, SHUT_RDWR);
+        thread_.join();
+        ::close(fd_);
+
+        std::error_code error_code;
+        fs::remove(socket_, error_code);
+    }
+
+    void EventSocketService::serve() noexcept {
+        while (true) {
+            const int client = ::accept(fd_, nullptr, nullptr);
+            if (client == -1) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                // The listening socket was shut down.
+                break;
+            }
+            rpc::Event event;
+            google::protobuf::io::FileInputStream stream(client);
+            if (event.ParseFromZeroCopyStream(&stream)) {
+                reporter_.report(event);
+            } else {
+                spdlog::warn("Could not parse event from the report socket. Ignored.");
+            }
+            ::close(client);
+        }
+    }
+}
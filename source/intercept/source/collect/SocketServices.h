@@ -0,0 +1,66 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "config.h"
+#include "libresult/Result.h"
+
+#include <filesystem>
+#include <memory>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace ic {
+
+    class Reporter;
+
+    // Accepts event reports sent directly from the preload library.
+    //
+    // The preload library can skip the wrapper process and report the start
+    // event itself over a unix socket. This class owns that socket: every
+    // connection carries a single serialized `rpc.Event` message, which is
+    // forwarded to the reporter. The socket file is removed when the service
+    // is destroyed.
+    class EventSocketService {
+    public:
+        using Ptr = std::shared_ptr<EventSocketService>;
+
+        [[nodiscard]] static rust::Result<EventSocketService::Ptr> create(const fs::path &socket, Reporter &reporter);
+
+        [[nodiscard]] const fs::path &address() const { return socket_; }
+
+    public:
+        EventSocketService(fs::path socket, int fd, Reporter &reporter);
+        ~EventSocketService() noexcept;
+
+        NON_DEFAULT_CONSTRUCTABLE(EventSocketService);
+        NON_COPYABLE_NOR_MOVABLE(EventSocketService);
+
+    private:
+        void serve() noexcept;
+
+    private:
+        fs::path socket_;
+        int fd_;
+        Reporter &reporter_;
+        std::thread thread_;
+    };
+}
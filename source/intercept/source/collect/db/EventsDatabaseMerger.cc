@@ -0,0 +1,67 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "EventsDatabaseMerger.h"
+#include "EventsDatabaseReader.h"
+#include "EventsDatabaseWriter.h"
+
+#include <cstdint>
+#include <map>
+
+namespace ic::collect::db {
+
+    rust::Result<size_t> EventsDatabaseMerger::merge(const std::vector<fs::path> &inputs, const fs::path &output) {
+        return EventsDatabaseWriter::create(output)
+                .and_then<size_t>([&inputs](auto writer) {
+                    size_t count = 0;
+                    uint64_t next_rid = 1;
+                    for (const auto &input : inputs) {
+                        auto source = EventsDatabaseReader::from(input);
+                        if (source.is_err()) {
+                            return rust::Result<size_t>(rust::Err(source.unwrap_err()));
+                        }
+                        auto reader = source.unwrap();
+                        // The remapping is scoped to one source file: equal
+                        // ids within a file belong to the same reporter,
+                        // while equal ids across files are just collisions.
+                        std::map<uint64_t, uint64_t> rids;
+                        for (auto it = reader->events_begin(); it != reader->events_end(); ++it) {
+                            if ((*it).is_err()) {
+                                return rust::Result<size_t>(rust::Err((*it).unwrap_err()));
+                            }
+                            const auto &event = (*it).unwrap();
+                            const auto [entry, inserted] = rids.emplace(event->rid(), next_rid);
+                            if (inserted) {
+                                ++next_rid;
+                            }
+                            // The reader restored the full environments, so
+                            // the writer re-computes the deltas against the
+                            // baseline of the combined stream.
+                            rpc::Event copy(*event);
+                            copy.set_rid(entry->second);
+                            if (auto written = writer->insert_event(copy); written.is_err()) {
+                                return rust::Result<size_t>(rust::Err(written.unwrap_err()));
+                            }
+                            ++count;
+                        }
+                    }
+                    return rust::Result<size_t>(rust::Ok(count));
+                });
+    }
+}
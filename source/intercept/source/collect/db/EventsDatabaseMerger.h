@@ -0,0 +1,44 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "libresult/Result.h"
+
+#include <filesystem>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace ic::collect::db {
+
+    // Combines multiple event databases into a single one.
+    //
+    // Distributed builds collect events on several nodes, each node
+    // writing its own database, and the reporter ids in those files can
+    // collide. The merge rewrites the reporter ids into a fresh namespace
+    // (kept consistent within each source file), so the process tree
+    // reconstruction stays coherent on the combined stream.
+    struct EventsDatabaseMerger {
+
+        // Reads the input files in the given order and writes every event
+        // into the output database. Returns the number of copied events.
+        [[nodiscard]] static rust::Result<size_t> merge(const std::vector<fs::path> &inputs, const fs::path &output);
+    };
+}
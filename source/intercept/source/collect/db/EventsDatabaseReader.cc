@@ -18,66 +18,651 @@
  */
 
 #include "EventsDatabaseReader.h"
+#include "EventsDatabaseWriter.h"
 #include "libsys/Errors.h"
 
+#include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/util/delimited_message_util.h>
 #include <fmt/format.h>
+#include <spdlog/spdlog.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
+#include <unistd.h>
 
+#include <cstring>
+#include <fstream>
 #include <utility>
 
+namespace {
+
+    // Check if the file starts with the zstd frame magic bytes. Leaves the
+    // read position at the beginning of the file.
+    bool starts_compressed(int fd) {
+        unsigned char magic[4];
+        const ssize_t count = ::read(fd, magic, sizeof(magic));
+        ::lseek(fd, 0, SEEK_SET);
+#ifdef HAVE_ZSTD
+        return (count == sizeof(magic))
+                && (std::memcmp(magic, ic::collect::db::ZSTD_FRAME_MAGIC, sizeof(magic)) == 0);
+#else
+        constexpr unsigned char ZSTD_FRAME_MAGIC[4] = { 0x28, 0xb5, 0x2f, 0xfd };
+        return (count == sizeof(magic))
+                && (std::memcmp(magic, ZSTD_FRAME_MAGIC, sizeof(magic)) == 0);
+#endif
+    }
+
+    // Reads the index footer, if the file has one. Returns the size of
+    // the event records region, which is the whole file for files
+    // without a footer.
+    rpc::EventIndex read_index(int fd, size_t file_size, size_t &events_size) {
+        events_size = file_size;
+
+        rpc::EventIndex index;
+        constexpr size_t TRAILER_SIZE = sizeof(uint64_t) + sizeof(ic::collect::db::INDEX_MAGIC);
+        if (file_size < TRAILER_SIZE) {
+            return index;
+        }
+        unsigned char trailer[TRAILER_SIZE];
+        if (::pread(fd, trailer, TRAILER_SIZE, static_cast<off_t>(file_size - TRAILER_SIZE)) != TRAILER_SIZE) {
+            return index;
+        }
+        if (std::memcmp(trailer + sizeof(uint64_t), ic::collect::db::INDEX_MAGIC, sizeof(ic::collect::db::INDEX_MAGIC)) != 0) {
+            return index;
+        }
+        uint64_t index_size = 0;
+        google::protobuf::io::CodedInputStream::ReadLittleEndian64FromArray(trailer, &index_size);
+        if (index_size > file_size - TRAILER_SIZE) {
+            return index;
+        }
+        std::vector<char> bytes(index_size);
+        const auto index_offset = static_cast<off_t>(file_size - TRAILER_SIZE - index_size);
+        if (::pread(fd, bytes.data(), index_size, index_offset) != static_cast<ssize_t>(index_size)) {
+            return index;
+        }
+        if (!index.ParseFromArray(bytes.data(), static_cast<int>(index_size))) {
+            index.Clear();
+            return index;
+        }
+        events_size = file_size - TRAILER_SIZE - index_size;
+        return index;
+    }
+
+    // Decides the kind and the reporter id of a serialized event record
+    // by scanning its top level tags, without constructing the message.
+    // (The oneof fields carry the highest field numbers of the message
+    // and the rid the lowest, so the scan passes only the small leading
+    // fields before it can decide.)
+    rpc::Event::EventCase probe_record(const uint8_t *data, size_t size, uint64_t &rid) noexcept {
+        google::protobuf::io::CodedInputStream coded(data, static_cast<int>(size));
+        for (;;) {
+            const uint32_t tag = coded.ReadTag();
+            if (tag == 0) {
+                return rpc::Event::EVENT_NOT_SET;
+            }
+            if ((tag >> 3u) == rpc::Event::kRidFieldNumber && (tag & 7u) == 0) {
+                if (!coded.ReadVarint64(&rid)) {
+                    return rpc::Event::EVENT_NOT_SET;
+                }
+                continue;
+            }
+            switch (tag >> 3u) {
+                case rpc::Event::kStartedFieldNumber:
+                    return rpc::Event::kStarted;
+                case rpc::Event::kTerminatedFieldNumber:
+                    return rpc::Event::kTerminated;
+                case rpc::Event::kSignalledFieldNumber:
+                    return rpc::Event::kSignalled;
+                default:
+                    break;
+            }
+            // skip the field content by its wire type.
+            switch (tag & 7u) {
+                case 0: {
+                    uint64_t ignored = 0;
+                    if (!coded.ReadVarint64(&ignored)) {
+                        return rpc::Event::EVENT_NOT_SET;
+                    }
+                    break;
+                }
+                case 1:
+                    if (!coded.Skip(sizeof(uint64_t))) {
+                        return rpc::Event::EVENT_NOT_SET;
+                    }
+                    break;
+                case 2: {
+                    uint32_t length = 0;
+                    if (!coded.ReadVarint32(&length) || !coded.Skip(static_cast<int>(length))) {
+                        return rpc::Event::EVENT_NOT_SET;
+                    }
+                    break;
+                }
+                case 5:
+                    if (!coded.Skip(sizeof(uint32_t))) {
+                        return rpc::Event::EVENT_NOT_SET;
+                    }
+                    break;
+                default:
+                    return rpc::Event::EVENT_NOT_SET;
+            }
+        }
+    }
+}
+
 namespace ic::collect::db {
 
     rust::Result<EventsDatabaseReader::Ptr> EventsDatabaseReader::from(const fs::path &file) {
-        int fd = open(file.c_str(), O_RDONLY);
+        // `-` names the standard input: the counterpart of the writer's
+        // stdout support, for pipeline setups without an intermediate
+        // file. A pipe is not seekable, the streaming path handles it.
+        int fd = (file == "-") ? ::dup(STDIN_FILENO) : open(file.c_str(), O_RDONLY);
         if (fd == -1) {
             auto message = fmt::format("Events db open failed (file {}): {}", file.string(), sys::error_string(errno));
             return rust::Err(std::runtime_error(message));
         }
+        // the magic probe reads and seeks back, which only a regular file
+        // allows. (a pipe from a live intercept run is never compressed.)
+        struct stat file_status {};
+        const bool regular = ::fstat(fd, &file_status) == 0 && S_ISREG(file_status.st_mode);
+#ifdef POSIX_FADV_SEQUENTIAL
+        if (regular) {
+            // The parse is strictly sequential; the advice widens the
+            // kernel readahead window and starts it right away, so the
+            // reads run ahead of the parser instead of being demanded
+            // page fault by page fault.
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        }
+#endif
+        if (regular && starts_compressed(fd)) {
+#ifdef HAVE_ZSTD
+            auto decompressor = std::make_unique<ZstdInputStream>(fd);
+            std::shared_ptr<EventsDatabaseReader> result =
+                    std::make_shared<EventsDatabaseReader>(file, std::move(decompressor));
+            return rust::Ok(result);
+#else
+            close(fd);
+            auto message = fmt::format("Events db is compressed (file {}): built without zstd", file.string());
+            return rust::Err(std::runtime_error(message));
+#endif
+        }
+        // Map the whole file and parse straight from the page cache. When
+        // the mapping is not possible (empty file, pipe, exotic
+        // filesystem), the buffered stream still works.
+        if (regular && file_status.st_size > 0) {
+            const auto size = static_cast<size_t>(file_status.st_size);
+            size_t events_size = size;
+            rpc::EventIndex index = read_index(fd, size, events_size);
+            void *address = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address != MAP_FAILED) {
+                ::madvise(address, size, MADV_SEQUENTIAL);
+#ifdef MADV_WILLNEED
+                ::madvise(address, size, MADV_WILLNEED);
+#endif
+                close(fd);
+                std::shared_ptr<EventsDatabaseReader> result =
+                        std::make_shared<EventsDatabaseReader>(file, address, size, std::move(index), events_size);
+                return rust::Ok(result);
+            }
+            std::unique_ptr<google::protobuf::io::FileInputStream> stream =
+                    std::make_unique<google::protobuf::io::FileInputStream>(fd, -1);
+            std::shared_ptr<EventsDatabaseReader> result =
+                    std::make_shared<EventsDatabaseReader>(file, std::move(stream), std::move(index), events_size);
+            return rust::Ok(result);
+        }
         std::unique_ptr<google::protobuf::io::FileInputStream> stream =
                 std::make_unique<google::protobuf::io::FileInputStream>(fd, -1);
         std::shared_ptr<EventsDatabaseReader> result =
-                std::make_shared<EventsDatabaseReader>(file, std::move(stream));
+                std::make_shared<EventsDatabaseReader>(file, std::move(stream), rpc::EventIndex(), 0);
         return rust::Ok(result);
     }
 
-    EventsDatabaseReader::EventsDatabaseReader(fs::path file, StreamPtr stream) noexcept
+    std::vector<fs::path> EventsDatabaseReader::segments(const fs::path &file) {
+        return segments(file, std::string());
+    }
+
+    std::vector<fs::path> EventsDatabaseReader::segments(const fs::path &file, const std::string &program) {
+        fs::path manifest = file;
+        manifest += ".segments";
+        // the manifest filters hold basenames; a full program path is
+        // reduced the same way the `selected` checks do.
+        const std::string name = fs::path(program).filename().string();
+
+        std::vector<fs::path> result;
+        bool listed = false;
+        std::ifstream stream(manifest);
+        std::string line;
+        while (std::getline(stream, line)) {
+            if (line.empty()) {
+                continue;
+            }
+            listed = true;
+            std::string filter;
+            if (const auto tab = line.find('\t'); tab != std::string::npos) {
+                filter = line.substr(tab + 1);
+                line.resize(tab);
+            }
+            if (!name.empty() && !filter.empty()) {
+                // an unparsable filter keeps the segment, the cost is a scan.
+                const auto parsed = NameFilter::from_hex(filter);
+                if (parsed && !parsed->maybe_contains(name)) {
+                    continue;
+                }
+            }
+            // a missing segment was consumed and deleted; skipped.
+            std::error_code ignored;
+            if (fs::path segment(line); fs::exists(segment, ignored)) {
+                result.emplace_back(std::move(segment));
+            }
+        }
+        if (!listed) {
+            result.push_back(file);
+        }
+        return result;
+    }
+
+    EventsDatabaseReader::EventsDatabaseReader(fs::path file, StreamPtr stream, rpc::EventIndex index, size_t events_size) noexcept
             : file_(std::move(file))
-            , stream_(std::move(stream))
+            , index_(std::move(index))
+            , events_size_(events_size)
+            , filter_()
+            , plain_(std::move(stream))
+            // The footer must not be parsed as an event record, so the
+            // reading is limited to the records region.
+            , limited_(index_.offsets_size() > 0
+                    ? std::make_unique<google::protobuf::io::LimitingInputStream>(plain_.get(), static_cast<int64_t>(events_size))
+                    : nullptr)
+            , mapped_(nullptr)
+            , mapped_size_(0)
+            , memory_()
+#ifdef HAVE_ZSTD
+            , decompressor_()
+            , compressed_()
+#endif
     { }
 
+    EventsDatabaseReader::EventsDatabaseReader(fs::path file, void *mapped, size_t mapped_size, rpc::EventIndex index, size_t events_size) noexcept
+            : file_(std::move(file))
+            , index_(std::move(index))
+            , events_size_(events_size)
+            , filter_()
+            , plain_()
+            , limited_()
+            , mapped_(mapped)
+            , mapped_size_(mapped_size)
+            , memory_(std::make_unique<google::protobuf::io::ArrayInputStream>(mapped, static_cast<int>(events_size)))
+#ifdef HAVE_ZSTD
+            , decompressor_()
+            , compressed_()
+#endif
+    { }
+
+#ifdef HAVE_ZSTD
+    EventsDatabaseReader::EventsDatabaseReader(fs::path file, std::unique_ptr<ZstdInputStream> decompressor) noexcept
+            : file_(std::move(file))
+            , index_()
+            , events_size_(0)
+            , filter_()
+            , plain_()
+            , limited_()
+            , mapped_(nullptr)
+            , mapped_size_(0)
+            , memory_()
+            , decompressor_(std::move(decompressor))
+            , compressed_(std::make_unique<google::protobuf::io::CopyingInputStreamAdaptor>(decompressor_.get()))
+    { }
+#endif
+
     EventsDatabaseReader::~EventsDatabaseReader() noexcept {
-        stream_->Close();
+        if (plain_) {
+            plain_->Close();
+        }
+        if (mapped_ != nullptr) {
+            ::munmap(mapped_, mapped_size_);
+        }
+    }
+
+    google::protobuf::io::ZeroCopyInputStream *EventsDatabaseReader::stream() noexcept {
+#ifdef HAVE_ZSTD
+        if (compressed_) {
+            return compressed_.get();
+        }
+#endif
+        if (memory_) {
+            return memory_.get();
+        }
+        if (limited_) {
+            return limited_.get();
+        }
+        return plain_.get();
     }
 
     EventsIterator EventsDatabaseReader::events_begin() {
         return next();
     }
 
+    size_t EventsDatabaseReader::indexed_count() const noexcept {
+        return static_cast<size_t>(index_.offsets_size());
+    }
+
+    const rpc::EventIndex &EventsDatabaseReader::index() const noexcept {
+        return index_;
+    }
+
+    uint64_t EventsDatabaseReader::content_hash() const noexcept {
+        return index_.content_hash();
+    }
+
+    bool EventsDatabaseReader::seekable() const noexcept {
+        return (mapped_ != nullptr);
+    }
+
+    EventsIterator EventsDatabaseReader::events_from(size_t record) noexcept {
+        return seek(record) ? next() : EventsIterator();
+    }
+
+    bool EventsDatabaseReader::seek(size_t record) noexcept {
+        if (mapped_ == nullptr || record >= indexed_count()) {
+            return false;
+        }
+        // When records are skipped, the environment baseline has to be
+        // loaded separately. (It is the first started record, which the
+        // writer persisted with the full environment.)
+        if (baseline_.empty()) {
+            for (int idx = 0; static_cast<size_t>(idx) < record; ++idx) {
+                if (index_.kinds(idx) == rpc::Event::kStarted) {
+                    const auto offset = static_cast<size_t>(index_.offsets(idx));
+                    google::protobuf::io::ArrayInputStream stream(
+                            static_cast<char *>(mapped_) + offset, static_cast<int>(events_size_ - offset));
+                    rpc::Event event;
+                    bool clean_eof;
+                    if (google::protobuf::util::ParseDelimitedFromZeroCopyStream(&event, &stream, &clean_eof)) {
+                        restore_environment(event);
+                    }
+                    break;
+                }
+            }
+        }
+        const auto offset = static_cast<size_t>(index_.offsets(record));
+        memory_ = std::make_unique<google::protobuf::io::ArrayInputStream>(
+                static_cast<char *>(mapped_) + offset, static_cast<int>(events_size_ - offset));
+        return true;
+    }
+
     EventsIterator EventsDatabaseReader::events_end() {
         return EventsIterator();
     }
 
+    rust::Result<rpc::EventBatch> EventsDatabaseReader::next_batch(size_t limit) noexcept {
+        rpc::EventBatch batch;
+        for (size_t idx = 0; idx < limit; ++idx) {
+            rpc::Event &event = *batch.add_events();
+            bool clean_eof;
+            const bool success =
+                    google::protobuf::util::ParseDelimitedFromZeroCopyStream(&event, stream(), &clean_eof);
+            if (success && !clean_eof) {
+                restore_execution(event);
+                restore_environment(event);
+                continue;
+            }
+            batch.mutable_events()->RemoveLast();
+            if (clean_eof || recoverable()) {
+                break;
+            }
+            return rust::Err(error());
+        }
+        return rust::Ok(std::move(batch));
+    }
+
+    void EventsDatabaseReader::project(rpc::Event::EventCase kind) noexcept {
+        filter_.kind = kind;
+    }
+
+    void EventsDatabaseReader::filter(EventsFilter filter) noexcept {
+        filter_ = std::move(filter);
+    }
+
     EventsIterator EventsDatabaseReader::next() noexcept {
         std::shared_ptr<rpc::Event> event = std::make_shared<rpc::Event>();
-        bool clean_eof;
-        const bool success =
-                google::protobuf::util::ParseDelimitedFromZeroCopyStream(event.get(), stream_.get(), &clean_eof);
-        if (success && !clean_eof) {
-            return EventsIterator(this, rust::Ok(event));
-        } else if (clean_eof) {
-            return EventsIterator();
+        auto read = read_into(*event);
+        if (read.is_err()) {
+            return EventsIterator(this, rust::Err(read.unwrap_err()));
+        }
+        return read.unwrap()
+                ? EventsIterator(this, rust::Ok(event))
+                : EventsIterator();
+    }
+
+    rust::Result<bool> EventsDatabaseReader::read_into(rpc::Event &event) noexcept {
+        // the kind and the rid range can be decided on the wire format,
+        // where the memory mapped sliced access is available.
+        const bool probed = memory_
+                && (filter_.kind != rpc::Event::EVENT_NOT_SET
+                    || filter_.rid_min != 0
+                    || filter_.rid_max != std::numeric_limits<uint64_t>::max());
+        event.Clear();
+        for (;;) {
+            bool clean_eof;
+            const bool success = probed
+                    ? parse_filtered(event, clean_eof)
+                    : google::protobuf::util::ParseDelimitedFromZeroCopyStream(&event, stream(), &clean_eof);
+            if (success && !clean_eof) {
+                // the stream could not be probed, filter after the parse.
+                if ((filter_.kind != rpc::Event::EVENT_NOT_SET && event.event_case() != filter_.kind)
+                        || event.rid() < filter_.rid_min
+                        || event.rid() > filter_.rid_max) {
+                    event.Clear();
+                    continue;
+                }
+                restore_execution(event);
+                restore_environment(event);
+                // the program names live behind the reference encoding,
+                // the check needs the restored executable field.
+                if (!filter_.programs.empty()
+                        && (!event.has_started()
+                            || filter_.programs.count(
+                                    fs::path(event.started().execution().executable()).filename().string()) == 0)) {
+                    event.Clear();
+                    continue;
+                }
+                return rust::Ok(true);
+            } else if (clean_eof) {
+                return rust::Ok(false);
+            } else if (recoverable()) {
+                return rust::Ok(false);
+            } else {
+                return rust::Err(error());
+            }
+        }
+    }
+
+    // Reads the next record passing the wire decidable predicates (the
+    // kind and the reporter id range) from the memory mapped region.
+    // The rejected records are recognized from their wire format bytes
+    // and stepped over without building the message, which spares the
+    // parsing (and the allocations) of the records the caller would
+    // only discard.
+    bool EventsDatabaseReader::parse_filtered(rpc::Event &event, bool &clean_eof) noexcept {
+        for (;;) {
+            google::protobuf::io::CodedInputStream coded(memory_.get());
+            uint32_t length = 0;
+            if (!coded.ReadVarint32(&length)) {
+                clean_eof = true;
+                return false;
+            }
+            const void *data = nullptr;
+            int available = 0;
+            if (!coded.GetDirectBufferPointer(&data, &available) || available < static_cast<int>(length)) {
+                clean_eof = false;
+                return false;
+            }
+            uint64_t rid = 0;
+            const auto kind = probe_record(static_cast<const uint8_t *>(data), length, rid);
+            const bool admitted =
+                    (filter_.kind == rpc::Event::EVENT_NOT_SET || kind == filter_.kind)
+                    && rid >= filter_.rid_min
+                    && rid <= filter_.rid_max;
+            if (admitted) {
+                const bool parsed = event.ParseFromArray(data, static_cast<int>(length));
+                coded.Skip(static_cast<int>(length));
+                clean_eof = false;
+                return parsed;
+            }
+            coded.Skip(static_cast<int>(length));
+        }
+    }
+
+    // Undo the delta encoding of the writer: the first started event holds
+    // the full environment (the baseline), later events carry only their
+    // differences against it.
+    void EventsDatabaseReader::restore_environment(rpc::Event &event) noexcept {
+        if (!event.has_started()) {
+            return;
+        }
+        auto &started = *event.mutable_started();
+        if (started.environment_delta()) {
+            auto &environment = *started.mutable_execution()->mutable_environment();
+            for (const auto &[key, value] : baseline_) {
+                environment[key] = value;
+            }
+            for (const auto &[key, value] : started.environment_diff()) {
+                environment[key] = value;
+            }
+            for (const auto &key : started.environment_removed()) {
+                environment.erase(key);
+            }
+            started.clear_environment_diff();
+            started.clear_environment_removed();
+            started.set_environment_delta(false);
+        } else if (baseline_.empty() && !started.execution().environment().empty()) {
+            const auto &environment = started.execution().environment();
+            baseline_.insert(environment.begin(), environment.end());
+        }
+    }
+
+    // Undo the command reference encoding of the writer: a started event
+    // with an execution reference takes the command line of the started
+    // event of the referenced reporter. With a sequential read the
+    // referenced event was seen already; after a seek it is loaded
+    // through the index footer.
+    void EventsDatabaseReader::restore_execution(rpc::Event &event) noexcept {
+        if (!event.has_started()) {
+            return;
+        }
+        auto &started = *event.mutable_started();
+        if (started.execution_ref() != 0) {
+            auto it = commands_.find(started.execution_ref());
+            if (it == commands_.end() && seekable()) {
+                load_execution(started.execution_ref());
+                it = commands_.find(started.execution_ref());
+            }
+            if (it != commands_.end()) {
+                auto &execution = *started.mutable_execution();
+                execution.set_executable(it->second.executable());
+                execution.mutable_arguments()->CopyFrom(it->second.arguments());
+                execution.set_packed_arguments(it->second.packed_arguments());
+                execution.mutable_argument_offsets()->CopyFrom(it->second.argument_offsets());
+                execution.set_working_dir(it->second.working_dir());
+            }
+            started.clear_execution_ref();
         } else {
-            return EventsIterator(this, rust::Err(error()));
+            // expand the string references before the command line is
+            // remembered: the stored copy must be the verbatim form.
+            auto &execution = *started.mutable_execution();
+            if (execution.executable_ref() != 0) {
+                auto exe = executables_.find(execution.executable_ref());
+                if (exe == executables_.end() && seekable()) {
+                    load_execution(execution.executable_ref());
+                    exe = executables_.find(execution.executable_ref());
+                }
+                if (exe != executables_.end()) {
+                    execution.set_executable(exe->second);
+                }
+                execution.clear_executable_ref();
+            } else if (!execution.executable().empty()) {
+                executables_.emplace(event.rid(), execution.executable());
+            }
+            if (execution.working_dir_ref() != 0) {
+                auto dir = directories_.find(execution.working_dir_ref());
+                if (dir == directories_.end() && seekable()) {
+                    load_execution(execution.working_dir_ref());
+                    dir = directories_.find(execution.working_dir_ref());
+                }
+                if (dir != directories_.end()) {
+                    execution.set_working_dir(dir->second);
+                }
+                execution.clear_working_dir_ref();
+            } else if (!execution.working_dir().empty()) {
+                directories_.emplace(event.rid(), execution.working_dir());
+            }
+            // remember the command line for later references. (only the
+            // command, the environment is restored separately.)
+            rpc::Execution copy;
+            copy.set_executable(started.execution().executable());
+            copy.mutable_arguments()->CopyFrom(started.execution().arguments());
+            copy.set_packed_arguments(started.execution().packed_arguments());
+            copy.mutable_argument_offsets()->CopyFrom(started.execution().argument_offsets());
+            copy.set_working_dir(started.execution().working_dir());
+            commands_.emplace(event.rid(), std::move(copy));
+        }
+    }
+
+    // Finds the started record of the given reporter through the index
+    // footer and parses it from the mapped region, so the command line it
+    // holds becomes available for the references.
+    void EventsDatabaseReader::load_execution(uint64_t rid) noexcept {
+        for (int idx = 0; idx < index_.rids_size(); ++idx) {
+            if (index_.rids(idx) == rid && index_.kinds(idx) == rpc::Event::kStarted) {
+                const auto offset = static_cast<size_t>(index_.offsets(idx));
+                google::protobuf::io::ArrayInputStream stream(
+                        static_cast<char *>(mapped_) + offset, static_cast<int>(events_size_ - offset));
+                rpc::Event event;
+                bool clean_eof;
+                if (google::protobuf::util::ParseDelimitedFromZeroCopyStream(&event, &stream, &clean_eof)) {
+                    restore_execution(event);
+                }
+                return;
+            }
+        }
+    }
+
+    // A parse failure without a system error is a record cut short: the
+    // tail a crashed (or killed) intercept session left behind. Every
+    // complete record before it parsed fine, so the iteration ends there
+    // with a warning instead of discarding the whole database. An actual
+    // read error (or a corrupt compressed frame) still surfaces as such.
+    bool EventsDatabaseReader::recoverable() noexcept {
+        const int error_num = plain_ ? plain_->GetErrno() : 0;
+        if (error_num != 0) {
+            return false;
+        }
+#ifdef HAVE_ZSTD
+        if (decompressor_) {
+            return false;
         }
+#endif
+        spdlog::warn("Events db is truncated (file {}): keeping the complete records, the partial tail is dropped.",
+                     file_.string());
+        return true;
     }
 
     std::runtime_error EventsDatabaseReader::error() noexcept {
-        int error_num = stream_->GetErrno();
-        auto message = fmt::format("Events db read failed (from file {}): {}", file_.string(), sys::error_string(error_num));
+        int error_num = 0;
+        if (plain_) {
+            error_num = plain_->GetErrno();
+        }
+#ifdef HAVE_ZSTD
+        else if (decompressor_) {
+            error_num = decompressor_->GetErrno();
+        }
+#endif
+        // The memory mapped reading has no errno; a parse failure there
+        // means the content is truncated or corrupt.
+        auto message = (error_num != 0)
+                ? fmt::format("Events db read failed (from file {}): {}", file_.string(), sys::error_string(error_num))
+                : fmt::format("Events db read failed (from file {}): truncated or corrupt content", file_.string());
         return std::runtime_error(message);
     }
 
@@ -20,13 +20,20 @@
 #pragma once
 
 #include "config.h"
+#include "collect/db/ZstdStreams.h"
 #include "libresult/Result.h"
 #include "intercept.pb.h"
 
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 
+#include <cstdint>
 #include <filesystem>
+#include <limits>
+#include <map>
 #include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace fs = std::filesystem;
@@ -36,6 +43,27 @@ namespace ic::collect::db {
     class EventsDatabaseReader;
     using EventPtr = std::shared_ptr<rpc::Event>;
 
+    // The predicates of a filtered iteration; a record is delivered when
+    // all of them hold. A default constructed filter matches everything.
+    //
+    // The kind and the reporter id range are evaluated against the wire
+    // format of memory mapped files, so the rejected records are stepped
+    // over without constructing the message. The program set names
+    // executable basenames; it is checked after the parse (the reference
+    // encoding of the database stores repeated program paths as
+    // dictionary references, the name is not in the rejected record's
+    // bytes), but only for the records the cheaper predicates admitted.
+    struct EventsFilter {
+        // EVENT_NOT_SET matches every kind.
+        rpc::Event::EventCase kind = rpc::Event::EVENT_NOT_SET;
+        // inclusive reporter id range.
+        uint64_t rid_min = 0;
+        uint64_t rid_max = std::numeric_limits<uint64_t>::max();
+        // empty matches every program; a non empty set matches only the
+        // started events whose executable basename is listed.
+        std::set<std::string> programs = {};
+    };
+
     class EventsIterator {
     public:
         using difference_type = std::ptrdiff_t;
@@ -66,26 +94,138 @@ namespace ic::collect::db {
         using Ptr = std::shared_ptr<EventsDatabaseReader>;
         using StreamPtr = std::unique_ptr<google::protobuf::io::FileInputStream>;
 
+        // Recognizes a zstd compressed database by the frame magic bytes
+        // and decompresses it transparently; otherwise the file is read as
+        // a plain delimited protobuf stream. Plain files are memory mapped,
+        // so the records are parsed straight from the page cache without
+        // an intermediate read buffer.
         [[nodiscard]] static rust::Result<EventsDatabaseReader::Ptr> from(const fs::path &file);
 
+        // The chain of a segmented database: the paths listed in the
+        // `<file>.segments` manifest (see the writer's segmentation),
+        // reduced to the segments still present. Every segment is a
+        // complete database on its own, read with an ordinary `from`
+        // call; a consumer may delete a fully processed one, the chain
+        // simply shortens. A database without a manifest is its own,
+        // single element chain.
+        [[nodiscard]] static std::vector<fs::path> segments(const fs::path &file);
+
+        // The chain filtered for one program: the segments whose
+        // manifest name filter (see the writer's segmentation) rules the
+        // program's basename out are dropped without opening them. A
+        // segment without a filter (the still open one, or a manifest of
+        // an older writer) is kept, the filter only errs towards
+        // keeping; matching events must still be selected by a scan.
+        [[nodiscard]] static std::vector<fs::path> segments(const fs::path &file, const std::string &program);
+
         [[nodiscard]] EventsIterator events_begin();
         [[nodiscard]] EventsIterator events_end();
 
+        // The number of records in the index footer. Zero when the file
+        // carries no index (older or compressed databases).
+        [[nodiscard]] size_t indexed_count() const noexcept;
+
+        // The index footer of the file. Only meaningful when the indexed
+        // count is not zero.
+        [[nodiscard]] const rpc::EventIndex &index() const noexcept;
+
+        // The running content hash from the index footer. Zero when the
+        // file carries no index, or predates the hash field. (See the
+        // EventIndex message.)
+        [[nodiscard]] uint64_t content_hash() const noexcept;
+
+        // True when the file is memory mapped, so the sliced access of
+        // the events_from method is available.
+        [[nodiscard]] bool seekable() const noexcept;
+
+        // Drains up to the given number of events into a batch message,
+        // continuing where the iteration stands. The environments are
+        // restored the same way as with the iterator. An empty batch
+        // marks the end of the database; a read failure is an error.
+        [[nodiscard]] rust::Result<rpc::EventBatch> next_batch(size_t limit) noexcept;
+
+        // Restricts the iteration to records of the given event kind.
+        // (Shorthand for a filter with only the kind predicate set.)
+        void project(rpc::Event::EventCase kind) noexcept;
+
+        // Restricts the iteration to the records matching the filter.
+        // On a memory mapped file the kind and the reporter id range are
+        // decided by scanning the top level tags on the wire format, so
+        // the rejected records are skipped without constructing the
+        // message; on buffered or compressed streams the records are
+        // parsed and filtered afterwards. Set it before the iteration
+        // starts; it applies to the iterator and the cursor form alike.
+        void filter(EventsFilter filter) noexcept;
+
+        // Start reading at the given record of the index footer. Returns
+        // the end iterator when the record is out of range, or when the
+        // file is not memory mapped. (The environment baseline is loaded
+        // from the first started record, so the restored environments are
+        // the same as with a sequential read.)
+        [[nodiscard]] EventsIterator events_from(size_t record) noexcept;
+
+        // Positions the reading at the given record of the index footer,
+        // without parsing it. Returns false when the record is out of
+        // range, or when the file is not memory mapped. (The environment
+        // baseline is loaded the same way as with events_from.)
+        [[nodiscard]] bool seek(size_t record) noexcept;
+
+        // The cursor form of the iteration: clears the given event and
+        // parses the next record into it, so one caller owned message is
+        // reused over the whole run. (Its strings and maps keep their
+        // capacity, and no shared pointer control block is allocated per
+        // record.) Returns true on a record, false at the end of the
+        // database; a read failure is an error. The filter and the
+        // environment restoring apply the same way as with the iterator.
+        [[nodiscard]] rust::Result<bool> read_into(rpc::Event &event) noexcept;
+
     private:
         friend class EventsIterator;
 
         [[nodiscard]] EventsIterator next() noexcept;
+        [[nodiscard]] bool parse_filtered(rpc::Event &event, bool &clean_eof) noexcept;
+        [[nodiscard]] bool recoverable() noexcept;
+        void restore_environment(rpc::Event &event) noexcept;
+        void restore_execution(rpc::Event &event) noexcept;
+        void load_execution(uint64_t rid) noexcept;
         [[nodiscard]] std::runtime_error error() noexcept;
 
     public:
-        explicit EventsDatabaseReader(fs::path file, StreamPtr stream) noexcept;
+        EventsDatabaseReader(fs::path file, StreamPtr stream, rpc::EventIndex index, size_t events_size) noexcept;
+        EventsDatabaseReader(fs::path file, void *mapped, size_t mapped_size, rpc::EventIndex index, size_t events_size) noexcept;
+#ifdef HAVE_ZSTD
+        EventsDatabaseReader(fs::path file, std::unique_ptr<ZstdInputStream> decompressor) noexcept;
+#endif
         ~EventsDatabaseReader() noexcept;
 
         NON_DEFAULT_CONSTRUCTABLE(EventsDatabaseReader);
         NON_COPYABLE_NOR_MOVABLE(EventsDatabaseReader);
 
+    private:
+        [[nodiscard]] google::protobuf::io::ZeroCopyInputStream *stream() noexcept;
+
     private:
         fs::path file_;
-        StreamPtr stream_;
+        std::map<std::string, std::string> baseline_;
+        // reporter id -> the command line of its started event, for the
+        // execution references. (the environment is not kept here.)
+        std::unordered_map<uint64_t, rpc::Execution> commands_;
+        // The program paths and the working directories seen verbatim,
+        // keyed by the reporter which stored them first. (The string
+        // dictionary of the database, for expanding the references.)
+        std::unordered_map<uint64_t, std::string> executables_;
+        std::unordered_map<uint64_t, std::string> directories_;
+        rpc::EventIndex index_;
+        size_t events_size_;
+        EventsFilter filter_;
+        StreamPtr plain_;
+        std::unique_ptr<google::protobuf::io::LimitingInputStream> limited_;
+        void *mapped_;
+        size_t mapped_size_;
+        std::unique_ptr<google::protobuf::io::ArrayInputStream> memory_;
+#ifdef HAVE_ZSTD
+        std::unique_ptr<ZstdInputStream> decompressor_;
+        std::unique_ptr<google::protobuf::io::CopyingInputStreamAdaptor> compressed_;
+#endif
     };
 }
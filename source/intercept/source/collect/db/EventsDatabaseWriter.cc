@@ -20,46 +20,570 @@
 #include "EventsDatabaseWriter.h"
 #include "libsys/Errors.h"
 
+#include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/util/delimited_message_util.h>
 #include <fmt/format.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <cerrno>
 #include <fcntl.h>
+#include <fstream>
+#include <unistd.h>
+
+namespace {
+
+    // The running content hash of the database: 64 bit FNV-1a over the
+    // serialized records. (The constants are the standard FNV ones.)
+    constexpr uint64_t HASH_BASIS = UINT64_C(0xcbf29ce484222325);
+    constexpr uint64_t HASH_PRIME = UINT64_C(0x100000001b3);
+
+    uint64_t hash_bytes(uint64_t hash, const void *data, size_t size) {
+        const auto *bytes = static_cast<const unsigned char *>(data);
+        for (size_t idx = 0; idx < size; ++idx) {
+            hash = (hash ^ bytes[idx]) * HASH_PRIME;
+        }
+        return hash;
+    }
+}
 
 namespace ic::collect::db {
 
-    rust::Result<EventsDatabaseWriter::Ptr> EventsDatabaseWriter::create(const fs::path &file) {
-        int fd = open(file.c_str(), O_WRONLY | O_CREAT, 00644);
-        if (fd == -1) {
-            auto message = fmt::format("Events db open failed (file {}): {}", file.string(), sys::error_string(errno));
+    std::string NameFilter::to_hex() const {
+        std::string result;
+        result.reserve(bits_.size() * 16);
+        for (const uint64_t word : bits_) {
+            result += fmt::format("{:016x}", word);
+        }
+        return result;
+    }
+
+    std::optional<NameFilter> NameFilter::from_hex(const std::string &hex) {
+        NameFilter result;
+        if (hex.size() != result.bits_.size() * 16) {
+            return std::nullopt;
+        }
+        for (size_t word = 0; word < result.bits_.size(); ++word) {
+            uint64_t value = 0;
+            for (size_t digit = 0; digit < 16; ++digit) {
+                const char character = hex[word * 16 + digit];
+                value <<= 4u;
+                if (character >= '0' && character <= '9') {
+                    value |= static_cast<uint64_t>(character - '0');
+                } else if (character >= 'a' && character <= 'f') {
+                    value |= static_cast<uint64_t>(character - 'a' + 10);
+                } else {
+                    return std::nullopt;
+                }
+            }
+            result.bits_[word] = value;
+        }
+        return result;
+    }
+
+    rust::Result<EventsDatabaseWriter::Ptr> EventsDatabaseWriter::create(const fs::path &file, size_t buffer_size, bool compress, size_t growth_chunk) {
+        // `-` names the standard output: pipeline setups feed the
+        // consumer directly, without an intermediate file. (The stream
+        // is duplicated, the writer owns and closes its own copy.)
+        const bool to_stdout = (file == "-");
+#ifndef HAVE_ZSTD
+        if (compress) {
+            auto message = fmt::format("Events db compression is not supported (file {}): built without zstd", file.string());
             return rust::Err(std::runtime_error(message));
         }
+#endif
+#ifdef HAVE_ZSTD
+        if (compress) {
+            int fd = to_stdout ? ::dup(STDOUT_FILENO) : open(file.c_str(), O_WRONLY | O_CREAT, 00644);
+            if (fd == -1) {
+                auto message = fmt::format("Events db open failed (file {}): {}", file.string(), sys::error_string(errno));
+                return rust::Err(std::runtime_error(message));
+            }
+            auto compressor = std::make_unique<ZstdOutputStream>(fd);
+            std::shared_ptr<EventsDatabaseWriter> result =
+                    std::make_shared<EventsDatabaseWriter>(file, std::move(compressor), buffer_size);
+            return rust::Ok(result);
+        }
+#endif
+        int fd = -1;
+        fs::path link_target;
+        if (to_stdout) {
+            fd = ::dup(STDOUT_FILENO);
+            if (fd == -1) {
+                auto message = fmt::format("Events db open failed (stdout): {}", sys::error_string(errno));
+                return rust::Err(std::runtime_error(message));
+            }
+        }
+#ifdef O_TMPFILE
+        // Open an unnamed file in the target directory and link it into
+        // place with the first written record. Until then the database is
+        // an anonymous inode, a session that never got an event leaves no
+        // torso under the output name; once records exist, a crashed
+        // session leaves them recoverable. (Not applicable when the
+        // output is a pipe, where a consumer reads the records live.)
+        struct stat target_status {};
+        const bool target_missing = (fd == -1) && ::stat(file.c_str(), &target_status) == -1;
+        if (fd == -1 && (target_missing || S_ISREG(target_status.st_mode))) {
+            const auto directory = file.has_parent_path() ? file.parent_path() : fs::path(".");
+            fd = open(directory.c_str(), O_TMPFILE | O_WRONLY, 00644);
+            if (fd != -1) {
+                link_target = file;
+            }
+        }
+#endif
+        if (fd == -1) {
+            fd = open(file.c_str(), O_WRONLY | O_CREAT, 00644);
+            if (fd == -1) {
+                auto message = fmt::format("Events db open failed (file {}): {}", file.string(), sys::error_string(errno));
+                return rust::Err(std::runtime_error(message));
+            }
+        }
+        // pipes can't be indexed: the footer would trail the records with
+        // no way for the consumer to tell them apart. (Nor preallocated,
+        // the growth chunks only make sense on a real file.)
+        struct stat file_status {};
+        const bool regular = ::fstat(fd, &file_status) == 0 && S_ISREG(file_status.st_mode);
         std::unique_ptr<google::protobuf::io::FileOutputStream> stream =
-                std::make_unique<google::protobuf::io::FileOutputStream>(fd, -1);
+                std::make_unique<google::protobuf::io::FileOutputStream>(fd, static_cast<int>(buffer_size));
         std::shared_ptr<EventsDatabaseWriter> result =
-                std::make_shared<EventsDatabaseWriter>(file, std::move(stream));
+                std::make_shared<EventsDatabaseWriter>(file, std::move(stream), regular, fd, buffer_size, (regular ? growth_chunk : 0), std::move(link_target));
         return rust::Ok(result);
     }
 
-    EventsDatabaseWriter::EventsDatabaseWriter(fs::path file, StreamPtr stream) noexcept
+    EventsDatabaseWriter::EventsDatabaseWriter(fs::path file, StreamPtr stream, bool indexed, int fd, size_t buffer_size, size_t growth_chunk, fs::path link_target) noexcept
+            : file_(std::move(file))
+            , content_hash_(HASH_BASIS)
+            , indexed_(indexed)
+            , plain_(std::move(stream))
+            , fd_(fd)
+            , buffer_size_(buffer_size)
+            , growth_chunk_(growth_chunk)
+            , allocated_(0)
+            , snapshot_interval_(0)
+            , last_snapshot_()
+            , segment_limit_(0)
+            , segment_(0)
+            , name_filter_()
+            , closed_filters_()
+            , link_target_(std::move(link_target))
+#ifdef HAVE_ZSTD
+            , compressor_()
+            , compressed_()
+#endif
+    { }
+
+#ifdef HAVE_ZSTD
+    EventsDatabaseWriter::EventsDatabaseWriter(fs::path file, std::unique_ptr<ZstdOutputStream> compressor, size_t buffer_size) noexcept
             : file_(std::move(file))
-            , stream_(std::move(stream))
+            , content_hash_(HASH_BASIS)
+            , indexed_(false)
+            , plain_()
+            , fd_(-1)
+            , buffer_size_(0)
+            , growth_chunk_(0)
+            , allocated_(0)
+            , snapshot_interval_(0)
+            , last_snapshot_()
+            , segment_limit_(0)
+            , segment_(0)
+            , name_filter_()
+            , closed_filters_()
+            , link_target_()
+            , compressor_(std::move(compressor))
+            , compressed_(std::make_unique<google::protobuf::io::CopyingOutputStreamAdaptor>(compressor_.get(), static_cast<int>(buffer_size)))
     { }
+#endif
 
     EventsDatabaseWriter::~EventsDatabaseWriter() noexcept {
-        stream_->Flush();
-        stream_->Close();
+        if (snapshot_interval_.count() > 0) {
+            // the index footer supersedes the mid-session checkpoints.
+            std::error_code ignored;
+            fs::remove(snapshot_file(), ignored);
+        }
+        if (plain_) {
+            write_index();
+            plain_->Flush();
+            // the file descriptor must still be open for the link.
+            link_into_place();
+            plain_->Close();
+        }
+#ifdef HAVE_ZSTD
+        if (compressed_) {
+            compressed_->Flush();
+            // release the adaptor before the compressor it writes to.
+            compressed_.reset();
+            compressor_->Close();
+        }
+#endif
+    }
+
+    google::protobuf::io::ZeroCopyOutputStream *EventsDatabaseWriter::stream() noexcept {
+#ifdef HAVE_ZSTD
+        if (compressed_) {
+            return compressed_.get();
+        }
+#endif
+        return plain_.get();
     }
 
     rust::Result<int> EventsDatabaseWriter::insert_event(const rpc::Event &event) {
-        return google::protobuf::util::SerializeDelimitedToZeroCopyStream(event, stream_.get())
-               ? rust::Result<int>(rust::Ok(1))
-               : rust::Result<int>(rust::Err(error()));
+        // The index only makes sense where the reader can seek, which
+        // neither a compressed stream nor a pipe allows.
+        if (plain_ && indexed_) {
+            index_.add_offsets(static_cast<uint64_t>(plain_->ByteCount()));
+            index_.add_rids(event.rid());
+            index_.add_kinds(static_cast<uint32_t>(event.event_case()));
+        }
+        if (event.has_started()) {
+            // the segment's name filter collects the basenames before the
+            // reference encoding replaces the executable field. Only the
+            // closed segments publish their filter. (See `write_manifest`.)
+            if (segment_limit_ != 0 && !event.started().execution().executable().empty()) {
+                name_filter_.insert(fs::path(event.started().execution().executable()).filename().string());
+            }
+            rpc::Event copy(event);
+            to_reference(copy);
+            if (!copy.started().execution().environment().empty()) {
+                if (baseline_.empty()) {
+                    // the first started event is the baseline, stored in full.
+                    const auto &environment = copy.started().execution().environment();
+                    baseline_.insert(environment.begin(), environment.end());
+                    return write_event(copy);
+                }
+                return write_event(to_delta(copy));
+            }
+            return write_event(copy);
+        }
+        return write_event(event);
+    }
+
+    rust::Result<int> EventsDatabaseWriter::insert_batch(const rpc::EventBatch &batch) {
+        int count = 0;
+        for (const auto &event : batch.events()) {
+            if (auto result = insert_event(event); result.is_err()) {
+                return result;
+            }
+            count += 1;
+        }
+        return rust::Ok(count);
+    }
+
+    rust::Result<int> EventsDatabaseWriter::write_event(const rpc::Event &event) {
+        if (plain_) {
+            preallocate();
+            // The file becomes visible with the first record: when a
+            // crashed session is killed mid-build, its flushed records
+            // stay recoverable under the output name.
+            link_into_place();
+        }
+        // serialized once: the same bytes feed the running content hash
+        // and the output stream (framed as length, then message).
+        std::string bytes;
+        if (!event.SerializeToString(&bytes)) {
+            return rust::Err(error());
+        }
+        const auto size = static_cast<uint64_t>(bytes.size());
+        content_hash_ = hash_bytes(content_hash_, &size, sizeof(size));
+        content_hash_ = hash_bytes(content_hash_, bytes.data(), bytes.size());
+        {
+            google::protobuf::io::CodedOutputStream coded(stream());
+            coded.WriteVarint32(static_cast<uint32_t>(bytes.size()));
+            coded.WriteRaw(bytes.data(), static_cast<int>(bytes.size()));
+            if (coded.HadError()) {
+                return rust::Err(error());
+            }
+        }
+        maybe_snapshot();
+        maybe_rotate();
+        return rust::Ok(1);
+    }
+
+    // The timed snapshot point: the buffered records are pushed to the
+    // file, and the sidecar checkpoint is replaced (written to a
+    // temporary name first, so a concurrent consumer never sees a torso).
+    void EventsDatabaseWriter::maybe_snapshot() noexcept {
+        if (snapshot_interval_.count() == 0) {
+            return;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (now - last_snapshot_ < snapshot_interval_) {
+            return;
+        }
+        last_snapshot_ = now;
+        plain_->Flush();
+        fs::path temporary = snapshot_file();
+        temporary += ".tmp";
+        {
+            std::ofstream stream(temporary);
+            stream << index_.offsets_size() << ' ' << plain_->ByteCount() << std::endl;
+        }
+        std::error_code ignored;
+        fs::rename(temporary, snapshot_file(), ignored);
+    }
+
+    fs::path EventsDatabaseWriter::snapshot_file() const {
+        fs::path result = file_;
+        result += ".snapshot";
+        return result;
+    }
+
+    // The rotation point: the file which grew past the limit is finished
+    // with its index footer, and the records continue in the next
+    // numbered segment. All the per file state restarts, so every
+    // segment reads as a complete database on its own; the manifest is
+    // replaced to cover the extended chain.
+    void EventsDatabaseWriter::maybe_rotate() noexcept {
+        if (segment_limit_ == 0
+                || static_cast<uint64_t>(plain_->ByteCount()) < segment_limit_) {
+            return;
+        }
+        // the next segment is opened first: without a place for further
+        // records, the current file simply keeps growing.
+        const fs::path next = segment_path(segment_ + 1);
+        const int fd = open(next.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 00644);
+        if (fd == -1) {
+            segment_limit_ = 0;
+            return;
+        }
+        write_index();
+        plain_->Flush();
+        // the first segment may still be an anonymous inode.
+        link_into_place();
+        plain_->Close();
+        plain_ = std::make_unique<google::protobuf::io::FileOutputStream>(fd, static_cast<int>(buffer_size_));
+        fd_ = fd;
+        segment_ += 1;
+        index_.Clear();
+        content_hash_ = HASH_BASIS;
+        baseline_.clear();
+        commands_.clear();
+        executables_.clear();
+        directories_.clear();
+        allocated_ = 0;
+        // the filter of the finished segment is now complete, publish it.
+        closed_filters_.push_back(name_filter_.to_hex());
+        name_filter_ = NameFilter();
+        write_manifest();
+    }
+
+    // Replaces the manifest with the chain as it stands (written to a
+    // temporary name first, so a concurrent consumer never sees a
+    // torso). The consumers tolerate missing entries, so a segment
+    // already processed can be deleted without touching the manifest.
+    void EventsDatabaseWriter::write_manifest() noexcept {
+        fs::path temporary = manifest_file();
+        temporary += ".tmp";
+        {
+            std::ofstream stream(temporary);
+            for (size_t segment = 0; segment <= segment_; ++segment) {
+                stream << segment_path(segment).string();
+                // the open segment has no line suffix: its filter is
+                // still growing, a consumer has to scan it.
+                if (segment < closed_filters_.size()) {
+                    stream << '\t' << closed_filters_[segment];
+                }
+                stream << std::endl;
+            }
+        }
+        std::error_code ignored;
+        fs::rename(temporary, manifest_file(), ignored);
+    }
+
+    fs::path EventsDatabaseWriter::segment_path(size_t segment) const {
+        if (segment == 0) {
+            return file_;
+        }
+        fs::path result = file_;
+        result += fmt::format(".{}", segment);
+        return result;
+    }
+
+    fs::path EventsDatabaseWriter::manifest_file() const {
+        fs::path result = file_;
+        result += ".segments";
+        return result;
+    }
+
+    void EventsDatabaseWriter::enable_snapshots(std::chrono::milliseconds interval) noexcept {
+        // the consumer needs complete records at a stable offset, which
+        // only an indexed regular file provides.
+        if (plain_ && indexed_) {
+            snapshot_interval_ = interval;
+            last_snapshot_ = std::chrono::steady_clock::now();
+        }
+    }
+
+    void EventsDatabaseWriter::enable_segmentation(size_t limit) noexcept {
+        // a pipe has no size to bound, and a compressed stream is a
+        // single frame; only an indexed regular file can rotate.
+        if (plain_ && indexed_) {
+            segment_limit_ = limit;
+        }
+    }
+
+    // Grows the backing allocation ahead of the writes. Allocating in
+    // large chunks keeps the file in a few extents, a file grown write by
+    // write fragments and slows down the sequential read that follows.
+    // The allocation keeps the file size at the written bytes, so the
+    // index footer stays locatable from the end of the file.
+    void EventsDatabaseWriter::preallocate() noexcept {
+#ifdef FALLOC_FL_KEEP_SIZE
+        if (growth_chunk_ == 0) {
+            return;
+        }
+        const auto written = static_cast<uint64_t>(plain_->ByteCount());
+        while (allocated_ < written + growth_chunk_ / 2) {
+            if (::fallocate(fd_, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(allocated_), static_cast<off_t>(growth_chunk_)) == -1) {
+                // not every filesystem supports it, stop asking then.
+                growth_chunk_ = 0;
+                return;
+            }
+            allocated_ += growth_chunk_;
+        }
+#endif
+    }
+
+    // Gives the anonymous file its final name. An already existing file
+    // is replaced, like an ordinary create would have truncated it. Done
+    // at most once; a failed attempt is retried on the next call.
+    void EventsDatabaseWriter::link_into_place() noexcept {
+        if (link_target_.empty()) {
+            return;
+        }
+        const auto source = fmt::format("/proc/self/fd/{}", fd_);
+        if (::linkat(AT_FDCWD, source.c_str(), AT_FDCWD, link_target_.c_str(), AT_SYMLINK_FOLLOW) == -1) {
+            if (errno != EEXIST) {
+                return;
+            }
+            ::unlink(link_target_.c_str());
+            if (::linkat(AT_FDCWD, source.c_str(), AT_FDCWD, link_target_.c_str(), AT_SYMLINK_FOLLOW) == -1) {
+                return;
+            }
+        }
+        link_target_.clear();
+    }
+
+    // Replaces a repeated command line with a reference to its first
+    // occurrence. The fingerprint covers the program, the arguments and
+    // the working directory; the environment is delta encoded separately.
+    void EventsDatabaseWriter::to_reference(rpc::Event &event) {
+        // the reference key is the reporter id, zero can not be one.
+        if (event.rid() == 0) {
+            return;
+        }
+        auto &started = *event.mutable_started();
+        auto &execution = *started.mutable_execution();
+
+        std::string fingerprint(execution.executable());
+        fingerprint.push_back('\0');
+        fingerprint.append(execution.working_dir());
+        fingerprint.push_back('\0');
+        fingerprint.append(execution.packed_arguments());
+        for (const auto offset : execution.argument_offsets()) {
+            fingerprint.push_back('\0');
+            fingerprint.append(std::to_string(offset));
+        }
+        for (const auto &argument : execution.arguments()) {
+            fingerprint.push_back('\0');
+            fingerprint.append(argument);
+        }
+        // unique commands are naturally bounded by the build, the limit
+        // only guards degenerate inputs. (past it new commands are simply
+        // stored in full.)
+        constexpr size_t COMMAND_LIMIT = 1 << 20;
+        if (commands_.size() >= COMMAND_LIMIT) {
+            if (const auto it = commands_.find(fingerprint); it != commands_.end() && it->second != event.rid()) {
+                started.set_execution_ref(it->second);
+            }
+        } else if (const auto [it, inserted] = commands_.try_emplace(std::move(fingerprint), event.rid());
+                !inserted && it->second != event.rid()) {
+            started.set_execution_ref(it->second);
+        } else {
+            // a new command line: its program path and working directory
+            // may still repeat from earlier, different commands.
+            to_string_reference(event);
+            return;
+        }
+        if (started.execution_ref() != 0) {
+            execution.clear_executable();
+            execution.clear_arguments();
+            execution.clear_packed_arguments();
+            execution.clear_argument_offsets();
+            execution.clear_working_dir();
+        }
+    }
+
+    // Replaces a repeated program path or working directory with a
+    // reference to the started event which stored it first. The command
+    // reference above only helps identical command lines; the string
+    // dictionary also covers distinct commands of the same program or
+    // the same directory.
+    void EventsDatabaseWriter::to_string_reference(rpc::Event &event) {
+        // the maps share the natural bound of the command map; the limit
+        // only guards degenerate inputs.
+        constexpr size_t STRING_LIMIT = 1 << 20;
+        auto &execution = *event.mutable_started()->mutable_execution();
+        if (!execution.executable().empty() && executables_.size() < STRING_LIMIT) {
+            if (const auto [it, inserted] = executables_.try_emplace(execution.executable(), event.rid());
+                    !inserted && it->second != event.rid()) {
+                execution.set_executable_ref(it->second);
+                execution.clear_executable();
+            }
+        }
+        if (!execution.working_dir().empty() && directories_.size() < STRING_LIMIT) {
+            if (const auto [it, inserted] = directories_.try_emplace(execution.working_dir(), event.rid());
+                    !inserted && it->second != event.rid()) {
+                execution.set_working_dir_ref(it->second);
+                execution.clear_working_dir();
+            }
+        }
+    }
+
+    rpc::Event EventsDatabaseWriter::to_delta(const rpc::Event &event) const {
+        rpc::Event copy(event);
+        auto &started = *copy.mutable_started();
+        auto &execution = *started.mutable_execution();
+
+        started.set_environment_delta(true);
+        auto &diff = *started.mutable_environment_diff();
+        for (const auto &[key, value] : execution.environment()) {
+            if (const auto it = baseline_.find(key); it == baseline_.end() || it->second != value) {
+                diff[key] = value;
+            }
+        }
+        for (const auto &[key, value] : baseline_) {
+            if (execution.environment().count(key) == 0) {
+                started.add_environment_removed(key);
+            }
+        }
+        execution.clear_environment();
+        return copy;
+    }
+
+    // Appends the index footer: the serialized index message, its size
+    // (8 bytes, little endian) and the magic bytes. The trailer is fixed
+    // size, so a reader can locate the footer from the end of the file.
+    void EventsDatabaseWriter::write_index() noexcept {
+        if (index_.offsets_size() == 0) {
+            return;
+        }
+        index_.set_content_hash(content_hash_);
+        std::string bytes;
+        if (!index_.SerializeToString(&bytes)) {
+            return;
+        }
+        google::protobuf::io::CodedOutputStream coded(plain_.get());
+        coded.WriteRaw(bytes.data(), static_cast<int>(bytes.size()));
+        coded.WriteLittleEndian64(bytes.size());
+        coded.WriteRaw(INDEX_MAGIC, sizeof(INDEX_MAGIC));
     }
 
     std::runtime_error EventsDatabaseWriter::error() noexcept {
-        int error_num = stream_->GetErrno();
+#ifdef HAVE_ZSTD
+        const int error_num = plain_ ? plain_->GetErrno() : compressor_->GetErrno();
+#else
+        const int error_num = plain_->GetErrno();
+#endif
         auto message = fmt::format("Events db write failed (to file {}): {}", file_.string(), sys::error_string(error_num));
         return std::runtime_error(message);
     }
@@ -20,32 +20,169 @@
 #pragma once
 
 #include "config.h"
+#include "collect/db/ZstdStreams.h"
 #include "libresult/Result.h"
 #include "intercept.pb.h"
 
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 
+#include <array>
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
+#include <map>
 #include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace fs = std::filesystem;
 
 namespace ic::collect::db {
 
+    // Marks the index footer at the end of an events database file.
+    // (See the EventIndex message for the footer layout.)
+    constexpr char INDEX_MAGIC[8] = { 'b', 'e', 'a', 'r', 'i', 'd', 'x', '1' };
+
+    // A fixed size bloom filter over the executable basenames recorded
+    // in a segment, carried next to the segment path in the manifest. A
+    // consumer interested in one program can skip a segment whose filter
+    // rules the name out; a positive answer only means "maybe present",
+    // the scan still decides. 256 bits with two probes keeps the false
+    // positive rate negligible for the few distinct names of a build.
+    struct NameFilter {
+        void insert(const std::string &name) noexcept {
+            const auto [first, second] = probes(name);
+            bits_[first / 64] |= (UINT64_C(1) << (first % 64));
+            bits_[second / 64] |= (UINT64_C(1) << (second % 64));
+        }
+
+        [[nodiscard]] bool maybe_contains(const std::string &name) const noexcept {
+            const auto [first, second] = probes(name);
+            return ((bits_[first / 64] & (UINT64_C(1) << (first % 64))) != 0)
+                && ((bits_[second / 64] & (UINT64_C(1) << (second % 64))) != 0);
+        }
+
+        // The manifest representation: the bit words as fixed width
+        // lowercase hex. Parsing rejects anything else.
+        [[nodiscard]] std::string to_hex() const;
+        [[nodiscard]] static std::optional<NameFilter> from_hex(const std::string &hex);
+
+    private:
+        // two probe positions derived from the halves of one FNV-1a hash.
+        [[nodiscard]] static std::pair<uint32_t, uint32_t> probes(const std::string &name) noexcept {
+            uint64_t hash = UINT64_C(0xcbf29ce484222325);
+            for (const char character : name) {
+                hash = (hash ^ static_cast<unsigned char>(character)) * UINT64_C(0x100000001b3);
+            }
+            return { static_cast<uint32_t>(hash >> 32u) % 256u, static_cast<uint32_t>(hash) % 256u };
+        }
+
+        std::array<uint64_t, 4> bits_ = {};
+    };
+
     class EventsDatabaseWriter {
     public:
         using Ptr = std::shared_ptr<EventsDatabaseWriter>;
         using StreamPtr = std::unique_ptr<google::protobuf::io::FileOutputStream>;
 
-        [[nodiscard]] static rust::Result<EventsDatabaseWriter::Ptr> create(const fs::path &file);
-
+        // The buffer size controls how much serialized event data is
+        // batched up before it reaches the operating system in one write
+        // call. Full builds produce databases beyond a gigabyte, where the
+        // stock 8KB buffer of the stream causes a storm of small writes.
+        //
+        // When compression is requested, the output is a single zstd frame
+        // (recognized by its magic bytes in the reader). The near-identical
+        // environment blocks of the events compress well, which matters on
+        // network filesystems.
+        //
+        // An uncompressed regular file grows in `growth_chunk` sized
+        // `fallocate` extents ahead of the writes (where the system
+        // supports it). Growing write by write fragments the file into
+        // many extents, which slows down the sequential read that
+        // follows. The file is also opened as an unnamed inode and linked
+        // under the output name with the first record: a session that
+        // recorded nothing leaves no torso behind, and one that crashed
+        // mid-build leaves a database whose complete records the reader
+        // recovers.
+        [[nodiscard]] static rust::Result<EventsDatabaseWriter::Ptr> create(
+                const fs::path &file,
+                size_t buffer_size = DEFAULT_BUFFER_SIZE,
+                bool compress = false,
+                size_t growth_chunk = DEFAULT_GROWTH_CHUNK);
+
+        static constexpr size_t DEFAULT_BUFFER_SIZE = 4 * 1024 * 1024;
+        static constexpr size_t DEFAULT_GROWTH_CHUNK = 64 * 1024 * 1024;
+
+        // Started events are persisted with their environment map reduced
+        // to a delta against the first event's environment. The reader
+        // reconstructs the full map transparently.
+        //
+        // Uncompressed files also collect an index footer (offset, kind
+        // and reporter id per record), appended when the writer closes.
+        // When the output is not a regular file (a pipe to a concurrent
+        // consumer), the footer is omitted, so the stream stays a plain
+        // sequence of event records.
         [[nodiscard]] rust::Result<int> insert_event(const rpc::Event &event);
 
+        // Appends every event of the batch, in order. The records land in
+        // the file one by one (the on-disk format stays a plain sequence
+        // of event records, readable by any reader), only the buffering
+        // and the bookkeeping costs are paid once per batch. Returns the
+        // number of written events.
+        [[nodiscard]] rust::Result<int> insert_batch(const rpc::EventBatch &batch);
+
+        // Enables timed snapshot points: at most every `interval`, the
+        // buffered records are flushed to the file and a sidecar
+        // checkpoint next to it (`<file>.snapshot`, holding the record
+        // count and the safe byte offset) is replaced atomically. A
+        // concurrently running consumer can then process everything up
+        // to the last checkpoint while the session is still recording.
+        // Only meaningful for an indexed regular file output, a no-op
+        // otherwise. The sidecar is removed when the writer closes; the
+        // index footer supersedes it.
+        void enable_snapshots(std::chrono::milliseconds interval) noexcept;
+
+        // Enables size based rotation: when the written file grows past
+        // `limit` bytes, its index footer is appended, the file is closed
+        // and the records continue in a numbered sibling (`<file>.1`,
+        // `<file>.2`, ...). Every segment is a complete database on its
+        // own (the environment baseline and the reference dictionaries
+        // restart with it), and a manifest next to the first segment
+        // (`<file>.segments`) lists the chain in order. The manifest
+        // line of a closed segment also carries a `NameFilter` over the
+        // executable basenames the segment recorded (tab separated, in
+        // hex), letting a consumer after one program skip the segments
+        // without it. A long running
+        // session then occupies bounded disk space: a consumer which
+        // processed a rotated out segment can delete it. Only meaningful
+        // for an indexed regular file output, a no-op otherwise.
+        void enable_segmentation(size_t limit) noexcept;
+
     private:
+        [[nodiscard]] rust::Result<int> write_event(const rpc::Event &event);
+        void to_reference(rpc::Event &event);
+        void to_string_reference(rpc::Event &event);
+        [[nodiscard]] rpc::Event to_delta(const rpc::Event &event) const;
+        void write_index() noexcept;
+        void preallocate() noexcept;
+        void link_into_place() noexcept;
+        void maybe_snapshot() noexcept;
+        void maybe_rotate() noexcept;
+        void write_manifest() noexcept;
+        [[nodiscard]] fs::path segment_path(size_t segment) const;
+        [[nodiscard]] fs::path manifest_file() const;
+        [[nodiscard]] fs::path snapshot_file() const;
+        [[nodiscard]] google::protobuf::io::ZeroCopyOutputStream *stream() noexcept;
         [[nodiscard]] std::runtime_error error() noexcept;
 
     public:
-        explicit EventsDatabaseWriter(fs::path file, StreamPtr stream) noexcept;
+        EventsDatabaseWriter(fs::path file, StreamPtr stream, bool indexed, int fd, size_t buffer_size, size_t growth_chunk, fs::path link_target) noexcept;
+#ifdef HAVE_ZSTD
+        EventsDatabaseWriter(fs::path file, std::unique_ptr<ZstdOutputStream> compressor, size_t buffer_size) noexcept;
+#endif
         ~EventsDatabaseWriter() noexcept;
 
         NON_DEFAULT_CONSTRUCTABLE(EventsDatabaseWriter);
@@ -53,6 +190,40 @@ namespace ic::collect::db {
 
     private:
         fs::path file_;
-        StreamPtr stream_;
+        std::map<std::string, std::string> baseline_;
+        // fingerprint of a started command -> the reporter id which
+        // persisted it first.
+        std::unordered_map<std::string, uint64_t> commands_;
+        // The program paths and the working directories already stored
+        // verbatim, keyed by their first holder. (The string dictionary
+        // of the database: later executions reference instead of repeat.)
+        std::unordered_map<std::string, uint64_t> executables_;
+        std::unordered_map<std::string, uint64_t> directories_;
+        rpc::EventIndex index_;
+        // running FNV-1a hash of the written records, stored in the
+        // index footer. (See the EventIndex message.)
+        uint64_t content_hash_;
+        bool indexed_;
+        StreamPtr plain_;
+        int fd_;
+        size_t buffer_size_;
+        size_t growth_chunk_;
+        uint64_t allocated_;
+        // zero keeps the snapshots off. (See `enable_snapshots`.)
+        std::chrono::milliseconds snapshot_interval_;
+        std::chrono::steady_clock::time_point last_snapshot_;
+        // zero keeps the rotation off. (See `enable_segmentation`.)
+        size_t segment_limit_;
+        size_t segment_;
+        // the name filter of the open segment (still collecting), and
+        // the published filters of the closed ones, in manifest order
+        // and in their hex form.
+        NameFilter name_filter_;
+        std::vector<std::string> closed_filters_;
+        fs::path link_target_;
+#ifdef HAVE_ZSTD
+        std::unique_ptr<ZstdOutputStream> compressor_;
+        std::unique_ptr<google::protobuf::io::CopyingOutputStreamAdaptor> compressed_;
+#endif
     };
 }
@@ -0,0 +1,151 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ZstdStreams.h"
+
+#ifdef HAVE_ZSTD
+
+#include <cerrno>
+
+#include <unistd.h>
+
+namespace {
+
+    bool write_all(int fd, const char *buffer, size_t size) {
+        size_t written = 0;
+        while (written < size) {
+            const ssize_t rc = ::write(fd, buffer + written, size - written);
+            if (rc == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            written += rc;
+        }
+        return true;
+    }
+}
+
+namespace ic::collect::db {
+
+    ZstdOutputStream::ZstdOutputStream(int fd) noexcept
+            : fd_(fd)
+            , errno_(0)
+            , context_(ZSTD_createCStream())
+            , output_(ZSTD_CStreamOutSize())
+    { }
+
+    ZstdOutputStream::~ZstdOutputStream() noexcept {
+        Close();
+    }
+
+    bool ZstdOutputStream::Write(const void *buffer, int size) {
+        if (context_ == nullptr || fd_ == -1) {
+            return false;
+        }
+        ZSTD_inBuffer input = { buffer, static_cast<size_t>(size), 0 };
+        return drain(input, ZSTD_e_continue);
+    }
+
+    bool ZstdOutputStream::Close() noexcept {
+        bool result = true;
+        if (fd_ != -1) {
+            if (context_ != nullptr) {
+                ZSTD_inBuffer input = { nullptr, 0, 0 };
+                result = drain(input, ZSTD_e_end);
+            }
+            result = (::close(fd_) == 0) && result;
+            fd_ = -1;
+        }
+        if (context_ != nullptr) {
+            ZSTD_freeCStream(context_);
+            context_ = nullptr;
+        }
+        return result;
+    }
+
+    bool ZstdOutputStream::drain(ZSTD_inBuffer &input, ZSTD_EndDirective mode) {
+        for (;;) {
+            ZSTD_outBuffer output = { output_.data(), output_.size(), 0 };
+            const size_t rc = ZSTD_compressStream2(context_, &output, &input, mode);
+            if (ZSTD_isError(rc)) {
+                errno_ = EIO;
+                return false;
+            }
+            if (!write_all(fd_, output_.data(), output.pos)) {
+                errno_ = errno;
+                return false;
+            }
+            const bool done = (mode == ZSTD_e_end) ? (rc == 0) : (input.pos == input.size);
+            if (done) {
+                return true;
+            }
+        }
+    }
+
+    ZstdInputStream::ZstdInputStream(int fd) noexcept
+            : fd_(fd)
+            , errno_(0)
+            , context_(ZSTD_createDStream())
+            , input_(ZSTD_DStreamInSize())
+            , in_({ input_.data(), 0, 0 })
+    { }
+
+    ZstdInputStream::~ZstdInputStream() noexcept {
+        if (context_ != nullptr) {
+            ZSTD_freeDStream(context_);
+        }
+        if (fd_ != -1) {
+            ::close(fd_);
+        }
+    }
+
+    int ZstdInputStream::Read(void *buffer, int size) {
+        if (context_ == nullptr || fd_ == -1) {
+            return -1;
+        }
+        ZSTD_outBuffer output = { buffer, static_cast<size_t>(size), 0 };
+        while (output.pos < output.size) {
+            if (in_.pos == in_.size) {
+                const ssize_t rc = ::read(fd_, input_.data(), input_.size());
+                if (rc == -1) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    errno_ = errno;
+                    return -1;
+                }
+                if (rc == 0) {
+                    // end of file; return what has been decompressed so far.
+                    break;
+                }
+                in_ = { input_.data(), static_cast<size_t>(rc), 0 };
+            }
+            const size_t rc = ZSTD_decompressStream(context_, &output, &in_);
+            if (ZSTD_isError(rc)) {
+                errno_ = EIO;
+                return -1;
+            }
+        }
+        return static_cast<int>(output.pos);
+    }
+}
+
+#endif
@@ -0,0 +1,90 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#ifdef HAVE_ZSTD
+
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+
+#include <zstd.h>
+
+#include <vector>
+
+namespace ic::collect::db {
+
+    // The first bytes of every zstd frame, used to recognize a compressed
+    // events database. (The delimited protobuf stream can not start with
+    // these bytes, because the varint length prefix has no `0x28` tag.)
+    constexpr unsigned char ZSTD_FRAME_MAGIC[4] = { 0x28, 0xb5, 0x2f, 0xfd };
+
+    // Compresses everything written to it into a single zstd frame on the
+    // given file descriptor. Meant to be used through the protobuf
+    // `CopyingOutputStreamAdaptor`, which does the buffering in front.
+    class ZstdOutputStream final : public google::protobuf::io::CopyingOutputStream {
+    public:
+        explicit ZstdOutputStream(int fd) noexcept;
+        ~ZstdOutputStream() noexcept override;
+
+        bool Write(const void *buffer, int size) override;
+        // Finish the zstd frame and close the file. Called by the
+        // destructor, but the caller can run it earlier to see the result.
+        bool Close() noexcept;
+
+        [[nodiscard]] int GetErrno() const noexcept { return errno_; }
+
+        NON_DEFAULT_CONSTRUCTABLE(ZstdOutputStream);
+        NON_COPYABLE_NOR_MOVABLE(ZstdOutputStream);
+
+    private:
+        bool drain(ZSTD_inBuffer &input, ZSTD_EndDirective mode);
+
+    private:
+        int fd_;
+        int errno_;
+        ZSTD_CStream *context_;
+        std::vector<char> output_;
+    };
+
+    // Decompresses a zstd frame from the given file descriptor. Meant to be
+    // used through the protobuf `CopyingInputStreamAdaptor`.
+    class ZstdInputStream final : public google::protobuf::io::CopyingInputStream {
+    public:
+        explicit ZstdInputStream(int fd) noexcept;
+        ~ZstdInputStream() noexcept override;
+
+        int Read(void *buffer, int size) override;
+
+        [[nodiscard]] int GetErrno() const noexcept { return errno_; }
+
+        NON_DEFAULT_CONSTRUCTABLE(ZstdInputStream);
+        NON_COPYABLE_NOR_MOVABLE(ZstdInputStream);
+
+    private:
+        int fd_;
+        int errno_;
+        ZSTD_DStream *context_;
+        std::vector<char> input_;
+        ZSTD_inBuffer in_;
+    };
+}
+
+#endif
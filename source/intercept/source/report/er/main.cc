@@ -0,0 +1,74 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// The minimal reporter.
+//
+// Speaks the command line of the wrapper process (the preload library
+// assembles it), but reports the start event over the collector's event
+// socket with the hand written serializer of the preload library, and
+// then replaces itself with the intercepted command. No gRPC, protobuf
+// or logging library is linked: the dynamic loader has almost nothing
+// to relocate, which matters because the loader time dominates the
+// lifetime of a trivial reporter. (Statically linked when the platform
+// allows, then the loader has exactly nothing to do.)
+//
+// The trade offs against the featureful wrapper: the termination of the
+// command is not reported (the same fidelity the direct report mode
+// has), and there is no verbose logging. The sessions fall back to the
+// wrapper for the verbose runs.
+
+#include "config.h"
+#include "report/libexec/Report.h"
+#include "report/libexec/Session.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+
+extern char **environ;
+
+int main(int argc, char *argv[])
+{
+    // The flags before the command are the wrapper's; only the command
+    // itself is needed here. (The destination flag names the gRPC
+    // address, the socket to report to is taken from the environment.)
+    const char *path = nullptr;
+    char *const *command = nullptr;
+    for (int idx = 1; idx < argc; ++idx) {
+        if (std::strcmp(argv[idx], cmd::wrapper::FLAG_EXECUTE) == 0 && idx + 1 < argc) {
+            path = argv[++idx];
+        } else if (std::strcmp(argv[idx], cmd::wrapper::FLAG_COMMAND) == 0) {
+            command = argv + idx + 1;
+            break;
+        }
+    }
+    if (path == nullptr || command == nullptr || *command == nullptr) {
+        return EXIT_FAILURE;
+    }
+
+    el::Session session;
+    session.direct = std::getenv(cmd::library::KEY_DIRECT);
+    // A failed report costs an event, not the build: the command runs
+    // either way.
+    el::report::send_started(session, path, command, environ, getpid(), getppid());
+
+    ::execv(path, command);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,55 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "report/libexec/Arena.h"
+
+#include <sys/mman.h>
+
+namespace el {
+
+    Arena::Arena(size_t count) noexcept
+            : buffer_()
+            , mapped_(nullptr)
+            , mapped_size_(0)
+    {
+        if (count > EMBEDDED_COUNT) {
+            mapped_size_ = count * sizeof(const char*);
+            void* address = ::mmap(nullptr, mapped_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (address != MAP_FAILED) {
+                mapped_ = address;
+            }
+        }
+    }
+
+    Arena::~Arena() noexcept
+    {
+        if (mapped_ != nullptr) {
+            ::munmap(mapped_, mapped_size_);
+        }
+    }
+
+    const char** Arena::data() noexcept
+    {
+        if (mapped_ != nullptr) {
+            return static_cast<const char**>(mapped_);
+        }
+        // The mapping failure leaves the size set, but no address.
+        return (mapped_size_ == 0) ? buffer_ : nullptr;
+    }
+}
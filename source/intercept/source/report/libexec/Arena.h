@@ -0,0 +1,66 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include <cstddef>
+
+namespace el {
+
+    /**
+     * Scratch storage for a pointer array of a single intercepted call.
+     *
+     * The library shall not call `malloc`, but the wrapper command it
+     * assembles grows with the argument list of the intercepted call,
+     * which has no usable upper bound. (Linker invocations can carry
+     * hundreds of kilobytes of arguments.) The common case is served
+     * from an embedded buffer, the over sized ones from an anonymous
+     * memory mapping. The storage lives as long as this object.
+     */
+    class Arena {
+    public:
+        /**
+         * Reserve storage for a pointer array.
+         *
+         * @param count the number of elements the array shall hold.
+         */
+        explicit Arena(size_t count) noexcept;
+
+        ~Arena() noexcept;
+
+        /**
+         * @return the address of the reserved array, or nullptr if the
+         *         memory mapping failed.
+         */
+        [[nodiscard]]
+        const char** data() noexcept;
+
+        NON_DEFAULT_CONSTRUCTABLE(Arena);
+        NON_COPYABLE_NOR_MOVABLE(Arena);
+
+    private:
+        static constexpr size_t EMBEDDED_COUNT = 512;
+
+        const char* buffer_[EMBEDDED_COUNT];
+        void* mapped_;
+        size_t mapped_size_;
+    };
+}
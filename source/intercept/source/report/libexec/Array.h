@@ -35,6 +35,10 @@ namespace el::array {
         if (it == nullptr)
             return nullptr;
 
+        // Four elements per round; the conditions short circuit, so no
+        // element past the terminator is read.
+        while (it[0] != 0 && it[1] != 0 && it[2] != 0 && it[3] != 0)
+            it += 4;
         while (*it != 0)
             ++it;
         return it;
@@ -69,6 +73,17 @@ namespace el::array {
     {
         auto src_it = src_begin;
         auto dst_it = dst_begin;
+        // Four elements per round: the arrays hold pointer sized
+        // elements, and the unrolled rounds let the compiler emit wide
+        // loads and stores. (The shim cannot call into libc for this.)
+        while (src_end - src_it >= 4 && dst_end - dst_it >= 4) {
+            dst_it[0] = src_it[0];
+            dst_it[1] = src_it[1];
+            dst_it[2] = src_it[2];
+            dst_it[3] = src_it[3];
+            src_it += 4;
+            dst_it += 4;
+        }
         for (; src_it != src_end && dst_it != dst_end;)
             *dst_it++ = *src_it++;
 
@@ -87,7 +102,13 @@ namespace el::array {
     template <typename T>
     constexpr bool equal_n(T* const lhs, T* const rhs, const size_t length) noexcept
     {
-        for (size_t idx = 0; idx < length; ++idx) {
+        size_t idx = 0;
+        for (; idx + 4 <= length; idx += 4) {
+            if (lhs[idx] != rhs[idx] || lhs[idx + 1] != rhs[idx + 1]
+                    || lhs[idx + 2] != rhs[idx + 2] || lhs[idx + 3] != rhs[idx + 3])
+                return false;
+        }
+        for (; idx < length; ++idx) {
             if (lhs[idx] != rhs[idx])
                 return false;
         }
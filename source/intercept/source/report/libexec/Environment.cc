@@ -39,4 +39,24 @@ namespace el::env {
         }
         return nullptr;
     }
+
+    void get_env_values(const char **envp, const char *const *keys, const char **values, const size_t count) noexcept
+    {
+        size_t remaining = count;
+        for (const char **it = envp; (*it != nullptr) && (remaining > 0); ++it) {
+            const char *const current = *it;
+            for (size_t idx = 0; idx < count; ++idx) {
+                if (values[idx] != nullptr)
+                    continue;
+                const size_t key_size = el::array::length(keys[idx]);
+                if (!el::array::equal_n(keys[idx], current, key_size))
+                    continue;
+                if (current[key_size] != '=')
+                    continue;
+                values[idx] = current + key_size + 1;
+                --remaining;
+                break;
+            }
+        }
+    }
 }
@@ -19,6 +19,8 @@
 
 #pragma once
 
+#include <cstddef>
+
 namespace el::env {
 
     /**
@@ -32,4 +34,21 @@ namespace el::env {
      * @return the value of the environment.
      */
     const char* get_env_value(const char** envp, const char* key) noexcept;
+
+    /**
+     * Returns the values for multiple environment names, from the given
+     * environment array, in a single pass over the array.
+     *
+     * The scan stops as soon as all keys are found. (Build shells easily
+     * carry a few hundred environment entries, scanning those once per
+     * key adds up.)
+     *
+     * @param envp the environment array.
+     * @param keys the names of the environments.
+     * @param values the found value addresses, in the order of the keys.
+     *               Entries shall be nullptr initialized by the caller,
+     *               and stay nullptr for the keys which were not found.
+     * @param count the number of keys (and values).
+     */
+    void get_env_values(const char** envp, const char* const* keys, const char** values, size_t count) noexcept;
 }
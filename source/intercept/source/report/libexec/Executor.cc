@@ -17,10 +17,13 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "config.h"
 #include "report/libexec/Executor.h"
 
+#include "Arena.h"
 #include "Array.h"
 #include "Logger.h"
+#include "Report.h"
 #include "Resolver.h"
 #include "Linker.h"
 #include "Session.h"
@@ -28,6 +31,8 @@
 #include <algorithm>
 #include <cerrno>
 
+#include <unistd.h>
+
 namespace {
 
     constexpr el::log::Logger LOGGER("Executor.cc");
@@ -48,6 +53,14 @@ namespace {
         }                                               \
     } while (false)
 
+#define CHECK_ARENA(PTR_)                               \
+    do {                                                \
+        if (nullptr == (PTR_)) {                        \
+            LOGGER.warning("scratch mapping failed");   \
+            return rust::Err(ENOMEM);                   \
+        }                                               \
+    } while (false)
+
     // Util class to create command arguments to execute the intercept process.
     //
     // Use this class to allocate buffer and assemble the content of it.
@@ -62,19 +75,17 @@ namespace {
         [[nodiscard]]
         constexpr size_t length() const noexcept
         {
-            return (session.verbose ? 6 : 7) + el::array::length(argv) + 1;
+            // the prefix, the execute and command flags with the path,
+            // the arguments and the terminating null.
+            return session.prefix_size + 3 + el::array::length(argv) + 1;
         }
 
         constexpr void assemble(const char** it) const noexcept
         {
             const char** const it_end = it + length();
 
-            *it++ = session.reporter;
-            *it++ = cmd::wrapper::FLAG_DESTINATION;
-            *it++ = session.destination;
-            if (session.verbose) {
-                *it++ = cmd::wrapper::FLAG_VERBOSE;
-            }
+            // the constant front was composed at load time.
+            it = el::array::copy(session.prefix, session.prefix + session.prefix_size, it, it_end);
             *it++ = cmd::wrapper::FLAG_EXECUTE;
             *it++ = path;
             *it++ = cmd::wrapper::FLAG_COMMAND;
@@ -96,10 +107,50 @@ namespace {
         const char* path;
         char* const* const argv;
     };
-}
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wvla"
+    // In direct report mode the start event is sent from this process and
+    // the executable is called without the wrapper process. Falls back to
+    // the wrapper if the event could not be delivered.
+    bool report_directly(const el::Session& session, const char* path, char* const* argv, char* const* envp) noexcept
+    {
+        return (session.direct != nullptr)
+            && el::report::send_started(session, path, argv, envp, getpid(), getppid());
+    }
+
+    // Tells if the execution shall pass through without reporting. When
+    // the session carries a "report only" list (colon separated program
+    // names), a program missing from it is executed directly: no wrapper
+    // is spawned and no event reaches the collector.
+    bool skip_report(const el::Session& session, const char* path) noexcept
+    {
+        if (session.only == nullptr) {
+            return false;
+        }
+        // the basename of the resolved executable.
+        const char* name = path;
+        for (const char* it = path; *it != 0; ++it) {
+            if (*it == '/') {
+                name = it + 1;
+            }
+        }
+        for (const char* it = session.only; *it != 0;) {
+            const char* end = it;
+            while (*end != 0 && *end != ':') {
+                ++end;
+            }
+            const char* candidate = name;
+            while (it != end && *candidate != 0 && *it == *candidate) {
+                ++it;
+                ++candidate;
+            }
+            if (it == end && *candidate == 0) {
+                return false;
+            }
+            it = (*end == 0) ? end : end + 1;
+        }
+        return true;
+    }
+}
 
 namespace el {
 
@@ -113,10 +164,19 @@ namespace el {
     {
         CHECK_SESSION(session_);
         CHECK_POINTER(path);
+        BEAR_PROBE1(exec, path);
 
         if (auto executable = resolver_.from_current_directory(path); executable.is_ok()) {
+            if (skip_report(session_, executable.unwrap())) {
+                return linker_.execve(executable.unwrap(), argv, envp);
+            }
+            if (report_directly(session_, executable.unwrap(), argv, envp)) {
+                return linker_.execve(executable.unwrap(), argv, envp);
+            }
             const CommandBuilder cmd(session_, executable.unwrap(), argv);
-            const char* dst[cmd.length()];
+            el::Arena arena(cmd.length());
+            const char** dst = arena.data();
+            CHECK_ARENA(dst);
             cmd.assemble(dst);
 
             return linker_.execve(cmd.file(), const_cast<char* const*>(dst), envp);
@@ -129,10 +189,19 @@ namespace el {
     {
         CHECK_SESSION(session_);
         CHECK_POINTER(file);
+        BEAR_PROBE1(exec, file);
 
         if (auto executable = resolver_.from_path(file, const_cast<const char **>(envp)); executable.is_ok()) {
+            if (skip_report(session_, executable.unwrap())) {
+                return linker_.execve(executable.unwrap(), argv, envp);
+            }
+            if (report_directly(session_, executable.unwrap(), argv, envp)) {
+                return linker_.execve(executable.unwrap(), argv, envp);
+            }
             const CommandBuilder cmd(session_, executable.unwrap(), argv);
-            const char* dst[cmd.length()];
+            el::Arena arena(cmd.length());
+            const char** dst = arena.data();
+            CHECK_ARENA(dst);
             cmd.assemble(dst);
 
             return linker_.execve(cmd.file(), const_cast<char* const*>(dst), envp);
@@ -145,10 +214,19 @@ namespace el {
     {
         CHECK_SESSION(session_);
         CHECK_POINTER(file);
+        BEAR_PROBE1(exec, file);
 
         if (auto executable = resolver_.from_search_path(file, search_path); executable.is_ok()) {
+            if (skip_report(session_, executable.unwrap())) {
+                return linker_.execve(executable.unwrap(), argv, envp);
+            }
+            if (report_directly(session_, executable.unwrap(), argv, envp)) {
+                return linker_.execve(executable.unwrap(), argv, envp);
+            }
             const CommandBuilder cmd(session_, executable.unwrap(), argv);
-            const char* dst[cmd.length()];
+            el::Arena arena(cmd.length());
+            const char** dst = arena.data();
+            CHECK_ARENA(dst);
             cmd.assemble(dst);
 
             return linker_.execve(cmd.file(), const_cast<char* const*>(dst), envp);
@@ -163,10 +241,19 @@ namespace el {
     {
         CHECK_SESSION(session_);
         CHECK_POINTER(path);
+        BEAR_PROBE1(exec, path);
 
         if (auto executable = resolver_.from_current_directory(path); executable.is_ok()) {
+            if (skip_report(session_, executable.unwrap())) {
+                return linker_.posix_spawn(pid, executable.unwrap(), file_actions, attrp, argv, envp);
+            }
+            if (session_.direct != nullptr) {
+                return posix_spawn_directly(pid, executable.unwrap(), file_actions, attrp, argv, envp);
+            }
             const CommandBuilder cmd(session_, executable.unwrap(), argv);
-            const char* dst[cmd.length()];
+            el::Arena arena(cmd.length());
+            const char** dst = arena.data();
+            CHECK_ARENA(dst);
             cmd.assemble(dst);
 
             return linker_.posix_spawn(pid, cmd.file(), file_actions, attrp, const_cast<char* const*>(dst), envp);
@@ -181,10 +268,19 @@ namespace el {
     {
         CHECK_SESSION(session_);
         CHECK_POINTER(file);
+        BEAR_PROBE1(exec, file);
 
         if (auto executable = resolver_.from_path(file, const_cast<const char **>(envp)); executable.is_ok()) {
+            if (skip_report(session_, executable.unwrap())) {
+                return linker_.posix_spawn(pid, executable.unwrap(), file_actions, attrp, argv, envp);
+            }
+            if (session_.direct != nullptr) {
+                return posix_spawn_directly(pid, executable.unwrap(), file_actions, attrp, argv, envp);
+            }
             const CommandBuilder cmd(session_, executable.unwrap(), argv);
-            const char* dst[cmd.length()];
+            el::Arena arena(cmd.length());
+            const char** dst = arena.data();
+            CHECK_ARENA(dst);
             cmd.assemble(dst);
 
             return linker_.posix_spawn(pid, cmd.file(), file_actions, attrp, const_cast<char* const*>(dst), envp);
@@ -192,6 +288,21 @@ namespace el {
             return rust::Err(executable.unwrap_err());
         }
     }
-}
 
-#pragma GCC diagnostic pop
+    rust::Result<int, int> Executor::posix_spawn_directly(pid_t* pid, const char* path, const posix_spawn_file_actions_t* file_actions,
+        const posix_spawnattr_t* attrp, char* const* argv,
+        char* const* envp) const
+    {
+        // The process identifier of the child is known only after the spawn
+        // call, so the start event is reported after it. (There is no wrapper
+        // to fall back to at that point. If the report fails, the event is
+        // lost, but the build is not disturbed.)
+        pid_t child = 0;
+        pid_t* child_ptr = (pid != nullptr) ? pid : &child;
+        auto result = linker_.posix_spawn(child_ptr, path, file_actions, attrp, argv, envp);
+        if (result.is_ok()) {
+            el::report::send_started(session_, path, argv, envp, *child_ptr, getpid());
+        }
+        return result;
+    }
+}
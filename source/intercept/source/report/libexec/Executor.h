@@ -76,6 +76,13 @@ namespace el {
             char* const argv[],
             char* const envp[]) const;
 
+    private:
+        rust::Result<int, int> posix_spawn_directly(pid_t* pid, const char* path,
+            const posix_spawn_file_actions_t* file_actions,
+            const posix_spawnattr_t* attrp,
+            char* const argv[],
+            char* const envp[]) const;
+
     private:
         el::Linker const &linker_;
         el::Session const &session_;
@@ -24,6 +24,25 @@
 
 namespace {
 
+    using execve_t = int (*)(
+        const char* path,
+        char* const argv[],
+        char* const envp[]);
+
+    using posix_spawn_t = int (*)(
+        pid_t* pid,
+        const char* path,
+        const posix_spawn_file_actions_t* file_actions,
+        const posix_spawnattr_t* attrp,
+        char* const argv[],
+        char* const envp[]);
+
+    // The table of the resolved symbols, filled by `Linker::load` when
+    // the library is loaded. (No locking needed: the library constructor
+    // runs before any of the intercepted calls can happen.)
+    execve_t EXECVE_FP = nullptr;
+    posix_spawn_t POSIX_SPAWN_FP = nullptr;
+
     template <typename T>
     T dynamic_linker(char const* const name)
     {
@@ -33,11 +52,15 @@ namespace {
 
 namespace el {
 
-    rust::Result<int, int> Linker::execve(const char* path, char* const* argv, char* const* envp) const noexcept
+    void Linker::load() noexcept
     {
-        using type = int (*)(const char*, char* const[], char* const[]);
+        EXECVE_FP = dynamic_linker<execve_t>("execve");
+        POSIX_SPAWN_FP = dynamic_linker<posix_spawn_t>("posix_spawn");
+    }
 
-        auto fp = dynamic_linker<type>("execve");
+    rust::Result<int, int> Linker::execve(const char* path, char* const* argv, char* const* envp) const noexcept
+    {
+        auto fp = (EXECVE_FP != nullptr) ? EXECVE_FP : dynamic_linker<execve_t>("execve");
         if (fp == nullptr) {
             return rust::Err(EINVAL);
         }
@@ -55,15 +78,7 @@ namespace el {
         char* const* argv,
         char* const* envp) const noexcept
     {
-        using type = int (*)(
-            pid_t * pid,
-            const char* path,
-            const posix_spawn_file_actions_t* file_actions,
-            const posix_spawnattr_t* attrp,
-            char* const argv[],
-            char* const envp[]);
-
-        auto fp = dynamic_linker<type>("posix_spawn");
+        auto fp = (POSIX_SPAWN_FP != nullptr) ? POSIX_SPAWN_FP : dynamic_linker<posix_spawn_t>("posix_spawn");
         if (fp == nullptr) {
             return rust::Err(EINVAL);
         }
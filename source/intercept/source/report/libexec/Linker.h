@@ -38,6 +38,16 @@ namespace el {
     struct Linker {
         virtual ~Linker() noexcept = default;
 
+        /**
+         * Resolve all intercepted symbols eagerly.
+         *
+         * Called once from the library constructor. After this the symbol
+         * lookup methods serve the calls from a resolved function pointer
+         * table, without a `dlsym` call per intercepted execution. (If the
+         * resolution did not run yet, the methods fall back to `dlsym`.)
+         */
+        static void load() noexcept;
+
         [[nodiscard]]
         virtual rust::Result<int, int> execve(
             const char* path,
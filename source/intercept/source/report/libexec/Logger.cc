@@ -23,11 +23,17 @@
 #include <cstdio>
 #include <unistd.h>
 
-namespace {
+namespace el::log {
+
+    Level LEVEL = SILENT;
 
-    el::log::Level LEVEL = el::log::SILENT;
+    void set(Level level)
+    {
+        LEVEL = level;
+        fsync(STDERR_FILENO);
+    }
 
-    void verbose_message(char const* name, char const* message, char const* variable)
+    void write_verbose(char const* name, char const* message, char const* variable) noexcept
     {
         struct timespec ts { 0, 0 };
         if (::clock_gettime(CLOCK_REALTIME, &ts) == -1) {
@@ -40,32 +46,11 @@ namespace {
         ::dprintf(STDERR_FILENO, "[%02d:%02d:%02d.%06ld, el, %d] %s; %s%s\n",
             local_time.tm_hour, local_time.tm_min, local_time.tm_sec, micros, pid, name, message, variable);
     }
-}
-
-namespace el::log {
-
-    void set(Level level)
-    {
-        LEVEL = level;
-        fsync(STDERR_FILENO);
-    }
-
-    void Logger::debug(char const* message) const noexcept
-    {
-        this->debug(message, "");
-    }
-
-    void Logger::debug(char const* message, char const* variable) const noexcept
-    {
-        if (el::log::VERBOSE == LEVEL) {
-            verbose_message(name_, message, variable);
-        }
-    }
 
     void Logger::warning(char const* message) const noexcept
     {
         if (el::log::VERBOSE == LEVEL) {
-            verbose_message(name_, message, "");
+            write_verbose(name_, message, "");
         } else {
             dprintf(STDERR_FILENO, "libexec.so: %s; %s\n", name_, message);
         }
@@ -19,6 +19,8 @@
 
 #pragma once
 
+#include "config.h"
+
 namespace el::log {
 
     enum Level {
@@ -26,9 +28,16 @@ namespace el::log {
         VERBOSE = 1
     };
 
+    // The current level. Use the `set` method to change it, the variable
+    // is exposed only to keep the level check inline in the callers.
+    extern Level LEVEL;
+
     // Not MT safe
     void set(Level);
 
+    // Formats and writes the message. (The level check happened already.)
+    void write_verbose(char const *name, char const *message, char const *variable) noexcept;
+
     class Logger {
     public:
         constexpr explicit Logger(const char *name) noexcept;
@@ -48,4 +57,25 @@ namespace el::log {
     Logger::Logger(const char *name) noexcept
             : name_(name)
     { }
+
+    // The debug calls are on the exec path of every intercepted process.
+    // Keep them down to an inlined check on the level (or to nothing, when
+    // the logging is disabled at build time); the formatting is behind the
+    // out of line write method.
+    inline void Logger::debug(char const *message) const noexcept
+    {
+        this->debug(message, "");
+    }
+
+    inline void Logger::debug(char const *message, char const *variable) const noexcept
+    {
+#ifdef SUPPORT_EXEC_LOG
+        if (VERBOSE == LEVEL) {
+            write_verbose(name_, message, variable);
+        }
+#else
+        (void)message;
+        (void)variable;
+#endif
+    }
 }
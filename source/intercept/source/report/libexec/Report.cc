@@ -0,0 +1,291 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "report/libexec/Report.h"
+
+#include "report/libexec/Array.h"
+#include "report/libexec/Logger.h"
+#include "report/libexec/Session.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+    constexpr el::log::Logger LOGGER("Report.cc");
+
+    // Wire format constants of the `rpc.Event` message. The values are
+    // pre-computed protobuf tags (field number shifted by 3, combined with
+    // the wire type) and have to be in sync with the proto definitions.
+    // (See `intercept.proto` and `supervise.proto` for the field numbers.)
+    constexpr uint8_t EVENT_RID = 0x08; // field 1, varint
+    constexpr uint8_t EVENT_TIMESTAMP = 0x12; // field 2, message
+    constexpr uint8_t EVENT_STARTED = 0x5A; // field 11, message
+    constexpr uint8_t TIMESTAMP_SECONDS = 0x08; // field 1, varint
+    constexpr uint8_t TIMESTAMP_NANOS = 0x10; // field 2, varint
+    constexpr uint8_t STARTED_EXECUTION = 0x0A; // field 1, message
+    constexpr uint8_t STARTED_PID = 0x10; // field 2, varint
+    constexpr uint8_t STARTED_PPID = 0x18; // field 3, varint
+    constexpr uint8_t EXECUTION_EXECUTABLE = 0x0A; // field 1, string
+    constexpr uint8_t EXECUTION_ARGUMENTS = 0x12; // field 2, repeated string
+    constexpr uint8_t EXECUTION_WORKING_DIR = 0x1A; // field 3, string
+    constexpr uint8_t EXECUTION_ENVIRONMENT = 0x22; // field 4, map entry
+    constexpr uint8_t MAP_KEY = 0x0A; // field 1, string
+    constexpr uint8_t MAP_VALUE = 0x12; // field 2, string
+
+    constexpr size_t varint_length(uint64_t value) noexcept
+    {
+        size_t result = 1;
+        for (value >>= 7u; value != 0; value >>= 7u)
+            ++result;
+        return result;
+    }
+
+    // The size of a length delimited field with a single byte tag.
+    constexpr size_t field_length(size_t payload) noexcept
+    {
+        return 1 + varint_length(payload) + payload;
+    }
+
+    // The size of a varint field with a single byte tag.
+    constexpr size_t varint_field_length(uint64_t value) noexcept
+    {
+        return 1 + varint_length(value);
+    }
+
+    // Finds the key/value separator in an environment entry.
+    // Returns nullptr if the entry is malformed.
+    constexpr const char* separator(const char* entry) noexcept
+    {
+        for (auto it = entry; *it != 0; ++it) {
+            if (*it == '=')
+                return it;
+        }
+        return nullptr;
+    }
+
+    size_t environment_entry_length(const char* entry) noexcept
+    {
+        const char* const sep = separator(entry);
+        if (sep == nullptr)
+            return 0;
+
+        const size_t key_size = sep - entry;
+        const size_t value_size = el::array::length(sep + 1);
+        return field_length(key_size) + field_length(value_size);
+    }
+
+    size_t execution_length(const char* path, char* const* argv, char* const* envp, const char* cwd) noexcept
+    {
+        size_t result = field_length(el::array::length(path));
+        for (auto it = argv; *it != nullptr; ++it)
+            result += field_length(el::array::length(*it));
+        result += field_length(el::array::length(cwd));
+        for (auto it = envp; (envp != nullptr) && (*it != nullptr); ++it) {
+            if (const size_t entry = environment_entry_length(*it); entry != 0)
+                result += field_length(entry);
+        }
+        return result;
+    }
+
+    // Serializes protobuf wire format entities into a socket.
+    //
+    // It buffers the output on the stack and flushes it to the socket when
+    // the buffer is full. (Can't allocate memory, like the rest of this
+    // library.)
+    class Writer {
+    public:
+        explicit Writer(int fd) noexcept
+                : fd_(fd)
+                , top_(0)
+                , failed_(false)
+        { }
+
+        void varint(uint64_t value) noexcept
+        {
+            while (value >= 0x80u) {
+                byte((value & 0x7Fu) | 0x80u);
+                value >>= 7u;
+            }
+            byte(value);
+        }
+
+        void tag(uint8_t value) noexcept
+        {
+            byte(value);
+        }
+
+        void bytes(const char* src, size_t count) noexcept
+        {
+            for (size_t idx = 0; idx < count; ++idx)
+                byte(src[idx]);
+        }
+
+        void string(uint8_t tag_, const char* src, size_t count) noexcept
+        {
+            tag(tag_);
+            varint(count);
+            bytes(src, count);
+        }
+
+        bool flush() noexcept
+        {
+            for (size_t done = 0; done < top_;) {
+                const ssize_t written = ::write(fd_, buffer_ + done, top_ - done);
+                if (written == -1) {
+                    if (errno == EINTR)
+                        continue;
+                    failed_ = true;
+                    break;
+                }
+                done += written;
+            }
+            top_ = 0;
+            return !failed_;
+        }
+
+        [[nodiscard]] bool ok() const noexcept
+        {
+            return !failed_;
+        }
+
+    private:
+        void byte(uint8_t value) noexcept
+        {
+            if (top_ == sizeof(buffer_))
+                flush();
+            buffer_[top_++] = value;
+        }
+
+    private:
+        int fd_;
+        size_t top_;
+        bool failed_;
+        char buffer_[8192];
+    };
+
+    void write_execution(Writer& writer, const char* path, char* const* argv, char* const* envp, const char* cwd) noexcept
+    {
+        writer.string(EXECUTION_EXECUTABLE, path, el::array::length(path));
+        for (auto it = argv; *it != nullptr; ++it)
+            writer.string(EXECUTION_ARGUMENTS, *it, el::array::length(*it));
+        writer.string(EXECUTION_WORKING_DIR, cwd, el::array::length(cwd));
+        for (auto it = envp; (envp != nullptr) && (*it != nullptr); ++it) {
+            const char* const sep = separator(*it);
+            if (sep == nullptr)
+                continue;
+            writer.tag(EXECUTION_ENVIRONMENT);
+            writer.varint(environment_entry_length(*it));
+            writer.string(MAP_KEY, *it, sep - *it);
+            writer.string(MAP_VALUE, sep + 1, el::array::length(sep + 1));
+        }
+    }
+
+    int connect_to(const char* socket_path) noexcept
+    {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        const size_t size = el::array::length(socket_path);
+        if (size >= sizeof(address.sun_path))
+            return -1;
+        el::array::copy(socket_path, socket_path + size + 1, address.sun_path, address.sun_path + sizeof(address.sun_path));
+
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd == -1)
+            return -1;
+        if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == -1) {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+}
+
+namespace el::report {
+
+    bool send_started(
+        Session const& session,
+        const char* path,
+        char* const* argv,
+        char* const* envp,
+        const pid_t pid,
+        const pid_t ppid) noexcept
+    {
+        if (session.direct == nullptr || path == nullptr || argv == nullptr)
+            return false;
+
+        char cwd[PATH_MAX];
+        if (::getcwd(cwd, sizeof(cwd)) == nullptr) {
+            LOGGER.debug("send_started failed: getcwd");
+            return false;
+        }
+
+        timespec now = {};
+        ::clock_gettime(CLOCK_REALTIME, &now);
+        const uint64_t rid = (uint64_t(pid) << 32u) ^ uint64_t(now.tv_sec * 1000000000L + now.tv_nsec);
+
+        // Compute the message sizes bottom up. (Nested messages are length
+        // delimited, which requires to know their size before writing them.)
+        const size_t execution_size = execution_length(path, argv, envp, cwd);
+        const size_t started_size = field_length(execution_size)
+                + varint_field_length(pid)
+                + varint_field_length(ppid);
+        const size_t timestamp_size = varint_field_length(now.tv_sec)
+                + varint_field_length(now.tv_nsec);
+
+        const int fd = connect_to(session.direct);
+        if (fd == -1) {
+            LOGGER.debug("send_started failed: connect to ", session.direct);
+            return false;
+        }
+
+        Writer writer(fd);
+        writer.tag(EVENT_RID);
+        writer.varint(rid);
+        writer.tag(EVENT_TIMESTAMP);
+        writer.varint(timestamp_size);
+        writer.tag(TIMESTAMP_SECONDS);
+        writer.varint(now.tv_sec);
+        writer.tag(TIMESTAMP_NANOS);
+        writer.varint(now.tv_nsec);
+        writer.tag(EVENT_STARTED);
+        writer.varint(started_size);
+        writer.tag(STARTED_EXECUTION);
+        writer.varint(execution_size);
+        write_execution(writer, path, argv, envp, cwd);
+        writer.tag(STARTED_PID);
+        writer.varint(pid);
+        writer.tag(STARTED_PPID);
+        writer.varint(ppid);
+        writer.flush();
+        ::close(fd);
+
+        if (!writer.ok()) {
+            LOGGER.debug("send_started failed: write to ", session.direct);
+        }
+        return writer.ok();
+    }
+}
@@ -0,0 +1,55 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <sys/types.h>
+
+namespace el {
+
+    struct Session;
+
+    namespace report {
+
+        /**
+         * Sends a process start event directly to the collector process.
+         *
+         * The event is written to the unix socket the session names (a single
+         * connect, write and close). The content is the same `rpc.Event`
+         * message the wrapper process would report, but serialized by hand
+         * to keep this library free from heap allocation and extra library
+         * dependencies.
+         *
+         * @param session the intercept session parameters.
+         * @param path the resolved path of the executable.
+         * @param argv the arguments of the execution.
+         * @param envp the environment of the execution.
+         * @param pid the process identifier of the execution.
+         * @param ppid the parent process identifier of the execution.
+         * @return true if the event was delivered to the collector.
+         */
+        bool send_started(
+            Session const& session,
+            const char* path,
+            char* const* argv,
+            char* const* envp,
+            pid_t pid,
+            pid_t ppid) noexcept;
+    }
+}
@@ -26,6 +26,7 @@
 
 #include <algorithm>
 #include <cerrno>
+#include <cstdint>
 #include <cstdlib>
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
@@ -38,6 +39,91 @@ namespace {
     bool contains_dir_separator(std::string_view const &candidate) {
         return std::find(candidate.begin(), candidate.end(), DIR_SEPARATOR) != candidate.end();
     }
+
+    // Cache for already resolved executables.
+    //
+    // Shell-heavy builds resolve the same few commands over and over, and
+    // every miss walks all PATH entries with an `access` call each. The
+    // cache is a small open-addressing table in static storage (this code
+    // shall not allocate heap memory), shared by all resolver instances of
+    // the process. A cached entry is not re-validated; like the shell's own
+    // command hash, it becomes stale only when the executable is removed
+    // mid-build, and the exec call reports that anyway.
+    constexpr size_t CACHE_SIZE = 16; // shall be a power of two
+    constexpr size_t CACHE_NAME_MAX = 64;
+
+    struct CacheEntry {
+        char name[CACHE_NAME_MAX];
+        uint32_t path_hash;
+        char result[PATH_MAX];
+    };
+
+    CacheEntry CACHE[CACHE_SIZE];
+
+    constexpr uint32_t hash_init() {
+        return 2166136261u;
+    }
+
+    constexpr uint32_t hash_step(uint32_t hash, char chr) {
+        return (hash ^ static_cast<unsigned char>(chr)) * 16777619u;
+    }
+
+    uint32_t hash_string(const char *it) {
+        uint32_t hash = hash_init();
+        for (; *it != 0; ++it) {
+            hash = hash_step(hash, *it);
+        }
+        return hash;
+    }
+
+    size_t cache_index(std::string_view const &file) {
+        uint32_t hash = hash_init();
+        for (const char chr : file) {
+            hash = hash_step(hash, chr);
+        }
+        return hash & (CACHE_SIZE - 1);
+    }
+
+    bool cache_key_matches(const CacheEntry &entry, std::string_view const &file, uint32_t path_hash) {
+        return entry.path_hash == path_hash
+                && file.size() < CACHE_NAME_MAX
+                && std::string_view(entry.name) == file;
+    }
+
+    const char* cache_lookup(std::string_view const &file, uint32_t path_hash) {
+        const size_t start = cache_index(file);
+        for (size_t probe = 0; probe < CACHE_SIZE; ++probe) {
+            const CacheEntry &entry = CACHE[(start + probe) & (CACHE_SIZE - 1)];
+            if (entry.name[0] == 0) {
+                return nullptr;
+            }
+            if (cache_key_matches(entry, file, path_hash)) {
+                return entry.result;
+            }
+        }
+        return nullptr;
+    }
+
+    void cache_store(std::string_view const &file, uint32_t path_hash, const char *result) {
+        if (file.size() >= CACHE_NAME_MAX || el::array::length(result) >= PATH_MAX) {
+            return;
+        }
+        const size_t start = cache_index(file);
+        // prefer an empty slot, otherwise overwrite the primary one.
+        size_t idx = start;
+        for (size_t probe = 0; probe < CACHE_SIZE; ++probe) {
+            const size_t candidate = (start + probe) & (CACHE_SIZE - 1);
+            if (CACHE[candidate].name[0] == 0) {
+                idx = candidate;
+                break;
+            }
+        }
+        CacheEntry &entry = CACHE[idx];
+        auto it = el::array::copy(file.begin(), file.end(), entry.name, entry.name + CACHE_NAME_MAX);
+        *it = 0;
+        entry.path_hash = path_hash;
+        el::array::copy(result, el::array::end(result) + 1, entry.result, entry.result + PATH_MAX);
+    }
 }
 
 namespace el {
@@ -90,6 +176,13 @@ namespace el {
             // the file contains a dir separator, it is treated as path.
             return from_current_directory(file);
         } else {
+            // serve repeated resolutions of the same file from the cache.
+            const uint32_t path_hash = hash_string(search_path);
+            if (const char *cached = cache_lookup(file, path_hash); cached != nullptr) {
+                array::copy(cached, array::end(cached) + 1, result_, result_ + PATH_MAX);
+                const char *ptr = result_;
+                return rust::Ok(ptr);
+            }
             // otherwise use the given search path to locate the executable.
             for (auto path : el::Paths(search_path)) {
                 // ignore empty entries
@@ -112,6 +205,7 @@ namespace el {
                 }
                 // check if it's okay to execute.
                 if (auto result = from_current_directory(candidate); result.is_ok()) {
+                    cache_store(file, path_hash, result.unwrap_or(candidate));
                     return result;
                 }
             }
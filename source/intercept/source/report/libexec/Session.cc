@@ -30,9 +30,23 @@ namespace el::session {
         if (nullptr == environment)
             return;
 
-        session.reporter = env::get_env_value(environment, cmd::library::KEY_REPORTER);
-        session.destination = env::get_env_value(environment, cmd::library::KEY_DESTINATION);
-        session.verbose = env::get_env_value(environment, cmd::library::KEY_VERBOSE) != nullptr;
+        // A single pass over the environment array serves all the keys.
+        const char* const keys[] = {
+            cmd::library::KEY_REPORTER,
+            cmd::library::KEY_DESTINATION,
+            cmd::library::KEY_VERBOSE,
+            cmd::library::KEY_DIRECT,
+            cmd::library::KEY_ONLY,
+        };
+        constexpr size_t count = sizeof(keys) / sizeof(keys[0]);
+        const char* values[count] = {};
+        env::get_env_values(environment, keys, values, count);
+
+        session.reporter = values[0];
+        session.destination = values[1];
+        session.verbose = values[2] != nullptr;
+        session.direct = values[3];
+        session.only = values[4];
     }
 
     void persist(Session &session, char *begin, char *end) noexcept
@@ -43,6 +57,23 @@ namespace el::session {
         Buffer buffer(begin, end);
         session.reporter = buffer.store(session.reporter);
         session.destination = buffer.store(session.destination);
+        session.direct = buffer.store(session.direct);
+        session.only = buffer.store(session.only);
+    }
+
+    void compose(Session &session) noexcept
+    {
+        if (!is_valid(session))
+            return;
+
+        size_t count = 0;
+        session.prefix[count++] = session.reporter;
+        session.prefix[count++] = cmd::wrapper::FLAG_DESTINATION;
+        session.prefix[count++] = session.destination;
+        if (session.verbose) {
+            session.prefix[count++] = cmd::wrapper::FLAG_VERBOSE;
+        }
+        session.prefix_size = count;
     }
 
     bool is_valid(Session const &session) noexcept
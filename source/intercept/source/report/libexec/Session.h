@@ -19,6 +19,8 @@
 
 #pragma once
 
+#include <cstddef>
+
 namespace el {
 
     class Buffer;
@@ -32,6 +34,19 @@ namespace el {
         char const* reporter = nullptr;
         char const* destination = nullptr;
         bool verbose = false;
+        // Path of the unix socket to report events directly to the collector.
+        // (When it's not set, the events are reported via the wrapper process.)
+        char const* direct = nullptr;
+        // Colon separated list of program names worth recording. When it
+        // is set, the executions of other programs are passed through
+        // without reporting.
+        char const* only = nullptr;
+        // The constant front of the wrapper command (the reporter, the
+        // destination and the verbosity flags), composed once at load
+        // time. The per-exec assembly only appends the intercepted
+        // command after it.
+        char const* prefix[4] = {};
+        size_t prefix_size = 0;
     };
 
     namespace session {
@@ -42,6 +57,10 @@ namespace el {
         // Util method to store the values.
         void persist(Session& session, char* begin, char* end) noexcept;
 
+        // Util method to compose the wrapper command prefix. Shall be
+        // called after the values took their final storage (`persist`).
+        void compose(Session& session) noexcept;
+
         // Util method to check if session is initialized.
         bool is_valid(Session const& session) noexcept;
     }
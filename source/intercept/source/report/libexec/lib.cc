@@ -104,8 +104,10 @@ extern "C" void on_load()
     if (LOADED.exchange(true))
         return;
 
+    el::Linker::load();
     el::session::from(SESSION, environment());
     el::session::persist(SESSION, BUFFER, BUFFER + BUFFER_SIZE);
+    el::session::compose(SESSION);
 
     el::log::Level level = SESSION.verbose ? el::log::VERBOSE : el::log::SILENT;
     el::log::set(level);
@@ -128,6 +130,12 @@ extern "C" void on_unload()
     LOGGER.debug("on_unload");
 }
 
+// The whole exec family (and the posix_spawn variants) is interposed
+// unconditionally. Trimming the set per build brings nothing here: the
+// passthrough targets are resolved once in `on_load`, a shim that the
+// build never calls costs nothing afterwards, and a shim that is called
+// has to report the execution or the compilation is lost from the
+// database. Keeping one symbol set also keeps one library artifact.
 extern "C" int execve(const char* path, char* const argv[], char* const envp[])
 {
     LOGGER.debug("execve path: ", path);
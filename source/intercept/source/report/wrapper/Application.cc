@@ -21,19 +21,23 @@
 #include "report/wrapper/EventReporter.h"
 #include "report/wrapper/RpcClients.h"
 #include "report/wrapper/Application.h"
+#include "ResolveHints.h"
 #include "libmain/ApplicationLogConfig.h"
 #include "libsys/Environment.h"
 #include "libsys/Path.h"
 #include "libsys/Process.h"
-#include "libsys/Signal.h"
 
 #include <spdlog/spdlog.h>
 #include <spdlog/fmt/ostr.h>
 
+#include <csignal>
 #include <filesystem>
+#include <list>
 #include <memory>
+#include <set>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace fs = std::filesystem;
 
@@ -51,7 +55,22 @@ namespace {
         }
     };
 
-    const ApplicationLogConfig APPLICATION_LOG_CONFIG;
+    // The logging setup is deferred: a wrapper exec happens for every
+    // intercepted command of the build, and the common case writes no log
+    // at all. The logger (and its registry, mutexes, pattern) is only
+    // built when something is about to be logged.
+    bool log_initialized = false;
+
+    const ApplicationLogConfig &init_log(bool verbose) {
+        static const ApplicationLogConfig config;
+        if (verbose) {
+            config.initForVerbose();
+        } else if (!log_initialized) {
+            config.initForSilent();
+        }
+        log_initialized = true;
+        return config;
+    }
 
     bool is_wrapper_call(int argc, const char **argv) {
         if (argc > 0) {
@@ -62,6 +81,82 @@ namespace {
         return false;
     }
 
+    // Reduces the reported environment to the captured variable names.
+    //
+    // The session passes the capture list in an environment variable (a
+    // colon separated list of names). Without the list the whole
+    // environment is reported. Shrinking the events here spares both the
+    // transfer and the storage of environments the consumer never reads.
+    //
+    // Only the report shrinks: the supervised process itself runs with
+    // the untouched environment. (The filter applies right before the
+    // started event is sent, never to the execution it spawns from. The
+    // list is read from our own environment, since the resolution has
+    // already scrubbed the session variables from the execution.)
+    sys::env::Vars captured(sys::env::Vars &&environment)
+    {
+        const char *list = getenv(cmd::wrapper::KEY_CAPTURE_ENV);
+        if (list == nullptr) {
+            return std::move(environment);
+        }
+        std::set<std::string> names;
+        for (const auto &entry : sys::path::split(list)) {
+            names.insert(entry.string());
+        }
+        sys::env::Vars result;
+        for (const auto &[key, value] : environment) {
+            if (names.count(key) > 0) {
+                result.emplace(key, value);
+            }
+        }
+        return result;
+    }
+
+    // Answers the executable resolution from the table the collector
+    // published, without talking to the supervisor.
+    //
+    // The table file travels in the session environment. Reading it
+    // mirrors what `Resolve` would do: replace the executable (and the
+    // first argument) with the real program, strip the wrapper directory
+    // from the PATH and scrub the session variables from the environment.
+    // Any failure makes the caller fall back to the RPC.
+    rust::Result<wr::Execution> resolve_locally(const wr::Execution &execution)
+    {
+        const char *hints_file = getenv(cmd::wrapper::KEY_HINTS);
+        if (hints_file == nullptr) {
+            return rust::Err(std::runtime_error("No resolve hints published."));
+        }
+        return domain::ResolveHints::read(fs::path(hints_file))
+                .and_then<wr::Execution>([&execution](const auto &hints) -> rust::Result<wr::Execution> {
+                    const auto candidate = hints.mapping.find(execution.executable.filename().string());
+                    if (candidate == hints.mapping.end()) {
+                        return rust::Err(std::runtime_error("Not recognized wrapper."));
+                    }
+                    auto arguments = execution.arguments;
+                    arguments.front() = candidate->second.string();
+
+                    auto environment = execution.environment.to_map();
+                    if (auto it = environment.find("PATH"); it != environment.end()) {
+                        std::list<fs::path> entries;
+                        for (const auto &entry : sys::path::split(it->second)) {
+                            if (entry != hints.wrapper_dir) {
+                                entries.push_back(entry);
+                            }
+                        }
+                        it->second = sys::path::join(entries);
+                    }
+                    for (const auto &name : hints.erase) {
+                        environment.erase(name);
+                    }
+                    return rust::Ok(wr::Execution{
+                            candidate->second,
+                            std::move(arguments),
+                            execution.working_dir,
+                            environment
+                    });
+                });
+    }
+
     namespace Wrapper {
 
         rust::Result<wr::SessionLocator> make_session(const sys::env::Vars &environment) noexcept
@@ -72,12 +167,12 @@ namespace {
                    : rust::Result<wr::SessionLocator>(rust::Ok(wr::SessionLocator{destination->second}));
         }
 
-        std::list<std::string> from(const char **argv)
+        std::vector<std::string> from(const char **argv)
         {
             const char** end = argv;
             while (*end != nullptr)
                 ++end;
-            return std::list<std::string>(argv, end);
+            return std::vector<std::string>(argv, end);
         }
 
         rust::Result<wr::Execution> make_execution(const char **argv, sys::env::Vars &&environment) noexcept
@@ -105,8 +200,8 @@ namespace {
             auto program = args.as_string(cmd::wrapper::FLAG_EXECUTE)
                     .map<fs::path>([](auto file) { return fs::path(file); });
             auto arguments = args.as_string_list(cmd::wrapper::FLAG_COMMAND)
-                    .map<std::list<std::string>>([](auto args) {
-                        return std::list<std::string>(args.begin(), args.end());
+                    .map<std::vector<std::string>>([](auto args) {
+                        return std::vector<std::string>(args.begin(), args.end());
                     });
             auto working_dir = sys::path::get_cwd();
 
@@ -117,12 +212,6 @@ namespace {
                     });
         }
     }
-
-    bool is_exited(const rust::Result<sys::ExitStatus> &status) {
-        return status
-                .map<bool>([](auto _status) { return _status.is_exited(); })
-                .unwrap_or(true);
-    }
 }
 
 namespace wr {
@@ -134,63 +223,87 @@ namespace wr {
     { }
 
     rust::Result<int> Command::execute() const {
-        wr::EventReporter event_reporter(session_);
-        wr::SupervisorClient supervisor_client(session_);
-
-        return supervisor_client.resolve(execution_)
+        // Block the signals before the first thread starts: the mask is
+        // per thread and inherited, so the gRPC threads of the channel
+        // and the reporter's sender thread never become the delivery
+        // target of a process directed SIGINT or SIGTERM. The signals
+        // queue for the supervision loop instead, which consumes them
+        // from its signalfd (or re-opens the delivery on this thread,
+        // when it has to fall back to the handler based forwarding).
+        sigset_t mask;
+        sigfillset(&mask);
+        ::pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+
+        // one channel serves both stubs; see `create_channel`.
+        auto channel = wr::create_channel(session_);
+        wr::EventReporter event_reporter(channel);
+        wr::SupervisorClient supervisor_client(std::move(channel));
+
+        // the published hints answer the resolution without a round trip;
+        // the RPC is the fallback for a missing or a stale table.
+        auto resolved = resolve_locally(execution_);
+        if (resolved.is_err()) {
+            resolved = supervisor_client.resolve(execution_);
+        }
+        return resolved
                 .and_then<sys::Process>([&event_reporter](auto execution) {
                     return sys::Process::Builder(execution.executable)
                             .add_arguments(execution.arguments.begin(), execution.arguments.end())
-                            .set_environment(execution.environment)
+                            .set_environment(execution.environment.to_map())
 #ifdef SUPPORT_PRELOAD
                             .spawn_with_preload()
 #else
                             .spawn()
 #endif
                             .on_success([&event_reporter, &execution](auto &child) {
-                                event_reporter.report_start(child.get_pid(), execution);
+                                // the report carries the reduced environment,
+                                // the child got the untouched one above.
+                                auto reported = execution;
+                                reported.environment = captured(reported.environment.to_map());
+                                event_reporter.report_start(child.get_pid(), reported);
                             });
                 })
                 .and_then<sys::ExitStatus>([&event_reporter](auto child) {
-                    sys::SignalForwarder guard(child);
-                    while (true) {
-                        auto status = child.wait(true)
-                                .on_success([&event_reporter](auto exit) {
-                                    event_reporter.report_wait(exit);
-                                });
-                        if (is_exited(status)) {
-                            return status;
-                        }
-                    }
+                    return sys::supervise(child, [&event_reporter](const auto &exit) {
+                        event_reporter.report_wait(exit);
+                    });
                 })
                 .map<int>([](auto status) {
                     return status.code().value_or(EXIT_FAILURE);
+                })
+                // the logging setup is deferred on the fast path; a
+                // failure still reaches the stderr with the usual prefix.
+                .on_error([](const auto &) {
+                    init_log(false);
                 });
     }
 
     Application::Application() noexcept
             : ps::Application()
-            , log_config(APPLICATION_LOG_CONFIG)
-    {
-        log_config.initForSilent();
-    }
+    { }
 
     rust::Result<ps::CommandPtr> Application::command(int argc, const char **argv, const char **envp) const {
         if (const bool wrapper = is_wrapper_call(argc, argv); wrapper) {
+            // The hot path: a wrapper exec where every input comes from
+            // environment variables. No flag parser and no logger is
+            // built here, their setup cost would multiply with every
+            // intercepted execution of the build.
             if (const bool verbose = (nullptr != getenv(cmd::wrapper::KEY_VERBOSE)); verbose) {
-                log_config.initForVerbose();
+                init_log(true).record(argv, envp);
             }
-            log_config.record(argv, envp);
-
-            return Application::from_envs(argc, argv, envp);
+            return Application::from_envs(argc, argv, envp)
+                    .on_error([](const auto &) {
+                        init_log(false);
+                    });
         } else {
+            const auto &log_config = init_log(false);
             return Application::parse(argc, argv)
-                    .on_success([this, &argv, &envp](const auto& args) {
+                    .on_success([&log_config, &argv, &envp](const auto& args) {
                         if (args.as_bool(flags::VERBOSE).unwrap_or(false)) {
                             log_config.initForVerbose();
                         }
                         log_config.record(argv, envp);
-                        spdlog::debug("arguments parsed: {0}", args);
+                        SPDLOG_DEBUG("arguments parsed: {0}", args);
                     })
                     .and_then<ps::CommandPtr>([&envp](auto args) {
                         // if parsing success, we create the main command and execute it.
@@ -204,10 +317,10 @@ namespace wr {
         auto session = Wrapper::make_session(environment);
         auto execution = Wrapper::make_execution(argv, std::move(environment));
 
-        return rust::merge(session, execution)
-                .map<ps::CommandPtr>([](const auto &tuple) {
-                    const auto&[session, execution] = tuple;
-                    return std::make_unique<Command>(session, execution);
+        return rust::merge(std::move(session), std::move(execution))
+                .map<ps::CommandPtr>([](auto tuple) {
+                    auto&[session, execution] = tuple;
+                    return std::make_unique<Command>(std::move(session), std::move(execution));
                 });
     }
 
@@ -216,10 +329,10 @@ namespace wr {
         auto session = Supervisor::make_session(args);
         auto execution = Supervisor::make_execution(args, std::move(environment));
 
-        return rust::merge(session, execution)
-                .map<ps::CommandPtr>([](const auto &tuple) {
-                    const auto&[session, execution] = tuple;
-                    return std::make_unique<Command>(session, execution);
+        return rust::merge(std::move(session), std::move(execution))
+                .map<ps::CommandPtr>([](auto tuple) {
+                    auto&[session, execution] = tuple;
+                    return std::make_unique<Command>(std::move(session), std::move(execution));
                 });
     }
 
@@ -48,8 +48,5 @@ namespace wr {
         static rust::Result<ps::CommandPtr> from_envs(int argc, const char **argv, const char **envp);
         static rust::Result<ps::CommandPtr> from_args(const flags::Arguments &args, const char **envp);
         static rust::Result<flags::Arguments> parse(int argc, const char **argv) ;
-
-    private:
-        ps::ApplicationLogConfig const &log_config;
     };
 }
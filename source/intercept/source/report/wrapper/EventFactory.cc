@@ -22,12 +22,32 @@
 
 #include <google/protobuf/util/time_util.h>
 
+#include <ctime>
 #include <random>
 
 using namespace google::protobuf::util;
 
 namespace {
 
+    // Stamps the event with the current wall clock, assigned directly
+    // into the timestamp fields. The coarse clock is served from the
+    // vDSO without entering the kernel, and its millisecond resolution
+    // is plenty for ordering build events.
+    void stamp(rpc::Event &event) {
+#ifdef CLOCK_REALTIME_COARSE
+        constexpr clockid_t CLOCK = CLOCK_REALTIME_COARSE;
+#else
+        constexpr clockid_t CLOCK = CLOCK_REALTIME;
+#endif
+        if (timespec now {}; ::clock_gettime(CLOCK, &now) == 0) {
+            auto &timestamp = *event.mutable_timestamp();
+            timestamp.set_seconds(now.tv_sec);
+            timestamp.set_nanos(static_cast<int32_t>(now.tv_nsec));
+        } else {
+            event.mutable_timestamp()->CopyFrom(TimeUtil::GetCurrentTime());
+        }
+    }
+
     std::uint64_t generate_unique_id() {
         std::random_device random_device;
         std::mt19937_64 generator(random_device());
@@ -41,12 +61,13 @@ namespace wr {
 
     EventFactory::EventFactory() noexcept
             : rid_(generate_unique_id())
+            , arena_()
     { }
 
-    rpc::Event EventFactory::start(ProcessId pid, ProcessId ppid, const Execution &execution) const {
-        rpc::Event event;
+    rpc::Event &EventFactory::start(ProcessId pid, ProcessId ppid, const Execution &execution) {
+        rpc::Event &event = *google::protobuf::Arena::CreateMessage<rpc::Event>(&arena_);
         event.set_rid(rid_);
-        event.mutable_timestamp()->CopyFrom(TimeUtil::GetCurrentTime());
+        stamp(event);
         {
             rpc::Event_Started &event_started = *event.mutable_started();
             event_started.set_pid(pid);
@@ -56,21 +77,22 @@ namespace wr {
         return event;
     }
 
-    rpc::Event EventFactory::signal(int number) const {
-        rpc::Event event;
+    rpc::Event &EventFactory::signal(int number) {
+        rpc::Event &event = *google::protobuf::Arena::CreateMessage<rpc::Event>(&arena_);
         event.set_rid(rid_);
-        event.mutable_timestamp()->CopyFrom(TimeUtil::GetCurrentTime());
+        stamp(event);
         {
             rpc::Event_Signalled &event_signalled = *event.mutable_signalled();
             event_signalled.set_number(number);
+            event_signalled.set_count(1);
         }
         return event;
     }
 
-    rpc::Event EventFactory::terminate(int code) const {
-        rpc::Event event;
+    rpc::Event &EventFactory::terminate(int code) {
+        rpc::Event &event = *google::protobuf::Arena::CreateMessage<rpc::Event>(&arena_);
         event.set_rid(rid_);
-        event.mutable_timestamp()->CopyFrom(TimeUtil::GetCurrentTime());
+        stamp(event);
         {
             rpc::Event_Terminated &event_terminated = *event.mutable_terminated();
             event_terminated.set_status(code);
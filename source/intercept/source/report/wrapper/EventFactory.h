@@ -23,19 +23,29 @@
 
 #include "intercept.pb.h"
 
+#include <google/protobuf/arena.h>
+
 namespace wr {
     using namespace domain;
 
+    // Creates the lifecycle events of the supervised process.
+    //
+    // The events are allocated on an arena owned by the factory. A wrapper
+    // creates at most three events (start, and signal or terminate), so the
+    // nested messages and their strings come from a single arena block
+    // instead of thousands of small heap allocations. The returned
+    // references are valid as long as the factory lives.
     class EventFactory {
     public:
         EventFactory() noexcept;
         ~EventFactory() noexcept = default;
 
-        [[nodiscard]] rpc::Event start(ProcessId pid, ProcessId ppid, const Execution &execution) const;
-        [[nodiscard]] rpc::Event signal(int number) const;
-        [[nodiscard]] rpc::Event terminate(int code) const;
+        [[nodiscard]] rpc::Event &start(ProcessId pid, ProcessId ppid, const Execution &execution);
+        [[nodiscard]] rpc::Event &signal(int number);
+        [[nodiscard]] rpc::Event &terminate(int code);
 
     private:
         ReporterId rid_;
+        google::protobuf::Arena arena_;
     };
 }
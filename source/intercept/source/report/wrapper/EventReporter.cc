@@ -19,22 +19,178 @@
 
 #include "report/wrapper/EventReporter.h"
 
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+
+#include <unistd.h>
+
+namespace {
+
+    // Credit is asked in one chunk: a wrapper reports a handful of events
+    // only, and every grant is a round trip to the collector.
+    constexpr uint64_t CREDIT_CHUNK = 16;
+
+    ring::EventRing::Ptr open_ring() noexcept {
+        ring::EventRing::Ptr result;
+        if (const char *ring_name = getenv(cmd::wrapper::KEY_RING); ring_name != nullptr) {
+            ring::EventRing::open(ring_name)
+                    .on_success([&result](const auto &ring) {
+                        result = ring;
+                    })
+                    .on_error([](const auto &error) {
+                        spdlog::warn("Event ring open failed: {} Falling back to gRPC.", error.what());
+                    });
+        }
+        return result;
+    }
+}
+
 namespace wr {
 
-    EventReporter::EventReporter(const SessionLocator &session_locator) noexcept
+    // the transports are set up before the sender thread starts, since the
+    // thread reads them without locking.
+    EventReporter::EventReporter(std::shared_ptr<::grpc::Channel> channel) noexcept
             : event_factory()
-            , client(session_locator)
+            , client(std::move(channel))
+            , ring(open_ring())
+            , pending()
+            , mutex()
+            , notify()
+            , stop(false)
+            , credit(0)
+            , spill()
+            , spill_file()
+            , resource_usage(getenv(cmd::wrapper::KEY_RESOURCE_USAGE) != nullptr)
+            , sender([this]() { deliver(); })
     { }
 
+    EventReporter::~EventReporter() noexcept {
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            stop = true;
+        }
+        notify.notify_one();
+        sender.join();
+    }
+
     void EventReporter::report_start(ProcessId pid, const Execution &execution) {
-        auto event = event_factory.start(pid, getppid(), execution);
-        client.report(event);
+        report(event_factory.start(pid, getppid(), execution));
     }
 
     void EventReporter::report_wait(sys::ExitStatus exit_status) {
-        auto event = (exit_status.is_signaled())
-                ? event_factory.signal(exit_status.signal().value())
-                : event_factory.terminate(exit_status.code().value());
-        client.report(event);
+        if (exit_status.is_signaled()) {
+            report(event_factory.signal(exit_status.signal().value()));
+            return;
+        }
+        rpc::Event &event = event_factory.terminate(exit_status.code().value());
+        if (resource_usage) {
+            // the accounting travels on the final status only.
+            if (const auto resources = exit_status.resources(); resources.has_value()) {
+                rpc::Event_Terminated &terminated = *event.mutable_terminated();
+                terminated.set_user_time_usec(resources->user_time_usec);
+                terminated.set_system_time_usec(resources->system_time_usec);
+                terminated.set_max_rss_kb(resources->max_rss_kb);
+            }
+        }
+        report(event);
+    }
+
+    void EventReporter::report(const rpc::Event &event) {
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            // Repeated identical signals (stop and continue storms from
+            // job control) coalesce into the queued record instead of
+            // growing the queue: the count carries the repetition, the
+            // refreshed timestamp the last delivery. The window is the
+            // queue residence; an event the sender already took goes out
+            // as it is.
+            if (event.has_signalled() && !pending.empty()
+                    && pending.back().has_signalled()
+                    && pending.back().signalled().number() == event.signalled().number()) {
+                rpc::Event &last = pending.back();
+                last.mutable_signalled()->set_count(
+                        last.signalled().count() + std::max<uint64_t>(1, event.signalled().count()));
+                *last.mutable_timestamp() = event.timestamp();
+            } else {
+                pending.push_back(event);
+            }
+        }
+        notify.notify_one();
+    }
+
+    void EventReporter::deliver() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            notify.wait(lock, [this]() { return stop || !pending.empty(); });
+            if (pending.empty()) {
+                break;
+            }
+            rpc::Event event = std::move(pending.front());
+            pending.pop_front();
+            // the transports can block; release the reporting threads.
+            lock.unlock();
+            BEAR_PROBE1(wrapper_send, event.rid());
+            // once the spilling started every event goes into the spill
+            // file: the file is ingested after the delivered events, a
+            // later event overtaking it would break the event order.
+            if (spill || !(ring && ring->push(event))) {
+                send_or_spill(event);
+            }
+            lock.lock();
+        }
+        lock.unlock();
+        hand_over_spill();
+    }
+
+    // The credit keeps the gRPC path from blocking on a congested
+    // collector: a zero grant turns the delivery into a local spill,
+    // which the collector ingests later from a single hand over call.
+    void EventReporter::send_or_spill(const rpc::Event &event) {
+        if (!spill && credit == 0) {
+            client.acquire(CREDIT_CHUNK)
+                    .on_success([this](auto granted) {
+                        credit = granted;
+                    });
+            if (credit == 0) {
+                spill_file = std::filesystem::temp_directory_path()
+                        / fmt::format("intercept-spill-{}.events", getpid());
+                ic::collect::db::EventsDatabaseWriter::create(spill_file)
+                        .on_success([this](const auto &writer) {
+                            spill = writer;
+                        })
+                        .on_error([this](const auto &error) {
+                            spdlog::warn("Event spill create failed: {} Reporting over the stream.", error.what());
+                            spill_file.clear();
+                            // deliver over the stream, blocking at worst.
+                            credit = CREDIT_CHUNK;
+                        });
+            }
+        }
+        if (spill) {
+            spill->insert_event(event)
+                    .on_error([](const auto &error) {
+                        spdlog::warn("Event spill write failed: {}", error.what());
+                    });
+        } else {
+            credit -= 1;
+            client.report(event);
+        }
+    }
+
+    void EventReporter::hand_over_spill() {
+        if (!spill) {
+            return;
+        }
+        // the writer finalizes the file on destruction.
+        spill.reset();
+        client.report_spill(spill_file.string())
+                .on_error([this](const auto &error) {
+                    spdlog::warn("Event spill hand over failed: {} The file remains: {}",
+                            error.what(), spill_file.string());
+                });
     }
 }
@@ -20,23 +20,38 @@
 #pragma once
 
 #include "Domain.h"
+#include "collect/db/EventsDatabaseWriter.h"
 #include "report/wrapper/EventFactory.h"
 #include "report/wrapper/RpcClients.h"
+#include "ring/EventRing.h"
 #include "libresult/Result.h"
 #include "libsys/Process.h"
 
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
 namespace wr {
 
     /**
      * Reports events to the interceptor gRPC service.
      *
-     * Depend on the implementation, it can collect the events and send at the very
-     * end, or it can send it immediately (sync or async).
+     * The delivery runs on a background thread: `report` only hands the
+     * event over and returns, so a slow collector delays the wrapper exit
+     * at worst, and never the supervised process itself. The destructor
+     * waits until every handed over event is delivered.
+     *
+     * The gRPC delivery is credit based: the collector grants budget
+     * while it keeps up, and a zero grant turns the delivery into a
+     * local spill file, handed over in a single call. An overloaded
+     * collector thus defers the reporting instead of stalling the build.
      */
     class EventReporter {
     public:
-        explicit EventReporter(const wr::SessionLocator& session_locator) noexcept;
-        ~EventReporter() noexcept = default;
+        explicit EventReporter(std::shared_ptr<::grpc::Channel> channel) noexcept;
+        ~EventReporter() noexcept;
 
         void report_start(ProcessId pid, const Execution &execution);
         void report_wait(sys::ExitStatus exit_status);
@@ -44,8 +59,34 @@ namespace wr {
         NON_DEFAULT_CONSTRUCTABLE(EventReporter);
         NON_COPYABLE_NOR_MOVABLE(EventReporter);
 
+    private:
+        void report(const rpc::Event &event);
+        void deliver();
+        void send_or_spill(const rpc::Event &event);
+        void hand_over_spill();
+
     private:
         EventFactory event_factory;
         InterceptorClient client;
+        // The shared memory transport, when the collector offers one.
+        // (The gRPC client stays as fallback.)
+        ring::EventRing::Ptr ring;
+        // Events waiting for the sender thread, in report order.
+        std::deque<rpc::Event> pending;
+        std::mutex mutex;
+        std::condition_variable notify;
+        bool stop;
+        // The event budget granted by the collector, and the spill file
+        // the events go into when the budget runs out. Once the spilling
+        // started the stream is not used again (the spill is ingested
+        // after the streamed events, going back would reorder them); the
+        // file is handed over in one tiny call before the thread stops.
+        uint64_t credit;
+        ic::collect::db::EventsDatabaseWriter::Ptr spill;
+        std::filesystem::path spill_file;
+        // Session wide switch: the collector sets the environment key
+        // when the user asked for the resource usage of the children.
+        const bool resource_usage;
+        std::thread sender;
     };
 }
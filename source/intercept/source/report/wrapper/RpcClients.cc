@@ -24,6 +24,9 @@
 #include <grpcpp/create_channel.h>
 #include <spdlog/spdlog.h>
 
+#include <cstdlib>
+#include <utility>
+
 namespace {
 
     std::runtime_error create_error(const grpc::Status& status) {
@@ -33,13 +36,24 @@ namespace {
 
 namespace wr {
 
-    SupervisorClient::SupervisorClient(const SessionLocator &session_locator)
-            : channel_(grpc::CreateChannel(session_locator, grpc::InsecureChannelCredentials()))
+    std::shared_ptr<::grpc::Channel> create_channel(const SessionLocator &session_locator) {
+        grpc::ChannelArguments arguments;
+        // the collector asks for compression when it sits on the far side
+        // of a network link. (gzip is what gRPC ships; the local unix
+        // domain transports never set the key.)
+        if (getenv(cmd::wrapper::KEY_COMPRESSION) != nullptr) {
+            arguments.SetCompressionAlgorithm(GRPC_COMPRESS_GZIP);
+        }
+        return grpc::CreateCustomChannel(session_locator, grpc::InsecureChannelCredentials(), arguments);
+    }
+
+    SupervisorClient::SupervisorClient(std::shared_ptr<::grpc::Channel> channel)
+            : channel_(std::move(channel))
             , supervisor_(rpc::Supervisor::NewStub(channel_))
     { }
 
     rust::Result<wr::Execution> SupervisorClient::resolve(const wr::Execution &execution) {
-        spdlog::debug("gRPC call requested: supervise::Supervisor::Resolve");
+        SPDLOG_DEBUG("gRPC call requested: supervise::Supervisor::Resolve");
 
         grpc::ClientContext context;
         rpc::ResolveRequest request;
@@ -48,28 +62,73 @@ namespace wr {
         request.set_allocated_execution(new rpc::Execution(into(execution)));
 
         const grpc::Status status = supervisor_->Resolve(&context, request, &response);
-        spdlog::debug("gRPC call [Resolve] finished: {}", status.ok());
+        SPDLOG_DEBUG("gRPC call [Resolve] finished: {}", status.ok());
         return status.ok()
                ? rust::Result<wr::Execution>(rust::Ok(from(response.execution())))
                : rust::Result<wr::Execution>(rust::Err(create_error(status)));
     }
 
-    InterceptorClient::InterceptorClient(const SessionLocator &session_locator)
-            : channel_(grpc::CreateChannel(session_locator, grpc::InsecureChannelCredentials()))
+    InterceptorClient::InterceptorClient(std::shared_ptr<::grpc::Channel> channel)
+            : channel_(std::move(channel))
             , interceptor_(rpc::Interceptor::NewStub(channel_))
+            , context_()
+            , writer_()
+            , response_()
     { }
 
+    InterceptorClient::~InterceptorClient() {
+        if (writer_) {
+            writer_->WritesDone();
+            const grpc::Status status = writer_->Finish();
+            SPDLOG_DEBUG("gRPC call [RegisterStream] finished: {}", status.ok());
+        }
+    }
+
     rust::Result<int> InterceptorClient::report(const rpc::Event &event) {
-        spdlog::debug("gRPC call requested: supervise::Interceptor::Register");
+        if (!writer_) {
+            SPDLOG_DEBUG("gRPC call requested: supervise::Interceptor::RegisterStream");
+            context_ = std::make_unique<grpc::ClientContext>();
+            writer_ = interceptor_->RegisterStream(context_.get(), &response_);
+        }
+        if (writer_->Write(event)) {
+            return rust::Result<int>(rust::Ok(0));
+        }
+        // The stream is broken, surface the final status as error.
+        const grpc::Status status = writer_->Finish();
+        SPDLOG_DEBUG("gRPC call [RegisterStream] finished: {}", status.ok());
+        writer_.reset();
+        return rust::Result<int>(rust::Err(create_error(status)));
+    }
+
+    rust::Result<uint64_t> InterceptorClient::acquire(uint64_t requested) {
+        SPDLOG_DEBUG("gRPC call requested: supervise::Interceptor::AcquireCredit");
 
         grpc::ClientContext context;
+        rpc::CreditRequest request;
+        rpc::CreditGrant response;
+
+        request.set_requested(requested);
+
+        const grpc::Status status = interceptor_->AcquireCredit(&context, request, &response);
+        SPDLOG_DEBUG("gRPC call [AcquireCredit] finished: {}", status.ok());
+        return status.ok()
+               ? rust::Result<uint64_t>(rust::Ok(response.granted()))
+               : rust::Result<uint64_t>(rust::Err(create_error(status)));
+    }
+
+    rust::Result<int> InterceptorClient::report_spill(const std::string &path) {
+        SPDLOG_DEBUG("gRPC call requested: supervise::Interceptor::RegisterSpill");
+
+        grpc::ClientContext context;
+        rpc::SpillLocation request;
         google::protobuf::Empty response;
 
-        const grpc::Status status = interceptor_->Register(&context, event, &response);
-        spdlog::debug("gRPC call [Register] finished: {}", status.ok());
-        if (!status.ok()) {
-            return rust::Result<int>(rust::Err(create_error(status)));
-        }
-        return rust::Result<int>(rust::Ok(0));
+        request.set_path(path);
+
+        const grpc::Status status = interceptor_->RegisterSpill(&context, request, &response);
+        SPDLOG_DEBUG("gRPC call [RegisterSpill] finished: {}", status.ok());
+        return status.ok()
+               ? rust::Result<int>(rust::Ok(0))
+               : rust::Result<int>(rust::Err(create_error(status)));
     }
 }
@@ -33,9 +33,16 @@
 namespace wr {
     using namespace domain;
 
+    // Opens a channel to the collector. The channel is shared between the
+    // client stubs of the process, since each connection costs a handshake
+    // which the short lived wrappers would pay twice. The channel connects
+    // lazily: a wrapper which delivers its events over the ring transport
+    // never dials the collector at all.
+    [[nodiscard]] std::shared_ptr<::grpc::Channel> create_channel(const wr::SessionLocator& session_locator);
+
     class SupervisorClient {
     public:
-        explicit SupervisorClient(const wr::SessionLocator& session_locator);
+        explicit SupervisorClient(std::shared_ptr<::grpc::Channel> channel);
 
         rust::Result<wr::Execution> resolve(const wr::Execution &);
 
@@ -49,15 +56,29 @@ namespace wr {
 
     class InterceptorClient {
     public:
-        explicit InterceptorClient(const wr::SessionLocator& session_locator);
+        explicit InterceptorClient(std::shared_ptr<::grpc::Channel> channel);
+        ~InterceptorClient();
 
         rust::Result<int> report(const rpc::Event &);
 
+        // Asks the collector for budget to report this many events.
+        // (A zero grant asks this client to spill the events locally.)
+        rust::Result<uint64_t> acquire(uint64_t requested);
+
+        // Hands over the path of a local spill file; the collector
+        // ingests and removes it.
+        rust::Result<int> report_spill(const std::string &path);
+
         NON_DEFAULT_CONSTRUCTABLE(InterceptorClient);
         NON_COPYABLE_NOR_MOVABLE(InterceptorClient);
 
     private:
         std::shared_ptr<::grpc::Channel> channel_;
         std::unique_ptr<rpc::Interceptor::Stub> interceptor_;
+        // All events of this process are reported over a single stream,
+        // which is opened at the first report and closed in the destructor.
+        std::unique_ptr<::grpc::ClientContext> context_;
+        std::unique_ptr<::grpc::ClientWriter<rpc::Event>> writer_;
+        google::protobuf::Empty response_;
     };
 }
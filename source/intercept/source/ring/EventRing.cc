@@ -0,0 +1,187 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ring/EventRing.h"
+#include "libsys/Errors.h"
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include <atomic>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+    constexpr uint64_t MAGIC = 0x4245415252494E47; // "BEARRING"
+
+    struct Header {
+        uint64_t magic;
+        uint32_t slot_count;
+        uint32_t slot_size;
+        // The producer counter. Producers claim slots by advancing it.
+        alignas(64) std::atomic<uint64_t> head;
+    };
+
+    struct Slot {
+        // The sequence number implements the slot hand over protocol:
+        // - `pos`: the slot is free, a producer at position `pos` can claim it,
+        // - `pos + 1`: the slot is filled, the consumer at `pos` can read it,
+        // - `pos + slot_count`: the slot is free for the next lap.
+        std::atomic<uint64_t> sequence;
+        uint32_t size;
+    };
+
+    constexpr size_t STRIDE = (sizeof(Slot) + ring::EventRing::SLOT_SIZE + 63) & ~size_t(63);
+    constexpr size_t TOTAL_SIZE = sizeof(Header) + ring::EventRing::SLOT_COUNT * STRIDE;
+
+    Header *header_of(void *memory) noexcept {
+        return reinterpret_cast<Header *>(memory);
+    }
+
+    Slot *slot_at(void *memory, const uint64_t position) noexcept {
+        const size_t index = position & (ring::EventRing::SLOT_COUNT - 1);
+        auto address = reinterpret_cast<char *>(memory) + sizeof(Header) + index * STRIDE;
+        return reinterpret_cast<Slot *>(address);
+    }
+
+    uint8_t *payload_of(Slot *slot) noexcept {
+        return reinterpret_cast<uint8_t *>(slot) + sizeof(Slot);
+    }
+
+    rust::Result<void *> map_shared(const std::string &name, const bool create) {
+        const int flags = create ? (O_RDWR | O_CREAT | O_EXCL) : O_RDWR;
+        const int fd = ::shm_open(name.c_str(), flags, 0600);
+        if (fd == -1) {
+            return rust::Err(std::runtime_error(
+                    fmt::format("Event ring open failed ({}): {}", name, sys::error_string(errno))));
+        }
+        if (create && (::ftruncate(fd, TOTAL_SIZE) == -1)) {
+            auto message = fmt::format("Event ring resize failed ({}): {}", name, sys::error_string(errno));
+            ::close(fd);
+            ::shm_unlink(name.c_str());
+            return rust::Err(std::runtime_error(message));
+        }
+        void *memory = ::mmap(nullptr, TOTAL_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (memory == MAP_FAILED) {
+            auto message = fmt::format("Event ring mmap failed ({}): {}", name, sys::error_string(errno));
+            if (create) {
+                ::shm_unlink(name.c_str());
+            }
+            return rust::Err(std::runtime_error(message));
+        }
+        return rust::Ok(memory);
+    }
+}
+
+namespace ring {
+
+    rust::Result<EventRing::Ptr> EventRing::create(const std::string &name) {
+        return map_shared(name, true)
+                .map<EventRing::Ptr>([&name](auto memory) {
+                    Header *header = header_of(memory);
+                    header->slot_count = SLOT_COUNT;
+                    header->slot_size = SLOT_SIZE;
+                    header->head.store(0, std::memory_order_relaxed);
+                    for (uint64_t position = 0; position < SLOT_COUNT; ++position) {
+                        slot_at(memory, position)->sequence.store(position, std::memory_order_relaxed);
+                    }
+                    // The magic is written last, it signals readiness to producers.
+                    header->magic = MAGIC;
+                    return std::make_shared<EventRing>(name, memory, TOTAL_SIZE, true);
+                });
+    }
+
+    rust::Result<EventRing::Ptr> EventRing::open(const std::string &name) {
+        return map_shared(name, false)
+                .and_then<EventRing::Ptr>([&name](auto memory) -> rust::Result<EventRing::Ptr> {
+                    const Header *header = header_of(memory);
+                    if (header->magic != MAGIC
+                            || header->slot_count != SLOT_COUNT
+                            || header->slot_size != SLOT_SIZE) {
+                        ::munmap(memory, TOTAL_SIZE);
+                        return rust::Err(std::runtime_error(
+                                fmt::format("Event ring layout mismatch ({})", name)));
+                    }
+                    return rust::Ok(std::make_shared<EventRing>(name, memory, TOTAL_SIZE, false));
+                });
+    }
+
+    EventRing::EventRing(std::string name, void *memory, size_t size, bool owner) noexcept
+            : name_(std::move(name))
+            , memory_(memory)
+            , size_(size)
+            , owner_(owner)
+            , tail_(0)
+    { }
+
+    EventRing::~EventRing() noexcept {
+        ::munmap(memory_, size_);
+        if (owner_) {
+            ::shm_unlink(name_.c_str());
+        }
+    }
+
+    bool EventRing::push(const rpc::Event &event) noexcept {
+        const size_t size = event.ByteSizeLong();
+        if (size > SLOT_SIZE) {
+            return false;
+        }
+        Header *header = header_of(memory_);
+        uint64_t position = header->head.load(std::memory_order_relaxed);
+        while (true) {
+            Slot *slot = slot_at(memory_, position);
+            const uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+            const auto difference = int64_t(sequence) - int64_t(position);
+            if (difference == 0) {
+                if (header->head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot->size = size;
+                    event.SerializeToArray(payload_of(slot), size);
+                    slot->sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+                // Another producer claimed the slot, `position` got re-read.
+            } else if (difference < 0) {
+                // A full lap behind, the ring is full.
+                return false;
+            } else {
+                position = header->head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool EventRing::pop(rpc::Event &event) noexcept {
+        Slot *slot = slot_at(memory_, tail_);
+        if (slot->sequence.load(std::memory_order_acquire) != tail_ + 1) {
+            return false;
+        }
+        const bool parsed = event.ParseFromArray(payload_of(slot), slot->size);
+        slot->sequence.store(tail_ + SLOT_COUNT, std::memory_order_release);
+        ++tail_;
+        if (!parsed) {
+            spdlog::warn("Could not parse event from the ring. Ignored.");
+        }
+        return parsed;
+    }
+}
@@ -0,0 +1,80 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "config.h"
+#include "libresult/Result.h"
+#include "intercept.pb.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace ring {
+
+    /**
+     * A bounded multi producer, single consumer event queue in shared memory.
+     *
+     * The reporter processes (the producers) serialize events into fixed size
+     * slots, the collector process (the only consumer) drains them in order.
+     * Slot claiming uses per slot sequence numbers, so producers only compete
+     * on a single atomic counter and nobody takes a lock. The ring is a best
+     * effort transport: when it is full (or an event does not fit into a
+     * slot) the push fails and the caller shall fall back to gRPC.
+     */
+    class EventRing {
+    public:
+        using Ptr = std::shared_ptr<EventRing>;
+
+        // Number of slots in the ring. (Has to be a power of two.)
+        static constexpr size_t SLOT_COUNT = 512;
+        // Payload capacity of a single slot.
+        static constexpr size_t SLOT_SIZE = 64 * 1024;
+
+        // Creates the shared memory object. (Called by the collector.)
+        [[nodiscard]] static rust::Result<EventRing::Ptr> create(const std::string &name);
+        // Opens an already created shared memory object. (Called by reporters.)
+        [[nodiscard]] static rust::Result<EventRing::Ptr> open(const std::string &name);
+
+        [[nodiscard]] const std::string &name() const { return name_; }
+
+        // Serialize the event into a free slot. Returns false if the ring
+        // is full or the event does not fit into a single slot.
+        [[nodiscard]] bool push(const rpc::Event &event) noexcept;
+        // Parse the next event from the ring. Returns false if the ring
+        // is empty (or the slot content could not be parsed).
+        [[nodiscard]] bool pop(rpc::Event &event) noexcept;
+
+    public:
+        EventRing(std::string name, void *memory, size_t size, bool owner) noexcept;
+        ~EventRing() noexcept;
+
+        NON_DEFAULT_CONSTRUCTABLE(EventRing);
+        NON_COPYABLE_NOR_MOVABLE(EventRing);
+
+    private:
+        std::string name_;
+        void *memory_;
+        size_t size_;
+        bool owner_;
+        // Consumer position. (Only the collector process touches it.)
+        uint64_t tail_;
+    };
+}
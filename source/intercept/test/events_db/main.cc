@@ -21,13 +21,21 @@
 #include "libmain/ApplicationFromArgs.h"
 #include "libmain/main.h"
 #include "libflags/Flags.h"
+#include "collect/db/EventsDatabaseMerger.h"
 #include "collect/db/EventsDatabaseReader.h"
+#include "collect/db/EventsDatabaseWriter.h"
 
 #include <google/protobuf/util/json_util.h>
 
+#include <algorithm>
+#include <cstdlib>
 #include <filesystem>
 #include <iostream>
 #include <fstream>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
 
 namespace fs = std::filesystem;
 
@@ -35,6 +43,21 @@ namespace {
 
     constexpr char APPEND[] = "append";
     constexpr char DUMP[] = "dump";
+    constexpr char GENERATE[] = "generate";
+    constexpr char MERGE[] = "merge";
+
+    rust::Result<size_t> as_count(const flags::Arguments &args, const char *flag) {
+        return args.as_string(flag)
+                .and_then<size_t>([&flag](auto value) {
+                    const std::string input(value);
+                    char *end = nullptr;
+                    const unsigned long result = std::strtoul(input.c_str(), &end, 10);
+                    return (end != input.c_str() && *end == 0)
+                            ? rust::Result<size_t>(rust::Ok(result))
+                            : rust::Result<size_t>(rust::Err(
+                                    std::runtime_error(fmt::format("Invalid number for {}: {}", flag, input))));
+                });
+    }
 
     struct AppendCommand : ps::Command {
         explicit AppendCommand(std::string_view input, std::string_view path)
@@ -90,6 +113,113 @@ namespace {
         fs::path path;
     };
 
+    // Fabricates an events database: a build shaped process tree of
+    // started and terminated event pairs, with configurable command line
+    // and environment sizes. Load testing the pipeline needs reproducible
+    // multi million event inputs, and capturing real ones is slow (and
+    // their content can not be shared). The same parameters synthesize
+    // the same events. (The byte layout of the serialized environment
+    // maps may still vary between runs.)
+    struct GenerateCommand : ps::Command {
+        GenerateCommand(std::string_view path, size_t events, size_t arguments, size_t variables, size_t fan_out)
+                : ps::Command()
+                , path(path)
+                , events(events)
+                , arguments(std::max<size_t>(2, arguments))
+                , variables(variables)
+                , fan_out(std::max<size_t>(1, fan_out))
+        { }
+
+        [[nodiscard]] rust::Result<int> execute() const override {
+            return ic::collect::db::EventsDatabaseWriter::create(path)
+                    .and_then<int>([this](const auto &db) {
+                        const rpc::Event prototype = started_prototype();
+                        rpc::Event terminated;
+                        terminated.mutable_terminated()->set_status(0);
+                        // the pid range avoids the single digit system pids,
+                        // the tree root is the synthesized build driver.
+                        constexpr uint32_t BASE_PID = 100000;
+                        for (size_t idx = 0; idx < events; ++idx) {
+                            const uint64_t rid = idx + 1;
+                            rpc::Event event(prototype);
+                            event.set_rid(rid);
+                            event.mutable_timestamp()->set_seconds(static_cast<int64_t>(idx / 1000));
+                            event.mutable_timestamp()->set_nanos(static_cast<int32_t>((idx % 1000) * 1000000));
+                            auto &started = *event.mutable_started();
+                            // the fan out forms the process tree: every node
+                            // has at most that many children.
+                            started.set_pid(BASE_PID + static_cast<uint32_t>(rid));
+                            started.set_ppid((idx == 0)
+                                    ? BASE_PID
+                                    : BASE_PID + 1 + static_cast<uint32_t>((idx - 1) / fan_out));
+                            auto &execution = *started.mutable_execution();
+                            // the source file makes every command line unique,
+                            // like the compilations of a real build.
+                            execution.set_arguments(static_cast<int>(arguments - 1),
+                                    fmt::format("source_{}.c", idx));
+                            // one per process variable keeps the environment
+                            // deltas of the database non empty.
+                            (*execution.mutable_environment())["SYNTHETIC_RID"] = std::to_string(rid);
+                            if (auto result = db->insert_event(event); result.is_err()) {
+                                return rust::Result<int>(rust::Err(result.unwrap_err()));
+                            }
+                            terminated.set_rid(rid);
+                            *terminated.mutable_timestamp() = event.timestamp();
+                            if (auto result = db->insert_event(terminated); result.is_err()) {
+                                return rust::Result<int>(rust::Err(result.unwrap_err()));
+                            }
+                        }
+                        return rust::Result<int>(rust::Ok(0));
+                    });
+        }
+
+    private:
+        // The shared part of every synthesized process: the compiler
+        // style command line and the environment block. Copied per event,
+        // only the varying fields are touched in the loop.
+        [[nodiscard]] rpc::Event started_prototype() const {
+            rpc::Event event;
+            auto &execution = *event.mutable_started()->mutable_execution();
+            execution.set_executable("/usr/bin/cc");
+            execution.add_arguments("cc");
+            for (size_t idx = 2; idx < arguments; ++idx) {
+                execution.add_arguments(fmt::format("-fsynthetic-flag-{}", idx));
+            }
+            execution.add_arguments("placeholder.c");
+            execution.set_working_dir("/home/user/build");
+            auto &environment = *execution.mutable_environment();
+            for (size_t idx = 0; idx < variables; ++idx) {
+                environment[fmt::format("SYNTHETIC_VARIABLE_{}", idx)] =
+                        fmt::format("value of the synthetic variable number {}", idx);
+            }
+            return event;
+        }
+
+    private:
+        fs::path path;
+        size_t events;
+        size_t arguments;
+        size_t variables;
+        size_t fan_out;
+    };
+
+    struct MergeCommand : ps::Command {
+        explicit MergeCommand(std::vector<fs::path> inputs, std::string_view path)
+                : ps::Command()
+                , inputs(std::move(inputs))
+                , path(path)
+        { }
+
+        [[nodiscard]] rust::Result<int> execute() const override {
+            return ic::collect::db::EventsDatabaseMerger::merge(inputs, path)
+                    .map<int>([](auto) { return 0; });
+        }
+
+    private:
+        std::vector<fs::path> inputs;
+        fs::path path;
+    };
+
     struct Application : ps::ApplicationFromArgs {
 
         Application() noexcept
@@ -105,7 +235,18 @@ namespace {
                     {"--output", {1, true, "path of the output file", std::nullopt, std::nullopt}},
                     {"--path",   {1, true, "path of the db file",     std::nullopt, std::nullopt}},
             });
-            const flags::Parser parser("intercept", cmd::VERSION, {append, dump});
+            const flags::Parser generate(GENERATE, {
+                    {"--path",      {1, true,  "path of the output db file",                    std::nullopt, std::nullopt}},
+                    {"--events",    {1, false, "number of process executions to synthesize",    {"1000"},     std::nullopt}},
+                    {"--arguments", {1, false, "command line arguments per execution",          {"16"},       std::nullopt}},
+                    {"--variables", {1, false, "environment variables per execution",           {"64"},       std::nullopt}},
+                    {"--fan-out",   {1, false, "children per process in the synthesized tree",  {"16"},       std::nullopt}},
+            });
+            const flags::Parser merge(MERGE, {
+                    {"--path",  {1,  true, "path of the output db file", std::nullopt, std::nullopt}},
+                    {"--input", {-1, true, "paths of the input db files", std::nullopt, std::nullopt}},
+            });
+            const flags::Parser parser("intercept", cmd::VERSION, {append, dump, generate, merge});
 
             return parser.parse_or_exit(argc, const_cast<const char **>(argv));
         }
@@ -119,6 +260,12 @@ namespace {
                         if (command == DUMP) {
                             return command_dump(args);
                         }
+                        if (command == GENERATE) {
+                            return command_generate(args);
+                        }
+                        if (command == MERGE) {
+                            return command_merge(args);
+                        }
                         return rust::Result<ps::CommandPtr>(rust::Err(std::runtime_error("")));
                     });
         }
@@ -142,6 +289,29 @@ namespace {
                         return std::make_unique<DumpCommand>(output, path);
                     });
         }
+
+        [[nodiscard]] static rust::Result<ps::CommandPtr> command_generate(const flags::Arguments &args) {
+            auto path = args.as_string("--path");
+            auto sizes = rust::merge(as_count(args, "--events"), as_count(args, "--arguments"),
+                                     as_count(args, "--variables"), as_count(args, "--fan-out"));
+            return rust::merge(path, sizes)
+                    .map<ps::CommandPtr>([](auto tuple) {
+                        const auto& [path, sizes] = tuple;
+                        const auto& [events, arguments, variables, fan_out] = sizes;
+                        return std::make_unique<GenerateCommand>(path, events, arguments, variables, fan_out);
+                    });
+        }
+
+        [[nodiscard]] static rust::Result<ps::CommandPtr> command_merge(const flags::Arguments &args) {
+            auto inputs = args.as_string_list("--input");
+            auto path = args.as_string("--path");
+            return rust::merge(inputs, path)
+                    .map<ps::CommandPtr>([](auto tuple) {
+                        const auto& [inputs, path] = tuple;
+                        return std::make_unique<MergeCommand>(
+                                std::vector<fs::path>(inputs.begin(), inputs.end()), path);
+                    });
+        }
     };
 }
 
@@ -0,0 +1,59 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+
+#include "report/libexec/Arena.h"
+
+namespace {
+
+    TEST(Arena, serves_small_request)
+    {
+        el::Arena sut(8);
+
+        const char** result = sut.data();
+        ASSERT_NE(nullptr, result);
+
+        result[0] = "Hi there people";
+        result[7] = nullptr;
+        EXPECT_STREQ("Hi there people", result[0]);
+    }
+
+    TEST(Arena, serves_large_request)
+    {
+        constexpr size_t SIZE = 64 * 1024;
+        el::Arena sut(SIZE);
+
+        const char** result = sut.data();
+        ASSERT_NE(nullptr, result);
+
+        for (size_t idx = 0; idx < SIZE; ++idx) {
+            result[idx] = "argument";
+        }
+        EXPECT_STREQ("argument", result[0]);
+        EXPECT_STREQ("argument", result[SIZE - 1]);
+    }
+
+    TEST(Arena, data_is_stable)
+    {
+        el::Arena sut(8);
+
+        EXPECT_EQ(sut.data(), sut.data());
+    }
+}
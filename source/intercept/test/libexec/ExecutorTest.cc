@@ -50,17 +50,18 @@ namespace {
     };
     char SEARCH_PATH[] = "/usr/bin:/usr/sbin";
 
-    el::Session SILENT_SESSION = {
-        "/usr/bin/intercept",
-        "/tmp/intercept.random",
-        false
-    };
+    el::Session make_session(const char* reporter, const char* destination, bool verbose)
+    {
+        el::Session session = { reporter, destination, verbose };
+        el::session::compose(session);
+        return session;
+    }
 
-    el::Session VERBOSE_SESSION = {
-        "/usr/bin/intercept",
-        "/tmp/intercept.random",
-        true
-    };
+    const el::Session SILENT_SESSION =
+            make_session("/usr/bin/intercept", "/tmp/intercept.random", false);
+
+    const el::Session VERBOSE_SESSION =
+            make_session("/usr/bin/intercept", "/tmp/intercept.random", true);
 
     MATCHER_P(CStyleArrayEqual, expecteds, "")
     {
@@ -26,6 +26,7 @@
 #include <map>
 #include <optional>
 #include <string_view>
+#include <utility>
 #include <vector>
 #include <iosfwd>
 
@@ -34,6 +35,7 @@ namespace flags {
     constexpr char HELP[] = "--help";
     constexpr char VERSION[] = "--version";
     constexpr char VERBOSE[] = "--verbose";
+    constexpr char TIMING[] = "--timing";
     constexpr char COMMAND[] = "command";
 
     class Parser;
@@ -85,12 +87,35 @@ namespace flags {
     struct Option {
         int arguments;
         bool required;
-        const std::string_view help;
-        const std::optional<std::string_view> default_value;
-        const std::optional<std::string_view> group_name;
+        std::string_view help;
+        std::optional<std::string_view> default_value;
+        std::optional<std::string_view> group_name;
+    };
+
+    // The options live in one flat table, ordered by the flag name. The
+    // lookup is a binary search over contiguous entries, and building the
+    // table is a single allocation plus a sort (a node based map would
+    // allocate per option on every invocation).
+    class OptionMap {
+    public:
+        using value_type = std::pair<std::string_view, Option>;
+        using const_iterator = std::vector<value_type>::const_iterator;
+
+        OptionMap() = default;
+        OptionMap(std::initializer_list<value_type> options);
+
+        [[nodiscard]] const_iterator find(std::string_view flag) const;
+        // Keeps the table ordered; an already known flag is left alone.
+        void insert(value_type entry);
+
+        [[nodiscard]] const_iterator begin() const { return entries_.begin(); }
+        [[nodiscard]] const_iterator end() const { return entries_.end(); }
+        [[nodiscard]] bool empty() const { return entries_.empty(); }
+
+    private:
+        std::vector<value_type> entries_;
     };
 
-    using OptionMap = std::map<std::string_view, Option>;
     using OptionValue = OptionMap::value_type;
 
     // Represents a command line parser.
@@ -117,6 +142,7 @@ namespace flags {
         Parser(std::string_view name, std::string_view version, std::initializer_list<OptionValue> options);
         Parser(std::string_view name, std::initializer_list<OptionValue> options);
         Parser(std::string_view name, std::string_view version, std::initializer_list<Parser> commands);
+        Parser(std::string_view name, std::string_view version, std::initializer_list<OptionValue> options, std::initializer_list<Parser> commands);
 
         ~Parser() = default;
 
@@ -19,6 +19,7 @@
 
 #include "libflags/Flags.h"
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <optional>
@@ -127,6 +128,29 @@ namespace {
 
 namespace flags {
 
+    OptionMap::OptionMap(std::initializer_list<value_type> options)
+            : entries_(options)
+    {
+        std::sort(entries_.begin(), entries_.end(),
+            [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+    }
+
+    OptionMap::const_iterator OptionMap::find(const std::string_view flag) const
+    {
+        const auto it = std::lower_bound(entries_.begin(), entries_.end(), flag,
+            [](const auto& entry, const auto& key) { return entry.first < key; });
+        return (it != entries_.end() && it->first == flag) ? it : entries_.end();
+    }
+
+    void OptionMap::insert(value_type entry)
+    {
+        const auto it = std::lower_bound(entries_.begin(), entries_.end(), entry.first,
+            [](const auto& candidate, const auto& key) { return candidate.first < key; });
+        if (it == entries_.end() || it->first != entry.first) {
+            entries_.insert(it, std::move(entry));
+        }
+    }
+
     Arguments::Arguments(std::string_view program, Arguments::Parameters&& parameters)
             : program_(program)
             , parameters_(parameters)
@@ -189,6 +213,7 @@ namespace flags {
             , commands_()
     {
         options_.insert({ VERBOSE, { 0, false, "run in verbose mode", std::nullopt, std::nullopt } });
+        options_.insert({ TIMING, { 0, false, "report the startup phase timings", std::nullopt, std::nullopt } });
         options_.insert({ HELP, { 0, false, "print help and exit", std::nullopt, { QUERY_GROUP } } });
         options_.insert({ VERSION, { 0, false, "print version and exit", std::nullopt, { QUERY_GROUP } } });
     }
@@ -200,6 +225,7 @@ namespace flags {
             , commands_()
     {
         options_.insert({ VERBOSE, { 0, false, "run in verbose mode", std::nullopt, std::nullopt } });
+        options_.insert({ TIMING, { 0, false, "report the startup phase timings", std::nullopt, std::nullopt } });
         options_.insert({ HELP, { 0, false, "print help and exit", std::nullopt, { QUERY_GROUP } } });
     }
 
@@ -213,6 +239,21 @@ namespace flags {
         options_.insert({ VERSION, { 0, false, "print version and exit", std::nullopt, { QUERY_GROUP } } });
     }
 
+    // A program which takes flags, but also offers subcommands: when the
+    // first argument names one of the commands, that parser takes over,
+    // otherwise the arguments are parsed as plain flags.
+    Parser::Parser(std::string_view name, std::string_view version, std::initializer_list<OptionValue> options, std::initializer_list<Parser> commands)
+            : name_(name)
+            , version_(version)
+            , options_(options)
+            , commands_(commands)
+    {
+        options_.insert({ VERBOSE, { 0, false, "run in verbose mode", std::nullopt, std::nullopt } });
+        options_.insert({ TIMING, { 0, false, "report the startup phase timings", std::nullopt, std::nullopt } });
+        options_.insert({ HELP, { 0, false, "print help and exit", std::nullopt, { QUERY_GROUP } } });
+        options_.insert({ VERSION, { 0, false, "print version and exit", std::nullopt, { QUERY_GROUP } } });
+    }
+
     rust::Result<Arguments> Parser::parse(const int argc, const char** argv) const
     {
         if (argc < 1 || argv == nullptr) {
@@ -164,7 +164,7 @@ namespace {
         });
         {
             const char *expected =
-                    "Usage: test [--flag] [--option <arg>] [--options <arg0> <arg1> <arg2>] [--verbose] [-- ...]\n";
+                    "Usage: test [--flag] [--option <arg>] [--options <arg0> <arg1> <arg2>] [--timing] [--verbose] [-- ...]\n";
 
             std::ostringstream out;
             sut.print_usage(nullptr, out);
@@ -175,12 +175,13 @@ namespace {
         }
         {
             const char *expected =
-                    "Usage: test [--flag] [--option <arg>] [--options <arg0> <arg1> <arg2>] [--verbose] [-- ...]\n"
+                    "Usage: test [--flag] [--option <arg>] [--options <arg0> <arg1> <arg2>] [--timing] [--verbose] [-- ...]\n"
                     "\n"
                     "  --flag               a single flag\n"
                     "  --option <arg>       a flag with a value\n"
                     "  --options <arg0> <arg1> <arg2>\n"
                     "               a flag with 3 values\n"
+                    "  --timing             report the startup phase timings\n"
                     "  --verbose            run in verbose mode\n"
                     "  -- ...               rest of the arguments\n"
                     "\n"
@@ -351,9 +352,10 @@ namespace {
         }
         {
             const char *expected =
-                    "Usage: test append [--option <arg>] [--verbose]\n"
+                    "Usage: test append [--option <arg>] [--timing] [--verbose]\n"
                     "\n"
                     "  --option <arg>       a flag with a value\n"
+                    "  --timing             report the startup phase timings\n"
                     "  --verbose            run in verbose mode\n"
                     "\n"
                     "query options\n"
@@ -0,0 +1,38 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+namespace ps::timing {
+
+    // Records where the startup time of the application goes.
+    //
+    // The `mark` calls name the phase which just finished; the elapsed
+    // time since the previous mark (or the program start) is recorded.
+    // The report writes one line per phase to the standard error, in a
+    // fixed `timing: <phase> <microseconds>` format, but only when the
+    // `--timing` flag enabled it - without that the marks are a clock
+    // read each and nothing is printed.
+    //
+    // The recorder is process-wide state, used from the main thread
+    // during startup; it is not prepared for concurrent marks.
+    void enable() noexcept;
+    void mark(const char* phase) noexcept;
+    void report() noexcept;
+}
@@ -20,6 +20,10 @@
 #pragma once
 
 #include "libmain/Application.h"
+#include "libmain/Timing.h"
+#include "libflags/Flags.h"
+
+#include <cstring>
 
 #include <spdlog/spdlog.h>
 
@@ -27,14 +31,26 @@ namespace ps {
 
     template <class App>
     int main(int argc, char* argv[], char* envp[]) {
+        // the flag is looked up before parsing, so the report covers the
+        // parsing itself too. (the parser knows the flag, it is added to
+        // every option table.)
+        for (int idx = 1; idx < argc; ++idx) {
+            if (std::strcmp(argv[idx], flags::TIMING) == 0) {
+                ps::timing::enable();
+                break;
+            }
+        }
         App app;
-        auto ptr = reinterpret_cast<ps::Application*>(&app);
+        ps::timing::mark("initialize");
 
-        return ptr->command(argc,
-                            const_cast<const char **>(argv),
-                            const_cast<const char **>(envp))
+        const int status = reinterpret_cast<ps::Application*>(&app)
+                ->command(argc,
+                          const_cast<const char **>(argv),
+                          const_cast<const char **>(envp))
                 .and_then<int>([](const ps::CommandPtr &cmd) {
-                    return cmd->execute();
+                    auto result = cmd->execute();
+                    ps::timing::mark("execute");
+                    return result;
                 })
                 // print out the result of the run
                 .on_error([](auto error) {
@@ -45,5 +61,8 @@ namespace ps {
                 })
                 // set the return code from error
                 .unwrap_or(EXIT_FAILURE);
+
+        ps::timing::report();
+        return status;
     }
 }
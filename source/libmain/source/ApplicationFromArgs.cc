@@ -18,6 +18,7 @@
  */
 
 #include "libmain/ApplicationFromArgs.h"
+#include "libmain/Timing.h"
 
 #include <spdlog/spdlog.h>
 #include <spdlog/fmt/ostr.h>
@@ -45,7 +46,10 @@ namespace ps {
             })
             // if parsing success, we create the main command and execute it.
             .and_then<CommandPtr>([this, &envp](auto args) {
-                return this->command(args, envp);
+                ps::timing::mark("parse");
+                auto result = this->command(args, envp);
+                ps::timing::mark("command");
+                return result;
             });
     }
 }
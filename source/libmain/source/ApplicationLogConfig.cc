@@ -21,6 +21,7 @@
 #include "libmain/ApplicationLogConfig.h"
 
 #include <spdlog/spdlog.h>
+#include <spdlog/async.h>
 #include <spdlog/fmt/ostr.h>
 #include <spdlog/sinks/stdout_sinks.h>
 
@@ -65,6 +66,15 @@ namespace ps {
 
     void ApplicationLogConfig::initForVerbose() const
     {
+        // The verbose logging is chatty, and the synchronous stderr sink
+        // serializes every thread which logs. Route the messages through
+        // a bounded asynchronous queue instead: the logging threads only
+        // enqueue, a single background thread writes. When the queue is
+        // full, the oldest messages are dropped rather than blocking the
+        // instrumented code.
+        spdlog::init_thread_pool(8192, 1);
+        spdlog::set_default_logger(
+            spdlog::create_async_nb<spdlog::sinks::stderr_sink_mt>("stderr-async"));
         spdlog::set_pattern(fmt::format("[%H:%M:%S.%f, {0}, %P] %v", id_));
         spdlog::set_level(spdlog::level::debug);
     }
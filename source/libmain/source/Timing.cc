@@ -0,0 +1,76 @@
+/*  Copyright (C) 2012-2021 by László Nagy
+    This file is part of Bear.
+
+    Bear is a tool to generate compilation database for clang tooling.
+
+    Bear is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bear is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "libmain/Timing.h"
+
+#include <chrono>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace {
+
+    using clock = std::chrono::steady_clock;
+
+    struct State {
+        bool enabled = false;
+        clock::time_point last = clock::now();
+        std::vector<std::pair<const char*, std::chrono::microseconds>> phases;
+    };
+
+    State& state() noexcept
+    {
+        static State instance;
+        return instance;
+    }
+}
+
+namespace ps::timing {
+
+    void enable() noexcept
+    {
+        state().enabled = true;
+    }
+
+    void mark(const char* phase) noexcept
+    {
+        auto& current = state();
+        const auto now = clock::now();
+        current.phases.emplace_back(
+            phase,
+            std::chrono::duration_cast<std::chrono::microseconds>(now - current.last));
+        current.last = now;
+    }
+
+    void report() noexcept
+    {
+        const auto& current = state();
+        if (!current.enabled) {
+            return;
+        }
+        std::chrono::microseconds total(0);
+        for (const auto& [phase, elapsed] : current.phases) {
+            fmt::print(stderr, "timing: {} {}\n", phase, elapsed.count());
+            total += elapsed;
+        }
+        fmt::print(stderr, "timing: total {}\n", total.count());
+    }
+}
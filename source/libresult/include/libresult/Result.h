@@ -187,7 +187,13 @@ namespace rust {
         [[nodiscard]] bool is_err() const;
 
         template <typename U>
-        Result<U, E> map(std::function<U(const T&)> const& f) const;
+        Result<U, E> map(std::function<U(const T&)> const& f) const &;
+
+        // The rvalue overload hands the payload to the function by move,
+        // so a chain over a temporary result forwards the value without
+        // a deep copy.
+        template <typename U>
+        Result<U, E> map(std::function<U(T&&)> const& f) &&;
 
         template <typename U>
         Result<U, E> map_or(U&& value, std::function<U(const T&)> const& func) const;
@@ -202,13 +208,18 @@ namespace rust {
         Result<U, E> and_(const Result<U, E>& rhs) const;
 
         template <typename U>
-        Result<U, E> and_then(std::function<Result<U, E>(const T&)> const& f) const;
+        Result<U, E> and_then(std::function<Result<U, E>(const T&)> const& f) const &;
+
+        template <typename U>
+        Result<U, E> and_then(std::function<Result<U, E>(T&&)> const& f) &&;
 
         Result<T, E> or_(const Result<T, E>& rhs) const;
 
         Result<T, E> or_else(std::function<Result<T, E>(const E&)> const& f) const;
 
-        const T& unwrap() const;
+        const T& unwrap() const &;
+        // Consuming access: moves the value out of a temporary result.
+        T unwrap() &&;
         const E& unwrap_err() const;
         const T& unwrap_or(const T& value) const;
 
@@ -261,10 +272,54 @@ namespace rust {
     merge(const Result<T1> &t1, const Result<T2> &t2, const Result<T3> &t3, const Result<T4> &t4) {
         return merge(merge(t1, t2), merge(t3, t4))
                 .template map<std::tuple<T1, T2, T3, T4>>([](auto tuple) {
-                    const auto&[t12, t34] = tuple;
-                    const auto&[t1, t2] = t12;
-                    const auto&[t3, t4] = t34;
-                    return std::make_tuple(t1, t2, t3, t4);
+                    auto&[t12, t34] = tuple;
+                    auto&[t1, t2] = t12;
+                    auto&[t3, t4] = t34;
+                    return std::make_tuple(std::move(t1), std::move(t2), std::move(t3), std::move(t4));
+                });
+    }
+
+    // The rvalue overloads move the payloads into the tuple. Use these
+    // when the results are not needed after the merge: the values are
+    // forwarded without a deep copy.
+    template <typename T1, typename T2>
+    Result<std::tuple<T1, T2>> merge(Result<T1>&& t1, Result<T2>&& t2)
+    {
+        if (t1.is_err()) {
+            return types::Err<std::runtime_error>(t1.unwrap_err());
+        }
+        if (t2.is_err()) {
+            return types::Err<std::runtime_error>(t2.unwrap_err());
+        }
+        return types::Ok<std::tuple<T1, T2>>(
+            std::make_tuple(std::move(t1).unwrap(), std::move(t2).unwrap()));
+    }
+
+    template <typename T1, typename T2, typename T3>
+    Result<std::tuple<T1, T2, T3>> merge(Result<T1>&& t1, Result<T2>&& t2, Result<T3>&& t3)
+    {
+        if (t1.is_err()) {
+            return types::Err<std::runtime_error>(t1.unwrap_err());
+        }
+        if (t2.is_err()) {
+            return types::Err<std::runtime_error>(t2.unwrap_err());
+        }
+        if (t3.is_err()) {
+            return types::Err<std::runtime_error>(t3.unwrap_err());
+        }
+        return types::Ok<std::tuple<T1, T2, T3>>(
+            std::make_tuple(std::move(t1).unwrap(), std::move(t2).unwrap(), std::move(t3).unwrap()));
+    }
+
+    template<typename T1, typename T2, typename T3, typename T4>
+    Result<std::tuple<T1, T2, T3, T4>>
+    merge(Result<T1> &&t1, Result<T2> &&t2, Result<T3> &&t3, Result<T4> &&t4) {
+        return merge(merge(std::move(t1), std::move(t2)), merge(std::move(t3), std::move(t4)))
+                .template map<std::tuple<T1, T2, T3, T4>>([](auto tuple) {
+                    auto&[t12, t34] = tuple;
+                    auto&[t1, t2] = t12;
+                    auto&[t3, t4] = t34;
+                    return std::make_tuple(std::move(t1), std::move(t2), std::move(t3), std::move(t4));
                 });
     }
 
@@ -388,7 +443,7 @@ namespace rust {
 
     template <typename T, typename E>
     template <typename U>
-    Result<U, E> Result<T, E>::map(const std::function<U(const T&)>& f) const
+    Result<U, E> Result<T, E>::map(const std::function<U(const T&)>& f) const &
     {
         if (ok_) {
             auto res = f(storage_.template get<T>());
@@ -398,6 +453,18 @@ namespace rust {
         }
     }
 
+    template <typename T, typename E>
+    template <typename U>
+    Result<U, E> Result<T, E>::map(const std::function<U(T&&)>& f) &&
+    {
+        if (ok_) {
+            auto res = f(std::move(storage_.template get<T>()));
+            return types::Ok<U>(std::move(res));
+        } else {
+            return types::Err<E>(storage_.template get<E>());
+        }
+    }
+
     template <typename T, typename E>
     template <typename U>
     Result<U, E> Result<T, E>::map_or(U&& value, const std::function<U(const T&)>& f) const
@@ -450,7 +517,7 @@ namespace rust {
 
     template <typename T, typename E>
     template <typename U>
-    Result<U, E> Result<T, E>::and_then(const std::function<Result<U, E>(const T&)>& f) const
+    Result<U, E> Result<T, E>::and_then(const std::function<Result<U, E>(const T&)>& f) const &
     {
         if (ok_) {
             return f(storage_.template get<T>());
@@ -459,6 +526,17 @@ namespace rust {
         }
     }
 
+    template <typename T, typename E>
+    template <typename U>
+    Result<U, E> Result<T, E>::and_then(const std::function<Result<U, E>(T&&)>& f) &&
+    {
+        if (ok_) {
+            return f(std::move(storage_.template get<T>()));
+        } else {
+            return types::Err<E>(storage_.template get<E>());
+        }
+    }
+
     template <typename T, typename E>
     Result<T, E> Result<T, E>::or_(const Result<T, E>& rhs) const
     {
@@ -480,11 +558,17 @@ namespace rust {
     }
 
     template <typename T, typename E>
-    const T& Result<T, E>::unwrap() const
+    const T& Result<T, E>::unwrap() const &
     {
         return storage_.template get<T>();
     }
 
+    template <typename T, typename E>
+    T Result<T, E>::unwrap() &&
+    {
+        return std::move(storage_.template get<T>());
+    }
+
     template <typename T, typename E>
     const E& Result<T, E>::unwrap_err() const
     {
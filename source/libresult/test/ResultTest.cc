@@ -21,6 +21,8 @@
 
 #include "libresult/Result.h"
 
+#include <memory>
+
 namespace {
 
     using Error = const char*;
@@ -357,4 +359,25 @@ namespace {
                       })
                       .unwrap_or('+')));
     }
+
+    TEST(result, merge_on_rvalues_moves_the_payload)
+    {
+        auto merged = merge(
+            Result<std::unique_ptr<int>>(Ok(std::make_unique<int>(2))),
+            Result<std::unique_ptr<int>>(Ok(std::make_unique<int>(3))));
+        EXPECT_TRUE(merged.is_ok());
+        const auto& [first, second] = merged.unwrap();
+        EXPECT_EQ(2, *first);
+        EXPECT_EQ(3, *second);
+    }
+
+    TEST(result, merge_on_rvalues_keeps_the_error)
+    {
+        auto merged = merge(
+            Result<std::unique_ptr<int>>(Ok(std::make_unique<int>(2))),
+            Result<std::unique_ptr<int>>(Err(std::runtime_error("problem"))));
+        EXPECT_TRUE(merged.is_err());
+        EXPECT_STREQ("problem", merged.unwrap_err().what());
+    }
+
 }
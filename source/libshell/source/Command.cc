@@ -19,67 +19,175 @@
 
 #include "libshell/Command.h"
 
-#include <regex>
 #include <stdexcept>
 
-namespace sh {
+namespace {
 
-    std::string escape(const std::string& input)
+    // The characters which can go into a shell command unescaped.
+    constexpr bool is_safe(const char character)
+    {
+        return (character >= 'A' && character <= 'Z')
+            || (character >= 'a' && character <= 'z')
+            || (character >= '0' && character <= '9')
+            || character == '_'
+            || character == '-'
+            || character == '.'
+            || character == ','
+            || character == ':'
+            || character == '/'
+            || character == '@';
+    }
+
+    // The escaping is done in two passes: the sizing pass lets the
+    // callers allocate the output once, the writing pass fills it.
+    size_t escaped_size(const std::string& input)
     {
         if (input.empty()) {
-            return "''";
+            return 2;
         }
+        size_t result = input.size();
+        for (const char character : input) {
+            if (character == '\n') {
+                result += 2;
+            } else if (!is_safe(character)) {
+                result += 1;
+            }
+        }
+        return result;
+    }
 
-        const std::regex ESCAPE_PATTERN(R"#(([^A-Za-z0-9_\-.,:/@\n]))#");
-        const std::regex LINE_FEED(R"#(\n)#");
+    void escape_into(std::string& output, const std::string& input)
+    {
+        if (input.empty()) {
+            output.append("''");
+            return;
+        }
+        for (const char character : input) {
+            if (character == '\n') {
+                output.append("'\n'");
+            } else if (!is_safe(character)) {
+                output.push_back('\\');
+                output.push_back(character);
+            } else {
+                output.push_back(character);
+            }
+        }
+    }
+}
 
-        auto output = std::regex_replace(input, ESCAPE_PATTERN, "\\$1");
-        return std::regex_replace(output, LINE_FEED, "'\n'");
+namespace sh {
+
+    std::string escape(const std::string& input)
+    {
+        std::string output;
+        output.reserve(escaped_size(input));
+        escape_into(output, input);
+        return output;
     }
 
     std::string join(const std::list<std::string>& arguments)
     {
+        // measure first, so the result is built in one allocation.
+        size_t size = arguments.empty() ? 0 : arguments.size() - 1;
+        for (const auto& argument : arguments) {
+            size += escaped_size(argument);
+        }
         std::string result;
+        result.reserve(size);
         for (auto it = arguments.begin(); it != arguments.end(); ++it) {
             if (it != arguments.begin()) {
-                result += " ";
+                result.push_back(' ');
             }
-            result += escape(*it);
+            escape_into(result, *it);
         }
         return result;
     }
 
+    // The splitting is a single pass over the input. Plain characters are
+    // consumed as whole runs (`find_first_of` scans with the library
+    // memchr machinery instead of per character branching), quoting and
+    // escaping are handled at the run boundaries. The previous
+    // implementation drove a std::regex over the input, which dominated
+    // the cost of re-reading stored command strings.
     rust::Result<std::list<std::string>> split(const std::string& input)
     {
-        const std::regex MAIN_PATTERN(R"#((?:\s*(?:([^\s\\'"]+)|'([^']*)'|"((?:[^"\\]|\\.)*)"|(\\.?)|(\S))(\s|$)?))#",
-                                      std::regex::ECMAScript);
-        const std::regex ESCAPE_PATTERN(R"#(\\(.))#");
-        const std::regex METACHAR_PATTERN(R"(\\([$`"\\\n]))");
+        constexpr const char* WHITESPACE = " \t\n\v\f\r";
+        constexpr const char* WORD_STOPPER = " \t\n\v\f\r\\'\"";
 
         std::list<std::string> words;
         std::string field;
+        bool in_word = false;
 
-        auto input_begin = std::sregex_iterator(input.begin(), input.end(), MAIN_PATTERN);
-        auto input_end = std::sregex_iterator();
-        for (auto it = input_begin; it != input_end; ++it) {
-            if (it->ready()) {
-                if (it->operator[](1).matched) {
-                    field += it->str(1);
-                } else if (it->operator[](2).matched) {
-                    field += it->str(2);
-                } else if (it->operator[](3).matched) {
-                    field += std::regex_replace(it->str(3), METACHAR_PATTERN, "$1");
-                } else if (it->operator[](4).matched) {
-                    field += std::regex_replace(it->str(4), ESCAPE_PATTERN, "$1");
-                } else if (it->operator[](5).matched) {
-                    return rust::Err(std::runtime_error("Mismatched quotes."));
-                }
-
-                if (it->operator[](6).matched) {
+        const size_t size = input.size();
+        size_t pos = 0;
+        while (pos < size) {
+            switch (const char current = input[pos]; current) {
+            case ' ': case '\t': case '\n': case '\v': case '\f': case '\r': {
+                if (in_word) {
                     words.push_back(field);
                     field.clear();
+                    in_word = false;
+                }
+                pos = input.find_first_not_of(WHITESPACE, pos + 1);
+                break;
+            }
+            case '\'': {
+                // single quotes: everything up to the closing quote is literal.
+                const size_t end = input.find('\'', pos + 1);
+                if (end == std::string::npos) {
+                    return rust::Err(std::runtime_error("Mismatched quotes."));
+                }
+                field.append(input, pos + 1, end - pos - 1);
+                in_word = true;
+                pos = end + 1;
+                break;
+            }
+            case '"': {
+                // double quotes: backslash only escapes the shell metacharacters.
+                in_word = true;
+                ++pos;
+                for (bool open = true; open;) {
+                    const size_t stop = input.find_first_of("\"\\", pos);
+                    if (stop == std::string::npos) {
+                        return rust::Err(std::runtime_error("Mismatched quotes."));
+                    }
+                    field.append(input, pos, stop - pos);
+                    if (input[stop] == '"') {
+                        pos = stop + 1;
+                        open = false;
+                    } else {
+                        if (stop + 1 >= size) {
+                            return rust::Err(std::runtime_error("Mismatched quotes."));
+                        }
+                        const char escaped = input[stop + 1];
+                        if (escaped != '$' && escaped != '`' && escaped != '"' && escaped != '\\' && escaped != '\n') {
+                            field.push_back('\\');
+                        }
+                        field.push_back(escaped);
+                        pos = stop + 2;
+                    }
                 }
+                break;
             }
+            case '\\': {
+                // backslash: the next character is literal, a trailing one stays.
+                field.push_back((pos + 1 < size) ? input[pos + 1] : '\\');
+                in_word = true;
+                pos += 2;
+                break;
+            }
+            default: {
+                const size_t stop = input.find_first_of(WORD_STOPPER, pos + 1);
+                const size_t end = (stop == std::string::npos) ? size : stop;
+                field.append(input, pos, end - pos);
+                in_word = true;
+                pos = end;
+                break;
+            }
+            }
+        }
+        if (in_word) {
+            words.push_back(field);
         }
         return rust::Ok(words);
     }
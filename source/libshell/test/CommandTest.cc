@@ -96,6 +96,20 @@ namespace {
         EXPECT_EQ(expected,sh::split("a b c d ").unwrap_or({}));
     }
 
+    TEST(command, adjacent_pieces)
+    {
+        std::list<std::string> expected = {"ab cd", "e"};
+
+        EXPECT_EQ(expected,sh::split("a'b c'd e").unwrap_or({}));
+    }
+
+    TEST(command, empty_quotes)
+    {
+        std::list<std::string> expected = {"a", "", "b"};
+
+        EXPECT_EQ(expected,sh::split("a '' b").unwrap_or({}));
+    }
+
     TEST(command, percent_signs)
     {
         std::list<std::string> expected = {"abc", "%foo bar%"};
@@ -20,12 +20,20 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <string>
 
 namespace sys::env {
 
     using Vars = std::map<std::string, std::string>;
 
+    // An immutable, shared environment snapshot.
+    //
+    // The orchestration passes the same environment (often hundreds of
+    // entries) to several child processes; sharing one snapshot spares a
+    // full copy of the strings per spawn.
+    using VarsPtr = std::shared_ptr<const Vars>;
+
     // Convert an environment array into a map.
     Vars from(const char** value);
 }
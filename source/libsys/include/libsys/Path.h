@@ -24,6 +24,7 @@
 
 #include <filesystem>
 #include <list>
+#include <optional>
 #include <string>
 
 namespace fs = std::filesystem;
@@ -37,4 +38,19 @@ namespace sys::path {
     std::string join(const std::list<fs::path> &input);
 
     rust::Result<fs::path> get_cwd();
+
+    // Caches the working directory query for its lifetime.
+    //
+    // The tools do not change their working directory, but some code
+    // paths query it repeatedly; a Context asks the system once and
+    // replays the answer. Callers which do change directory shall call
+    // `invalidate` afterwards.
+    class Context {
+    public:
+        [[nodiscard]] rust::Result<fs::path> get_cwd();
+        void invalidate();
+
+    private:
+        std::optional<fs::path> cwd_;
+    };
 }
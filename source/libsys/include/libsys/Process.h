@@ -21,22 +21,35 @@
 
 #include "config.h"
 #include "libresult/Result.h"
+#include "libsys/Environment.h"
 
+#include <cstdint>
 #include <filesystem>
-#include <list>
+#include <functional>
 #include <map>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <vector>
 #include <unistd.h>
 
 namespace fs = std::filesystem;
 
 namespace sys {
 
+    // Resource usage of a terminated process, as the kernel accounted
+    // it. (The values come from the `wait4` call which reaped the
+    // process.)
+    struct ResourceUsage {
+        uint64_t user_time_usec;
+        uint64_t system_time_usec;
+        uint64_t max_rss_kb;
+    };
+
     class ExitStatus {
     public:
         ExitStatus(bool is_code, int code);
+        ExitStatus(bool is_code, int code, ResourceUsage resources);
 
         ExitStatus() = delete ;
         ~ExitStatus() noexcept = default;
@@ -51,30 +64,56 @@ namespace sys {
         [[nodiscard]]
         bool is_exited() const;
 
+        // Present on the final (exit or kill) status of a reaped child
+        // only; the stop and continue statuses carry no accounting.
+        [[nodiscard]]
+        std::optional<ResourceUsage> resources() const;
+
     private:
         bool is_code_;
         int code_;
+        std::optional<ResourceUsage> resources_;
     };
 
     class Process {
     public:
         class Builder;
+        class Prepared;
 
         [[nodiscard]]
         pid_t get_pid() const;
 
+        // True when the process leads its own process group. Signals
+        // meant for the whole process tree then go to the group in one
+        // `kill(-pgid)` call. (See `Builder::set_process_group`.)
+        [[nodiscard]]
+        bool leads_group() const;
+
         rust::Result<ExitStatus> wait(bool request_for_signals = false);
         rust::Result<int> kill(int num);
 
     public:
-        explicit Process(pid_t pid);
+        explicit Process(pid_t pid, bool leads_group = false);
 
         NON_DEFAULT_CONSTRUCTABLE(Process);
 
     private:
         pid_t pid_;
+        bool leads_group_;
     };
 
+    // Waits for the child process to terminate, while forwarding the
+    // signals the calling process receives to the child. The observer is
+    // called with every state change of the child (stop, continue, signal,
+    // exit). Returns the final exit status.
+    //
+    // Where the system provides them (Linux), the wait is implemented with
+    // the `signalfd` and `pidfd` facilities: the signals are consumed from
+    // a file descriptor instead of asynchronous handlers, which avoids the
+    // race between the handler list and the wait loop. Otherwise it falls
+    // back to signal handlers. (See `SignalForwarder`.)
+    rust::Result<ExitStatus> supervise(Process &child, const std::function<void(const ExitStatus &)> &observer);
+
     class Process::Builder {
     public:
         explicit Builder(fs::path program);
@@ -95,6 +134,17 @@ namespace sys {
 
         Builder& set_environment(std::map<std::string, std::string>&&);
         Builder& set_environment(const std::map<std::string, std::string>&);
+        // Shares the snapshot instead of copying it; the preferred form
+        // when the same environment serves several spawns.
+        Builder& set_environment(sys::env::VarsPtr);
+
+        // The child becomes the leader of a new process group, and its
+        // descendants inherit the group. Tearing down the whole tree is
+        // then a single group targeted signal, instead of forwarding to
+        // the direct child and hoping it cascades. (For the root command
+        // of a build; a process inside a supervised tree shall stay in
+        // the group of its root.)
+        Builder& set_process_group();
 
         rust::Result<Process> spawn();
 
@@ -102,12 +152,68 @@ namespace sys {
         rust::Result<Process> spawn_with_preload();
 #endif
 
+        // Freezes the command into an immutable spawn image: the argv and
+        // envp arrays are flattened once, and every spawn from the image
+        // reuses them. The preferred form when the same command serves
+        // several spawns; a one shot command spawns from the builder
+        // directly. The builder stays usable afterwards.
+        [[nodiscard]] std::shared_ptr<const Prepared> prepare() const;
+
+        // The argv view of the prepared command (terminated by a null
+        // pointer), pointing into the builder's arena. For running the
+        // prepared command in the current process instead of a child.
+        std::vector<char*> arguments();
+
     public:
         NON_DEFAULT_CONSTRUCTABLE(Builder);
 
+    private:
+
+    private:
+        fs::path program_;
+        // The arguments live in one contiguous arena (zero terminated,
+        // addressed by the offset table), so the spawn only builds the
+        // pointer array and copies nothing.
+        std::string arena_;
+        std::vector<size_t> offsets_;
+        sys::env::VarsPtr environment_;
+        bool process_group_;
+    };
+
+    // An immutable spawn image of a prepared command.
+    //
+    // Holds the flattened argv and envp arrays (the environment map is
+    // rendered into "key=value" strings once), so spawning from the image
+    // repeatedly pays no per spawn flattening. A daemonized process which
+    // launches many children of the same shape prepares once and spawns
+    // from the image.
+    //
+    // The pointer arrays address the image's own arenas, hence the
+    // instances live behind a shared pointer and never move.
+    class Process::Prepared {
+    public:
+        using Ptr = std::shared_ptr<const Prepared>;
+
+        // Spawns a child process from the image. Safe to call repeatedly
+        // and from multiple threads.
+        [[nodiscard]] rust::Result<Process> spawn() const;
+
+    public:
+        Prepared(fs::path program,
+                 const std::string &arguments,
+                 const std::vector<size_t> &offsets,
+                 const sys::env::Vars &environment,
+                 bool process_group);
+
+        NON_DEFAULT_CONSTRUCTABLE(Prepared);
+        NON_COPYABLE_NOR_MOVABLE(Prepared);
+
     private:
         fs::path program_;
-        std::list<std::string> parameters_;
-        std::map<std::string, std::string> environment_;
+        std::string argument_arena_;
+        std::string environment_arena_;
+        std::vector<char*> argv_;
+        std::vector<char*> envp_;
+        bool process_group_;
     };
 }
@@ -21,11 +21,17 @@
 
 #include "config.h"
 #include <csignal>
+#include <cstddef>
 
 namespace sys {
 
     class Process;
 
+    // Forwards the signals the process receives to the child for the
+    // guard's lifetime. The children share a process-wide dispatcher:
+    // a guard only claims a slot in a fixed table, the handlers are
+    // installed when the first guard appears and removed when the last
+    // one goes away.
     class SignalForwarder {
     public:
         explicit SignalForwarder(const Process &child) noexcept;
@@ -37,7 +43,6 @@ namespace sys {
 
     private:
         pid_t pid_;
-        using handler_t = void (*)(int);
-        handler_t handlers_[NSIG];
+        size_t slot_;
     };
 }
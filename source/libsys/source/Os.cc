@@ -23,16 +23,18 @@
 #include "config.h"
 
 #include <cerrno>
+#include <map>
+#include <mutex>
 #include <unistd.h>
 
 #include <fmt/format.h>
 
 
-namespace sys::os {
+namespace {
 
     constexpr const size_t BUFFER_SIZE = 1024;
 
-    rust::Result<std::string> get_confstr(const int key)
+    rust::Result<std::string> query_confstr(const int key)
     {
 #ifdef HAVE_CONFSTR
         errno = 0;
@@ -44,11 +46,32 @@ namespace sys::os {
             }
         }
         return rust::Err(std::runtime_error(
-            fmt::format("System call \"confstr\" failed.: {}", error_string(errno))));
+            fmt::format("System call \"confstr\" failed.: {}", sys::error_string(errno))));
 #else
 #error "System call "confstr" not exists."
 #endif
     }
+}
+
+namespace sys::os {
+
+    // The confstr values are constants for the process lifetime, so the
+    // system is asked only once per key; later calls replay the stored
+    // answer. (Failures are stored too: a key the system does not know
+    // will not be known on a retry either.)
+    rust::Result<std::string> get_confstr(const int key)
+    {
+        static std::mutex mutex;
+        static std::map<int, rust::Result<std::string>> cache;
+
+        const std::lock_guard<std::mutex> lock(mutex);
+        if (const auto it = cache.find(key); it != cache.end()) {
+            return it->second;
+        }
+        auto result = query_confstr(key);
+        cache.emplace(key, result);
+        return result;
+    }
 
     rust::Result<std::string> get_path(const sys::env::Vars& environment)
     {
@@ -79,4 +79,21 @@ namespace sys::path {
                ? rust::Result<fs::path>(rust::Err(std::runtime_error(error_code.message())))
                : rust::Result<fs::path>(rust::Ok(result));
     }
+
+    rust::Result<fs::path> Context::get_cwd()
+    {
+        if (cwd_) {
+            return rust::Ok(cwd_.value());
+        }
+        // failures are not cached; the next call asks the system again.
+        return sys::path::get_cwd()
+                .on_success([this](const auto &result) {
+                    cwd_ = result;
+                });
+    }
+
+    void Context::invalidate()
+    {
+        cwd_.reset();
+    }
 }
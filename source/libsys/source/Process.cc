@@ -20,6 +20,7 @@
 #include "libsys/Process.h"
 #include "libsys/Path.h"
 #include "libsys/Errors.h"
+#include "libsys/Signal.h"
 #include "Guard.h"
 
 #include <cerrno>
@@ -27,11 +28,19 @@
 #include <cstdlib>
 #include <filesystem>
 #include <utility>
+#include <vector>
 #include <iostream>
 
 #ifdef HAVE_SYS_WAIT_H
 #include <sys/wait.h>
 #endif
+#include <sys/resource.h>
+#if defined(HAVE_SYS_SIGNALFD_H) && defined(HAVE_PIDFD_OPEN) && defined(HAVE_PIDFD_SEND_SIGNAL)
+#define SUPPORT_PIDFD_SUPERVISE
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#endif
 #ifdef HAVE_SPAWN_H
 #include <spawn.h>
 #endif
@@ -53,13 +62,14 @@ namespace {
     constexpr char PATH_TO_SH[] = "/bin/sh";
 
     struct Arguments {
-        const std::list<std::string>& value;
+        // the nullptr terminated argument pointers.
+        const std::vector<char*>& value;
     };
 
     std::ostream& operator<<(std::ostream& os, const Arguments& arguments)
     {
         os << '[';
-        for (auto it = arguments.value.begin(); it != arguments.value.end(); ++it) {
+        for (auto it = arguments.value.begin(); it != arguments.value.end() && *it != nullptr; ++it) {
             if (it != arguments.value.begin()) {
                 os << ", ";
             }
@@ -84,14 +94,61 @@ namespace {
             char* const argv[],
             char* const envp[])>;
 
-    rust::Result<spawn_function_t> reference_spawn_function()
+    // The spawn attributes for the children this process creates.
+    //
+    // Recent glibc implements posix_spawn with a vfork style clone: the
+    // child borrows the parent's address space until the exec, so the
+    // spawn does not pay for duplicating the page tables of a large
+    // parent. Older releases only do so when asked explicitly, hence
+    // the flag where it exists.
+    //
+    // With `own_group` the child becomes the leader of a new process
+    // group (the zero group id below stands for the child's own pid).
+    //
+    // The child always starts with an empty signal mask: a supervising
+    // parent blocks the forwarded signals (see the signalfd loop), and
+    // the block would be inherited otherwise.
+    const posix_spawnattr_t* make_attributes(bool own_group)
+    {
+        short flags = POSIX_SPAWN_SETSIGMASK;
+#ifdef POSIX_SPAWN_USEVFORK
+        flags |= POSIX_SPAWN_USEVFORK;
+#endif
+        if (own_group) {
+            flags |= POSIX_SPAWN_SETPGROUP;
+        }
+        auto* attributes = new posix_spawnattr_t;
+        if (0 != ::posix_spawnattr_init(attributes)) {
+            delete attributes;
+            return nullptr;
+        }
+        ::posix_spawnattr_setflags(attributes, flags);
+        sigset_t empty;
+        sigemptyset(&empty);
+        ::posix_spawnattr_setsigmask(attributes, &empty);
+        if (own_group) {
+            ::posix_spawnattr_setpgroup(attributes, 0);
+        }
+        return attributes;
+    }
+
+    const posix_spawnattr_t* spawn_attributes(bool own_group)
     {
-        spawn_function_t result = [](const char* path,
+        static const posix_spawnattr_t* const attributes[2] = {
+                make_attributes(false),
+                make_attributes(true),
+        };
+        return attributes[own_group ? 1 : 0];
+    }
+
+    rust::Result<spawn_function_t> reference_spawn_function(bool own_group = false)
+    {
+        spawn_function_t result = [own_group](const char* path,
                                      char* const argv[],
                                      char* const envp[]) -> rust::Result<pid_t> {
             errno = 0;
             pid_t child;
-            if (0 != ::posix_spawnp(&child, path, nullptr, nullptr, const_cast<char**>(argv), const_cast<char**>(envp))) {
+            if (0 != ::posix_spawnp(&child, path, nullptr, spawn_attributes(own_group), const_cast<char**>(argv), const_cast<char**>(envp))) {
                 return rust::Err(std::runtime_error(
                     fmt::format("System call \"posix_spawnp\" failed for {}: {}", path, sys::error_string(errno))));
             } else {
@@ -124,7 +181,7 @@ namespace {
 
             errno = 0;
             pid_t child;
-            if (0 != (*fp)(&child, path, nullptr, nullptr, const_cast<char**>(argv), const_cast<char**>(envp))) {
+            if (0 != (*fp)(&child, path, nullptr, spawn_attributes(false), const_cast<char**>(argv), const_cast<char**>(envp))) {
                 ::dlclose(handle);
                 return rust::Err(std::runtime_error(
                     fmt::format("System call \"posix_spawnp\" failed for {}: {}", path, sys::error_string(errno))));
@@ -140,55 +197,89 @@ namespace {
     rust::Result<sys::Process> spawn_process(
             spawn_function_t fp,
             const fs::path& program,
-            const std::list<std::string>& parameters,
-            const std::map<std::string, std::string>& environment)
-    {
-        // convert the arguments into a c-style array
-        std::vector<char*> args;
-        std::transform(parameters.begin(), parameters.end(),
-                       std::back_insert_iterator(args),
-                       [](const auto& arg) { return const_cast<char*>(arg.c_str()); });
-        args.push_back(nullptr);
-        // convert the environment into a c-style array
-        sys::env::Guard env(environment);
-
-        return fp(program.c_str(), args.data(), const_cast<char**>(env.data()))
+            std::vector<char*> args,
+            const char** envp,
+            bool own_group = false)
+    {
+        return fp(program.c_str(), args.data(), const_cast<char**>(envp))
                 // The file is accessible but it is not an executable file.
                 // Invoke the shell to interpret it as a script.
                 .or_else([&](const std::runtime_error&) {
                     args.insert(args.begin(), const_cast<char*>(PATH_TO_SH));
-                    return fp(PATH_TO_SH, args.data(), const_cast<char**>(env.data()));
+                    return fp(PATH_TO_SH, args.data(), const_cast<char**>(envp));
                 })
-                .map<sys::Process>([](const auto& pid) {
-                    return sys::Process(pid);
+                .map<sys::Process>([own_group](const auto& pid) {
+                    return sys::Process(pid, own_group);
                 })
-                .on_success([&parameters](const auto& process) {
-                    spdlog::debug("Process spawned. [pid: {}, command: {}]",
-                                  process.get_pid(), Arguments { parameters });
+                .on_success([&args](const auto& process) {
+                    SPDLOG_DEBUG("Process spawned. [pid: {}, command: {}]",
+                                  process.get_pid(), Arguments { args });
                 })
                 .on_error([](const auto& error) {
-                    spdlog::debug("Process spawn failed. {}", error.what());
+                    SPDLOG_DEBUG("Process spawn failed. {}", error.what());
                 });
     }
 
+    rust::Result<sys::Process> spawn_process(
+            spawn_function_t fp,
+            const fs::path& program,
+            std::vector<char*> args,
+            const std::map<std::string, std::string>& environment,
+            bool own_group = false)
+    {
+        // convert the environment into a c-style array
+        sys::env::Guard env(environment);
+
+        return spawn_process(fp, program, std::move(args), env.data(), own_group);
+    }
+
+    // Translates the kernel accounting of a reaped child. (`ru_maxrss`
+    // is in kilobytes on Linux and in bytes on macOS.)
+    sys::ResourceUsage decode_usage(const struct rusage &usage)
+    {
+        return sys::ResourceUsage {
+                static_cast<uint64_t>(usage.ru_utime.tv_sec) * 1000000u
+                        + static_cast<uint64_t>(usage.ru_utime.tv_usec),
+                static_cast<uint64_t>(usage.ru_stime.tv_sec) * 1000000u
+                        + static_cast<uint64_t>(usage.ru_stime.tv_usec),
+#ifdef __APPLE__
+                static_cast<uint64_t>(usage.ru_maxrss) / 1024u,
+#else
+                static_cast<uint64_t>(usage.ru_maxrss),
+#endif
+        };
+    }
+
+    rust::Result<sys::ExitStatus> decode_status(int status, const struct rusage *usage)
+    {
+        if (WIFEXITED(status)) {
+            return (usage != nullptr)
+                    ? rust::Ok(sys::ExitStatus(true, WEXITSTATUS(status), decode_usage(*usage)))
+                    : rust::Ok(sys::ExitStatus(true, WEXITSTATUS(status)));
+        } else if (WIFSIGNALED(status)) {
+            return (usage != nullptr)
+                    ? rust::Ok(sys::ExitStatus(false, WTERMSIG(status), decode_usage(*usage)))
+                    : rust::Ok(sys::ExitStatus(false, WTERMSIG(status)));
+        } else if (WIFSTOPPED(status)) {
+            return rust::Ok(sys::ExitStatus(false, WSTOPSIG(status)));
+        } else if (WIFCONTINUED(status)) {
+            return rust::Ok(sys::ExitStatus(false, SIGCONT));
+        } else {
+            return rust::Err(std::runtime_error("System call \"waitpid\" result is broken."));
+        }
+    }
+
     rust::Result<sys::ExitStatus> wait_for(pid_t pid, bool request_for_signals)
     {
         errno = 0;
         const int mask = request_for_signals ? (WUNTRACED | WCONTINUED) : 0;
-        if (int status; -1 != ::waitpid(pid, &status, mask)) {
-            if (WIFEXITED(status)) {
-                return rust::Ok(sys::ExitStatus(true, WEXITSTATUS(status)));
-            } else if (WIFSIGNALED(status)) {
-                return rust::Ok(sys::ExitStatus(false, WTERMSIG(status)));
-            } else if (WIFSTOPPED(status)) {
-                return rust::Ok(sys::ExitStatus(false, WSTOPSIG(status)));
-            } else if (WIFCONTINUED(status)) {
-                return rust::Ok(sys::ExitStatus(false, SIGCONT));
-            } else {
-                return rust::Err(std::runtime_error("System call \"waitpid\" result is broken."));
-            }
+        struct rusage usage;
+        if (int status; -1 != ::wait4(pid, &status, mask, &usage)) {
+            // the accounting is valid for a reaped process only.
+            const bool reaped = WIFEXITED(status) || WIFSIGNALED(status);
+            return decode_status(status, reaped ? &usage : nullptr);
         } else {
-            auto message = fmt::format("System call \"waitpid\" failed: {}", sys::error_string(errno));
+            auto message = fmt::format("System call \"wait4\" failed: {}", sys::error_string(errno));
             return rust::Err(std::runtime_error(message));
         }
     }
@@ -203,6 +294,148 @@ namespace {
             return rust::Err(std::runtime_error(message));
         }
     }
+
+    // Replicates the previous supervision loop: asynchronous signal
+    // handlers forward the signals, while the process blocks in waitpid.
+    rust::Result<sys::ExitStatus> supervise_with_handlers(
+            sys::Process &child,
+            const std::function<void(const sys::ExitStatus &)> &observer)
+    {
+        // the handlers deliver on this thread: clear any inherited block
+        // (a caller preparing for the signalfd loop blocks the signals
+        // early, before its threads start).
+        sigset_t open_mask;
+        sigemptyset(&open_mask);
+        ::pthread_sigmask(SIG_SETMASK, &open_mask, nullptr);
+        sys::SignalForwarder guard(child);
+        while (true) {
+            auto status = child.wait(true).on_success(observer);
+            const bool exited = status
+                    .map<bool>([](auto exit) { return exit.is_exited(); })
+                    .unwrap_or(true);
+            if (exited) {
+                return status;
+            }
+        }
+    }
+
+#ifdef SUPPORT_PIDFD_SUPERVISE
+    std::optional<rust::Result<sys::ExitStatus>> try_reap(pid_t pid)
+    {
+        errno = 0;
+        int status;
+        struct rusage usage;
+        const pid_t result = ::wait4(pid, &status, WNOHANG | WUNTRACED | WCONTINUED, &usage);
+        if (result == 0) {
+            return std::nullopt;
+        }
+        if (result == -1) {
+            auto message = fmt::format("System call \"wait4\" failed: {}", sys::error_string(errno));
+            return std::make_optional(rust::Result<sys::ExitStatus>(rust::Err(std::runtime_error(message))));
+        }
+        const bool reaped = WIFEXITED(status) || WIFSIGNALED(status);
+        return std::make_optional(decode_status(status, reaped ? &usage : nullptr));
+    }
+
+    // Tells if this process runs a single thread.
+    bool single_threaded()
+    {
+        std::error_code error_code;
+        size_t count = 0;
+        for (const auto &entry : fs::directory_iterator("/proc/self/task", error_code)) {
+            (void) entry;
+            if (++count > 1) {
+                return false;
+            }
+        }
+        return !error_code && count == 1;
+    }
+
+    // Supervision without asynchronous signal handlers: the signals are
+    // blocked and consumed from a signalfd, the forwarding targets a pidfd
+    // (immune to pid reuse), and a single poll drives both. Returns no
+    // value when the file descriptors could not be set up; the caller
+    // shall fall back to the signal handler based loop then.
+    std::optional<rust::Result<sys::ExitStatus>> supervise_with_pidfd(
+            sys::Process &child,
+            const std::function<void(const sys::ExitStatus &)> &observer)
+    {
+        sigset_t mask;
+        sigfillset(&mask);
+        sigset_t previous;
+        if (0 != ::pthread_sigmask(SIG_BLOCK, &mask, &previous)) {
+            return std::nullopt;
+        }
+        // The mask is per thread: when other threads run with an open
+        // mask, a process directed signal is delivered to one of those
+        // and never queues for the signalfd. That is safe only when the
+        // caller blocked the signals before its threads started (the
+        // mask is inherited); otherwise the handler based loop is the
+        // right one, handlers are process wide.
+        if (!::sigismember(&previous, SIGTERM) && !single_threaded()) {
+            ::pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+            return std::nullopt;
+        }
+        const int signal_fd = ::signalfd(-1, &mask, SFD_CLOEXEC);
+        const int pid_fd = static_cast<int>(::syscall(SYS_pidfd_open, child.get_pid(), 0));
+        const auto restore = [&previous, &signal_fd, &pid_fd]() {
+            if (signal_fd != -1) {
+                ::close(signal_fd);
+            }
+            if (pid_fd != -1) {
+                ::close(pid_fd);
+            }
+            ::pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+        };
+        if (signal_fd == -1 || pid_fd == -1) {
+            restore();
+            return std::nullopt;
+        }
+        while (true) {
+            pollfd entries[] = {
+                    { signal_fd, POLLIN, 0 },
+                    { pid_fd, POLLIN, 0 },
+            };
+            if (-1 == ::poll(entries, 2, -1)) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                auto message = fmt::format("System call \"poll\" failed: {}", sys::error_string(errno));
+                restore();
+                return std::make_optional(rust::Result<sys::ExitStatus>(rust::Err(std::runtime_error(message))));
+            }
+            if (entries[0].revents & POLLIN) {
+                signalfd_siginfo info = {};
+                if (sizeof(info) == ::read(signal_fd, &info, sizeof(info))) {
+                    const auto signum = static_cast<int>(info.ssi_signo);
+                    if (signum != SIGCHLD && signum != SIGKILL && signum != SIGSTOP) {
+                        if (child.leads_group()) {
+                            // one group targeted signal tears down the
+                            // whole tree; the pidfd only names its leader.
+                            ::kill(-child.get_pid(), signum);
+                        } else {
+                            ::syscall(SYS_pidfd_send_signal, pid_fd, signum, nullptr, 0);
+                        }
+                    }
+                }
+            }
+            // A SIGCHLD or the pidfd becoming readable both mean a state
+            // change; a non blocking waitpid tells which one it was. The
+            // kernel coalesces SIGCHLD, so one wakeup may stand for
+            // several state changes: drained until nothing is pending.
+            while (auto status = try_reap(child.get_pid())) {
+                const bool exited = status.value()
+                        .on_success(observer)
+                        .map<bool>([](auto exit) { return exit.is_exited(); })
+                        .unwrap_or(true);
+                if (exited) {
+                    restore();
+                    return status;
+                }
+            }
+        }
+    }
+#endif
 }
 
 namespace sys {
@@ -210,6 +443,14 @@ namespace sys {
     ExitStatus::ExitStatus(bool is_code, int code)
             : is_code_(is_code)
             , code_(code)
+            , resources_()
+    {
+    }
+
+    ExitStatus::ExitStatus(bool is_code, int code, ResourceUsage resources)
+            : is_code_(is_code)
+            , code_(code)
+            , resources_(resources)
     {
     }
 
@@ -233,8 +474,14 @@ namespace sys {
         return is_code_ || ((code_ != SIGCONT) && (code_ != SIGSTOP));
     }
 
-    Process::Process(pid_t pid)
+    std::optional<ResourceUsage> ExitStatus::resources() const
+    {
+        return resources_;
+    }
+
+    Process::Process(pid_t pid, bool leads_group)
             : pid_(pid)
+            , leads_group_(leads_group)
     {
     }
 
@@ -243,72 +490,116 @@ namespace sys {
         return pid_;
     }
 
+    bool Process::leads_group() const
+    {
+        return leads_group_;
+    }
+
     rust::Result<ExitStatus> Process::wait(bool request_for_signals)
     {
-        spdlog::debug("Process wait requested. [pid: {}]", pid_);
+        SPDLOG_DEBUG("Process wait requested. [pid: {}]", pid_);
         return wait_for(pid_, request_for_signals)
             .on_success([this](const auto&) {
-                spdlog::debug("Process wait request: done. [pid: {}]", pid_);
+                SPDLOG_DEBUG("Process wait request: done. [pid: {}]", pid_);
             })
             .on_error([this](const auto& error) {
-                spdlog::debug("Process wait request: failed. [pid: {}] {}", pid_, error.what());
+                SPDLOG_DEBUG("Process wait request: failed. [pid: {}] {}", pid_, error.what());
             });
     }
 
     rust::Result<int> Process::kill(int num)
     {
-        spdlog::debug("Process kill requested. [pid: {}, signum: {}]", pid_, num);
+        SPDLOG_DEBUG("Process kill requested. [pid: {}, signum: {}]", pid_, num);
         return send_signal(pid_, num)
             .on_success([this](const auto&) {
-                spdlog::debug("Process kill request: done. [pid: {}]", pid_);
+                SPDLOG_DEBUG("Process kill request: done. [pid: {}]", pid_);
             })
             .on_error([this](const auto& error) {
-                spdlog::debug("Process kill request: failed. [pid: {}] {}", pid_, error.what());
+                SPDLOG_DEBUG("Process kill request: failed. [pid: {}] {}", pid_, error.what());
             });
     }
 
+    rust::Result<ExitStatus> supervise(Process &child, const std::function<void(const ExitStatus &)> &observer)
+    {
+        SPDLOG_DEBUG("Process supervise requested. [pid: {}]", child.get_pid());
+#ifdef SUPPORT_PIDFD_SUPERVISE
+        if (auto status = supervise_with_pidfd(child, observer); status) {
+            return status.value();
+        }
+        SPDLOG_DEBUG("Process supervise: signalfd setup failed, using signal handlers. [pid: {}]", child.get_pid());
+#endif
+        return supervise_with_handlers(child, observer);
+    }
+
     Process::Builder::Builder(fs::path program)
         : program_(std::move(program))
-        , parameters_()
-        , environment_()
+        , arena_()
+        , offsets_()
+        , environment_(std::make_shared<const sys::env::Vars>())
+        , process_group_(false)
     {
     }
 
     Process::Builder& Process::Builder::add_argument(const char* param)
     {
-        parameters_.emplace_back(std::string(param));
-        return *this;
+        return add_argument(std::string_view(param));
     }
 
     Process::Builder& Process::Builder::add_argument(std::string&& param)
     {
-        parameters_.emplace_back(param);
-        return *this;
+        return add_argument(std::string_view(param));
     }
 
     Process::Builder& Process::Builder::add_argument(const std::string_view& param)
     {
-        parameters_.emplace_back(std::string(param));
+        offsets_.push_back(arena_.size());
+        arena_.append(param);
+        arena_.push_back(char(0));
         return *this;
     }
 
     Process::Builder& Process::Builder::set_environment(std::map<std::string, std::string>&& environment)
     {
-        std::swap(environment_, environment);
+        environment_ = std::make_shared<const sys::env::Vars>(std::move(environment));
         return *this;
     }
 
     Process::Builder& Process::Builder::set_environment(const std::map<std::string, std::string>& environment)
     {
-        environment_ = environment;
+        environment_ = std::make_shared<const sys::env::Vars>(environment);
+        return *this;
+    }
+
+    Process::Builder& Process::Builder::set_environment(sys::env::VarsPtr environment)
+    {
+        environment_ = std::move(environment);
+        return *this;
+    }
+
+    Process::Builder& Process::Builder::set_process_group()
+    {
+        process_group_ = true;
         return *this;
     }
 
+    // Builds the nullptr terminated pointer array over the arena. The
+    // pointers stay valid while the builder is alive and unchanged.
+    std::vector<char*> Process::Builder::arguments()
+    {
+        std::vector<char*> result;
+        result.reserve(offsets_.size() + 1);
+        for (const size_t offset : offsets_) {
+            result.push_back(arena_.data() + offset);
+        }
+        result.push_back(nullptr);
+        return result;
+    }
+
     rust::Result<Process> Process::Builder::spawn()
     {
-        return reference_spawn_function()
+        return reference_spawn_function(process_group_)
             .and_then<Process>([this](auto fp) {
-                return spawn_process(fp, program_, parameters_, environment_);
+                return spawn_process(fp, program_, arguments(), *environment_, process_group_);
             });
     }
 
@@ -317,8 +608,58 @@ namespace sys {
     {
         return resolve_spawn_function()
             .and_then<Process>([this](auto fp) {
-                return spawn_process(fp, program_, parameters_, environment_);
+                return spawn_process(fp, program_, arguments(), *environment_);
             });
     }
 #endif
+
+    std::shared_ptr<const Process::Prepared> Process::Builder::prepare() const
+    {
+        return std::make_shared<const Prepared>(program_, arena_, offsets_, *environment_, process_group_);
+    }
+
+    Process::Prepared::Prepared(
+            fs::path program,
+            const std::string &arguments,
+            const std::vector<size_t> &offsets,
+            const sys::env::Vars &environment,
+            bool process_group)
+        : program_(std::move(program))
+        , argument_arena_(arguments)
+        , environment_arena_()
+        , argv_()
+        , envp_()
+        , process_group_(process_group)
+    {
+        // render the environment into one arena; the pointer arrays are
+        // built afterwards, when the arenas no longer grow.
+        std::vector<size_t> environment_offsets;
+        environment_offsets.reserve(environment.size());
+        for (const auto& [key, value] : environment) {
+            environment_offsets.push_back(environment_arena_.size());
+            environment_arena_.append(key);
+            environment_arena_.push_back('=');
+            environment_arena_.append(value);
+            environment_arena_.push_back(char(0));
+        }
+        argv_.reserve(offsets.size() + 1);
+        for (const size_t offset : offsets) {
+            argv_.push_back(argument_arena_.data() + offset);
+        }
+        argv_.push_back(nullptr);
+        envp_.reserve(environment_offsets.size() + 1);
+        for (const size_t offset : environment_offsets) {
+            envp_.push_back(environment_arena_.data() + offset);
+        }
+        envp_.push_back(nullptr);
+    }
+
+    rust::Result<Process> Process::Prepared::spawn() const
+    {
+        return reference_spawn_function(process_group_)
+            .and_then<Process>([this](auto fp) {
+                // the script fallback prepends to the argv, hence a copy.
+                return spawn_process(fp, program_, argv_, const_cast<const char**>(envp_.data()), process_group_);
+            });
+    }
 }
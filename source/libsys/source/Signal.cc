@@ -20,7 +20,8 @@
 #include "libsys/Signal.h"
 #include "libsys/Process.h"
 
-#include <set>
+#include <atomic>
+#include <mutex>
 
 namespace {
 
@@ -35,12 +36,50 @@ namespace {
         }
     }
 
-    std::set<pid_t> CHILD_PROCESSES;
+    // The children are registered in a fixed table of atomic slots (a
+    // zero entry is a free one). The handler only loads the entries, so
+    // the dispatch stays async-signal-safe and free of locks, and a
+    // registration is a single compare-and-swap.
+    //
+    // A child leading its own process group registers with a negated
+    // pid: the kill then targets the whole group, so the teardown of a
+    // deep process tree is one syscall instead of a cascade through the
+    // intermediate processes.
+    constexpr size_t CHILD_SLOTS = 64;
+    std::atomic<pid_t> CHILD_PROCESSES[CHILD_SLOTS];
 
     void handler(int signum) {
         if (shall_forward(signum)) {
-            for (auto pid : CHILD_PROCESSES) {
-                ::kill(pid, signum);
+            for (auto &slot : CHILD_PROCESSES) {
+                if (const pid_t pid = slot.load(); pid != 0) {
+                    ::kill(pid, signum);
+                }
+            }
+        }
+    }
+
+    // The handlers are process-wide: the first registered child installs
+    // them and the last one leaving restores the originals. Only this
+    // bookkeeping takes the lock, the dispatch table above does not.
+    std::mutex HANDLER_MUTEX;
+    size_t HANDLER_USERS = 0;
+    using handler_t = void (*)(int);
+    handler_t SAVED_HANDLERS[NSIG];
+
+    void acquire_handlers() {
+        const std::lock_guard<std::mutex> lock(HANDLER_MUTEX);
+        if (HANDLER_USERS++ == 0) {
+            for (int signum = 1; signum < NSIG; ++signum) {
+                SAVED_HANDLERS[signum] = ::signal(signum, &handler);
+            }
+        }
+    }
+
+    void release_handlers() {
+        const std::lock_guard<std::mutex> lock(HANDLER_MUTEX);
+        if (--HANDLER_USERS == 0) {
+            for (int signum = 1; signum < NSIG; ++signum) {
+                ::signal(signum, SAVED_HANDLERS[signum]);
             }
         }
     }
@@ -49,20 +88,25 @@ namespace {
 namespace sys {
 
     SignalForwarder::SignalForwarder(const Process &child) noexcept
-            : pid_(child.get_pid())
-            , handlers_()
+            : pid_(child.leads_group() ? -child.get_pid() : child.get_pid())
+            , slot_(CHILD_SLOTS)
     {
-        CHILD_PROCESSES.insert(pid_);
-        for (int signum = 1; signum < NSIG; ++signum) {
-            handlers_[signum] = ::signal(signum, &handler);
+        for (size_t idx = 0; idx < CHILD_SLOTS; ++idx) {
+            if (pid_t expected = 0; CHILD_PROCESSES[idx].compare_exchange_strong(expected, pid_)) {
+                slot_ = idx;
+                break;
+            }
         }
+        // a full table means this child gets no forwarded signals; the
+        // supervision itself is not affected.
+        acquire_handlers();
     }
 
     SignalForwarder::~SignalForwarder() noexcept
     {
-        CHILD_PROCESSES.erase(pid_);
-        for (int signum = 1; signum < NSIG; ++signum) {
-            ::signal(signum, handlers_[signum]);
+        if (slot_ < CHILD_SLOTS) {
+            CHILD_PROCESSES[slot_].store(0);
         }
+        release_handlers();
     }
 }